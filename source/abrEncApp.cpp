@@ -122,11 +122,17 @@ namespace X265_NS {
 #endif
             for (uint8_t pass = 0; pass < m_numEncodes; pass++)
             {
-                m_inputPicBuffer[pass] = X265_MALLOC(x265_picture*, m_queueSize);
-                for (uint32_t idx = 0; idx < m_queueSize; idx++)
+                /* owners always precede the rungs sharing their queue */
+                if (m_passEnc[pass]->m_srcId != pass)
+                    m_inputPicBuffer[pass] = m_inputPicBuffer[m_passEnc[pass]->m_srcId];
+                else
                 {
-                    m_inputPicBuffer[pass][idx] = x265_picture_alloc();
-                    x265_picture_init(m_passEnc[pass]->m_param, m_inputPicBuffer[pass][idx]);
+                    m_inputPicBuffer[pass] = X265_MALLOC(x265_picture*, m_queueSize);
+                    for (uint32_t idx = 0; idx < m_queueSize; idx++)
+                    {
+                        m_inputPicBuffer[pass][idx] = x265_picture_alloc();
+                        x265_picture_init(m_passEnc[pass]->m_param, m_inputPicBuffer[pass][idx]);
+                    }
                 }
 
                 CHECKED_MALLOC_ZERO(m_analysisBuffer[pass], x265_analysis_data, m_queueSize);
@@ -175,13 +181,18 @@ namespace X265_NS {
 #endif
             for (uint8_t pass = 0; pass < m_numEncodes; pass++)
             {
+                bool bOwner = m_passEnc[pass]->m_srcId == pass;
                 for (uint32_t index = 0; index < m_queueSize; index++)
                 {
-                    X265_FREE(m_inputPicBuffer[pass][index]->planes[0]);
-                    x265_picture_free(m_inputPicBuffer[pass][index]);
+                    if (bOwner)
+                    {
+                        X265_FREE(m_inputPicBuffer[pass][index]->planes[0]);
+                        x265_picture_free(m_inputPicBuffer[pass][index]);
+                    }
                     x265_free_analysis_data(&m_param[pass], &m_analysisBuffer[pass][index]);
                 }
-                X265_FREE(m_inputPicBuffer[pass]);
+                if (bOwner)
+                    X265_FREE(m_inputPicBuffer[pass]);
 
                 X265_FREE(m_analysisBuffer[pass]);
                 X265_FREE(m_readFlag[pass]);
@@ -227,16 +238,79 @@ namespace X265_NS {
         m_encoder = NULL;
         m_scaler = NULL;
         m_reader = NULL;
+        m_directInput = false;
+        m_srcId = id;
+        m_numConsumers = 1;
         m_ret = 0;
     }
 
+    /* Whether this rung reads exactly the frames of the input of owner; with
+     * bFiltered they must also pass through the same --vf filter chain */
+    bool PassEncoder::sharesInput(const PassEncoder& owner, bool bFiltered) const
+    {
+        const CLIOptions& a = m_cliopt;
+        const CLIOptions& b = owner.m_cliopt;
+        const InputFileInfo& ia = a.inputInfo;
+        const InputFileInfo& ib = b.inputInfo;
+
+        /* dithering converts the planes of the picture in place */
+        if (a.bDither || b.bDither || !a.inputName[0])
+            return false;
+        if (m_param->numViews > 1 || m_param->format || owner.m_param->numViews > 1 || owner.m_param->format ||
+            m_param->numScalableLayers != owner.m_param->numScalableLayers)
+            return false;
+        if (strcmp(a.inputName, b.inputName) || ia.width != ib.width || ia.height != ib.height ||
+            ia.csp != ib.csp || ia.depth != ib.depth || ia.fpsNum != ib.fpsNum || ia.fpsDenom != ib.fpsDenom ||
+            a.seek != b.seek || a.framesToBeEncoded != b.framesToBeEncoded)
+            return false;
+        if (!bFiltered)
+            return true;
+        return a.vf ? b.vf && !strcmp(a.vf, b.vf) : !b.vf;
+    }
+
     int PassEncoder::init(int &result)
     {
         if (m_parent->m_numEncodes > 1)
             setReuseLevel();
                 
-        if (!(m_cliopt.enableScaler && m_id))
+        /* Encode from the source queue of an earlier rung which reads the same
+         * input through the same filters. Failing that, an earlier rung which
+         * holds the unfiltered input feeds our filters, so the input is only
+         * read once and each distinct filter chain runs once per frame */
+        int upstreamId = -1;
+        if (m_parent->m_numEncodes > 1 && !m_cliopt.enableScaler)
+        {
+            for (uint32_t i = 0; i < m_id && m_srcId == m_id; i++)
+            {
+                PassEncoder* owner = m_parent->m_passEnc[i];
+                if (owner->m_srcId == i && sharesInput(*owner, true))
+                    m_srcId = i;
+            }
+            for (uint32_t i = 0; i < m_id && m_srcId == m_id && upstreamId < 0 && m_cliopt.filters.size(); i++)
+            {
+                PassEncoder* owner = m_parent->m_passEnc[i];
+                if (owner->m_srcId == i && !owner->m_cliopt.filters.size() && sharesInput(*owner, false))
+                    upstreamId = i;
+            }
+        }
+
+        if (m_srcId != m_id)
+        {
+            m_parent->m_passEnc[m_srcId]->m_numConsumers++;
+            x265_log(m_param, X265_LOG_INFO, "%s: encoding from the source frames of %s\n",
+                     m_cliopt.encName, m_parent->m_passEnc[m_srcId]->m_cliopt.encName);
+        }
+        else if (!(m_cliopt.enableScaler && m_id))
+        {
             m_reader = new Reader(m_id, this);
+            if (upstreamId >= 0)
+            {
+                m_reader->m_upstreamId = upstreamId;
+                m_parent->m_passEnc[upstreamId]->m_numConsumers++;
+                x265_log(m_param, X265_LOG_INFO, "%s: filtering the source frames of %s\n",
+                         m_cliopt.encName, m_parent->m_passEnc[upstreamId]->m_cliopt.encName);
+            }
+        }
         else
         {
             VideoDesc *src = NULL, *dst = NULL;
@@ -295,6 +369,26 @@ namespace X265_NS {
         /* get the encoder parameters post-initialization */
         m_cliopt.api->encoder_parameters(m_encoder, m_param);
 
+        if (m_reader)
+        {
+            /* let the input read straight into the encoder's source frames when
+             * nothing in the CLI touches the pixels on their way to the encoder */
+            bool bSingleInput = m_parent->m_numEncodes == 1 && m_param->numViews == 1 &&
+                                !m_param->format && !(m_param->bField && m_param->interlaceMode);
+            m_directInput = bSingleInput && !m_cliopt.filters.size() &&
+                            m_input[0]->useEncoderBuffers(m_cliopt.api, m_encoder);
+
+            /* run the filter chain on several frames at once; the last filter
+             * then writes into the encoder's source frames when it can */
+            if (m_cliopt.filterThreads > 1 && m_param->numViews - !!m_param->format == 1 &&
+                FilterPipeline::isSupported(m_cliopt.filters))
+                m_reader->m_pipeline = new FilterPipeline(m_cliopt.filters, m_cliopt.filterThreads, m_cliopt.api,
+                                                          bSingleInput ? m_encoder : NULL);
+
+            for (int view = 0; m_reader->m_upstreamId < 0 && view < m_param->numViews - !!m_param->format; view++)
+                m_input[view]->startReader();
+        }
+
         return 1;
     }
 
@@ -489,13 +583,14 @@ ret:
     bool PassEncoder::readPicture(x265_picture* dstPic, int view)
     {
         /*Check and wait if there any input frames to read*/
+        PassEncoder* source = m_parent->m_passEnc[m_srcId];
         int ipread = m_parent->m_picReadCnt[m_id].get();
-        int ipwrite = m_parent->m_picWriteCnt[m_id].get();
+        int ipwrite = m_parent->m_picWriteCnt[m_srcId].get();
 
         bool isAbrLoad = m_cliopt.loadLevel && (m_parent->m_numEncodes > 1);
-        while (!m_inputOver && (ipread == ipwrite))
+        while (!source->m_inputOver && (ipread == ipwrite))
         {
-            ipwrite = m_parent->m_picWriteCnt[m_id].waitForChange(ipwrite);
+            ipwrite = m_parent->m_picWriteCnt[m_srcId].waitForChange(ipwrite);
         }
 
         if (m_threadActive && ipread < ipwrite)
@@ -553,7 +648,7 @@ ret:
                         readPos = analysisData->poc % m_parent->m_queueSize;
                         while ((ipwrite < readPos) || ((ipwrite - 1) < (int)analysisData->poc))
                         {
-                            ipwrite = m_parent->m_picWriteCnt[m_id].waitForChange(ipwrite);
+                            ipwrite = m_parent->m_picWriteCnt[m_srcId].waitForChange(ipwrite);
                         }
                     }
 
@@ -648,7 +743,9 @@ ret:
                 else
                 {
                     m_cliopt.output->setPS(m_encoder);
+                    int64_t writeStart = x265_mdate();
                     m_cliopt.totalbytes += m_cliopt.output->writeHeaders(p_nal, nal);
+                    m_cliopt.outputBlockedTime += x265_mdate() - writeStart;
                 }
             }
 
@@ -827,8 +924,10 @@ ret:
 
                     int numEncoded = api->encoder_encode(m_encoder, &p_nal, &nal, picInput, pic_recon);
 
+                    /* release the queue slot once per picture, its fields have been copied */
                     int idx = (inFrameCount - 1) % m_parent->m_queueSize;
-                    m_parent->m_picIdxReadCnt[m_id][idx].incr();
+                    if (inputNum == inputPicNum - 1)
+                        m_parent->m_picIdxReadCnt[m_srcId][idx].incr();
                     m_parent->m_picReadCnt[m_id].incr();
                     if (m_cliopt.loadLevel && picInput)
                     {
@@ -860,7 +959,9 @@ ret:
                     }
                     if (nal)
                     {
+                        int64_t writeStart = x265_mdate();
                         m_cliopt.totalbytes += m_cliopt.output->writeFrame(p_nal, nal, pic_out[0]);
+                        m_cliopt.outputBlockedTime += x265_mdate() - writeStart;
                         if (pts_queue)
                         {
                             pts_queue->push(-pic_out[0].pts);
@@ -898,7 +999,9 @@ ret:
                 }
                 if (nal)
                 {
+                    int64_t writeStart = x265_mdate();
                     m_cliopt.totalbytes += m_cliopt.output->writeFrame(p_nal, nal, pic_out[0]);
+                    m_cliopt.outputBlockedTime += x265_mdate() - writeStart;
                     if (pts_queue)
                     {
                         pts_queue->push(-pic_out[0].pts);
@@ -948,6 +1051,8 @@ ret:
 #else
                 api->encoder_log(m_encoder, m_cliopt.argCnt, m_cliopt.argString);
 #endif
+            if (m_directInput || (m_reader && m_reader->m_pipeline))
+                stopDirectInput();
             api->encoder_close(m_encoder);
 
             int64_t second_largest_pts = 0;
@@ -961,7 +1066,17 @@ ret:
                 delete pts_queue;
                 pts_queue = NULL;
             }
+            int64_t closeStart = x265_mdate();
             m_cliopt.output->closeFile(largest_pts, second_largest_pts);
+            m_cliopt.outputBlockedTime += x265_mdate() - closeStart;
+
+            /* time the encode loop could not submit frames because the output
+             * (muxer or storage) had not caught up, reported as info only when
+             * it is a noticeable share of the encode */
+            int64_t elapsed = x265_mdate() - m_cliopt.startTime;
+            double blockedShare = elapsed > 0 ? 100.0 * m_cliopt.outputBlockedTime / elapsed : 0.0;
+            general_log(m_param, NULL, blockedShare >= 5.0 ? X265_LOG_INFO : X265_LOG_DEBUG, "output blocked %.2fs (%.1f%% of elapsed time) in %s\n",
+                        m_cliopt.outputBlockedTime / 1000000.0, blockedShare, profileName);
 
             if (b_ctrl_c)
             {
@@ -979,6 +1094,30 @@ ret:
         }
     }
 
+    /* Stop both reader threads and return every picture they still hold which
+     * points into the encoder's frame pool, before the encoder is closed */
+    void PassEncoder::stopDirectInput()
+    {
+        m_reader->m_threadActive = false;
+        for (uint32_t index = 0; index < m_parent->m_queueSize; index++)
+            m_parent->m_picIdxReadCnt[m_id][index].poke();
+        m_reader->stop();
+
+        bool bOwned = m_directInput;
+        if (m_reader->m_pipeline)
+        {
+            bOwned = m_reader->m_pipeline->usesEncoderBuffers();
+            m_reader->m_pipeline->releaseEncoderBuffers();
+        }
+        else
+            m_input[0]->releaseEncoderBuffers();
+
+        /* queued pictures not yet encoded are released by encoder_close */
+        for (uint32_t index = 0; bOwned && index < m_parent->m_queueSize; index++)
+            memset(m_parent->m_inputPicBuffer[m_id][index]->planes, 0, sizeof(m_parent->m_inputPicBuffer[m_id][index]->planes));
+        m_directInput = false;
+    }
+
     void PassEncoder::destroy()
     {
         stop();
@@ -1179,6 +1318,71 @@ ret:
         for (int view = 0; view < MAX_VIEWS; view++)
             m_input[view] = parentEnc->m_input[view];
         m_cliopt = &parentEnc->m_cliopt;
+        m_pipeline = NULL;
+        m_inputEnd = false;
+        m_upstreamId = -1;
+        m_upstreamRead = 0;
+        m_upstreamHeld = -1;
+    }
+
+    /* Read the next source frame, from the input file or from the source
+     * queue of the upstream rung. Upstream planes stay valid until
+     * releaseSource() */
+    bool Reader::readSource(x265_picture& pic)
+    {
+        if (m_upstreamId < 0)
+            return m_input[0]->readPicture(pic);
+
+        releaseSource();
+        AbrEncoder* parent = m_parentEnc->m_parent;
+        PassEncoder* upstream = parent->m_passEnc[m_upstreamId];
+        uint32_t written = parent->m_picWriteCnt[m_upstreamId].get();
+        while (m_threadActive && !upstream->m_inputOver && m_upstreamRead == written)
+            written = parent->m_picWriteCnt[m_upstreamId].waitForChange(written);
+        written = parent->m_picWriteCnt[m_upstreamId].get();
+        if (!m_threadActive || m_upstreamRead >= written)
+            return false;
+
+        m_upstreamHeld = m_upstreamRead++ % parent->m_queueSize;
+        x265_picture* srcPic = parent->m_inputPicBuffer[m_upstreamId][m_upstreamHeld];
+        pic.poc = srcPic->poc;
+        pic.pts = srcPic->pts;
+        pic.userSEI = srcPic->userSEI;
+        pic.bitDepth = srcPic->bitDepth;
+        pic.framesize = srcPic->framesize;
+        pic.height = srcPic->height;
+        pic.width = srcPic->width;
+        pic.colorSpace = srcPic->colorSpace;
+        pic.rpu.payload = srcPic->rpu.payload;
+        pic.picStruct = srcPic->picStruct;
+        memcpy(pic.stride, srcPic->stride, sizeof(pic.stride));
+        memcpy(pic.planes, srcPic->planes, sizeof(pic.planes));
+        return true;
+    }
+
+    /* Hand the upstream frame in use back to its queue */
+    void Reader::releaseSource()
+    {
+        if (m_upstreamHeld >= 0)
+        {
+            m_parentEnc->m_parent->m_picIdxReadCnt[m_upstreamId][m_upstreamHeld].incr();
+            m_upstreamHeld = -1;
+        }
+    }
+
+    /* Keep the filter pipeline full and return its oldest frame in pic. The
+     * planes stay valid until the next call */
+    bool Reader::readFiltered(x265_picture& pic)
+    {
+        while (!m_inputEnd && !m_pipeline->isFull())
+        {
+            if (readSource(pic) && !b_ctrl_c)
+                m_inputEnd = !m_pipeline->push(pic);
+            else
+                m_inputEnd = true;
+            releaseSource();
+        }
+        return !b_ctrl_c && m_pipeline->pop(pic);
     }
 
     void Reader::threadMain()
@@ -1199,21 +1403,23 @@ ret:
             if (m_parentEnc->m_cliopt.framesToBeEncoded && written >= m_parentEnc->m_cliopt.framesToBeEncoded)
                 break;
 
-            while (overWritePicBuffer && read < overWritePicBuffer)
+            while (m_threadActive && overWritePicBuffer && read < overWritePicBuffer * m_parentEnc->m_numConsumers)
             {
                 read = m_parentEnc->m_parent->m_picIdxReadCnt[m_id][writeIdx].waitForChange(read);
             }
+            if (!m_threadActive)
+                break;
 
             for (int view = 0; view < m_parentEnc->m_param->numViews - !!m_parentEnc->m_param->format; view++)
             {
                 x265_picture* dest = (m_parentEnc->m_param->numViews > 1) ? m_parentEnc->m_parent->m_inputPicBuffer[view][writeIdx] : m_parentEnc->m_parent->m_inputPicBuffer[m_id][writeIdx];
                 src->format = m_parentEnc->m_param->format;
-                if (m_input[view]->readPicture(*src) && !b_ctrl_c)
+                if (m_pipeline ? readFiltered(*src) : (m_upstreamId < 0 ? m_input[view]->readPicture(*src) : readSource(*src)) && !b_ctrl_c)
                 {
-                    for (auto &&i : m_cliopt->filters)
+                    for (size_t i = 0; !m_pipeline && i < m_cliopt->filters.size(); i++)
                     {
-                        i->processFrame(*src);
-                        if (i->isFail())
+                        m_cliopt->filters[i]->processFrame(*src);
+                        if (m_cliopt->filters[i]->isFail())
                         {
                             m_threadActive = false;
                             m_parentEnc->m_inputOver = true;
@@ -1238,19 +1444,28 @@ ret:
                     dest->stride[2] = src->stride[2];
                     dest->format = src->format;
 
-                    if (!dest->planes[0])
-                        dest->planes[0] = X265_MALLOC(char, dest->framesize);
-
-                    memcpy(dest->planes[0], src->planes[0], src->framesize * sizeof(char));
-                    int height = (src->height * (src->format == 2 ? 2 : 1));
-                    dest->planes[1] = (char*)dest->planes[0] + src->stride[0] * height;
-                    dest->planes[2] = (char*)dest->planes[1] + src->stride[1] * (height >> x265_cli_csps[src->colorSpace].height[1]);
-#if ENABLE_ALPHA
-                    if (m_parentEnc->m_param->numScalableLayers > 1)
+                    if (m_parentEnc->m_directInput || (m_pipeline && m_pipeline->usesEncoderBuffers()))
                     {
-                        dest->planes[3] = (char*)dest->planes[2] + src->stride[2] * (src->height >> x265_cli_csps[src->colorSpace].height[2]);
+                        /* the planes already belong to one of the encoder's source frames */
+                        memcpy(dest->planes, src->planes, sizeof(dest->planes));
                     }
+                    else
+                    {
+                        if (!dest->planes[0])
+                            dest->planes[0] = X265_MALLOC(char, dest->framesize);
+
+                        memcpy(dest->planes[0], src->planes[0], src->framesize * sizeof(char));
+                        int height = (src->height * (src->format == 2 ? 2 : 1));
+                        dest->planes[1] = (char*)dest->planes[0] + src->stride[0] * height;
+                        dest->planes[2] = (char*)dest->planes[1] + src->stride[1] * (height >> x265_cli_csps[src->colorSpace].height[1]);
+#if ENABLE_ALPHA
+                        if (m_parentEnc->m_param->numScalableLayers > 1)
+                        {
+                            dest->planes[3] = (char*)dest->planes[2] + src->stride[2] * (src->height >> x265_cli_csps[src->colorSpace].height[2]);
+                        }
 #endif
+                    }
+                    releaseSource();
                     if (view == m_parentEnc->m_param->numViews - 1 - !!m_parentEnc->m_param->format)
                         m_parentEnc->m_parent->m_picWriteCnt[m_id].incr();
                 }
@@ -1262,6 +1477,7 @@ ret:
                 }
             }
         }
+        releaseSource();
         x265_picture_free(src);
     }
 }
@@ -49,7 +49,7 @@ namespace X265_NS {
         // Temporary duplicated param for free the analysis info, unnecessary free here
         x265_param         *m_param;    //[numEncodes]
 
-        x265_picture       ***m_inputPicBuffer; //[numEncodes][queueSize]
+        x265_picture       ***m_inputPicBuffer; //[numEncodes][queueSize], rungs sharing source frames alias one queue
         x265_analysis_data **m_analysisBuffer; //[numEncodes][queueSize]
         int                **m_readFlag;
 
@@ -78,6 +78,13 @@ namespace X265_NS {
         Reader *m_reader;
         Scaler *m_scaler;
         bool m_inputOver;
+        bool m_directInput; /* input reads into encoder owned pictures, see x265_encoder_get_input_buffer() */
+
+        /* ABR rungs with the same input and filter chain encode from a single
+         * queue of source frames, owned by the first of them. Each queue slot
+         * is overwritten once all m_numConsumers readers have released it */
+        uint32_t m_srcId;        /* rung owning the source queue this rung encodes from */
+        uint32_t m_numConsumers; /* rungs and readers of other rungs consuming our queue */
 
         int m_threadActive;
         int m_lastIdx;
@@ -108,8 +115,11 @@ namespace X265_NS {
         bool readPicture(x265_picture*, int view);
         void destroy();
 
+        bool sharesInput(const PassEncoder& owner, bool bFiltered) const;
+
     private:
         void threadMain();
+        void stopDirectInput();
     };
 
     class Scaler : public Thread
@@ -148,9 +158,21 @@ namespace X265_NS {
         InputFile* m_input[MAX_VIEWS];
         CLIOptions* m_cliopt;
         int m_threadActive;
+        FilterPipeline* m_pipeline; /* --vf frames filtered in parallel, or NULL */
+        bool m_inputEnd;
+
+        /* rung whose unfiltered source queue feeds our filter chain in place
+         * of the input file, or -1 */
+        int m_upstreamId;
+        uint32_t m_upstreamRead;
+        int m_upstreamHeld;      /* queue slot of the upstream frame in use, or -1 */
 
         Reader(int id, PassEncoder *parentEnc);
+        ~Reader() { delete m_pipeline; }
         void threadMain();
+        bool readSource(x265_picture& pic);
+        void releaseSource();
+        bool readFiltered(x265_picture& pic);
     };
 }
 
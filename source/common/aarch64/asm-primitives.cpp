@@ -384,6 +384,9 @@ extern "C" {
 #include "loopfilter-prim.h"
 #include "intrapred-prim.h"
 #include "sao-prim.h"
+#include "lookahead-prim.h"
+#include "temporalfilter-prim.h"
+#include "pixelcmp-prim.h"
 #include "filter-neon-dotprod.h"
 #include "filter-neon-i8mm.h"
 
@@ -1057,6 +1060,9 @@ void setupIntrinsicPrimitives(EncoderPrimitives &p, int cpuMask)
         setupLoopFilterPrimitives_neon(p);
         setupIntraPrimitives_neon(p);
         setupSaoPrimitives_neon(p);
+        setupLookaheadPrimitives_neon(p);
+        setupTemporalFilterPrimitives_neon(p);
+        setupPixelCmpPrimitives_neon(p);
     }
 #ifdef HAVE_NEON_DOTPROD
     if (cpuMask & X265_CPU_NEON_DOTPROD)
@@ -0,0 +1,390 @@
+/*****************************************************************************
+ * Copyright (C) 2024 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+
+#include "common.h"
+#include "primitives.h"
+#include "lookahead-prim.h"
+#include <arm_neon.h>
+
+using namespace X265_NS;
+
+namespace
+{
+
+/* Lanes whose vector angle is this close to a whole degree are recomputed
+ * with edgeThetaDegrees(), see lookahead-avx2.cpp */
+#define THETA_EPSILON 1e-3f
+
+static inline int gaussianPixel(const pixel *s0, const pixel *s1, const pixel *s2, const pixel *s3, const pixel *s4, int x)
+{
+    int sum = 2 * (s0[x - 2] + s0[x + 2] + s4[x - 2] + s4[x + 2]) +
+              4 * (s0[x - 1] + s0[x + 1] + s4[x - 1] + s4[x + 1] + s1[x - 2] + s1[x + 2] + s3[x - 2] + s3[x + 2]) +
+              5 * (s0[x] + s4[x] + s2[x - 2] + s2[x + 2]) +
+              9 * (s1[x - 1] + s1[x + 1] + s3[x - 1] + s3[x + 1]) +
+              12 * (s1[x] + s3[x] + s2[x - 1] + s2[x + 1]) +
+              15 * s2[x];
+    return sum / 159;
+}
+
+/* 8 pixels widened to 16 bits */
+static inline uint16x8_t load8(const pixel *p)
+{
+#if HIGH_BIT_DEPTH
+    return vld1q_u16(p);
+#else
+    return vmovl_u8(vld1_u8(p));
+#endif
+}
+
+static inline void store8(pixel *p, uint16x8_t v)
+{
+#if HIGH_BIT_DEPTH
+    vst1q_u16(p, v);
+#else
+    vst1_u8(p, vmovn_u16(v));
+#endif
+}
+
+#if HIGH_BIT_DEPTH
+static inline uint32x4_t gaussianSum4(const pixel *s0, const pixel *s1, const pixel *s2, const pixel *s3, const pixel *s4)
+{
+    uint32x4_t outerA = vaddq_u32(vaddq_u32(vmovl_u16(vld1_u16(s0 - 2)), vmovl_u16(vld1_u16(s0 + 2))),
+                                  vaddq_u32(vmovl_u16(vld1_u16(s4 - 2)), vmovl_u16(vld1_u16(s4 + 2))));
+    uint32x4_t innerA = vaddq_u32(vaddq_u32(vmovl_u16(vld1_u16(s0 - 1)), vmovl_u16(vld1_u16(s0 + 1))),
+                                  vaddq_u32(vmovl_u16(vld1_u16(s4 - 1)), vmovl_u16(vld1_u16(s4 + 1))));
+    uint32x4_t midA = vaddq_u32(vmovl_u16(vld1_u16(s0)), vmovl_u16(vld1_u16(s4)));
+    uint32x4_t outerB = vaddq_u32(vaddq_u32(vmovl_u16(vld1_u16(s1 - 2)), vmovl_u16(vld1_u16(s1 + 2))),
+                                  vaddq_u32(vmovl_u16(vld1_u16(s3 - 2)), vmovl_u16(vld1_u16(s3 + 2))));
+    uint32x4_t innerB = vaddq_u32(vaddq_u32(vmovl_u16(vld1_u16(s1 - 1)), vmovl_u16(vld1_u16(s1 + 1))),
+                                  vaddq_u32(vmovl_u16(vld1_u16(s3 - 1)), vmovl_u16(vld1_u16(s3 + 1))));
+    uint32x4_t midB = vaddq_u32(vmovl_u16(vld1_u16(s1)), vmovl_u16(vld1_u16(s3)));
+    uint32x4_t outerC = vaddq_u32(vmovl_u16(vld1_u16(s2 - 2)), vmovl_u16(vld1_u16(s2 + 2)));
+    uint32x4_t innerC = vaddq_u32(vmovl_u16(vld1_u16(s2 - 1)), vmovl_u16(vld1_u16(s2 + 1)));
+    uint32x4_t midC = vmovl_u16(vld1_u16(s2));
+
+    uint32x4_t sum = vshlq_n_u32(outerA, 1);
+    sum = vaddq_u32(sum, vshlq_n_u32(vaddq_u32(innerA, outerB), 2));
+    sum = vmlaq_n_u32(sum, vaddq_u32(midA, outerC), 5);
+    sum = vmlaq_n_u32(sum, innerB, 9);
+    sum = vmlaq_n_u32(sum, vaddq_u32(midB, innerC), 12);
+    return vmlaq_n_u32(sum, midC, 15);
+}
+
+/* x / 159 == (x * 27012373) >> 32 for all 18 bit x */
+static inline uint16x4_t divide159(uint32x4_t x)
+{
+    uint32x4_t lo = vreinterpretq_u32_u64(vmull_n_u32(vget_low_u32(x), 27012373));
+    uint32x4_t hi = vreinterpretq_u32_u64(vmull_high_n_u32(x, 27012373));
+    return vmovn_u32(vuzp2q_u32(lo, hi));
+}
+
+static void edgeGaussian_neon(pixel *dst, const pixel *src, intptr_t stride, int width, int height)
+{
+    for (int y = 2; y < height - 2; y++)
+    {
+        const pixel *s0 = src + (y - 2) * stride;
+        const pixel *s1 = s0 + stride;
+        const pixel *s2 = s1 + stride;
+        const pixel *s3 = s2 + stride;
+        const pixel *s4 = s3 + stride;
+        pixel *d = dst + y * stride;
+
+        int x = 2;
+        for (; x + 8 <= width - 2; x += 8)
+        {
+            uint16x4_t lo = divide159(gaussianSum4(s0 + x, s1 + x, s2 + x, s3 + x, s4 + x));
+            uint16x4_t hi = divide159(gaussianSum4(s0 + x + 4, s1 + x + 4, s2 + x + 4, s3 + x + 4, s4 + x + 4));
+            vst1q_u16(d + x, vcombine_u16(lo, hi));
+        }
+
+        for (; x < width - 2; x++)
+            d[x] = (pixel)gaussianPixel(s0, s1, s2, s3, s4, x);
+    }
+}
+#else
+static void edgeGaussian_neon(pixel *dst, const pixel *src, intptr_t stride, int width, int height)
+{
+    for (int y = 2; y < height - 2; y++)
+    {
+        const pixel *s0 = src + (y - 2) * stride;
+        const pixel *s1 = s0 + stride;
+        const pixel *s2 = s1 + stride;
+        const pixel *s3 = s2 + stride;
+        const pixel *s4 = s3 + stride;
+        pixel *d = dst + y * stride;
+
+        int x = 2;
+        for (; x + 8 <= width - 2; x += 8)
+        {
+            uint16x8_t outerA = vaddq_u16(vaddl_u8(vld1_u8(s0 + x - 2), vld1_u8(s0 + x + 2)), vaddl_u8(vld1_u8(s4 + x - 2), vld1_u8(s4 + x + 2)));
+            uint16x8_t innerA = vaddq_u16(vaddl_u8(vld1_u8(s0 + x - 1), vld1_u8(s0 + x + 1)), vaddl_u8(vld1_u8(s4 + x - 1), vld1_u8(s4 + x + 1)));
+            uint16x8_t midA = vaddl_u8(vld1_u8(s0 + x), vld1_u8(s4 + x));
+            uint16x8_t outerB = vaddq_u16(vaddl_u8(vld1_u8(s1 + x - 2), vld1_u8(s1 + x + 2)), vaddl_u8(vld1_u8(s3 + x - 2), vld1_u8(s3 + x + 2)));
+            uint16x8_t innerB = vaddq_u16(vaddl_u8(vld1_u8(s1 + x - 1), vld1_u8(s1 + x + 1)), vaddl_u8(vld1_u8(s3 + x - 1), vld1_u8(s3 + x + 1)));
+            uint16x8_t midB = vaddl_u8(vld1_u8(s1 + x), vld1_u8(s3 + x));
+            uint16x8_t outerC = vaddl_u8(vld1_u8(s2 + x - 2), vld1_u8(s2 + x + 2));
+            uint16x8_t innerC = vaddl_u8(vld1_u8(s2 + x - 1), vld1_u8(s2 + x + 1));
+            uint16x8_t midC = vmovl_u8(vld1_u8(s2 + x));
+
+            /* the sum fits 16 unsigned bits */
+            uint16x8_t sum = vshlq_n_u16(outerA, 1);
+            sum = vaddq_u16(sum, vshlq_n_u16(vaddq_u16(innerA, outerB), 2));
+            sum = vmlaq_n_u16(sum, vaddq_u16(midA, outerC), 5);
+            sum = vmlaq_n_u16(sum, innerB, 9);
+            sum = vmlaq_n_u16(sum, vaddq_u16(midB, innerC), 12);
+            sum = vmlaq_n_u16(sum, midC, 15);
+
+            /* x / 159 == (x * 52759) >> 23 for all 16 bit x */
+            uint32x4_t lo = vmull_n_u16(vget_low_u16(sum), 52759);
+            uint32x4_t hi = vmull_high_n_u16(sum, 52759);
+            uint16x8_t q = vshrq_n_u16(vcombine_u16(vshrn_n_u32(lo, 16), vshrn_n_u32(hi, 16)), 7);
+            vst1_u8(d + x, vmovn_u16(q));
+        }
+
+        for (; x < width - 2; x++)
+            d[x] = (pixel)gaussianPixel(s0, s1, s2, s3, s4, x);
+    }
+}
+#endif // if HIGH_BIT_DEPTH
+
+/* Gradient angles of 4 lanes in whole degrees, see sobelTheta8() in
+ * lookahead-avx2.cpp. Returns the mask of lanes left to the reference */
+static inline uint32x4_t sobelTheta4(uint32x4_t &theta, int32x4_t gh, int32x4_t gv)
+{
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    float32x4_t fh = vcvtq_f32_s32(gh);
+    float32x4_t fv = vcvtq_f32_s32(gv);
+
+    float32x4_t ax = vabsq_f32(fh);
+    float32x4_t ay = vabsq_f32(fv);
+    float32x4_t t = vdivq_f32(vminq_f32(ax, ay), vmaxq_f32(vmaxq_f32(ax, ay), one));
+
+    uint32x4_t big = vcgtq_f32(t, vdupq_n_f32(0.414213562373095f));
+    t = vbslq_f32(big, vdivq_f32(vsubq_f32(t, one), vaddq_f32(t, one)), t);
+    float32x4_t z = vmulq_f32(t, t);
+    float32x4_t p = vdupq_n_f32(8.05374449538e-2f);
+    p = vsubq_f32(vmulq_f32(p, z), vdupq_n_f32(1.38776856032e-1f));
+    p = vaddq_f32(vmulq_f32(p, z), vdupq_n_f32(1.99777106478e-1f));
+    p = vsubq_f32(vmulq_f32(p, z), vdupq_n_f32(3.33329491539e-1f));
+    p = vaddq_f32(vmulq_f32(vmulq_f32(p, z), t), t);
+
+    float32x4_t deg = vaddq_f32(vbslq_f32(big, vdupq_n_f32(45.0f), zero), vmulq_n_f32(p, (float)(180 / PI)));
+    deg = vbslq_f32(vcgtq_f32(ay, ax), vsubq_f32(vdupq_n_f32(90.0f), deg), deg);
+    deg = vbslq_f32(vcltq_f32(fh, zero), vsubq_f32(vdupq_n_f32(180.0f), deg), deg);
+    deg = vbslq_f32(vcltq_f32(fv, zero), vsubq_f32(vdupq_n_f32(180.0f), deg), deg);
+
+    /* whole angles of the axes and diagonals */
+    uint32x4_t axisV = vceqzq_s32(gv);
+    uint32x4_t axisH = vceqzq_s32(gh);
+    uint32x4_t diagonal = vceqq_s32(vabsq_s32(gh), vabsq_s32(gv));
+    uint32x4_t oppositeSigns = vcltzq_s32(veorq_s32(gh, gv));
+    deg = vbslq_f32(diagonal, vbslq_f32(oppositeSigns, vdupq_n_f32(135.0f), vdupq_n_f32(45.0f)), deg);
+    deg = vbslq_f32(axisH, vdupq_n_f32(90.0f), deg);
+    deg = vbslq_f32(axisV, vbslq_f32(vcltzq_s32(gh), vdupq_n_f32(180.0f), zero), deg);
+    uint32x4_t exact = vorrq_u32(vorrq_u32(axisV, axisH), diagonal);
+
+    theta = vcvtq_u32_f32(deg);
+
+    float32x4_t frac = vabdq_f32(deg, vrndnq_f32(deg));
+    return vbicq_u32(vcltq_f32(frac, vdupq_n_f32(THETA_EPSILON)), exact);
+}
+
+static void edgeSobel_neon(pixel *edge, pixel *theta, const pixel *src, intptr_t stride, int width, int height, pixel whitePixel)
+{
+    /* the float magnitude may round above 2^24, but never across the threshold */
+    const float32x4_t threshold = vdupq_n_f32((float)(EDGE_THRESHOLD * EDGE_THRESHOLD));
+    const uint16x8_t white = vdupq_n_u16(whitePixel);
+
+    for (int y = 1; y < height - 1; y++)
+    {
+        const pixel *s0 = src + (y - 1) * stride;
+        const pixel *s1 = s0 + stride;
+        const pixel *s2 = s1 + stride;
+
+        int x = 1;
+        for (; x + 8 <= width - 1; x += 8)
+        {
+            int16x8_t tl = vreinterpretq_s16_u16(load8(s0 + x - 1)), tc = vreinterpretq_s16_u16(load8(s0 + x));
+            int16x8_t tr = vreinterpretq_s16_u16(load8(s0 + x + 1));
+            int16x8_t ml = vreinterpretq_s16_u16(load8(s1 + x - 1)), mr = vreinterpretq_s16_u16(load8(s1 + x + 1));
+            int16x8_t bl = vreinterpretq_s16_u16(load8(s2 + x - 1)), bc = vreinterpretq_s16_u16(load8(s2 + x));
+            int16x8_t br = vreinterpretq_s16_u16(load8(s2 + x + 1));
+
+            /* the pixel differences fit 16 bits, the gradients need 32 */
+            int16x8_t dh = vaddq_s16(vsubq_s16(tr, tl), vsubq_s16(br, bl));
+            int16x8_t dv = vaddq_s16(vsubq_s16(bl, tl), vsubq_s16(br, tr));
+            int16x8_t dm = vsubq_s16(mr, ml);
+            int16x8_t dc = vsubq_s16(bc, tc);
+            int32x4_t ghLo = vmlal_n_s16(vmull_n_s16(vget_low_s16(dh), 3), vget_low_s16(dm), 10);
+            int32x4_t ghHi = vmlal_high_n_s16(vmull_high_n_s16(dh, 3), dm, 10);
+            int32x4_t gvLo = vmlal_n_s16(vmull_n_s16(vget_low_s16(dv), 3), vget_low_s16(dc), 10);
+            int32x4_t gvHi = vmlal_high_n_s16(vmull_high_n_s16(dv, 3), dc, 10);
+
+            float32x4_t fhLo = vcvtq_f32_s32(ghLo), fhHi = vcvtq_f32_s32(ghHi);
+            float32x4_t fvLo = vcvtq_f32_s32(gvLo), fvHi = vcvtq_f32_s32(gvHi);
+            uint32x4_t edgeLo = vcgeq_f32(vaddq_f32(vmulq_f32(fhLo, fhLo), vmulq_f32(fvLo, fvLo)), threshold);
+            uint32x4_t edgeHi = vcgeq_f32(vaddq_f32(vmulq_f32(fhHi, fhHi), vmulq_f32(fvHi, fvHi)), threshold);
+            store8(edge + y * stride + x, vandq_u16(vcombine_u16(vmovn_u32(edgeLo), vmovn_u32(edgeHi)), white));
+
+            if (theta)
+            {
+                uint32x4_t thetaLo, thetaHi;
+                uint32x4_t redoLo = sobelTheta4(thetaLo, ghLo, gvLo);
+                uint32x4_t redoHi = sobelTheta4(thetaHi, ghHi, gvHi);
+                pixel *t = theta + y * stride + x;
+                store8(t, vcombine_u16(vmovn_u32(thetaLo), vmovn_u32(thetaHi)));
+
+                uint16x8_t redo = vcombine_u16(vmovn_u32(redoLo), vmovn_u32(redoHi));
+                if (vmaxvq_u16(redo))
+                {
+                    int32_t h[8], v[8];
+                    uint16_t r[8];
+                    vst1q_s32(h, ghLo);
+                    vst1q_s32(h + 4, ghHi);
+                    vst1q_s32(v, gvLo);
+                    vst1q_s32(v + 4, gvHi);
+                    vst1q_u16(r, redo);
+                    for (int i = 0; i < 8; i++)
+                        if (r[i])
+                            t[i] = edgeThetaDegrees(h[i], v[i]);
+                }
+            }
+        }
+
+        for (; x < width - 1; x++)
+        {
+            int gradientH = 3 * (s0[x + 1] - s0[x - 1]) + 10 * (s1[x + 1] - s1[x - 1]) + 3 * (s2[x + 1] - s2[x - 1]);
+            int gradientV = 3 * (s2[x - 1] - s0[x - 1]) + 10 * (s2[x] - s0[x]) + 3 * (s2[x + 1] - s0[x + 1]);
+            int64_t magnitude = (int64_t)gradientH * gradientH + (int64_t)gradientV * gradientV;
+
+            if (theta)
+                theta[y * stride + x] = edgeThetaDegrees(gradientH, gradientV);
+            edge[y * stride + x] = magnitude >= (int64_t)(EDGE_THRESHOLD * EDGE_THRESHOLD) ? whitePixel : 0;
+        }
+    }
+}
+
+static void intensityHistogram_neon(const pixel *src, intptr_t stride, int width, int height, int dsFactor, uint32_t *histogram, uint64_t *sum)
+{
+    const int shift = X265_DEPTH - 8;
+    uint64_t total = 0;
+
+    if (dsFactor != 1 && dsFactor != 4)
+    {
+        for (int y = 0; y < height; y += dsFactor)
+        {
+            for (int x = 0; x < width; x += dsFactor)
+            {
+                histogram[src[x] >> shift]++;
+                total += src[x];
+            }
+            src += stride * dsFactor;
+        }
+        *sum = total;
+        return;
+    }
+
+    uint32_t bins[4][256];
+    if (dsFactor == 1)
+        memset(bins, 0, sizeof(bins));
+
+    uint64x2_t acc = vdupq_n_u64(0);
+    const int step = 16 / sizeof(pixel);
+
+    for (int y = 0; y < height; y += dsFactor)
+    {
+        uint32x4_t rowAcc = vdupq_n_u32(0);
+        int x = 0;
+#if HIGH_BIT_DEPTH
+        if (dsFactor == 1)
+        {
+            for (; x + step <= width; x += step)
+                rowAcc = vpadalq_u16(rowAcc, vld1q_u16(src + x));
+        }
+        else
+        {
+            /* samples x and x + 4 are the low halves of the two 64 bit lanes */
+            for (; x + step <= width; x += step)
+                acc = vaddq_u64(acc, vandq_u64(vreinterpretq_u64_u16(vld1q_u16(src + x)), vdupq_n_u64(0xFFFF)));
+        }
+#else
+        if (dsFactor == 1)
+        {
+            for (; x + step <= width; x += step)
+                rowAcc = vpadalq_u16(rowAcc, vpaddlq_u8(vld1q_u8(src + x)));
+        }
+        else
+        {
+            for (; x + step <= width; x += step)
+                rowAcc = vaddq_u32(rowAcc, vandq_u32(vreinterpretq_u32_u8(vld1q_u8(src + x)), vdupq_n_u32(0xFF)));
+        }
+#endif
+        acc = vpadalq_u32(acc, rowAcc);
+        for (; x < width; x += dsFactor)
+            total += src[x];
+
+        if (dsFactor == 1)
+        {
+            x = 0;
+            for (; x + 4 <= width; x += 4)
+            {
+                bins[0][src[x] >> shift]++;
+                bins[1][src[x + 1] >> shift]++;
+                bins[2][src[x + 2] >> shift]++;
+                bins[3][src[x + 3] >> shift]++;
+            }
+            for (; x < width; x++)
+                bins[0][src[x] >> shift]++;
+        }
+        else
+        {
+            for (x = 0; x < width; x += dsFactor)
+                histogram[src[x] >> shift]++;
+        }
+        src += stride * dsFactor;
+    }
+
+    if (dsFactor == 1)
+    {
+        for (int i = 0; i < 256; i += 4)
+        {
+            uint32x4_t h = vld1q_u32(histogram + i);
+            h = vaddq_u32(h, vaddq_u32(vld1q_u32(bins[0] + i), vld1q_u32(bins[1] + i)));
+            h = vaddq_u32(h, vaddq_u32(vld1q_u32(bins[2] + i), vld1q_u32(bins[3] + i)));
+            vst1q_u32(histogram + i, h);
+        }
+    }
+
+    *sum = total + vaddvq_u64(acc);
+}
+
+}
+
+namespace X265_NS
+{
+void setupLookaheadPrimitives_neon(EncoderPrimitives &p)
+{
+    p.edgeGaussian = edgeGaussian_neon;
+    p.edgeSobel = edgeSobel_neon;
+    p.intensityHistogram = intensityHistogram_neon;
+}
+}
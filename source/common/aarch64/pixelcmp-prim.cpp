@@ -0,0 +1,304 @@
+/*****************************************************************************
+ * Copyright (C) 2024 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+
+#include "common.h"
+#include "primitives.h"
+#include "pixelcmp-prim.h"
+#include <arm_neon.h>
+
+using namespace X265_NS;
+
+namespace
+{
+
+/* candidates whose partial sums are kept in registers at once */
+const int XN_BATCH = 8;
+
+#if HIGH_BIT_DEPTH
+/* one fenc row of lx pixels held in registers */
+template<int lx>
+struct SadRow
+{
+    enum { N8 = lx >> 3, N4 = (lx & 4) >> 2 };
+
+    uint16x8_t v8[N8 ? N8 : 1];
+    uint16x4_t v4;
+
+    inline void load(const pixel *p)
+    {
+        for (int x = 0; x < N8; x++)
+            v8[x] = vld1q_u16(p + 8 * x);
+        if (N4)
+            v4 = vld1_u16(p + 8 * N8);
+    }
+
+    /* absolute differences with the same row of a candidate, a lane sums
+     * at most 8 of them */
+    inline uint16x8_t sad(const pixel *r) const
+    {
+        uint16x8_t s = vdupq_n_u16(0);
+        for (int x = 0; x < N8; x++)
+            s = vabaq_u16(s, v8[x], vld1q_u16(r + 8 * x));
+        if (N4)
+            s = vcombine_u16(vaba_u16(vget_low_u16(s), v4, vld1_u16(r + 8 * N8)), vget_high_u16(s));
+        return s;
+    }
+};
+#else
+static inline uint8x8_t load4(const pixel *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return vcreate_u8(v);
+}
+
+/* one fenc row of lx pixels held in registers */
+template<int lx>
+struct SadRow
+{
+    enum { N16 = lx >> 4, N8 = (lx & 8) >> 3, N4 = (lx & 4) >> 2 };
+
+    uint8x16_t v16[N16 ? N16 : 1];
+    uint8x8_t  v8;
+    uint8x8_t  v4;
+
+    inline void load(const pixel *p)
+    {
+        for (int x = 0; x < N16; x++)
+            v16[x] = vld1q_u8(p + 16 * x);
+        if (N8)
+            v8 = vld1_u8(p + 16 * N16);
+        if (N4)
+            v4 = load4(p + 16 * N16 + 8 * N8);
+    }
+
+    /* absolute differences with the same row of a candidate, a lane sums
+     * at most 8 of them */
+    inline uint16x8_t sad(const pixel *r) const
+    {
+        uint16x8_t s = vdupq_n_u16(0);
+        for (int x = 0; x < N16; x++)
+        {
+            uint8x16_t c = vld1q_u8(r + 16 * x);
+            s = vabal_u8(s, vget_low_u8(v16[x]), vget_low_u8(c));
+            s = vabal_high_u8(s, v16[x], c);
+        }
+        if (N8)
+            s = vabal_u8(s, v8, vld1_u8(r + 16 * N16));
+        if (N4)
+            s = vabal_u8(s, v4, load4(r + 16 * N16 + 8 * N8));
+        return s;
+    }
+};
+#endif // if HIGH_BIT_DEPTH
+
+/* Each fenc row is loaded once and compared with the same row of up to
+ * XN_BATCH candidates */
+template<int lx, int ly>
+void sad_xn_neon(const pixel *fenc, const pixel *const *fref, int count, intptr_t frefstride, int32_t *res)
+{
+    for (int base = 0; base < count; base += XN_BATCH)
+    {
+        const int n = X265_MIN(count - base, XN_BATCH);
+        const pixel *const *ref = fref + base;
+        uint32x4_t acc[XN_BATCH];
+        SadRow<lx> f;
+
+        for (int i = 0; i < n; i++)
+            acc[i] = vdupq_n_u32(0);
+
+        for (int y = 0; y < ly; y++)
+        {
+            f.load(fenc + y * FENC_STRIDE);
+            for (int i = 0; i < n; i++)
+                acc[i] = vpadalq_u16(acc[i], f.sad(ref[i] + y * frefstride));
+        }
+
+        for (int i = 0; i < n; i++)
+            res[base + i] = (int32_t)vaddvq_u32(acc[i]);
+    }
+}
+
+/* Four rows of 8 pixels widened to 16 bits, two horizontally adjacent 4x4
+ * blocks or, in 4 column strips, two vertically adjacent ones */
+struct Rows
+{
+    int16x8_t r[4];
+};
+
+#if HIGH_BIT_DEPTH
+static inline int16x8_t widen8(const pixel *p)
+{
+    return vreinterpretq_s16_u16(vld1q_u16(p));
+}
+
+static inline int16x4_t widen4(const pixel *p)
+{
+    return vreinterpret_s16_u16(vld1_u16(p));
+}
+#else
+static inline int16x8_t widen8(const pixel *p)
+{
+    return vreinterpretq_s16_u16(vmovl_u8(vld1_u8(p)));
+}
+
+static inline int16x4_t widen4(const pixel *p)
+{
+    return vget_low_s16(vreinterpretq_s16_u16(vmovl_u8(load4(p))));
+}
+#endif
+
+static inline void load8x4(Rows &rows, const pixel *p, intptr_t stride)
+{
+    for (int i = 0; i < 4; i++)
+        rows.r[i] = widen8(p + i * stride);
+}
+
+static inline void load4x8(Rows &rows, const pixel *p, intptr_t stride)
+{
+    for (int i = 0; i < 4; i++)
+        rows.r[i] = vcombine_s16(widen4(p + i * stride), widen4(p + (i + 4) * stride));
+}
+
+/* satd of the two 4x4 blocks of fenc and candidate rows added to acc. The
+ * satd of a block, (sum of |coefficients|) >> 1, is the sum of the halved
+ * sums of its rows, each even, and the halving is folded into the last
+ * butterfly stage by |x + y| + |x - y| = 2 * max(|x|, |y|) as in
+ * pixelcmp-avx2.cpp. No stage overflows 16 bits up to 12 bit pixels */
+static inline uint32x4_t satdRows(uint32x4_t acc, const Rows &f, const Rows &r)
+{
+    int16x8_t d0 = vsubq_s16(f.r[0], r.r[0]);
+    int16x8_t d1 = vsubq_s16(f.r[1], r.r[1]);
+    int16x8_t d2 = vsubq_s16(f.r[2], r.r[2]);
+    int16x8_t d3 = vsubq_s16(f.r[3], r.r[3]);
+
+    /* vertical transform */
+    int16x8_t a0 = vaddq_s16(d0, d1);
+    int16x8_t a1 = vsubq_s16(d0, d1);
+    int16x8_t a2 = vaddq_s16(d2, d3);
+    int16x8_t a3 = vsubq_s16(d2, d3);
+    int16x8_t b0 = vaddq_s16(a0, a2);
+    int16x8_t b1 = vaddq_s16(a1, a3);
+    int16x8_t b2 = vsubq_s16(a0, a2);
+    int16x8_t b3 = vsubq_s16(a1, a3);
+
+    /* first horizontal stage, leaves the pairs of the last stage adjacent */
+    int16x8_t e01 = vuzp1q_s16(b0, b1);
+    int16x8_t o01 = vuzp2q_s16(b0, b1);
+    int16x8_t e23 = vuzp1q_s16(b2, b3);
+    int16x8_t o23 = vuzp2q_s16(b2, b3);
+    int16x8_t h0 = vabsq_s16(vaddq_s16(e01, o01));
+    int16x8_t h1 = vabsq_s16(vsubq_s16(e01, o01));
+    int16x8_t h2 = vabsq_s16(vaddq_s16(e23, o23));
+    int16x8_t h3 = vabsq_s16(vsubq_s16(e23, o23));
+
+    int16x8_t m0 = vmaxq_s16(vuzp1q_s16(h0, h1), vuzp2q_s16(h0, h1));
+    int16x8_t m1 = vmaxq_s16(vuzp1q_s16(h2, h3), vuzp2q_s16(h2, h3));
+
+    acc = vpadalq_u16(acc, vreinterpretq_u16_s16(m0));
+    return vpadalq_u16(acc, vreinterpretq_u16_s16(m1));
+}
+
+/* The fenc strip is loaded once and compared with the same strip of up to
+ * XN_BATCH candidates */
+template<int w, int h>
+void satd_xn_neon(const pixel *fenc, const pixel *const *fref, int count, intptr_t frefstride, int32_t *res)
+{
+    for (int base = 0; base < count; base += XN_BATCH)
+    {
+        const int n = X265_MIN(count - base, XN_BATCH);
+        const pixel *const *ref = fref + base;
+        uint32x4_t acc[XN_BATCH];
+        Rows f, r;
+
+        for (int i = 0; i < n; i++)
+            acc[i] = vdupq_n_u32(0);
+
+        for (int x = 0; x + 8 <= w; x += 8)
+        {
+            for (int y = 0; y < h; y += 4)
+            {
+                load8x4(f, fenc + y * FENC_STRIDE + x, FENC_STRIDE);
+                for (int i = 0; i < n; i++)
+                {
+                    load8x4(r, ref[i] + y * frefstride + x, frefstride);
+                    acc[i] = satdRows(acc[i], f, r);
+                }
+            }
+        }
+
+        if (w & 4)
+        {
+            /* the heights of these partitions are multiples of 8 */
+            const int x = w & ~7;
+            for (int y = 0; y < h; y += 8)
+            {
+                load4x8(f, fenc + y * FENC_STRIDE + x, FENC_STRIDE);
+                for (int i = 0; i < n; i++)
+                {
+                    load4x8(r, ref[i] + y * frefstride + x, frefstride);
+                    acc[i] = satdRows(acc[i], f, r);
+                }
+            }
+        }
+
+        for (int i = 0; i < n; i++)
+            res[base + i] = (int32_t)vaddvq_u32(acc[i]);
+    }
+}
+
+}
+
+namespace X265_NS
+{
+void setupPixelCmpPrimitives_neon(EncoderPrimitives &p)
+{
+#define LUMA_PU(W, H) \
+    p.pu[LUMA_ ## W ## x ## H].sad_xn = sad_xn_neon<W, H>; \
+    p.pu[LUMA_ ## W ## x ## H].satd_xn = satd_xn_neon<W, H>;
+
+    LUMA_PU(8, 8);
+    LUMA_PU(16, 16);
+    LUMA_PU(32, 32);
+    LUMA_PU(64, 64);
+    LUMA_PU(4, 8);
+    LUMA_PU(8, 4);
+    LUMA_PU(16, 8);
+    LUMA_PU(8, 16);
+    LUMA_PU(16, 12);
+    LUMA_PU(12, 16);
+    LUMA_PU(16, 4);
+    LUMA_PU(4, 16);
+    LUMA_PU(32, 16);
+    LUMA_PU(16, 32);
+    LUMA_PU(32, 24);
+    LUMA_PU(24, 32);
+    LUMA_PU(32, 8);
+    LUMA_PU(8, 32);
+    LUMA_PU(64, 32);
+    LUMA_PU(32, 64);
+    LUMA_PU(64, 48);
+    LUMA_PU(48, 64);
+    LUMA_PU(64, 16);
+    LUMA_PU(16, 64);
+#undef LUMA_PU
+}
+}
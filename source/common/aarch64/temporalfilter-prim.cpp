@@ -0,0 +1,221 @@
+/*****************************************************************************
+ * Copyright (C) 2024 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+
+
+#include "common.h"
+#include "primitives.h"
+#include "temporalfilter-prim.h"
+#include <arm_neon.h>
+
+using namespace X265_NS;
+
+namespace
+{
+
+/* 4 and 8 pixels widened to 16 bits */
+static inline int16x4_t load4(const pixel *p)
+{
+#if HIGH_BIT_DEPTH
+    return vreinterpret_s16_u16(vld1_u16(p));
+#else
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return vget_low_s16(vreinterpretq_s16_u16(vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(v)))));
+#endif
+}
+
+static inline int16x8_t load8(const pixel *p)
+{
+#if HIGH_BIT_DEPTH
+    return vreinterpretq_s16_u16(vld1q_u16(p));
+#else
+    return vreinterpretq_s16_u16(vmovl_u8(vld1_u8(p)));
+#endif
+}
+
+static inline void store4(pixel *p, uint16x4_t v)
+{
+#if HIGH_BIT_DEPTH
+    vst1_u16(p, v);
+#else
+    uint8_t b[8];
+    vst1_u8(b, vmovn_u16(vcombine_u16(v, v)));
+    memcpy(p, b, 4);
+#endif
+}
+
+static inline void store8(pixel *p, uint16x8_t v)
+{
+#if HIGH_BIT_DEPTH
+    vst1q_u16(p, v);
+#else
+    vst1_u8(p, vmovn_u16(v));
+#endif
+}
+
+/* (sum + 2048) >> 12 clipped to the pixel range */
+static inline uint16x4_t interpRound(int32x4_t sum)
+{
+    sum = vrshrq_n_s32(sum, 12);
+    return vqmovun_s32(vminq_s32(sum, vdupq_n_s32((1 << X265_DEPTH) - 1)));
+}
+
+/* MCSTF blocks are 8 or 4 pixels wide */
+static void temporalFilterInterp_neon(pixel *dst, intptr_t dstStride, const pixel *src, intptr_t srcStride, int width, int height,
+                                      const int *xFilter, const int *yFilter)
+{
+    int32x4_t temp[8 + 5][2];
+
+    src -= 2 * srcStride;
+    for (int by = 0; by < height + 5; by++, src += srcStride)
+    {
+        if (width == 8)
+        {
+            int16x8_t p = load8(src - 2);
+            int32x4_t lo = vmull_n_s16(vget_low_s16(p), (int16_t)xFilter[1]);
+            int32x4_t hi = vmull_high_n_s16(p, (int16_t)xFilter[1]);
+            for (int k = 2; k <= 6; k++)
+            {
+                p = load8(src + k - 3);
+                lo = vmlal_n_s16(lo, vget_low_s16(p), (int16_t)xFilter[k]);
+                hi = vmlal_high_n_s16(hi, p, (int16_t)xFilter[k]);
+            }
+            temp[by][0] = lo;
+            temp[by][1] = hi;
+        }
+        else
+        {
+            int32x4_t lo = vmull_n_s16(load4(src - 2), (int16_t)xFilter[1]);
+            for (int k = 2; k <= 6; k++)
+                lo = vmlal_n_s16(lo, load4(src + k - 3), (int16_t)xFilter[k]);
+            temp[by][0] = lo;
+        }
+    }
+
+    for (int by = 0; by < height; by++, dst += dstStride)
+    {
+        int32x4_t lo = vmulq_n_s32(temp[by][0], yFilter[1]);
+        for (int k = 2; k <= 6; k++)
+            lo = vmlaq_n_s32(lo, temp[by + k - 1][0], yFilter[k]);
+
+        if (width == 8)
+        {
+            int32x4_t hi = vmulq_n_s32(temp[by][1], yFilter[1]);
+            for (int k = 2; k <= 6; k++)
+                hi = vmlaq_n_s32(hi, temp[by + k - 1][1], yFilter[k]);
+            store8(dst, vcombine_u16(interpRound(lo), interpRound(hi)));
+        }
+        else
+            store4(dst, interpRound(lo));
+    }
+}
+
+static inline uint32x4_t load4u(const pixel *p)
+{
+    return vreinterpretq_u32_s32(vmovl_s16(load4(p)));
+}
+
+static inline float64x2_t lowToDouble(uint32x4_t v)
+{
+    return vcvtq_f64_u64(vmovl_u32(vget_low_u32(v)));
+}
+
+static inline float64x2_t highToDouble(uint32x4_t v)
+{
+    return vcvtq_f64_u64(vmovl_u32(vget_high_u32(v)));
+}
+
+/* Four pixels per iteration in double precision, in the same order of
+ * operations as the C primitive; vrndaq_f64 rounds halves away from zero
+ * like round() */
+static void temporalFilterBlend_neon(pixel *dst, intptr_t dstStride, const pixel *const *ref, intptr_t refStride, int numRefs,
+                                     const double *refWeight, const double *const *weightLut, int width, int height)
+{
+    const double maxSampleValue = (1 << X265_DEPTH) - 1;
+    const float64x2_t zero = vdupq_n_f64(0.0);
+    const float64x2_t maxVal = vdupq_n_f64(maxSampleValue);
+
+    for (int y = 0; y < height; y++, dst += dstStride)
+    {
+        int x = 0;
+        for (; x + 4 <= width; x += 4)
+        {
+            const uint32x4_t org = load4u(dst + x);
+            float64x2_t newLo = lowToDouble(org);
+            float64x2_t newHi = highToDouble(org);
+            float64x2_t sumLo = vdupq_n_f64(1.0);
+            float64x2_t sumHi = sumLo;
+
+            for (int i = 0; i < numRefs; i++)
+            {
+                const uint32x4_t refVal = load4u(ref[i] + y * refStride + x);
+                const uint32x4_t diff = vabdq_u32(refVal, org);
+                const double *lut = weightLut[i];
+                const double w[4] = { lut[vgetq_lane_u32(diff, 0)], lut[vgetq_lane_u32(diff, 1)],
+                                      lut[vgetq_lane_u32(diff, 2)], lut[vgetq_lane_u32(diff, 3)] };
+                const float64x2_t rw = vdupq_n_f64(refWeight[i]);
+                const float64x2_t wLo = vmulq_f64(rw, vld1q_f64(w));
+                const float64x2_t wHi = vmulq_f64(rw, vld1q_f64(w + 2));
+
+                newLo = vaddq_f64(newLo, vmulq_f64(wLo, lowToDouble(refVal)));
+                newHi = vaddq_f64(newHi, vmulq_f64(wHi, highToDouble(refVal)));
+                sumLo = vaddq_f64(sumLo, wLo);
+                sumHi = vaddq_f64(sumHi, wHi);
+            }
+
+            newLo = vminq_f64(vmaxq_f64(vrndaq_f64(vdivq_f64(newLo, sumLo)), zero), maxVal);
+            newHi = vminq_f64(vmaxq_f64(vrndaq_f64(vdivq_f64(newHi, sumHi)), zero), maxVal);
+            uint32x4_t out = vcombine_u32(vmovn_u64(vcvtq_u64_f64(newLo)), vmovn_u64(vcvtq_u64_f64(newHi)));
+            store4(dst + x, vmovn_u32(out));
+        }
+
+        for (; x < width; x++)
+        {
+            const int orgVal = (int)dst[x];
+            double temporalWeightSum = 1.0;
+            double newVal = (double)orgVal;
+
+            for (int i = 0; i < numRefs; i++)
+            {
+                const int refVal = (int)ref[i][y * refStride + x];
+                const double weight = refWeight[i] * weightLut[i][abs(refVal - orgVal)];
+
+                newVal += weight * refVal;
+                temporalWeightSum += weight;
+            }
+            newVal /= temporalWeightSum;
+            double sampleVal = round(newVal);
+            sampleVal = (sampleVal < 0 ? 0 : (sampleVal > maxSampleValue ? maxSampleValue : sampleVal));
+            dst[x] = (pixel)sampleVal;
+        }
+    }
+}
+
+}
+
+namespace X265_NS
+{
+void setupTemporalFilterPrimitives_neon(EncoderPrimitives &p)
+{
+    p.temporalFilterInterp = temporalFilterInterp_neon;
+    p.temporalFilterBlend = temporalFilterBlend_neon;
+}
+}
@@ -33,6 +33,11 @@ volatile int __attribute__((weak)) numErrorsDuringEncoding = 0;
 #include <fcntl.h>
 #else
 #include <sys/time.h>
+#include <unistd.h>
+#endif
+
+#if HAVE_LIBNUMA
+#include <numaif.h>
 #endif
 
 namespace X265_NS {
@@ -91,6 +96,41 @@ void x265_free(void *ptr)
 
 #endif // if _WIN32
 
+/* Allocate a buffer whose pages are placed on the given NUMA node. The memory
+ * policy is attached with mbind() before the pages are touched, so placement
+ * does not depend on which thread writes them first. Only whole pages inside
+ * the buffer are bound; small allocations share heap pages with other users
+ * and are left alone. The buffer is released with x265_free() */
+void *x265_malloc_node(size_t size, int numaNode)
+{
+    void *ptr = x265_malloc(size);
+
+#if HAVE_LIBNUMA
+    const size_t minBindSize = 64 * 1024;
+    if (ptr && numaNode >= 0 && numaNode < 64 && size >= minBindSize)
+    {
+        uintptr_t pageSize = (uintptr_t)sysconf(_SC_PAGESIZE);
+        uintptr_t start = ((uintptr_t)ptr + pageSize - 1) & ~(pageSize - 1);
+        uintptr_t end = ((uintptr_t)ptr + size) & ~(pageSize - 1);
+        if (end > start)
+        {
+            unsigned long nodeMask[64 / (8 * sizeof(unsigned long))];
+            memset(nodeMask, 0, sizeof(nodeMask));
+            nodeMask[numaNode / (8 * sizeof(unsigned long))] = 1UL << (numaNode % (8 * sizeof(unsigned long)));
+
+            /* MPOL_MF_MOVE migrates any pages recycled from the heap which
+             * were already faulted in on another node */
+            if (mbind((void*)start, end - start, MPOL_PREFERRED, nodeMask, 64 + 1, MPOL_MF_MOVE))
+                x265_log(NULL, X265_LOG_DEBUG, "unable to bind %d bytes to NUMA node %d\n", (int)(end - start), numaNode);
+        }
+    }
+#else
+    (void)numaNode;
+#endif
+
+    return ptr;
+}
+
 /* Not a general-purpose function; multiplies input by -1/6 to convert
  * qp to qscale. */
 int x265_exp2fix8(double x)
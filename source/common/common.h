@@ -164,6 +164,13 @@ typedef uint64_t sse_t;
 #define FRAME_BRIGHTNESS_THRESHOLD  50.0 // Min % of pixels in a frame, that are above BRIGHTNESS_THRESHOLD for it to be considered a bright frame
 #define FRAME_EDGE_THRESHOLD  10.0 // Min % of edge pixels in a frame, for it to be considered to have high edge density
 
+#if HIGH_BIT_DEPTH
+#define EDGE_THRESHOLD 1023.0
+#else
+#define EDGE_THRESHOLD 255.0
+#endif
+#define PI 3.14159265
+
 
 template<typename T>
 inline T x265_min(T a, T b) { return a < b ? a : b; }
@@ -248,6 +255,30 @@ typedef int16_t  coeff_t;      // transform coefficient
         } \
     }
 
+/* NUMA node-local variants; the pages of the buffer are placed on numaNode
+ * when first touched. A node of -1 behaves exactly like X265_MALLOC */
+#define X265_MALLOC_NODE(type, count, node) (type*)x265_malloc_node(sizeof(type) * (count), node)
+#define CHECKED_MALLOC_NODE(var, type, count, node) \
+    { \
+        var = (type*)x265_malloc_node(sizeof(type) * (count), node); \
+        if (!var) \
+        { \
+            x265_log(NULL, X265_LOG_ERROR, "malloc of size %d failed\n", sizeof(type) * (count)); \
+            goto fail; \
+        } \
+    }
+#define CHECKED_MALLOC_ZERO_NODE(var, type, count, node) \
+    { \
+        var = (type*)x265_malloc_node(sizeof(type) * (count), node); \
+        if (var) \
+            memset((void*)var, 0, sizeof(type) * (count)); \
+        else \
+        { \
+            x265_log(NULL, X265_LOG_ERROR, "malloc of size %d failed\n", sizeof(type) * (count)); \
+            goto fail; \
+        } \
+    }
+
 #if defined(_MSC_VER)
 #define X265_LOG2F(x) (logf((float)(x)) * 1.44269504088896405f)
 #define X265_LOG2(x) (log((double)(x)) * 1.4426950408889640513713538072172)
@@ -460,6 +491,7 @@ double   x265_qp2qScale(double qp);
 uint32_t x265_picturePlaneSize(int csp, int width, int height, int plane);
 
 void*    x265_malloc(size_t size);
+void*    x265_malloc_node(size_t size, int numaNode);
 void     x265_free(void *ptr);
 char*    x265_slurp_file(const char *filename);
 
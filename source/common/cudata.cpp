@@ -55,6 +55,23 @@ static void bcast64(uint8_t* dst, uint8_t val) { uint64_t bval = 0x0101010101010
 static void copy256(uint8_t* dst, uint8_t* src) { memcpy(dst, src, 256); }
 static void bcast256(uint8_t* dst, uint8_t val) { memset(dst, val, 256); }
 
+/* plane kernels, one call moves all the per-part arrays of a CU. The plane
+ * size N is a compile time constant so each copy or set becomes a few vector
+ * moves instead of an indirect call per array */
+template<int N>
+static void copyPlanes(uint8_t* dst, intptr_t dstStride, const uint8_t* src, intptr_t srcStride, int planes)
+{
+    for (int i = 0; i < planes; i++, dst += dstStride, src += srcStride)
+        memcpy(dst, src, N);
+}
+
+template<int N>
+static void bcastPlanes(uint8_t* dst, intptr_t stride, const uint8_t* vals, int planes)
+{
+    for (int i = 0; i < planes; i++, dst += stride)
+        memset(dst, vals[i], N);
+}
+
 namespace {
 // file private namespace
 
@@ -101,6 +118,15 @@ inline bool lessThanRow(int addr, int val)
     return (addr >> LOG2_RASTER_SIZE) < val;
 }
 
+/* Scale factor of a MV spanning diffPocD pictures to one spanning diffPocB */
+inline int getPOCScale(int diffPocB, int diffPocD)
+{
+    int tdb   = x265_clip3(-128, 127, diffPocB);
+    int tdd   = x265_clip3(-128, 127, diffPocD);
+    int x     = (0x4000 + abs(tdd / 2)) / tdd;
+    return x265_clip3(-4096, 4095, (tdb * x + 32) >> 6);
+}
+
 inline MV scaleMv(MV mv, int scale)
 {
     int mvx = x265_clip3(-32768, 32767, (scale * mv.x + 127 + (scale * mv.x < 0)) >> 8);
@@ -163,24 +189,44 @@ void CUData::initialize(const CUDataMemPool& dataPool, uint32_t depth, const x26
         m_partSet = bcast256;
         m_subPartCopy = copy64;
         m_subPartSet = bcast64;
+        m_planeCopy = copyPlanes<256>;
+        m_subPlaneCopy = copyPlanes<64>;
+        m_planeSet = bcastPlanes<256>;
+        m_mvPlaneCopy = copyPlanes<256 * sizeof(MV)>;
+        m_subMvPlaneCopy = copyPlanes<64 * sizeof(MV)>;
         break;
     case 64:  // 32x32 CU
         m_partCopy = copy64;
         m_partSet = bcast64;
         m_subPartCopy = copy16;
         m_subPartSet = bcast16;
+        m_planeCopy = copyPlanes<64>;
+        m_subPlaneCopy = copyPlanes<16>;
+        m_planeSet = bcastPlanes<64>;
+        m_mvPlaneCopy = copyPlanes<64 * sizeof(MV)>;
+        m_subMvPlaneCopy = copyPlanes<16 * sizeof(MV)>;
         break;
     case 16:  // 16x16 CU
         m_partCopy = copy16;
         m_partSet = bcast16;
         m_subPartCopy = copy4;
         m_subPartSet = bcast4;
+        m_planeCopy = copyPlanes<16>;
+        m_subPlaneCopy = copyPlanes<4>;
+        m_planeSet = bcastPlanes<16>;
+        m_mvPlaneCopy = copyPlanes<16 * sizeof(MV)>;
+        m_subMvPlaneCopy = copyPlanes<4 * sizeof(MV)>;
         break;
     case 4:   // 8x8 CU
         m_partCopy = copy4;
         m_partSet = bcast4;
         m_subPartCopy = NULL;
         m_subPartSet = NULL;
+        m_planeCopy = copyPlanes<4>;
+        m_subPlaneCopy = NULL;
+        m_planeSet = bcastPlanes<4>;
+        m_mvPlaneCopy = copyPlanes<4 * sizeof(MV)>;
+        m_subMvPlaneCopy = NULL;
         break;
     default:
         X265_CHECK(0, "unexpected CU partition count\n");
@@ -190,30 +236,31 @@ void CUData::initialize(const CUDataMemPool& dataPool, uint32_t depth, const x26
     if (csp == X265_CSP_I400)
     {
         /* Each CU's data is layed out sequentially within the charMemBlock */
-        uint8_t *charBuf = dataPool.charMemBlock + (m_numPartitions * (BytesPerPartition - 4)) * instance;
+        uint8_t *charBuf = dataPool.charMemBlock + partDataSize(m_numPartitions) * instance;
 
         m_qp        = (int8_t*)charBuf; charBuf += m_numPartitions;
         m_qpAnalysis = (int8_t*)charBuf; charBuf += m_numPartitions;
         m_log2CUSize         = charBuf; charBuf += m_numPartitions;
         m_lumaIntraDir       = charBuf; charBuf += m_numPartitions;
+        m_chromaIntraDir     = charBuf; charBuf += m_numPartitions;
         m_tqBypass           = charBuf; charBuf += m_numPartitions;
         m_refIdx[0] = (int8_t*)charBuf; charBuf += m_numPartitions;
         m_refIdx[1] = (int8_t*)charBuf; charBuf += m_numPartitions;
         m_cuDepth            = charBuf; charBuf += m_numPartitions;
         m_predMode           = charBuf; charBuf += m_numPartitions; /* the order up to here is important in initCTU() and initSubCU() */
         m_partSize           = charBuf; charBuf += m_numPartitions;
-        m_skipFlag[0]        = charBuf; charBuf += m_numPartitions;
-        m_skipFlag[1]        = charBuf; charBuf += m_numPartitions;
         m_mergeFlag          = charBuf; charBuf += m_numPartitions;
         m_interDir           = charBuf; charBuf += m_numPartitions;
         m_mvpIdx[0]          = charBuf; charBuf += m_numPartitions;
         m_mvpIdx[1]          = charBuf; charBuf += m_numPartitions;
-        m_tuDepth            = charBuf; charBuf += m_numPartitions;
+        m_tuDepth            = charBuf; charBuf += m_numPartitions; /* residual flags from here, cleared by copyFromPic() */
         m_transformSkip[0]   = charBuf; charBuf += m_numPartitions;
         m_cbf[0]             = charBuf; charBuf += m_numPartitions;
-        m_chromaIntraDir     = charBuf; charBuf += m_numPartitions;
+        m_skipFlag[0]        = charBuf; charBuf += m_numPartitions; /* not copied between CUs */
+        m_skipFlag[1]        = charBuf; charBuf += m_numPartitions;
+        m_numPlanes = BytesPerPartition - 4;
 
-        X265_CHECK(charBuf == dataPool.charMemBlock + (m_numPartitions * (BytesPerPartition - 4)) * (instance + 1), "CU data layout is broken\n"); //BytesPerPartition
+        X265_CHECK(charBuf == (uint8_t*)m_qp + m_numPlanes * m_numPartitions, "CU data layout is broken\n");
 
         m_mv[0]  = dataPool.mvMemBlock + (instance * 4) * m_numPartitions;
         m_mv[1]  = m_mv[0] +  m_numPartitions;
@@ -231,34 +278,35 @@ void CUData::initialize(const CUDataMemPool& dataPool, uint32_t depth, const x26
     else
     {
         /* Each CU's data is layed out sequentially within the charMemBlock */
-        uint8_t *charBuf = dataPool.charMemBlock + (m_numPartitions * BytesPerPartition) * instance;
+        uint8_t *charBuf = dataPool.charMemBlock + partDataSize(m_numPartitions) * instance;
 
         m_qp        = (int8_t*)charBuf; charBuf += m_numPartitions;
         m_qpAnalysis = (int8_t*)charBuf; charBuf += m_numPartitions;
         m_log2CUSize         = charBuf; charBuf += m_numPartitions;
         m_lumaIntraDir       = charBuf; charBuf += m_numPartitions;
+        m_chromaIntraDir     = charBuf; charBuf += m_numPartitions;
         m_tqBypass           = charBuf; charBuf += m_numPartitions;
         m_refIdx[0] = (int8_t*)charBuf; charBuf += m_numPartitions;
         m_refIdx[1] = (int8_t*)charBuf; charBuf += m_numPartitions;
         m_cuDepth            = charBuf; charBuf += m_numPartitions;
         m_predMode           = charBuf; charBuf += m_numPartitions; /* the order up to here is important in initCTU() and initSubCU() */
         m_partSize           = charBuf; charBuf += m_numPartitions;
-        m_skipFlag[0]        = charBuf; charBuf += m_numPartitions;
-        m_skipFlag[1]        = charBuf; charBuf += m_numPartitions;
         m_mergeFlag          = charBuf; charBuf += m_numPartitions;
         m_interDir           = charBuf; charBuf += m_numPartitions;
         m_mvpIdx[0]          = charBuf; charBuf += m_numPartitions;
         m_mvpIdx[1]          = charBuf; charBuf += m_numPartitions;
-        m_tuDepth            = charBuf; charBuf += m_numPartitions;
+        m_tuDepth            = charBuf; charBuf += m_numPartitions; /* residual flags from here, cleared by copyFromPic() */
         m_transformSkip[0]   = charBuf; charBuf += m_numPartitions;
         m_transformSkip[1]   = charBuf; charBuf += m_numPartitions;
         m_transformSkip[2]   = charBuf; charBuf += m_numPartitions;
         m_cbf[0]             = charBuf; charBuf += m_numPartitions;
         m_cbf[1]             = charBuf; charBuf += m_numPartitions;
         m_cbf[2]             = charBuf; charBuf += m_numPartitions;
-        m_chromaIntraDir     = charBuf; charBuf += m_numPartitions;
+        m_skipFlag[0]        = charBuf; charBuf += m_numPartitions; /* not copied between CUs */
+        m_skipFlag[1]        = charBuf; charBuf += m_numPartitions;
+        m_numPlanes = BytesPerPartition;
 
-        X265_CHECK(charBuf == dataPool.charMemBlock + (m_numPartitions * BytesPerPartition) * (instance + 1), "CU data layout is broken\n");
+        X265_CHECK(charBuf == (uint8_t*)m_qp + m_numPlanes * m_numPartitions, "CU data layout is broken\n");
 
         m_mv[0]  = dataPool.mvMemBlock + (instance * 4) * m_numPartitions;
         m_mv[1]  = m_mv[0] +  m_numPartitions;
@@ -295,23 +343,16 @@ void CUData::initCTU(const Frame& frame, uint32_t cuAddr, int qp, uint32_t first
     m_lastIntraBCMv[1].set(0, 0);
 #endif
 
-    /* sequential memsets */
-    m_partSet((uint8_t*)m_qp, (uint8_t)qp);
-    m_partSet((uint8_t*)m_qpAnalysis, (uint8_t)qp);
-    m_partSet(m_log2CUSize,   (uint8_t)m_slice->m_param->maxLog2CUSize);
-    m_partSet(m_lumaIntraDir, (uint8_t)ALL_IDX);
-    m_partSet(m_chromaIntraDir, (uint8_t)ALL_IDX);
-    m_partSet(m_tqBypass,     (uint8_t)frame.m_encData->m_param->bLossless);
-    if (m_slice->m_sliceType != I_SLICE)
-    {
-        m_partSet((uint8_t*)m_refIdx[0], (uint8_t)REF_NOT_VALID);
-        m_partSet((uint8_t*)m_refIdx[1], (uint8_t)REF_NOT_VALID);
-    }
+    /* broadcast the planes from m_qp to m_refIdx, the reference indices of
+     * I slices are left as they are */
+    const uint8_t vals[] = { (uint8_t)qp, (uint8_t)qp, (uint8_t)m_slice->m_param->maxLog2CUSize, (uint8_t)ALL_IDX, (uint8_t)ALL_IDX,
+                             (uint8_t)frame.m_encData->m_param->bLossless, (uint8_t)REF_NOT_VALID, (uint8_t)REF_NOT_VALID };
+    m_planeSet((uint8_t*)m_qp, m_numPartitions, vals, m_slice->m_sliceType != I_SLICE ? 8 : 6);
 
     X265_CHECK(!(frame.m_encData->m_param->bLossless && !m_slice->m_pps->bTransquantBypassEnabled), "lossless enabled without TQbypass in PPS\n");
 
     /* initialize the remaining CU data in one memset */
-    memset(m_cuDepth, 0, (frame.m_param->internalCsp == X265_CSP_I400 ? BytesPerPartition - 12 : BytesPerPartition - 8) * m_numPartitions);
+    memset(m_cuDepth, 0, (m_numPlanes - 8) * m_numPartitions);
 
     for (int8_t i = 0; i < NUM_TU_DEPTH; i++)
         m_refTuDepth[i] = -1;
@@ -323,6 +364,7 @@ void CUData::initCTU(const Frame& frame, uint32_t cuAddr, int qp, uint32_t first
     m_cuAbove = (m_cuAddr >= widthInCU) && !m_bFirstRowInSlice ? m_encData->getPicCTU(m_cuAddr - widthInCU) : NULL;
     m_cuAboveLeft = (m_cuLeft && m_cuAbove) ? m_encData->getPicCTU(m_cuAddr - widthInCU - 1) : NULL;
     m_cuAboveRight = (m_cuAbove && ((m_cuAddr % widthInCU) < (widthInCU - 1))) ? m_encData->getPicCTU(m_cuAddr - widthInCU + 1) : NULL;
+    m_mvCandCache = NULL;
     memset(m_distortion, 0, m_numPartitions * sizeof(sse_t));
 }
 
@@ -343,6 +385,7 @@ void CUData::initSubCU(const CUData& ctu, const CUGeom& cuGeom, int qp)
     m_cuAbove       = ctu.m_cuAbove;
     m_cuAboveLeft   = ctu.m_cuAboveLeft;
     m_cuAboveRight  = ctu.m_cuAboveRight;
+    m_mvCandCache   = ctu.m_mvCandCache;
     m_bFirstRowInSlice = ctu.m_bFirstRowInSlice;
     m_bLastRowInSlice = ctu.m_bLastRowInSlice;
     m_bLastCuInSlice = ctu.m_bLastCuInSlice;
@@ -354,19 +397,13 @@ void CUData::initSubCU(const CUData& ctu, const CUGeom& cuGeom, int qp)
 
     X265_CHECK(m_numPartitions == cuGeom.numPartitions, "initSubCU() size mismatch\n");
 
-    m_partSet((uint8_t*)m_qp, (uint8_t)qp);
-    m_partSet((uint8_t*)m_qpAnalysis, (uint8_t)qp);
-
-    m_partSet(m_log2CUSize,   (uint8_t)cuGeom.log2CUSize);
-    m_partSet(m_lumaIntraDir, (uint8_t)ALL_IDX);
-    m_partSet(m_chromaIntraDir, (uint8_t)ALL_IDX);
-    m_partSet(m_tqBypass,     (uint8_t)m_encData->m_param->bLossless);
-    m_partSet((uint8_t*)m_refIdx[0], (uint8_t)REF_NOT_VALID);
-    m_partSet((uint8_t*)m_refIdx[1], (uint8_t)REF_NOT_VALID);
-    m_partSet(m_cuDepth,      (uint8_t)cuGeom.depth);
+    /* broadcast the planes from m_qp to m_cuDepth */
+    const uint8_t vals[] = { (uint8_t)qp, (uint8_t)qp, (uint8_t)cuGeom.log2CUSize, (uint8_t)ALL_IDX, (uint8_t)ALL_IDX,
+                             (uint8_t)m_encData->m_param->bLossless, (uint8_t)REF_NOT_VALID, (uint8_t)REF_NOT_VALID, (uint8_t)cuGeom.depth };
+    m_planeSet((uint8_t*)m_qp, m_numPartitions, vals, 9);
 
     /* initialize the remaining CU data in one memset */
-    memset(m_predMode, 0, (ctu.m_chromaFormat == X265_CSP_I400 ? BytesPerPartition - 13 : BytesPerPartition - 9) * m_numPartitions);
+    memset(m_predMode, 0, (m_numPlanes - 9) * m_numPartitions);
     memset(m_distortion, 0, m_numPartitions * sizeof(sse_t));
 
 #if ENABLE_SCC_EXT
@@ -388,29 +425,11 @@ void CUData::copyPartFrom(const CUData& subCU, const CUGeom& childGeom, uint32_t
     m_bFirstRowInSlice = subCU.m_bFirstRowInSlice;
     m_bLastCuInSlice = subCU.m_bLastCuInSlice;
 
-    m_subPartCopy((uint8_t*)m_qp + offset, (uint8_t*)subCU.m_qp);
-    m_subPartCopy((uint8_t*)m_qpAnalysis + offset, (uint8_t*)subCU.m_qpAnalysis);
-    m_subPartCopy(m_log2CUSize + offset, subCU.m_log2CUSize);
-    m_subPartCopy(m_lumaIntraDir + offset, subCU.m_lumaIntraDir);
-    m_subPartCopy(m_tqBypass + offset, subCU.m_tqBypass);
-    m_subPartCopy((uint8_t*)m_refIdx[0] + offset, (uint8_t*)subCU.m_refIdx[0]);
-    m_subPartCopy((uint8_t*)m_refIdx[1] + offset, (uint8_t*)subCU.m_refIdx[1]);
-    m_subPartCopy(m_cuDepth + offset, subCU.m_cuDepth);
-    m_subPartCopy(m_predMode + offset, subCU.m_predMode);
-    m_subPartCopy(m_partSize + offset, subCU.m_partSize);
-    m_subPartCopy(m_mergeFlag + offset, subCU.m_mergeFlag);
-    m_subPartCopy(m_interDir + offset, subCU.m_interDir);
-    m_subPartCopy(m_mvpIdx[0] + offset, subCU.m_mvpIdx[0]);
-    m_subPartCopy(m_mvpIdx[1] + offset, subCU.m_mvpIdx[1]);
-    m_subPartCopy(m_tuDepth + offset, subCU.m_tuDepth);
-
-    m_subPartCopy(m_transformSkip[0] + offset, subCU.m_transformSkip[0]);
-    m_subPartCopy(m_cbf[0] + offset, subCU.m_cbf[0]);
-
-    memcpy(m_mv[0] + offset, subCU.m_mv[0], childGeom.numPartitions * sizeof(MV));
-    memcpy(m_mv[1] + offset, subCU.m_mv[1], childGeom.numPartitions * sizeof(MV));
-    memcpy(m_mvd[0] + offset, subCU.m_mvd[0], childGeom.numPartitions * sizeof(MV));
-    memcpy(m_mvd[1] + offset, subCU.m_mvd[1], childGeom.numPartitions * sizeof(MV));
+    X265_CHECK(subCU.m_numPartitions == childGeom.numPartitions, "copyPartFrom() size mismatch\n");
+
+    /* all planes but the skip flags, then the MV planes */
+    m_subPlaneCopy((uint8_t*)m_qp + offset, m_numPartitions, (uint8_t*)subCU.m_qp, subCU.m_numPartitions, m_numPlanes - 2);
+    m_subMvPlaneCopy((uint8_t*)(m_mv[0] + offset), m_numPartitions * sizeof(MV), (uint8_t*)subCU.m_mv[0], subCU.m_numPartitions * sizeof(MV), NumMvPlanes);
 
     memcpy(m_distortion + offset, subCU.m_distortion, childGeom.numPartitions * sizeof(sse_t));
 
@@ -420,12 +439,6 @@ void CUData::copyPartFrom(const CUData& subCU, const CUGeom& childGeom, uint32_t
 
     if (subCU.m_chromaFormat != X265_CSP_I400)
     {
-        m_subPartCopy(m_transformSkip[1] + offset, subCU.m_transformSkip[1]);
-        m_subPartCopy(m_transformSkip[2] + offset, subCU.m_transformSkip[2]);
-        m_subPartCopy(m_cbf[1] + offset, subCU.m_cbf[1]);
-        m_subPartCopy(m_cbf[2] + offset, subCU.m_cbf[2]);
-        m_subPartCopy(m_chromaIntraDir + offset, subCU.m_chromaIntraDir);
-
         uint32_t tmpC = tmp >> (m_hChromaShift + m_vChromaShift);
         uint32_t tmpC2 = tmp2 >> (m_hChromaShift + m_vChromaShift);
         memcpy(m_trCoeff[1] + tmpC2, subCU.m_trCoeff[1], sizeof(coeff_t) * tmpC);
@@ -460,13 +473,11 @@ void CUData::initLosslessCU(const CUData& cu, const CUGeom& cuGeom)
     m_cuAbove      = cu.m_cuAbove;
     m_cuAboveLeft  = cu.m_cuAboveLeft;
     m_cuAboveRight = cu.m_cuAboveRight;
+    m_mvCandCache  = cu.m_mvCandCache;
     m_absIdxInCTU  = cuGeom.absPartIdx;
     m_numPartitions = cuGeom.numPartitions;
-    memcpy(m_qp, cu.m_qp, BytesPerPartition * m_numPartitions);
-    memcpy(m_mv[0],  cu.m_mv[0],  m_numPartitions * sizeof(MV));
-    memcpy(m_mv[1],  cu.m_mv[1],  m_numPartitions * sizeof(MV));
-    memcpy(m_mvd[0], cu.m_mvd[0], m_numPartitions * sizeof(MV));
-    memcpy(m_mvd[1], cu.m_mvd[1], m_numPartitions * sizeof(MV));
+    memcpy(m_qp, cu.m_qp, m_numPlanes * m_numPartitions);
+    memcpy(m_mv[0], cu.m_mv[0], NumMvPlanes * m_numPartitions * sizeof(MV));
     memcpy(m_distortion, cu.m_distortion, m_numPartitions * sizeof(sse_t));
 
     /* force TQBypass to true */
@@ -493,28 +504,9 @@ void CUData::copyToPic(uint32_t depth) const
 {
     CUData& ctu = *m_encData->getPicCTU(m_cuAddr);
 
-    m_partCopy((uint8_t*)ctu.m_qp + m_absIdxInCTU, (uint8_t*)m_qp);
-    m_partCopy((uint8_t*)ctu.m_qpAnalysis + m_absIdxInCTU, (uint8_t*)m_qpAnalysis);
-    m_partCopy(ctu.m_log2CUSize + m_absIdxInCTU, m_log2CUSize);
-    m_partCopy(ctu.m_lumaIntraDir + m_absIdxInCTU, m_lumaIntraDir);
-    m_partCopy(ctu.m_tqBypass + m_absIdxInCTU, m_tqBypass);
-    m_partCopy((uint8_t*)ctu.m_refIdx[0] + m_absIdxInCTU, (uint8_t*)m_refIdx[0]);
-    m_partCopy((uint8_t*)ctu.m_refIdx[1] + m_absIdxInCTU, (uint8_t*)m_refIdx[1]);
-    m_partCopy(ctu.m_cuDepth + m_absIdxInCTU, m_cuDepth);
-    m_partCopy(ctu.m_predMode + m_absIdxInCTU, m_predMode);
-    m_partCopy(ctu.m_partSize + m_absIdxInCTU, m_partSize);
-    m_partCopy(ctu.m_mergeFlag + m_absIdxInCTU, m_mergeFlag);
-    m_partCopy(ctu.m_interDir + m_absIdxInCTU, m_interDir);
-    m_partCopy(ctu.m_mvpIdx[0] + m_absIdxInCTU, m_mvpIdx[0]);
-    m_partCopy(ctu.m_mvpIdx[1] + m_absIdxInCTU, m_mvpIdx[1]);
-    m_partCopy(ctu.m_tuDepth + m_absIdxInCTU, m_tuDepth);
-    m_partCopy(ctu.m_transformSkip[0] + m_absIdxInCTU, m_transformSkip[0]);
-    m_partCopy(ctu.m_cbf[0] + m_absIdxInCTU, m_cbf[0]);
-
-    memcpy(ctu.m_mv[0] + m_absIdxInCTU, m_mv[0], m_numPartitions * sizeof(MV));
-    memcpy(ctu.m_mv[1] + m_absIdxInCTU, m_mv[1], m_numPartitions * sizeof(MV));
-    memcpy(ctu.m_mvd[0] + m_absIdxInCTU, m_mvd[0], m_numPartitions * sizeof(MV));
-    memcpy(ctu.m_mvd[1] + m_absIdxInCTU, m_mvd[1], m_numPartitions * sizeof(MV));
+    /* all planes but the skip flags, then the MV planes */
+    m_planeCopy((uint8_t*)ctu.m_qp + m_absIdxInCTU, ctu.m_numPartitions, (uint8_t*)m_qp, m_numPartitions, m_numPlanes - 2);
+    m_mvPlaneCopy((uint8_t*)(ctu.m_mv[0] + m_absIdxInCTU), ctu.m_numPartitions * sizeof(MV), (uint8_t*)m_mv[0], m_numPartitions * sizeof(MV), NumMvPlanes);
 
     memcpy(ctu.m_distortion + m_absIdxInCTU, m_distortion, m_numPartitions * sizeof(sse_t));
 
@@ -524,12 +516,6 @@ void CUData::copyToPic(uint32_t depth) const
 
     if (ctu.m_chromaFormat != X265_CSP_I400)
     {
-        m_partCopy(ctu.m_transformSkip[1] + m_absIdxInCTU, m_transformSkip[1]);
-        m_partCopy(ctu.m_transformSkip[2] + m_absIdxInCTU, m_transformSkip[2]);
-        m_partCopy(ctu.m_cbf[1] + m_absIdxInCTU, m_cbf[1]);
-        m_partCopy(ctu.m_cbf[2] + m_absIdxInCTU, m_cbf[2]);
-        m_partCopy(ctu.m_chromaIntraDir + m_absIdxInCTU, m_chromaIntraDir);
-
         uint32_t tmpC = tmpY >> (m_hChromaShift + m_vChromaShift);
         uint32_t tmpC2 = tmpY2 >> (m_hChromaShift + m_vChromaShift);
         memcpy(ctu.m_trCoeff[1] + tmpC2, m_trCoeff[1], sizeof(coeff_t) * tmpC);
@@ -545,6 +531,7 @@ void CUData::copyFromPic(const CUData& ctu, const CUGeom& cuGeom, int csp, bool
     m_cuAddr        = ctu.m_cuAddr;
     m_cuPelX        = ctu.m_cuPelX + g_zscanToPelX[cuGeom.absPartIdx];
     m_cuPelY        = ctu.m_cuPelY + g_zscanToPelY[cuGeom.absPartIdx];
+    m_mvCandCache   = ctu.m_mvCandCache;
     m_absIdxInCTU   = cuGeom.absPartIdx;
     m_numPartitions = cuGeom.numPartitions;
 
@@ -555,39 +542,15 @@ void CUData::copyFromPic(const CUData& ctu, const CUGeom& cuGeom, int csp, bool
         m_partCopy((uint8_t*)m_qpAnalysis, (uint8_t*)ctu.m_qpAnalysis + m_absIdxInCTU);
     }
 
-    m_partCopy(m_log2CUSize,   ctu.m_log2CUSize + m_absIdxInCTU);
-    m_partCopy(m_lumaIntraDir, ctu.m_lumaIntraDir + m_absIdxInCTU);
-    m_partCopy(m_tqBypass,     ctu.m_tqBypass + m_absIdxInCTU);
-    m_partCopy((uint8_t*)m_refIdx[0], (uint8_t*)ctu.m_refIdx[0] + m_absIdxInCTU);
-    m_partCopy((uint8_t*)m_refIdx[1], (uint8_t*)ctu.m_refIdx[1] + m_absIdxInCTU);
-    m_partCopy(m_cuDepth,      ctu.m_cuDepth + m_absIdxInCTU);
+    m_planeCopy(m_log2CUSize, m_numPartitions, ctu.m_log2CUSize + m_absIdxInCTU, ctu.m_numPartitions, 7); /* m_log2CUSize to m_cuDepth */
     m_partSet(m_predMode, ctu.m_predMode[m_absIdxInCTU] & (MODE_INTRA | MODE_INTER)); /* clear skip flag */
-    m_partCopy(m_partSize,     ctu.m_partSize + m_absIdxInCTU);
-    m_partCopy(m_mergeFlag,    ctu.m_mergeFlag + m_absIdxInCTU);
-    m_partCopy(m_interDir,     ctu.m_interDir + m_absIdxInCTU);
-    m_partCopy(m_mvpIdx[0],    ctu.m_mvpIdx[0] + m_absIdxInCTU);
-    m_partCopy(m_mvpIdx[1],    ctu.m_mvpIdx[1] + m_absIdxInCTU);
-    m_partCopy(m_chromaIntraDir, ctu.m_chromaIntraDir + m_absIdxInCTU);
-
-    memcpy(m_mv[0], ctu.m_mv[0] + m_absIdxInCTU, m_numPartitions * sizeof(MV));
-    memcpy(m_mv[1], ctu.m_mv[1] + m_absIdxInCTU, m_numPartitions * sizeof(MV));
-    memcpy(m_mvd[0], ctu.m_mvd[0] + m_absIdxInCTU, m_numPartitions * sizeof(MV));
-    memcpy(m_mvd[1], ctu.m_mvd[1] + m_absIdxInCTU, m_numPartitions * sizeof(MV));
+    m_planeCopy(m_partSize, m_numPartitions, ctu.m_partSize + m_absIdxInCTU, ctu.m_numPartitions, 5); /* m_partSize to m_mvpIdx[1] */
+    m_mvPlaneCopy((uint8_t*)m_mv[0], m_numPartitions * sizeof(MV), (uint8_t*)(ctu.m_mv[0] + m_absIdxInCTU), ctu.m_numPartitions * sizeof(MV), NumMvPlanes);
 
     memcpy(m_distortion, ctu.m_distortion + m_absIdxInCTU, m_numPartitions * sizeof(sse_t));
 
-    /* clear residual coding flags */
-    m_partSet(m_tuDepth, 0);
-    m_partSet(m_transformSkip[0], 0);
-    m_partSet(m_cbf[0], 0);
-
-    if (csp != X265_CSP_I400)
-    {        
-        m_partSet(m_transformSkip[1], 0);
-        m_partSet(m_transformSkip[2], 0);
-        m_partSet(m_cbf[1], 0);
-        m_partSet(m_cbf[2], 0);
-    }
+    /* clear residual coding flags, m_tuDepth to the last m_cbf */
+    memset(m_tuDepth, 0, (csp != X265_CSP_I400 ? 7 : 3) * m_numPartitions);
 }
 
 /* Only called by encodeResidue, these fields can be modified during inter/intra coding */
@@ -1617,50 +1580,49 @@ uint32_t CUData::getInterMergeCandidates(uint32_t absPartIdx, uint32_t puIdx, MV
     if (m_slice->m_sps->bTemporalMVPEnabled)
 #endif
     {
-        uint32_t partIdxRB = deriveRightBottomIdx(puIdx);
         MV colmv;
-        int ctuIdx = -1;
-
-        // image boundary check
-        if (m_encData->getPicCTU(m_cuAddr)->m_cuPelX + g_zscanToPelX[partIdxRB] + UNIT_SIZE < m_slice->m_sps->picWidthInLumaSamples &&
-            m_encData->getPicCTU(m_cuAddr)->m_cuPelY + g_zscanToPelY[partIdxRB] + UNIT_SIZE < m_slice->m_sps->picHeightInLumaSamples)
-        {
-            uint32_t absPartIdxRB = g_zscanToRaster[partIdxRB];
-            uint32_t numUnits = s_numPartInCUSize;
-            bool bNotLastCol = lessThanCol(absPartIdxRB, numUnits - 1); // is not at the last column of CTU
-            bool bNotLastRow = lessThanRow(absPartIdxRB, numUnits - 1); // is not at the last row    of CTU
-
-            if (bNotLastCol && bNotLastRow)
-            {
-                absPartAddr = g_rasterToZscan[absPartIdxRB + RASTER_SIZE + 1];
-                ctuIdx = m_cuAddr;
-            }
-            else if (bNotLastCol)
-                absPartAddr = g_rasterToZscan[(absPartIdxRB + 1) & (numUnits - 1)];
-            else if (bNotLastRow)
-            {
-                absPartAddr = g_rasterToZscan[absPartIdxRB + RASTER_SIZE - numUnits + 1];
-                ctuIdx = m_cuAddr + 1;
-            }
-            else // is the right bottom corner of CTU
-                absPartAddr = 0;
-        }
+        int ctuIdx = getColRightBottom(puIdx, absPartAddr);
 
         int maxList = isInterB ? 2 : 1;
         int dir = 0, refIdx = 0;
-        for (int list = 0; list < maxList; list++)
+        if (m_mvCandCache)
         {
-            bool bExistMV = ctuIdx >= 0 && getColMVP(colmv, refIdx, list, ctuIdx, absPartAddr);
-            if (!bExistMV)
+            /* the right bottom unit, falling back to the center unit per list */
+            const MVCandCache::ColUnit* rb = ctuIdx >= 0 ? &getColUnit(ctuIdx, absPartAddr) : NULL;
+            const MVCandCache::ColUnit* center = NULL;
+            for (int list = 0; list < maxList; list++)
             {
-                uint32_t partIdxCenter = deriveCenterIdx(puIdx);
-                bExistMV = getColMVP(colmv, refIdx, list, m_cuAddr, partIdxCenter);
+                const MVCandCache::ColUnit* unit = rb;
+                if (!unit || !unit->bMerge[list])
+                {
+                    if (!center)
+                        center = &getColUnit(m_cuAddr, deriveCenterIdx(puIdx));
+                    unit = center;
+                }
+                if (unit->bMerge[list])
+                {
+                    dir |= (1 << list);
+                    candMvField[count][list].mv = unit->mergeMv[list];
+                    candMvField[count][list].refIdx = refIdx;
+                }
             }
-            if (bExistMV)
+        }
+        else
+        {
+            for (int list = 0; list < maxList; list++)
             {
-                dir |= (1 << list);
-                candMvField[count][list].mv = colmv;
-                candMvField[count][list].refIdx = refIdx;
+                bool bExistMV = ctuIdx >= 0 && getColMVP(colmv, refIdx, list, ctuIdx, absPartAddr);
+                if (!bExistMV)
+                {
+                    uint32_t partIdxCenter = deriveCenterIdx(puIdx);
+                    bExistMV = getColMVP(colmv, refIdx, list, m_cuAddr, partIdxCenter);
+                }
+                if (bExistMV)
+                {
+                    dir |= (1 << list);
+                    candMvField[count][list].mv = colmv;
+                    candMvField[count][list].refIdx = refIdx;
+                }
             }
         }
 
@@ -1752,6 +1714,11 @@ int CUData::getPMV(InterNeighbourMV* neighbours, uint32_t picList, uint32_t refI
     bool validDirect[MD_ABOVE_LEFT + 1];
     bool validIndirect[MD_ABOVE_LEFT + 1];
 
+    /* the PMV list below stores every candidate and only counts the valid
+     * ones, so an invalid indirect candidate must still hold a value */
+    for (int dir = 0; dir <= MD_ABOVE_LEFT; dir++)
+        indirectMV[dir] = 0;
+
 #if (ENABLE_MULTIVIEW || ENABLE_SCC_EXT)
     if (m_slice->m_param->numViews > 1 || m_slice->m_param->bEnableSCC)
     {
@@ -1784,62 +1751,68 @@ int CUData::getPMV(InterNeighbourMV* neighbours, uint32_t picList, uint32_t refI
     else
 #endif
     {
-        // Left candidate.
-        validDirect[MD_BELOW_LEFT] = getDirectPMV(directMV[MD_BELOW_LEFT], neighbours + MD_BELOW_LEFT, picList, refIdx);
-        validDirect[MD_LEFT] = getDirectPMV(directMV[MD_LEFT], neighbours + MD_LEFT, picList, refIdx);
-        // Top candidate.
-        validDirect[MD_ABOVE_RIGHT] = getDirectPMV(directMV[MD_ABOVE_RIGHT], neighbours + MD_ABOVE_RIGHT, picList, refIdx);
-        validDirect[MD_ABOVE] = getDirectPMV(directMV[MD_ABOVE], neighbours + MD_ABOVE, picList, refIdx);
-        validDirect[MD_ABOVE_LEFT] = getDirectPMV(directMV[MD_ABOVE_LEFT], neighbours + MD_ABOVE_LEFT, picList, refIdx);
-
-        // Left candidate.
-        validIndirect[MD_BELOW_LEFT] = getIndirectPMV(indirectMV[MD_BELOW_LEFT], neighbours + MD_BELOW_LEFT, picList, refIdx);
-        validIndirect[MD_LEFT] = getIndirectPMV(indirectMV[MD_LEFT], neighbours + MD_LEFT, picList, refIdx);
-        // Top candidate.
-        validIndirect[MD_ABOVE_RIGHT] = getIndirectPMV(indirectMV[MD_ABOVE_RIGHT], neighbours + MD_ABOVE_RIGHT, picList, refIdx);
-        validIndirect[MD_ABOVE] = getIndirectPMV(indirectMV[MD_ABOVE], neighbours + MD_ABOVE, picList, refIdx);
-        validIndirect[MD_ABOVE_LEFT] = getIndirectPMV(indirectMV[MD_ABOVE_LEFT], neighbours + MD_ABOVE_LEFT, picList, refIdx);
+        /* the direct and indirect candidates of all five neighbours, selected
+         * from the reference indices without branching; a neighbour with no
+         * reference in either list has neither */
+        const int* refPOC[2] = { m_slice->m_refPOCList[picList], m_slice->m_refPOCList[!picList] };
+        int curRefPOC = refPOC[0][refIdx];
+        for (int dir = MD_LEFT; dir <= MD_ABOVE_LEFT; dir++)
+        {
+            const InterNeighbourMV& neighbour = neighbours[dir];
+            int ref0 = neighbour.refIdx[picList];
+            int ref1 = neighbour.refIdx[!picList];
+            bool bDirect0 = (ref0 >= 0) & (refPOC[0][ref0 & 0xf] == curRefPOC);
+            bool bDirect1 = (ref1 >= 0) & (refPOC[1][ref1 & 0xf] == curRefPOC);
+
+            validDirect[dir] = bDirect0 | bDirect1;
+            directMV[dir] = neighbour.mv[bDirect0 ? picList : !picList];
+            validIndirect[dir] = neighbour.unifiedRef != -1;
+            if (validIndirect[dir])
+            {
+                uint32_t list = ref0 >= 0 ? picList : !picList;
+                indirectMV[dir] = scaleSpatialMv(neighbour.mv[list], picList, refIdx, list, neighbour.refIdx[list]);
+            }
+        }
     }
 
+    /* the first valid candidate of each group is the lowest bit of its mask */
+    const MV* leftCand[4] = { &directMV[MD_BELOW_LEFT], &directMV[MD_LEFT], &indirectMV[MD_BELOW_LEFT], &indirectMV[MD_LEFT] };
+    const MV* aboveCand[3] = { &directMV[MD_ABOVE_RIGHT], &directMV[MD_ABOVE], &directMV[MD_ABOVE_LEFT] };
+    const MV* aboveScaledCand[3] = { &indirectMV[MD_ABOVE_RIGHT], &indirectMV[MD_ABOVE], &indirectMV[MD_ABOVE_LEFT] };
+    uint32_t leftMask = validDirect[MD_BELOW_LEFT] | validDirect[MD_LEFT] << 1 | validIndirect[MD_BELOW_LEFT] << 2 | validIndirect[MD_LEFT] << 3;
+    uint32_t aboveMask = validDirect[MD_ABOVE_RIGHT] | validDirect[MD_ABOVE] << 1 | validDirect[MD_ABOVE_LEFT] << 2;
+    uint32_t aboveScaledMask = validIndirect[MD_ABOVE_RIGHT] | validIndirect[MD_ABOVE] << 1 | validIndirect[MD_ABOVE_LEFT] << 2;
+    unsigned long idx;
+
     int num = 0;
     // Left predictor search
-    if (validDirect[MD_BELOW_LEFT])
-        amvpCand[num++] = directMV[MD_BELOW_LEFT];
-    else if (validDirect[MD_LEFT])
-        amvpCand[num++] = directMV[MD_LEFT];
-    else if (validIndirect[MD_BELOW_LEFT])
-        amvpCand[num++] = indirectMV[MD_BELOW_LEFT];
-    else if (validIndirect[MD_LEFT])
-        amvpCand[num++] = indirectMV[MD_LEFT];
-
-    bool bAddedSmvp = num > 0;
+    if (leftMask)
+    {
+        CTZ(idx, leftMask);
+        amvpCand[num++] = *leftCand[idx];
+    }
 
     // Above predictor search
-    if (validDirect[MD_ABOVE_RIGHT])
-        amvpCand[num++] = directMV[MD_ABOVE_RIGHT];
-    else if (validDirect[MD_ABOVE])
-        amvpCand[num++] = directMV[MD_ABOVE];
-    else if (validDirect[MD_ABOVE_LEFT])
-        amvpCand[num++] = directMV[MD_ABOVE_LEFT];
+    if (aboveMask)
+    {
+        CTZ(idx, aboveMask);
+        amvpCand[num++] = *aboveCand[idx];
+    }
 
-    if (!bAddedSmvp)
+    if (!leftMask && aboveScaledMask)
     {
-        if (validIndirect[MD_ABOVE_RIGHT])
-            amvpCand[num++] = indirectMV[MD_ABOVE_RIGHT];
-        else if (validIndirect[MD_ABOVE])
-            amvpCand[num++] = indirectMV[MD_ABOVE];
-        else if (validIndirect[MD_ABOVE_LEFT])
-            amvpCand[num++] = indirectMV[MD_ABOVE_LEFT];
+        CTZ(idx, aboveScaledMask);
+        amvpCand[num++] = *aboveScaledCand[idx];
     }
 
     int numMvc = 0;
     for (int dir = MD_LEFT; dir <= MD_ABOVE_LEFT; dir++)
     {
-        if (validDirect[dir] && directMV[dir].notZero())
-            pmv[numMvc++] = directMV[dir];
+        pmv[numMvc] = directMV[dir];
+        numMvc += validDirect[dir] & directMV[dir].notZero();
 
-        if (validIndirect[dir] && indirectMV[dir].notZero())
-            pmv[numMvc++] = indirectMV[dir];
+        pmv[numMvc] = indirectMV[dir];
+        numMvc += validIndirect[dir] & indirectMV[dir].notZero();
     }
 
     if (num == 2)
@@ -1854,35 +1827,9 @@ int CUData::getPMV(InterNeighbourMV* neighbours, uint32_t picList, uint32_t refI
         {
             int refId = refIdx;
             uint32_t absPartAddr = m_absIdxInCTU + absPartIdx;
-            uint32_t partIdxRB = deriveRightBottomIdx(puIdx);
 
             // co-located RightBottom temporal predictor (H)
-            int ctuIdx = -1;
-
-            // image boundary check
-            if (m_encData->getPicCTU(m_cuAddr)->m_cuPelX + g_zscanToPelX[partIdxRB] + UNIT_SIZE < m_slice->m_sps->picWidthInLumaSamples &&
-                m_encData->getPicCTU(m_cuAddr)->m_cuPelY + g_zscanToPelY[partIdxRB] + UNIT_SIZE < m_slice->m_sps->picHeightInLumaSamples)
-            {
-                uint32_t absPartIdxRB = g_zscanToRaster[partIdxRB];
-                uint32_t numUnits = s_numPartInCUSize;
-                bool bNotLastCol = lessThanCol(absPartIdxRB, numUnits - 1); // is not at the last column of CTU
-                bool bNotLastRow = lessThanRow(absPartIdxRB, numUnits - 1); // is not at the last row    of CTU
-
-                if (bNotLastCol && bNotLastRow)
-                {
-                    absPartAddr = g_rasterToZscan[absPartIdxRB + RASTER_SIZE + 1];
-                    ctuIdx = m_cuAddr;
-                }
-                else if (bNotLastCol)
-                    absPartAddr = g_rasterToZscan[(absPartIdxRB + 1) & (numUnits - 1)];
-                else if (bNotLastRow)
-                {
-                    absPartAddr = g_rasterToZscan[absPartIdxRB + RASTER_SIZE - numUnits + 1];
-                    ctuIdx = m_cuAddr + 1;
-                }
-                else // is the right bottom corner of CTU
-                    absPartAddr = 0;
-            }
+            int ctuIdx = getColRightBottom(puIdx, absPartAddr);
             if (ctuIdx >= 0 && getColMVP(neighbours[MD_COLLOCATED].mv[picList], refId, picList, ctuIdx, absPartAddr))
                 pmv[numMvc++] = amvpCand[num++] = neighbours[MD_COLLOCATED].mv[picList];
             else
@@ -1901,20 +1848,7 @@ int CUData::getPMV(InterNeighbourMV* neighbours, uint32_t picList, uint32_t refI
         {
             int tempRefIdx = neighbours[MD_COLLOCATED].refIdx[picList];
             if (tempRefIdx != -1)
-            {
-                uint32_t cuAddr = neighbours[MD_COLLOCATED].cuAddr[picList];
-                const Frame* colPic = m_slice->m_refFrameList[m_slice->isInterB() && !m_slice->m_colFromL0Flag][m_slice->m_colRefIdx];
-                const CUData* colCU = colPic->m_encData->getPicCTU(cuAddr);
-
-                // Scale the vector
-                int colRefPOC = colCU->m_slice->m_refPOCList[tempRefIdx >> 4][tempRefIdx & 0xf];
-                int colPOC = colCU->m_slice->m_poc;
-
-                int curRefPOC = m_slice->m_refPOCList[picList][refIdx];
-                int curPOC = m_slice->m_poc;
-
-                pmv[numMvc++] = amvpCand[num++] = scaleMvByPOCDist(neighbours[MD_COLLOCATED].mv[picList], curPOC, curRefPOC, colPOC, colRefPOC);
-            }
+                pmv[numMvc++] = amvpCand[num++] = scaleCollocatedMv(neighbours[MD_COLLOCATED], picList, refIdx);
         }
     }
 
@@ -1943,37 +1877,19 @@ void CUData::getNeighbourMV(uint32_t puIdx, uint32_t absPartIdx, InterNeighbourM
     if (m_slice->m_bTemporalMvp && !(m_slice->m_param->bEnableSCC || m_slice->m_param->numViews > 1))
     {
         uint32_t absPartAddr = m_absIdxInCTU + absPartIdx;
-        uint32_t partIdxRB = deriveRightBottomIdx(puIdx);
 
         // co-located RightBottom temporal predictor (H)
-        int ctuIdx = -1;
+        int ctuIdx = getColRightBottom(puIdx, absPartAddr);
 
-        // image boundary check
-        if (m_encData->getPicCTU(m_cuAddr)->m_cuPelX + g_zscanToPelX[partIdxRB] + UNIT_SIZE < m_slice->m_sps->picWidthInLumaSamples &&
-            m_encData->getPicCTU(m_cuAddr)->m_cuPelY + g_zscanToPelY[partIdxRB] + UNIT_SIZE < m_slice->m_sps->picHeightInLumaSamples)
+        if (m_mvCandCache)
         {
-            uint32_t absPartIdxRB = g_zscanToRaster[partIdxRB];
-            uint32_t numUnits = s_numPartInCUSize;
-            bool bNotLastCol = lessThanCol(absPartIdxRB, numUnits - 1); // is not at the last column of CTU
-            bool bNotLastRow = lessThanRow(absPartIdxRB, numUnits - 1); // is not at the last row    of CTU
-
-            if (bNotLastCol && bNotLastRow)
-            {
-                absPartAddr = g_rasterToZscan[absPartIdxRB + RASTER_SIZE + 1];
-                ctuIdx = m_cuAddr;
-            }
-            else if (bNotLastCol)
-                absPartAddr = g_rasterToZscan[(absPartIdxRB + 1) & (numUnits - 1)];
-            else if (bNotLastRow)
-            {
-                absPartAddr = g_rasterToZscan[absPartIdxRB + RASTER_SIZE - numUnits + 1];
-                ctuIdx = m_cuAddr + 1;
-            }
-            else // is the right bottom corner of CTU
-                absPartAddr = 0;
+            const MVCandCache::ColUnit* unit = ctuIdx >= 0 ? &getColUnit(ctuIdx, absPartAddr) : NULL;
+            if (!unit || !unit->bCollocated)
+                unit = &getColUnit(m_cuAddr, deriveCenterIdx(puIdx));
+            if (unit->bCollocated)
+                neighbours[MD_COLLOCATED] = unit->collocated;
         }
-
-        if (!(ctuIdx >= 0 && getCollocatedMV(ctuIdx, absPartAddr, neighbours + MD_COLLOCATED)))
+        else if (!(ctuIdx >= 0 && getCollocatedMV(ctuIdx, absPartAddr, neighbours + MD_COLLOCATED)))
         {
             uint32_t partIdxCenter =  deriveCenterIdx(puIdx);
             uint32_t curCTUIdx = m_cuAddr;
@@ -2066,29 +1982,31 @@ bool CUData::getDirectPMV(MV& pmv, InterNeighbourMV *neighbours, uint32_t picLis
 // Load indirect spatial MV if available. An indirect MV has to be scaled.
 bool CUData::getIndirectPMV(MV& outMV, InterNeighbourMV *neighbours, uint32_t picList, uint32_t refIdx) const
 {
+#if ENABLE_MULTIVIEW || ENABLE_SCC_EXT
     int curPOC = m_slice->m_poc;
-    int neibPOC = curPOC;
     int curRefPOC = m_slice->m_refPOCList[picList][refIdx];
+#endif
+    uint32_t curList = picList;
 
     for (int i = 0; i < 2; i++, picList = !picList)
     {
         int partRefIdx = neighbours->refIdx[picList];
         if (partRefIdx >= 0)
         {
-            int neibRefPOC = m_slice->m_refPOCList[picList][partRefIdx];
             MV mvp = neighbours->mv[picList];
 
 #if ENABLE_MULTIVIEW || ENABLE_SCC_EXT
+            int neibRefPOC = m_slice->m_refPOCList[picList][partRefIdx];
             if ((curRefPOC == curPOC) == (neibRefPOC == curPOC))
             {
                 if (curRefPOC == curPOC)
                     outMV = mvp;
                 if (!(curRefPOC == curPOC))
-                    outMV = scaleMvByPOCDist(mvp, curPOC, curRefPOC, neibPOC, neibRefPOC);
+                    outMV = scaleSpatialMv(mvp, curList, refIdx, picList, partRefIdx);
                 return true;
             }
 #else
-            outMV = scaleMvByPOCDist(mvp, curPOC, curRefPOC, neibPOC, neibRefPOC);
+            outMV = scaleSpatialMv(mvp, curList, refIdx, picList, partRefIdx);
             return true;
 #endif
         }
@@ -2167,6 +2085,107 @@ bool CUData::getCollocatedMV(int cuAddr, int partUnitIdx, InterNeighbourMV *neig
     return neighbour->unifiedRef != -1;
 }
 
+/* Returns the temporal candidates of a collocated unit of the CTU or of the
+ * CTU to its right, deriving them on first use */
+const MVCandCache::ColUnit& CUData::getColUnit(int cuAddr, int partUnitIdx) const
+{
+    X265_CHECK(m_mvCandCache->cuAddr == m_cuAddr, "motion candidate cache of another CTU\n");
+    X265_CHECK(cuAddr == (int)m_cuAddr || cuAddr == (int)m_cuAddr + 1, "collocated CTU out of range\n");
+
+    /* every position read is inside the picture, so the candidates depend
+     * only on the 16x16 unit holding it */
+    MVCandCache::ColUnit& unit = m_mvCandCache->col[cuAddr != (int)m_cuAddr][partUnitIdx >> 4];
+    if (!unit.bDerived)
+    {
+        unit.bDerived = true;
+        unit.collocated.unifiedRef = -1;
+        unit.bCollocated = getCollocatedMV(cuAddr, partUnitIdx, &unit.collocated);
+
+        int refIdx = 0;
+        unit.bMerge[0] = getColMVP(unit.mergeMv[0], refIdx, 0, cuAddr, partUnitIdx);
+        unit.bMerge[1] = m_slice->isInterB() && getColMVP(unit.mergeMv[1], refIdx, 1, cuAddr, partUnitIdx);
+    }
+    return unit;
+}
+
+/* Derives the collocated right bottom position of a PU, returns the CTU
+ * holding it or -1 when it is not usable. absPartAddr is left unchanged when
+ * the position lies outside the picture */
+int CUData::getColRightBottom(uint32_t puIdx, uint32_t& absPartAddr) const
+{
+    uint32_t partIdxRB = deriveRightBottomIdx(puIdx);
+    int ctuIdx = -1;
+
+    // image boundary check
+    if (m_encData->getPicCTU(m_cuAddr)->m_cuPelX + g_zscanToPelX[partIdxRB] + UNIT_SIZE < m_slice->m_sps->picWidthInLumaSamples &&
+        m_encData->getPicCTU(m_cuAddr)->m_cuPelY + g_zscanToPelY[partIdxRB] + UNIT_SIZE < m_slice->m_sps->picHeightInLumaSamples)
+    {
+        uint32_t absPartIdxRB = g_zscanToRaster[partIdxRB];
+        uint32_t numUnits = s_numPartInCUSize;
+        bool bNotLastCol = lessThanCol(absPartIdxRB, numUnits - 1); // is not at the last column of CTU
+        bool bNotLastRow = lessThanRow(absPartIdxRB, numUnits - 1); // is not at the last row    of CTU
+
+        if (bNotLastCol && bNotLastRow)
+        {
+            absPartAddr = g_rasterToZscan[absPartIdxRB + RASTER_SIZE + 1];
+            ctuIdx = m_cuAddr;
+        }
+        else if (bNotLastCol)
+            absPartAddr = g_rasterToZscan[(absPartIdxRB + 1) & (numUnits - 1)];
+        else if (bNotLastRow)
+        {
+            absPartAddr = g_rasterToZscan[absPartIdxRB + RASTER_SIZE - numUnits + 1];
+            ctuIdx = m_cuAddr + 1;
+        }
+        else // is the right bottom corner of CTU
+            absPartAddr = 0;
+    }
+    return ctuIdx;
+}
+
+/* Motion of the reference picture at the centre of a PU and just right of
+ * and below it, scaled to the distance of the reference; the co-located
+ * predictors of --me epzs. Positions outside the CTU row of the PU are
+ * skipped, further rows of the reference may still be encoding. Returns the
+ * number of vectors written to mvc */
+int CUData::getRefPicMotion(MV* mvc, int picList, int refIdx, uint32_t absPartIdx, uint32_t width, uint32_t height) const
+{
+    const Frame* refPic = m_slice->m_refFrameList[picList][refIdx];
+    const Slice* refSlice = refPic->m_encData->m_slice;
+    int curPOC = m_slice->m_poc;
+    int refPOC = m_slice->m_refPOCList[picList][refIdx];
+    if (refPOC == curPOC || refSlice->isIntra())
+        return 0;
+
+    uint32_t ctuSize = m_slice->m_param->maxCUSize;
+    uint32_t puX = m_cuPelX + g_zscanToPelX[absPartIdx];
+    uint32_t puY = m_cuPelY + g_zscanToPelY[absPartIdx];
+    const uint32_t posX[3] = { puX + width / 2, puX + width, puX + width / 2 };
+    const uint32_t posY[3] = { puY + height / 2, puY + height / 2, puY + height };
+
+    int num = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        if (posX[i] >= m_slice->m_sps->picWidthInLumaSamples || posY[i] >= m_slice->m_sps->picHeightInLumaSamples ||
+            posY[i] / ctuSize != puY / ctuSize)
+            continue;
+
+        const CUData* colCU = refPic->m_encData->getPicCTU(posY[i] / ctuSize * m_slice->m_sps->numCuInWidth + posX[i] / ctuSize);
+        uint32_t colIdx = g_rasterToZscan[((posY[i] & (ctuSize - 1)) >> LOG2_UNIT_SIZE) * RASTER_SIZE + ((posX[i] & (ctuSize - 1)) >> LOG2_UNIT_SIZE)];
+        if (colCU->m_predMode[colIdx] == MODE_NONE || colCU->isIntra(colIdx))
+            continue;
+
+        int colList = colCU->m_refIdx[picList][colIdx] >= 0 ? picList : !picList;
+        int colRefIdx = colCU->m_refIdx[colList][colIdx];
+        if (colRefIdx < 0 || refSlice->m_refPOCList[colList][colRefIdx] == refPOC)
+            continue;
+
+        mvc[num++] = scaleMvByPOCDist(colCU->m_mv[colList][colIdx], curPOC, refPOC, refPOC, refSlice->m_refPOCList[colList][colRefIdx]);
+    }
+
+    return num;
+}
+
 MV CUData::scaleMvByPOCDist(const MV& inMV, int curPOC, int curRefPOC, int colPOC, int colRefPOC) const
 {
     int diffPocD = colPOC - colRefPOC;
@@ -2175,13 +2194,50 @@ MV CUData::scaleMvByPOCDist(const MV& inMV, int curPOC, int curRefPOC, int colPO
     if (diffPocD == diffPocB)
         return inMV;
     else
-    {
-        int tdb   = x265_clip3(-128, 127, diffPocB);
-        int tdd   = x265_clip3(-128, 127, diffPocD);
-        int x     = (0x4000 + abs(tdd / 2)) / tdd;
-        int scale = x265_clip3(-4096, 4095, (tdb * x + 32) >> 6);
-        return scaleMv(inMV, scale);
-    }
+        return scaleMv(inMV, getPOCScale(diffPocB, diffPocD));
+}
+
+/* Scales the MV of a spatial neighbour to the reference of the PU, with the
+ * scale factors of the CTU cache when there is one */
+MV CUData::scaleSpatialMv(const MV& mv, int picList, int refIdx, int neibList, int neibRefIdx) const
+{
+    int curPOC = m_slice->m_poc;
+    int curRefPOC = m_slice->m_refPOCList[picList][refIdx];
+    int neibRefPOC = m_slice->m_refPOCList[neibList][neibRefIdx];
+
+    if (!m_mvCandCache)
+        return scaleMvByPOCDist(mv, curPOC, curRefPOC, curPOC, neibRefPOC);
+
+    /* a scale factor of 256 leaves the MV unchanged */
+    int16_t& scale = m_mvCandCache->scale[picList][refIdx][neibList][neibRefIdx];
+    if (scale == MVCandCache::SCALE_UNSET)
+        scale = (int16_t)(curRefPOC == neibRefPOC ? 256 : getPOCScale(curPOC - curRefPOC, curPOC - neibRefPOC));
+    return scale == 256 ? mv : scaleMv(mv, scale);
+}
+
+/* Scales the collocated MV of a list, as set by getCollocatedMV(), to the
+ * reference of the PU */
+MV CUData::scaleCollocatedMv(const InterNeighbourMV& collocated, int picList, int refIdx) const
+{
+    int tempRefIdx = collocated.refIdx[picList];
+    int16_t* cached = m_mvCandCache ? &m_mvCandCache->colScale[picList][refIdx][tempRefIdx >> 4][tempRefIdx & 0xf] : NULL;
+    if (cached && *cached != MVCandCache::SCALE_UNSET)
+        return *cached == 256 ? collocated.mv[picList] : scaleMv(collocated.mv[picList], *cached);
+
+    uint32_t cuAddr = collocated.cuAddr[picList];
+    const Frame* colPic = m_slice->m_refFrameList[m_slice->isInterB() && !m_slice->m_colFromL0Flag][m_slice->m_colRefIdx];
+    const CUData* colCU = colPic->m_encData->getPicCTU(cuAddr);
+
+    // Scale the vector
+    int colRefPOC = colCU->m_slice->m_refPOCList[tempRefIdx >> 4][tempRefIdx & 0xf];
+    int colPOC = colCU->m_slice->m_poc;
+
+    int curRefPOC = m_slice->m_refPOCList[picList][refIdx];
+    int curPOC = m_slice->m_poc;
+
+    if (cached)
+        *cached = (int16_t)(colPOC - colRefPOC == curPOC - curRefPOC ? 256 : getPOCScale(curPOC - curRefPOC, colPOC - colRefPOC));
+    return scaleMvByPOCDist(collocated.mv[picList], curPOC, curRefPOC, colPOC, colRefPOC);
 }
 
 uint32_t CUData::deriveCenterIdx(uint32_t puIdx) const
@@ -123,6 +123,46 @@ struct InterNeighbourMV
     union { int16_t refIdx[2]; int32_t unifiedRef; };
 };
 
+/* Motion candidate data of one CTU, derived on first use and then shared by
+ * all the partitions and modes evaluated in it.
+ *
+ * The collocated MVs of a PU are read from the 16x16 unit below-right of it
+ * or from its center, in the collocated CTU or in the one to its right, and do
+ * not depend on the partition. The scale factor of a spatial or temporal AMVP
+ * candidate depends only on the reference of the PU and on the one of the
+ * neighbour, all the CTUs of the collocated picture sharing one slice */
+struct MVCandCache
+{
+    enum { NUM_UNITS = MAX_NUM_PARTITIONS >> 4 };
+    enum { SCALE_UNSET = -0x7f80 };   // 0x80 bytes, outside the range of scale factors
+
+    struct ColUnit
+    {
+        bool             bDerived;
+        bool             bCollocated; // AMVP neighbour is available
+        bool             bMerge[2];   // merge candidate is available, per list
+        MV               mergeMv[2];  // merge candidate for reference index 0, per list
+        InterNeighbourMV collocated;  // AMVP neighbour, as set by getCollocatedMV()
+    };
+
+    uint32_t cuAddr;                  // CTU the units belong to
+    ColUnit  col[2][NUM_UNITS];       // units of the CTU and of the CTU to its right
+
+    /* [list][refIdx] of the PU, [list][refIdx] of the neighbour */
+    int16_t  scale[2][MAX_NUM_REF][2][MAX_NUM_REF];
+    int16_t  colScale[2][MAX_NUM_REF][2][MAX_NUM_REF];
+
+    void reset(uint32_t addr)
+    {
+        cuAddr = addr;
+        for (int c = 0; c < 2; c++)
+            for (int i = 0; i < NUM_UNITS; i++)
+                col[c][i].bDerived = false;
+        memset(scale, 0x80, sizeof(scale));
+        memset(colScale, 0x80, sizeof(colScale));
+    }
+};
+
 struct IBC
 {
     int             m_numBVs;
@@ -134,6 +174,11 @@ struct IBC
 typedef void(*cucopy_t)(uint8_t* dst, uint8_t* src); // dst and src are aligned to MIN(size, 32)
 typedef void(*cubcast_t)(uint8_t* dst, uint8_t val); // dst is aligned to MIN(size, 32)
 
+/* copy or set a run of planes (per-part arrays laid out back to back), the
+ * strides are the distances in bytes between consecutive planes */
+typedef void(*cuplanecopy_t)(uint8_t* dst, intptr_t dstStride, const uint8_t* src, intptr_t srcStride, int planes);
+typedef void(*cuplanebcast_t)(uint8_t* dst, intptr_t stride, const uint8_t* vals, int planes);
+
 // Partition count table, index represents partitioning mode.
 const uint32_t nbPartsTable[8] = { 1, 2, 2, 4, 2, 2, 2, 2 };
 
@@ -186,6 +231,11 @@ public:
     cubcast_t     m_partSet;          // pointer to function that sets m_numPartitions elements
     cucopy_t      m_subPartCopy;      // pointer to function that copies m_numPartitions/4 elements, may be NULL
     cubcast_t     m_subPartSet;       // pointer to function that sets m_numPartitions/4 elements, may be NULL
+    cuplanecopy_t  m_planeCopy;       // copies planes of m_numPartitions bytes
+    cuplanecopy_t  m_subPlaneCopy;    // copies planes of m_numPartitions/4 bytes, may be NULL
+    cuplanebcast_t m_planeSet;        // sets planes of m_numPartitions bytes
+    cuplanecopy_t  m_mvPlaneCopy;     // copies planes of m_numPartitions MVs
+    cuplanecopy_t  m_subMvPlaneCopy;  // copies planes of m_numPartitions/4 MVs, may be NULL
 
     uint32_t      m_cuAddr;           // address of CTU within the picture in raster order
     uint32_t      m_absIdxInCTU;      // address of CU within its CTU in Z scan order
@@ -202,25 +252,29 @@ public:
     uint8_t      m_bLastRowInSlice;
     uint8_t      m_bLastCuInSlice;
 
-    /* Per-part data, stored contiguously */
+    /* Per-part data, stored as planes of m_numPartitions bytes in one cache
+     * line aligned block, in this order. The planes up to m_cuDepth are set
+     * from a value list by initCTU() and initSubCU(), the ones after it are
+     * cleared, and all but the trailing skip flags are copied in bulk */
     int8_t*       m_qp;               // array of QP values
     int8_t*       m_qpAnalysis;       // array of QP values for analysis reuse
     uint8_t*      m_log2CUSize;       // array of cu log2Size TODO: seems redundant to depth
     uint8_t*      m_lumaIntraDir;     // array of intra directions (luma)
+    uint8_t*      m_chromaIntraDir;   // array of intra directions (chroma)
     uint8_t*      m_tqBypass;         // array of CU lossless flags
     int8_t*       m_refIdx[2];        // array of motion reference indices per list
     uint8_t*      m_cuDepth;          // array of depths
     uint8_t*      m_predMode;         // array of prediction modes
     uint8_t*      m_partSize;         // array of partition sizes
     uint8_t*      m_mergeFlag;        // array of merge flags
-    uint8_t*      m_skipFlag[2];
     uint8_t*      m_interDir;         // array of inter directions
     uint8_t*      m_mvpIdx[2];        // array of motion vector predictor candidates or merge candidate indices [0]
     uint8_t*      m_tuDepth;          // array of transform indices
     uint8_t*      m_transformSkip[3]; // array of transform skipping flags per plane
     uint8_t*      m_cbf[3];           // array of coded block flags (CBF) per plane
-    uint8_t*      m_chromaIntraDir;   // array of intra directions (chroma)
+    uint8_t*      m_skipFlag[2];      // analysis reuse skip flags, only set in CTUs
     enum { BytesPerPartition = 24 };  // combined sizeof() of all per-part data
+    uint32_t      m_numPlanes;        // planes in use, 20 without chroma
 
     sse_t*        m_distortion;
     coeff_t*      m_trCoeff[3];       // transformed coefficient buffer per plane
@@ -229,11 +283,13 @@ public:
     MV*           m_mv[2];            // array of motion vectors per list
     MV*           m_mvd[2];           // array of coded motion vector deltas per list
     enum { TMVP_UNIT_MASK = 0xF0 };  // mask for mapping index to into a compressed (reference) MV field
+    enum { NumMvPlanes = 4 };         // m_mv[0], m_mv[1], m_mvd[0] and m_mvd[1], stored back to back
 
     const CUData* m_cuAboveLeft;      // pointer to above-left neighbor CTU
     const CUData* m_cuAboveRight;     // pointer to above-right neighbor CTU
     const CUData* m_cuAbove;          // pointer to above neighbor CTU
     const CUData* m_cuLeft;           // pointer to left neighbor CTU
+    MVCandCache*  m_mvCandCache;      // motion candidate data of the CTU, may be NULL
     double m_meanQP;
     uint64_t      m_fAc_den[3];
     uint64_t      m_fDc_den[3];
@@ -249,6 +305,9 @@ public:
 
     CUData();
 
+    /* bytes of per-part data of one CU instance, each instance starts a cache line */
+    static uint32_t partDataSize(uint32_t numPartitions) { return (numPartitions * BytesPerPartition + 63) & ~63; }
+
     void     initialize(const CUDataMemPool& dataPool, uint32_t depth, const x265_param& param, int instance);
     static void calcCTUGeoms(uint32_t ctuWidth, uint32_t ctuHeight, uint32_t maxCUSize, uint32_t minCUSize, CUGeom cuDataArray[CUGeom::MAX_GEOMS]);
 
@@ -297,6 +356,7 @@ public:
     int      getPMV(InterNeighbourMV* neighbours, uint32_t reference_list, uint32_t refIdx, MV* amvpCand, MV* pmv) const;
 #endif
     void     getNeighbourMV(uint32_t puIdx, uint32_t absPartIdx, InterNeighbourMV* neighbours) const;
+    int      getRefPicMotion(MV* mvc, int picList, int refIdx, uint32_t absPartIdx, uint32_t width, uint32_t height) const;
     void     getIntraTUQtDepthRange(uint32_t tuDepthRange[2], uint32_t absPartIdx) const;
     void     getInterTUQtDepthRange(uint32_t tuDepthRange[2], uint32_t absPartIdx) const;
     uint32_t getBestRefIdx(uint32_t subPartIdx) const { return ((m_interDir[subPartIdx] & 1) << m_refIdx[0][subPartIdx]) | 
@@ -363,6 +423,10 @@ protected:
 
     bool getColMVP(MV& outMV, int& outRefIdx, int picList, int cuAddr, int absPartIdx) const;
     bool getCollocatedMV(int cuAddr, int partUnitIdx, InterNeighbourMV *neighbour) const;
+    const MVCandCache::ColUnit& getColUnit(int cuAddr, int partUnitIdx) const;
+    int  getColRightBottom(uint32_t puIdx, uint32_t& absPartAddr) const;
+    MV   scaleSpatialMv(const MV& mv, int picList, int refIdx, int neibList, int neibRefIdx) const;
+    MV   scaleCollocatedMv(const InterNeighbourMV& collocated, int picList, int refIdx) const;
 
     MV scaleMvByPOCDist(const MV& inMV, int curPOC, int curRefPOC, int colPOC, int colRefPOC) const;
 
@@ -395,23 +459,23 @@ struct CUDataMemPool
     CUDataMemPool() { charMemBlock = NULL; trCoeffMemBlock = NULL; mvMemBlock = NULL; distortionMemBlock = NULL; 
                       dynRefineRdBlock = NULL; dynRefCntBlock = NULL; dynRefVarBlock = NULL;}
 
-    bool create(uint32_t depth, uint32_t csp, uint32_t numInstances, const x265_param& param)
+    bool create(uint32_t depth, uint32_t csp, uint32_t numInstances, const x265_param& param, int numaNode = -1)
     {
         uint32_t numPartition = param.num4x4Partitions >> (depth * 2);
         uint32_t cuSize = param.maxCUSize >> depth;
         uint32_t sizeL = cuSize * cuSize;
         if (csp == X265_CSP_I400)
         {
-            CHECKED_MALLOC(trCoeffMemBlock, coeff_t, (sizeL) * numInstances);
+            CHECKED_MALLOC_NODE(trCoeffMemBlock, coeff_t, (sizeL) * numInstances, numaNode);
         }
         else
         {            
             uint32_t sizeC = sizeL >> (CHROMA_H_SHIFT(csp) + CHROMA_V_SHIFT(csp));
-            CHECKED_MALLOC(trCoeffMemBlock, coeff_t, (sizeL + sizeC * 2) * numInstances);
+            CHECKED_MALLOC_NODE(trCoeffMemBlock, coeff_t, (sizeL + sizeC * 2) * numInstances, numaNode);
         }
-        CHECKED_MALLOC(charMemBlock, uint8_t, numPartition * numInstances * CUData::BytesPerPartition);
-        CHECKED_MALLOC_ZERO(mvMemBlock, MV, numPartition * 4 * numInstances);
-        CHECKED_MALLOC(distortionMemBlock, sse_t, numPartition * numInstances);
+        CHECKED_MALLOC_NODE(charMemBlock, uint8_t, CUData::partDataSize(numPartition) * numInstances, numaNode);
+        CHECKED_MALLOC_ZERO_NODE(mvMemBlock, MV, numPartition * 4 * numInstances, numaNode);
+        CHECKED_MALLOC_NODE(distortionMemBlock, sse_t, numPartition * numInstances, numaNode);
         return true;
     fail:
         return false;
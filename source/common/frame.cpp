@@ -50,6 +50,7 @@ Frame::Frame()
     memset(&m_lowres, 0, sizeof(m_lowres));
     m_rcData = NULL;
     m_encodeStartTime = 0;
+    m_decideDepth = m_decideTrellis = m_decideSlices = 0;
     m_reconfigureRc = false;
     m_ctuInfo = NULL;
     m_prevCtuInfoChange = NULL;
@@ -69,6 +70,7 @@ Frame::Frame()
     // mcstf
     m_isSubSampled = NULL;
     m_mcstf = NULL;
+    m_mvFieldCache = NULL;
     m_refPicCnt[0] = 0;
     m_refPicCnt[1] = 0;
     m_nextMCSTF = NULL;
@@ -87,7 +89,7 @@ Frame::Frame()
     m_targetQp = 0;
 }
 
-bool Frame::create(x265_param *param, float* quantOffsets)
+bool Frame::create(x265_param *param, float* quantOffsets, int numaNode)
 {
     m_fencPic = new PicYuv;
     m_param = param;
@@ -175,12 +177,14 @@ bool Frame::create(x265_param *param, float* quantOffsets)
         m_edgeBitPic = m_edgeBitPlane + lumaMarginY * stride + lumaMarginX;
     }
 
-    if (m_fencPic->create(param, !!m_param->bCopyPicToFrame) && m_lowres.create(param, m_fencPic, param->rc.qgSize))
+    if (m_fencPic->create(param, !!m_param->bCopyPicToFrame, NULL, numaNode) && m_lowres.create(param, m_fencPic, param->rc.qgSize, numaNode))
     {
         X265_CHECK((m_reconColCount == NULL), "m_reconColCount was initialized");
         m_numRows = (m_fencPic->m_picHeight + param->maxCUSize - 1)  / param->maxCUSize;
         m_reconRowFlag = new ThreadSafeInteger[m_numRows];
         m_reconColCount = new ThreadSafeInteger[m_numRows];
+        if (!m_reconRowDeps.init(m_numRows))
+            return false;
 
         if (quantOffsets)
         {
@@ -211,7 +215,7 @@ fail:
     return false;
 }
 
-bool Frame::allocEncodeData(x265_param *param, const SPS& sps)
+bool Frame::allocEncodeData(x265_param *param, const SPS& sps, int numaNode)
 {
     m_encData = new FrameData;
     m_param = param;
@@ -220,7 +224,7 @@ bool Frame::allocEncodeData(x265_param *param, const SPS& sps)
         m_reconPic[i] = new PicYuv;
         m_encData->m_reconPic[i] = m_reconPic[i];
     }
-    bool ok = m_encData->create(*param, sps, m_fencPic->m_picCsp) && m_reconPic[0]->create(param) && (param->bEnableSCC ? (param->bEnableSCC && m_reconPic[1]->create(param)) : 1);
+    bool ok = m_encData->create(*param, sps, m_fencPic->m_picCsp, numaNode) && m_reconPic[0]->create(param, true, NULL, numaNode) && (param->bEnableSCC ? (param->bEnableSCC && m_reconPic[1]->create(param, true, NULL, numaNode)) : 1);
     if (ok)
     {
         /* initialize right border of m_reconPicYuv as SAO may read beyond the
@@ -358,6 +362,8 @@ void Frame::destroy()
         m_reconColCount = NULL;
     }
 
+    m_reconRowDeps.destroy();
+
     if (m_quantOffsets)
     {
         delete[] m_quantOffsets;
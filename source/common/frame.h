@@ -28,6 +28,7 @@
 #include "common.h"
 #include "lowres.h"
 #include "threading.h"
+#include "wavefront.h"
 #include "temporalfilter.h"
 
 namespace X265_NS {
@@ -35,6 +36,7 @@ namespace X265_NS {
 
 class FrameData;
 class PicYuv;
+class MotionFieldCache;
 struct SPS;
 
 #define IS_REFERENCED(frame) (frame->m_lowres.sliceType != X265_TYPE_B)
@@ -109,10 +111,12 @@ public:
     x265_sei               m_userSEI;
     uint32_t               m_picStruct;          // picture structure SEI message
     x265_dolby_vision_rpu  m_rpu;
+    x265_picture           m_inputPic;           // planes of m_fencPic handed out by x265_encoder_get_input_buffer()
 
     /* Frame Parallelism - notification between FrameEncoders of available motion reference rows */
     ThreadSafeInteger*     m_reconRowFlag;       // flag of CTU rows completely reconstructed and extended for motion reference
     ThreadSafeInteger*     m_reconColCount;      // count of CTU cols completely reconstructed and extended for motion reference
+    RowDependencyGraph     m_reconRowDeps;       // wavefront rows of other FrameEncoders waiting on each reconstructed row
     int32_t                m_numRows;
     volatile uint32_t      m_countRefEncoders;   // count of FrameEncoder threads monitoring m_reconRowCount
 
@@ -128,6 +132,9 @@ public:
     Event                  m_copied;
     int*                   m_prevCtuInfoChange;
     int64_t                m_encodeStartTime;
+    int                    m_decideDepth;        // lookahead window, trellis depth and lookahead
+    int                    m_decideTrellis;      // slices this picture was decided with
+    int                    m_decideSlices;
 
     uint8_t**              m_addOnDepth;
     uint8_t**              m_addOnCtuInfo;
@@ -149,6 +156,7 @@ public:
     int*                   m_isSubSampled;
     TemporalFilterRefPicInfo m_mcstfRefList[MAX_MCSTF_TEMPORAL_WINDOW_LENGTH];
     PicYuv*                m_mcstffencPic;
+    MotionFieldCache*      m_mvFieldCache;        // motion fields shared with the lookahead and MCSTF, or NULL
 
     /*Vbv-End-Flag*/
     int vbvEndFlag;
@@ -184,9 +192,9 @@ public:
 
     Frame();
 
-    bool create(x265_param *param, float* quantOffsets);
+    bool create(x265_param *param, float* quantOffsets, int numaNode = -1);
     bool createSubSample();
-    bool allocEncodeData(x265_param *param, const SPS& sps);
+    bool allocEncodeData(x265_param *param, const SPS& sps, int numaNode = -1);
     void reinit(const SPS& sps);
     void destroy();
 };
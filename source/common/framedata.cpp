@@ -31,16 +31,17 @@ FrameData::FrameData()
     memset(this, 0, sizeof(*this));
 }
 
-bool FrameData::create(const x265_param& param, const SPS& sps, int csp)
+bool FrameData::create(const x265_param& param, const SPS& sps, int csp, int numaNode)
 {
     m_param = &param;
+    m_numaNode = numaNode;
     m_slice  = new Slice;
     m_picCTU = new CUData[sps.numCUsInFrame];
     m_picCsp = csp;
     m_spsrpsIdx = -1;
     if (param.rc.bStatWrite)
         m_spsrps = const_cast<RPS*>(sps.spsrps);
-    bool isallocated = m_cuMemPool.create(0, param.internalCsp, sps.numCUsInFrame, param);
+    bool isallocated = m_cuMemPool.create(0, param.internalCsp, sps.numCUsInFrame, param, numaNode);
     if (m_param->bDynamicRefine)
     {
         CHECKED_MALLOC_ZERO(m_cuMemPool.dynRefineRdBlock, uint64_t, MAX_NUM_DYN_REFINE * sps.numCUsInFrame);
@@ -62,7 +63,7 @@ bool FrameData::create(const x265_param& param, const SPS& sps, int csp)
     }
     else
         return false;
-    CHECKED_MALLOC_ZERO(m_cuStat, RCStatCU, sps.numCUsInFrame + 1);
+    CHECKED_MALLOC_ZERO_NODE(m_cuStat, RCStatCU, sps.numCUsInFrame + 1, numaNode);
     CHECKED_MALLOC(m_rowStat, RCStatRow, sps.numCuInHeight);
     reinit(sps);
     
@@ -118,6 +118,7 @@ public:
     PicYuv*        m_reconPic[NUM_RECON_VERSION];
     bool           m_bHasReferences;   /* used during DPB/RPS updates */
     int            m_frameEncoderID;   /* the ID of the FrameEncoder encoding this frame */
+    int            m_numaNode;         /* node the recon planes and CTU data were allocated on, or -1 */
     JobProvider*   m_jobProvider;
 
     CUDataMemPool  m_cuMemPool;
@@ -173,7 +174,7 @@ public:
 
     FrameData();
 
-    bool create(const x265_param& param, const SPS& sps, int csp);
+    bool create(const x265_param& param, const SPS& sps, int csp, int numaNode = -1);
     void reinit(const SPS& sps);
     void destroy();
     inline CUData* getPicCTU(uint32_t ctuAddr) { return &m_picCTU[ctuAddr]; }
@@ -69,7 +69,91 @@ fail:
     return false;
 }
 
-bool Lowres::create(x265_param* param, PicYuv *origPic, uint32_t qgSize)
+LowresTablePool::LowresTablePool()
+{
+    frameBytes = 0;
+    fullFrameBytes = 0;
+    for (int i = 0; i < NUM_SIZES; i++)
+    {
+        m_size[i] = 0;
+        m_free[i] = NULL;
+    }
+    m_bytesAllocated = 0;
+    m_peakBytes = 0;
+    m_totalBytes = 0;
+    m_numFrames = 0;
+}
+
+LowresTablePool::~LowresTablePool()
+{
+    for (int i = 0; i < NUM_SIZES; i++)
+    {
+        while (m_free[i])
+        {
+            FreeTable* next = m_free[i]->next;
+            X265_FREE(m_free[i]);
+            m_free[i] = next;
+        }
+    }
+}
+
+void* LowresTablePool::acquire(size_t size, size_t& ownerBytes)
+{
+    ScopedLock s(m_lock);
+
+    if (!ownerBytes)
+        m_numFrames++;
+    ownerBytes += size;
+    m_totalBytes += size;
+
+    for (int i = 0; i < NUM_SIZES; i++)
+    {
+        if (m_size[i] == size && m_free[i])
+        {
+            FreeTable* table = m_free[i];
+            m_free[i] = table->next;
+            return table;
+        }
+    }
+
+    void* table = X265_MALLOC(uint8_t, size);
+    if (!table)
+    {
+        x265_log(NULL, X265_LOG_ERROR, "unable to allocate %u byte lowres table\n", (uint32_t)size);
+        return NULL;
+    }
+    m_bytesAllocated += size;
+    m_peakBytes = X265_MAX(m_peakBytes, m_bytesAllocated);
+    return table;
+}
+
+void LowresTablePool::release(void* table, size_t size)
+{
+    ScopedLock s(m_lock);
+
+    for (int i = 0; i < NUM_SIZES; i++)
+    {
+        if (!m_size[i])
+            m_size[i] = size;
+        if (m_size[i] == size)
+        {
+            FreeTable* entry = (FreeTable*)table;
+            entry->next = m_free[i];
+            m_free[i] = entry;
+            return;
+        }
+    }
+
+    X265_FREE(table);
+    m_bytesAllocated -= size;
+}
+
+size_t LowresTablePool::avgFrameBytes() const
+{
+    return m_numFrames ? (size_t)(m_totalBytes / m_numFrames) : 0;
+}
+
+bool Lowres::create(x265_param* param, PicYuv *origPic, uint32_t qgSize, int numaNode)
 {
     isLowres = true;
     bframes = param->bframes;
@@ -89,6 +173,15 @@ bool Lowres::create(x265_param* param, PicYuv *origPic, uint32_t qgSize)
     int cuCountFullRes = (qgSize > 8) ? cuCount : cuCount << 2;
     isHMELowres = param->bEnableHME ? 1 : 0;
 
+    memset(rowSatds, 0, sizeof(rowSatds));
+    memset(lowresCosts, 0, sizeof(lowresCosts));
+    memset(lowresMvs, 0, sizeof(lowresMvs));
+    memset(lowresMvCosts, 0, sizeof(lowresMvCosts));
+    memset(lowerResMvs, 0, sizeof(lowerResMvs));
+    memset(lowerResMvCosts, 0, sizeof(lowerResMvCosts));
+    tablePool = NULL;
+    tableBytes = 0;
+
     /* rounding the width to multiple of lowres CU size */
     width = maxBlocksInRow * X265_LOWRES_CU_SIZE;
     lines = maxBlocksInCol * X265_LOWRES_CU_SIZE;
@@ -102,12 +195,10 @@ bool Lowres::create(x265_param* param, PicYuv *origPic, uint32_t qgSize)
         CHECKED_MALLOC_ZERO(qpCuTreeOffset, double, cuCountFullRes);
         if (qgSize == 8)
             CHECKED_MALLOC_ZERO(invQscaleFactor8x8, int, cuCount);
-        CHECKED_MALLOC_ZERO(edgeInclined, int, cuCountFullRes);
+        CHECKED_MALLOC_ZERO(edgeInclined, uint8_t, cuCountFullRes);
     }
 
-    if (origPic->m_param->bAQMotion)
-        CHECKED_MALLOC_ZERO(qpAqMotionOffset, double, cuCountFullRes);
-    if (origPic->m_param->bDynamicRefine || origPic->m_param->bEnableFades)
+    if (origPic->m_param->bDynamicRefine || origPic->m_param->bEnableFades || origPic->m_param->bSplitPredict)
         CHECKED_MALLOC_ZERO(blockVariance, uint32_t, cuCountFullRes);
 
     if (!!param->rc.hevcAq)
@@ -150,8 +241,9 @@ bool Lowres::create(x265_param* param, PicYuv *origPic, uint32_t qgSize)
     }
     CHECKED_MALLOC(propagateCost, uint16_t, cuCount);
 
-    /* allocate lowres buffers */
-    CHECKED_MALLOC_ZERO(buffer[0], pixel, 4 * planesize);
+    /* allocate lowres buffers, the per-block cost arrays are too small to be
+     * worth binding to the node */
+    CHECKED_MALLOC_ZERO_NODE(buffer[0], pixel, 4 * planesize, numaNode);
 
     buffer[1] = buffer[0] + planesize;
     buffer[2] = buffer[1] + planesize;
@@ -170,7 +262,7 @@ bool Lowres::create(x265_param* param, PicYuv *origPic, uint32_t qgSize)
         size_t planesizeHalf = planesize / 2;
         size_t padoffsetHalf = padoffset / 2;
         /* allocate lower-res buffers */
-        CHECKED_MALLOC_ZERO(lowerResBuffer[0], pixel, 4 * planesizeHalf);
+        CHECKED_MALLOC_ZERO_NODE(lowerResBuffer[0], pixel, 4 * planesizeHalf, numaNode);
 
         lowerResBuffer[1] = lowerResBuffer[0] + planesizeHalf;
         lowerResBuffer[2] = lowerResBuffer[1] + planesizeHalf;
@@ -185,38 +277,26 @@ bool Lowres::create(x265_param* param, PicYuv *origPic, uint32_t qgSize)
     CHECKED_MALLOC(intraCost, int32_t, cuCount);
     CHECKED_MALLOC(intraMode, uint8_t, cuCount);
 
-    for (int i = 0; i < bframes + 2; i++)
+    /* the tables of the inter pairs and of the motion searches are taken from
+     * the lookahead's table pool on demand, only the intra pair is kept */
+    costTableSize = maxBlocksInCol * sizeof(int32_t) + cuCount * sizeof(uint16_t);
+    mvTableSize = cuCount * (sizeof(MV) + sizeof(int32_t));
+    if (bEnableHME)
     {
-        for (int j = 0; j < bframes + 2; j++)
-        {
-            CHECKED_MALLOC(rowSatds[i][j], int32_t, maxBlocksInCol);
-            CHECKED_MALLOC(lowresCosts[i][j], uint16_t, cuCount);
-        }
+        int maxBlocksInRowLowerRes = ((width/2) + X265_LOWRES_CU_SIZE - 1) >> X265_LOWRES_CU_BITS;
+        int maxBlocksInColLowerRes = ((lines/2) + X265_LOWRES_CU_SIZE - 1) >> X265_LOWRES_CU_BITS;
+        mvTableSize += maxBlocksInRowLowerRes * maxBlocksInColLowerRes * (sizeof(MV) + sizeof(int32_t));
     }
+    rowSatds[0][0] = (int32_t*)X265_MALLOC(uint8_t, costTableSize);
+    if (!rowSatds[0][0])
+        goto fail;
+    lowresCosts[0][0] = (uint16_t*)(rowSatds[0][0] + maxBlocksInCol);
 
     for (int i = 0; i < 4; i++)
     {
         CHECKED_MALLOC(lowresMcstfMvs[0][i], MV, cuCount);
     }
 
-    for (int i = 0; i < bframes + 2; i++)
-    {
-        CHECKED_MALLOC(lowresMvs[0][i], MV, cuCount);
-        CHECKED_MALLOC(lowresMvs[1][i], MV, cuCount);
-        CHECKED_MALLOC(lowresMvCosts[0][i], int32_t, cuCount);
-        CHECKED_MALLOC(lowresMvCosts[1][i], int32_t, cuCount);
-        if (bEnableHME)
-        {
-            int maxBlocksInRowLowerRes = ((width/2) + X265_LOWRES_CU_SIZE - 1) >> X265_LOWRES_CU_BITS;
-            int maxBlocksInColLowerRes = ((lines/2) + X265_LOWRES_CU_SIZE - 1) >> X265_LOWRES_CU_BITS;
-            int cuCountLowerRes = maxBlocksInRowLowerRes * maxBlocksInColLowerRes;
-            CHECKED_MALLOC(lowerResMvs[0][i], MV, cuCountLowerRes);
-            CHECKED_MALLOC(lowerResMvs[1][i], MV, cuCountLowerRes);
-            CHECKED_MALLOC(lowerResMvCosts[0][i], int32_t, cuCountLowerRes);
-            CHECKED_MALLOC(lowerResMvCosts[1][i], int32_t, cuCountLowerRes);
-        }
-    }
-
     if (param->bHistBasedSceneCut)
     {
         quarterSampleLowResWidth = widthFullRes / 4;
@@ -227,7 +307,7 @@ bool Lowres::create(x265_param* param, PicYuv *origPic, uint32_t qgSize)
 
         size_t quarterSampleLowResPlanesize = quarterSampleLowResStrideY * (quarterSampleLowResHeight + 2 * quarterSampleLowResOriginX);
         /* allocate quarter sampled lowres buffers */
-        CHECKED_MALLOC_ZERO(quarterSampleLowResBuffer, pixel, quarterSampleLowResPlanesize);
+        CHECKED_MALLOC_ZERO_NODE(quarterSampleLowResBuffer, pixel, quarterSampleLowResPlanesize, numaNode);
 
         // Allocate memory for Histograms
         picHistogram = X265_MALLOC(uint32_t***, NUMBER_OF_SEGMENTS_IN_WIDTH * sizeof(uint32_t***));
@@ -249,6 +329,14 @@ bool Lowres::create(x265_param* param, PicYuv *origPic, uint32_t qgSize)
         }
     }
 
+    /* the planes and per-block arrays, for the memory report */
+    fixedBytes = 4 * planesize * sizeof(pixel) + costTableSize +
+                 cuCount * (sizeof(int32_t) + sizeof(uint8_t) + sizeof(uint16_t) + 4 * sizeof(MV));
+    if (bEnableHME || param->bEnableTemporalFilter)
+        fixedBytes += 2 * planesize * sizeof(pixel);
+    if (qpAqOffset)
+        fixedBytes += cuCountFullRes * (2 * sizeof(double) + sizeof(int) + sizeof(uint8_t));
+
     return true;
 
 fail:
@@ -263,28 +351,15 @@ void Lowres::destroy(x265_param* param)
     X265_FREE(intraCost);
     X265_FREE(intraMode);
 
+    /* tables still held go straight back to the allocator, the table pool
+     * of the lookahead may already be gone */
     for (int i = 0; i < bframes + 2; i++)
     {
         for (int j = 0; j < bframes + 2; j++)
-        {
             X265_FREE(rowSatds[i][j]);
-            X265_FREE(lowresCosts[i][j]);
-        }
-    }
 
-    for (int i = 0; i < bframes + 2; i++)
-    {
         X265_FREE(lowresMvs[0][i]);
         X265_FREE(lowresMvs[1][i]);
-        X265_FREE(lowresMvCosts[0][i]);
-        X265_FREE(lowresMvCosts[1][i]);
-        if (bEnableHME)
-        {
-            X265_FREE(lowerResMvs[0][i]);
-            X265_FREE(lowerResMvs[1][i]);
-            X265_FREE(lowerResMvCosts[0][i]);
-            X265_FREE(lowerResMvCosts[1][i]);
-        }
     }
 
     for (int i = 0; i < 4; i++)
@@ -297,8 +372,7 @@ void Lowres::destroy(x265_param* param)
     X265_FREE(propagateCost);
     X265_FREE(invQscaleFactor8x8);
     X265_FREE(edgeInclined);
-    X265_FREE(qpAqMotionOffset);
-    if (param->bDynamicRefine || param->bEnableFades)
+    if (param->bDynamicRefine || param->bEnableFades || param->bSplitPredict)
         X265_FREE(blockVariance);
     if (maxAQDepth > 0)
     {
@@ -343,6 +417,112 @@ void Lowres::destroy(x265_param* param)
 
     }
 }
+
+/* the cost table of a pair holds rowSatds followed by lowresCosts */
+bool Lowres::allocCostTable(int i, int j)
+{
+    X265_CHECK(tablePool && !rowSatds[i][j] && (i | j), "unexpected lowres cost table allocation\n");
+
+    rowSatds[i][j] = (int32_t*)tablePool->acquire(costTableSize, tableBytes);
+    if (!rowSatds[i][j])
+        return false;
+    lowresCosts[i][j] = (uint16_t*)(rowSatds[i][j] + maxBlocksInCol);
+    return true;
+}
+
+/* the vector table of a distance holds lowresMvs and lowerResMvs followed by
+ * lowresMvCosts and lowerResMvCosts */
+bool Lowres::allocMvTable(int list, int dist)
+{
+    X265_CHECK(tablePool && !lowresMvs[list][dist], "unexpected lowres vector table allocation\n");
+
+    MV* mvs = (MV*)tablePool->acquire(mvTableSize, tableBytes);
+    if (!mvs)
+        return false;
+
+    int cuCount = maxBlocksInRow * maxBlocksInCol;
+    int cuCountLowerRes = (int)(mvTableSize / (sizeof(MV) + sizeof(int32_t))) - cuCount;
+    int32_t* costs = (int32_t*)(mvs + cuCount + cuCountLowerRes);
+    lowresMvCosts[list][dist] = costs;
+    if (bEnableHME)
+    {
+        /* lowres searches of cooperative slices may look at HME vectors of
+         * rows another slice has not searched yet; a zero cost skips them */
+        lowerResMvs[list][dist] = mvs + cuCount;
+        lowerResMvCosts[list][dist] = costs + cuCount;
+        memset(lowerResMvCosts[list][dist], 0, cuCountLowerRes * sizeof(int32_t));
+    }
+    lowresMvs[list][dist] = mvs;
+    return true;
+}
+
+void Lowres::releaseTables()
+{
+    if (!tableBytes)
+        return;
+
+    for (int i = 0; i < bframes + 2; i++)
+    {
+        for (int j = 0; j < bframes + 2; j++)
+        {
+            if ((i | j) && rowSatds[i][j])
+            {
+                tablePool->release(rowSatds[i][j], costTableSize);
+                rowSatds[i][j] = NULL;
+                lowresCosts[i][j] = NULL;
+            }
+        }
+
+        for (int list = 0; list < 2; list++)
+        {
+            if (lowresMvs[list][i])
+            {
+                tablePool->release(lowresMvs[list][i], mvTableSize);
+                lowresMvs[list][i] = NULL;
+                lowresMvCosts[list][i] = NULL;
+                lowerResMvs[list][i] = NULL;
+                lowerResMvCosts[list][i] = NULL;
+            }
+        }
+    }
+    tableBytes = 0;
+}
+
+/* component wise median of the vectors of a distance, the motion of the
+ * whole picture. Components beyond 256 lowres pixels are clipped, they are
+ * outliers unless the picture itself moves that far */
+MV Lowres::medianMV(int list, int dist) const
+{
+    const int MEDIAN_RANGE = 1024;
+
+    const MV* mvs = lowresMvs[list][dist];
+    if (!mvs)
+        return MV(0, 0);
+
+    uint32_t histX[2 * MEDIAN_RANGE + 1], histY[2 * MEDIAN_RANGE + 1];
+    memset(histX, 0, sizeof(histX));
+    memset(histY, 0, sizeof(histY));
+    uint32_t count = maxBlocksInRow * maxBlocksInCol;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        histX[x265_clip3(-MEDIAN_RANGE, MEDIAN_RANGE, mvs[i].x) + MEDIAN_RANGE]++;
+        histY[x265_clip3(-MEDIAN_RANGE, MEDIAN_RANGE, mvs[i].y) + MEDIAN_RANGE]++;
+    }
+
+    int32_t median[2];
+    const uint32_t* hist[2] = { histX, histY };
+    for (int c = 0; c < 2; c++)
+    {
+        uint32_t sum = 0;
+        int i = 0;
+        while ((sum += hist[c][i]) <= count / 2)
+            i++;
+        median[c] = i - MEDIAN_RANGE;
+    }
+
+    return MV(median[0], median[1]);
+}
+
 // (re) initialize lowres state
 void Lowres::init(PicYuv *origPic, int poc)
 {
@@ -354,19 +534,16 @@ void Lowres::init(PicYuv *origPic, int poc)
     indB = 0;
     memset(costEst, -1, sizeof(costEst));
     memset(weightedCostDelta, 0, sizeof(weightedCostDelta));
+    cuTreeStep = 0;
+    cuTreeFinishDist = -1;
+    bCuTreeTracked = false;
+    cuTreeSerial = 0;
 
     if (qpAqOffset && invQscaleFactor)
         memset(costEstAq, -1, sizeof(costEstAq));
 
-    for (int y = 0; y < bframes + 2; y++)
-        for (int x = 0; x < bframes + 2; x++)
-            rowSatds[y][x][0] = -1;
-
-    for (int i = 0; i < bframes + 2; i++)
-    {
-        lowresMvs[0][i][0].x = 0x7FFF;
-        lowresMvs[1][i][0].x = 0x7FFF;
-    }
+    releaseTables();
+    rowSatds[0][0][0] = -1;
 
     for (int i = 0; i < 4; i++)
     {
@@ -28,6 +28,7 @@
 #include "common.h"
 #include "picyuv.h"
 #include "mv.h"
+#include "threading.h"
 
 namespace X265_NS {
 // private namespace
@@ -159,6 +160,45 @@ struct PicQPAdaptationLayer
     void  destroy();
 };
 
+/* Recycles the per (p0,p1) cost tables and per distance motion vector tables
+ * of lowres pictures. A picture takes a table the first time its lookahead
+ * evaluates that pair or searches that distance and hands it back when it is
+ * re-initialized or leaves the DPB, so only the pairs the slicetype decision
+ * actually visits occupy memory. Tables of the cost and vector sizes are kept
+ * on free lists, any other size goes straight to the allocator */
+class LowresTablePool
+{
+public:
+
+    LowresTablePool();
+    ~LowresTablePool();
+
+    /* ownerBytes counts the bytes held by the picture taking the table */
+    void*  acquire(size_t size, size_t& ownerBytes);
+    void   release(void* table, size_t size);
+
+    size_t peakBytes() const    { return m_peakBytes; }
+    size_t avgFrameBytes() const;
+
+    /* for the memory report of the lookahead */
+    size_t frameBytes;          // fixed lowres storage of one picture
+    size_t fullFrameBytes;      // tables of one picture if every pair were evaluated
+
+protected:
+
+    struct FreeTable { FreeTable* next; };
+
+    enum { NUM_SIZES = 2 };
+
+    Lock       m_lock;
+    size_t     m_size[NUM_SIZES];
+    FreeTable* m_free[NUM_SIZES];
+    size_t     m_bytesAllocated; // tables held by pictures or on the free lists
+    size_t     m_peakBytes;
+    uint64_t   m_totalBytes;     // bytes acquired, summed over every frame
+    uint64_t   m_numFrames;      // pictures which acquired at least one table
+};
+
 /* lowres buffers, sizes and strides */
 struct Lowres : public ReferencePlanes
 {
@@ -188,9 +228,20 @@ struct Lowres : public ReferencePlanes
     uint8_t*  intraMode;
     int64_t   satdCost;
     uint16_t* lowresCostForRc;
+
+    /* rowSatds and lowresCosts of a pair share one table, lowresMvs and
+     * lowresMvCosts (and the HME vectors) of a distance share another. Both
+     * are NULL until allocCostTable() or allocMvTable() takes one from
+     * tablePool; a NULL vector table means the search was not yet made. The
+     * intra pair [0][0] is allocated once with the picture */
     uint16_t* lowresCosts[X265_BFRAME_MAX + 2][X265_BFRAME_MAX + 2];
     int32_t*  lowresMvCosts[2][X265_BFRAME_MAX + 2];
     MV*       lowresMvs[2][X265_BFRAME_MAX + 2];
+    LowresTablePool* tablePool;
+    size_t    costTableSize;
+    size_t    mvTableSize;
+    size_t    tableBytes;      // bytes of tables taken from tablePool
+    size_t    fixedBytes;      // everything else allocated by create()
     MV*       lowresMcstfMvs[2][4];
     uint32_t  maxBlocksInRow;
     uint32_t  maxBlocksInCol;
@@ -211,14 +262,13 @@ struct Lowres : public ReferencePlanes
     /* rate control / adaptive quant data */
     double*   qpAqOffset;      // AQ QP offset values for each 16x16 CU
     double*   qpCuTreeOffset;  // cuTree QP offset values for each 16x16 CU
-    double*   qpAqMotionOffset;
     int*      invQscaleFactor;    // qScale values for qp Aq Offsets
     int*      invQscaleFactor8x8; // temporary buffer for qg-size 8
     uint32_t* blockVariance;
     uint64_t  wp_ssd[3];       // This is different than SSDY, this is sum(pixel^2) - sum(pixel)^2 for entire frame
     uint64_t  wp_sum[3];
     double    frameVariance;
-    int*      edgeInclined;
+    uint8_t*  edgeInclined;
 
 
     /* cutree intermediate data */
@@ -231,6 +281,17 @@ struct Lowres : public ReferencePlanes
 
     uint16_t* propagateCost;
     double    weightedCostDelta[X265_BFRAME_MAX + 2];
+
+    /* incremental cuTree: the propagation step last applied from this frame
+     * (cuTreeStep 0: none, 1: unreferenced, 2: referenced) and whether
+     * propagateCost still holds the sum of the steps applied to it */
+    Lowres*   cuTreeRefs[2];
+    int       cuTreeRefNum[2];
+    int       cuTreeStep;
+    int       cuTreeFinishDist;
+    bool      bCuTreeTracked;
+    uint32_t  cuTreeSerial;
+    int       cuTreeIndex;
     ReferencePlanes weightedRef[X265_BFRAME_MAX + 2];
 
     /* For hist-based scenecut */
@@ -250,9 +311,14 @@ struct Lowres : public ReferencePlanes
     uint64_t     averageIntensityPerSegment[NUMBER_OF_SEGMENTS_IN_WIDTH][NUMBER_OF_SEGMENTS_IN_HEIGHT][3];
     uint8_t      averageIntensity[3];
 
-    bool create(x265_param* param, PicYuv *origPic, uint32_t qgSize);
+    bool create(x265_param* param, PicYuv *origPic, uint32_t qgSize, int numaNode = -1);
     void destroy(x265_param* param);
     void init(PicYuv *origPic, int poc);
+
+    bool allocCostTable(int i, int j);
+    bool allocMvTable(int list, int dist);
+    void releaseTables();
+    MV   medianMV(int list, int dist) const;
 };
 }
 
@@ -204,6 +204,7 @@ void x265_param_default(x265_param* param)
     param->bHistBasedSceneCut = 0;
     param->lookaheadSlices = 8;
     param->lookaheadThreads = 0;
+    param->poolMode = X265_POOL_BITMAP;
     param->scenecutBias = 5.0;
     param->radl = 0;
     param->chunkStart = 0;
@@ -245,6 +246,8 @@ void x265_param_default(x265_param* param)
     param->bEnableEarlySkip = 1;
     param->recursionSkipMode = 1;
     param->edgeVarThreshold = 0.05f;
+    param->bSplitPredict = 0;
+    param->splitPredictThreshold = 0.9;
     param->bEnableAMP = 0;
     param->bEnableRectInter = 0;
     param->rdLevel = 3;
@@ -316,6 +319,14 @@ void x265_param_default(x265_param* param)
     param->rc.aqBiasStrength = 1.0;
     param->rc.qpAdaptationRange = 1.0;
     param->rc.cuTree = 1;
+    param->bIncrementalCuTree = 0;
+    param->bAdaptiveLookahead = 0;
+    param->lookaheadTargetFps = 0;
+    param->lookaheadMinDepth = 0;
+    param->lookaheadSave[0] = 0;
+    param->lookaheadLoad[0] = 0;
+    param->bLookaheadOnly = 0;
+    param->lookaheadBatch = 0;
     param->rc.rfConstantMax = 0;
     param->rc.rfConstantMin = 0;
     param->rc.bStatRead = 0;
@@ -421,6 +432,7 @@ void x265_param_default(x265_param* param)
 
     /* MCSTF */
     param->bEnableTemporalFilter = 0;
+    param->bShareMotionFields = 0;
     param->temporalFilterStrength = 0.95;
     param->searchRangeForLayer0 = 3;
     param->searchRangeForLayer1 = 3;
@@ -1306,6 +1318,8 @@ int x265_param_parse(x265_param* p, const char* name, const char* value)
     OPT("temporal-mvp") p->bEnableTemporalMvp = atobool(value);
     OPT("early-skip") p->bEnableEarlySkip = atobool(value);
     OPT("rskip") p->recursionSkipMode = atoi(value);
+    OPT("split-predict") p->bSplitPredict = atobool(value);
+    OPT("split-predict-threshold") p->splitPredictThreshold = atof(value);
     OPT("rdpenalty") p->rdPenalty = atoi(value);
     OPT("tskip") p->bEnableTransformSkip = atobool(value);
     OPT("no-tskip-fast") p->bEnableTSkipFast = atobool(value);
@@ -1480,6 +1494,14 @@ int x265_param_parse(x265_param* p, const char* name, const char* value)
     OPT("input-csp") p->internalCsp = parseName(value, x265_source_csp_names, bError);
     OPT("me")        p->searchMethod = parseName(value, x265_motion_est_names, bError);
     OPT("cutree")    p->rc.cuTree = atobool(value);
+    OPT("cutree-incremental") p->bIncrementalCuTree = atobool(value);
+    OPT("adaptive-lookahead") p->bAdaptiveLookahead = atobool(value);
+    OPT("lookahead-target-fps") p->lookaheadTargetFps = atof(value);
+    OPT("lookahead-min") p->lookaheadMinDepth = atoi(value);
+    OPT("lookahead-save") snprintf(p->lookaheadSave, X265_MAX_STRING_SIZE, "%s", value);
+    OPT("lookahead-load") snprintf(p->lookaheadLoad, X265_MAX_STRING_SIZE, "%s", value);
+    OPT("lookahead-only") p->bLookaheadOnly = atobool(value);
+    OPT("lookahead-batch") p->lookaheadBatch = atoi(value);
     OPT("slow-firstpass") p->rc.bEnableSlowFirstPass = atobool(value);
     OPT("strict-cbr")
     {
@@ -1565,6 +1587,7 @@ int x265_param_parse(x265_param* p, const char* name, const char* value)
     OPT("stats") snprintf(p->rc.statFileName, X265_MAX_STRING_SIZE, "%s", value);
     OPT("scaling-list") snprintf(p->scalingLists, X265_MAX_STRING_SIZE, "%s", value);
     OPT2("pools", "numa-pools") snprintf(p->numaPools, X265_MAX_STRING_SIZE, "%s", value);
+    OPT("pool-mode") p->poolMode = parseName(value, x265_pool_mode_names, bError);
     OPT("lambda-file") snprintf(p->rc.lambdaFileName, X265_MAX_STRING_SIZE, "%s", value);
     OPT("analysis-reuse-file") snprintf(p->analysisReuseFileName, X265_MAX_STRING_SIZE, "%s", value);
     OPT("qg-size") p->rc.qgSize = atoi(value);
@@ -1766,6 +1789,7 @@ int x265_param_parse(x265_param* p, const char* name, const char* value)
         OPT("film-grain") p->filmGrain = (char* )value;
         OPT("aom-film-grain") p->aomFilmGrain = (char*)value;
         OPT("mcstf") p->bEnableTemporalFilter = atobool(value);
+        OPT("share-motion-fields") p->bShareMotionFields = atobool(value);
         OPT("sbrc") p->bEnableSBRC = atobool(value);
 #if ENABLE_ALPHA
         OPT("alpha")
@@ -1969,8 +1993,8 @@ int x265_check_params(x265_param* param)
           "Frame rate numerator and denominator must be specified");
     CHECK(param->interlaceMode < 0 || param->interlaceMode > 2,
           "Interlace mode must be 0 (progressive) 1 (top-field first) or 2 (bottom field first)");
-    CHECK(param->searchMethod < 0 || param->searchMethod > X265_FULL_SEARCH,
-          "Search method is not supported value (0:DIA 1:HEX 2:UMH 3:HM 4:SEA 5:FULL)");
+    CHECK(param->searchMethod < 0 || param->searchMethod > X265_EPZS_SEARCH,
+          "Search method is not supported value (0:DIA 1:HEX 2:UMH 3:HM 4:SEA 5:FULL 6:EPZS)");
     CHECK(param->searchRange < 0,
           "Search Range must be more than 0");
     CHECK(param->searchRange >= 32768,
@@ -2034,6 +2058,8 @@ int x265_check_params(x265_param* param)
         CHECK(param->edgeVarThreshold < 0.0f || param->edgeVarThreshold > 1.0f,
               "Minimum edge density percentage for a CU should be an integer between 0 to 100");
     }
+    CHECK(param->splitPredictThreshold < 0.5 || param->splitPredictThreshold > 1.0,
+          "Split predict threshold must be between 0.5 and 1.0");
     CHECK(param->bframes && (param->bEnableTemporalFilter ? (param->bframes > param->lookaheadDepth) : (param->bframes >= param->lookaheadDepth)) && !param->rc.bStatRead,
           "Lookahead depth must be greater than the max consecutive bframe count");
     CHECK(param->bframes < 0,
@@ -2044,6 +2070,14 @@ int x265_check_params(x265_param* param)
           "Lookahead depth must be less than 256");
     CHECK(param->lookaheadSlices > 16 || param->lookaheadSlices < 0,
           "Lookahead slices must between 0 and 16");
+    CHECK(param->lookaheadTargetFps < 0,
+          "Lookahead target fps must not be negative");
+    CHECK(param->lookaheadMinDepth < 0 || param->lookaheadMinDepth > X265_LOOKAHEAD_MAX,
+          "Lookahead minimum depth must be between 0 and 250");
+    CHECK(param->bLookaheadOnly && strlen(param->lookaheadLoad),
+          "lookahead-only cannot be combined with lookahead-load");
+    CHECK(param->lookaheadBatch < 0 || param->lookaheadBatch > 8,
+          "Lookahead batch grain must be between 0 and 8");
     CHECK(param->rc.aqMode < X265_AQ_NONE || (X265_AQ_EDGE_BIASED < param->rc.aqMode && param->rc.aqMode != X265_AQ_VARIANCE_BIASED && param->rc.aqMode != X265_AQ_VARIANCE_AUTO_MIN && param->rc.aqMode != X265_AQ_VARIANCE_AUTO_MIN_BIASED),
           "Aq-Mode is out of range");
     CHECK(param->rc.aqStrength < 0 || param->rc.aqStrength > 3,
@@ -2057,6 +2091,8 @@ int x265_check_params(x265_param* param)
     CHECK(param->psyRd < 0 || 5.0 < param->psyRd, "Psy-rd strength must be between 0 and 5.0");
     CHECK(param->psyRdoq < 0 || 50.0 < param->psyRdoq, "Psy-rdoq strength must be between 0 and 50.0");
     CHECK(param->bEnableWavefront < 0, "WaveFrontSynchro cannot be negative");
+    CHECK(param->poolMode < X265_POOL_BITMAP || param->poolMode > X265_POOL_STEAL,
+          "Invalid pool-mode, must be bitmap or steal");
     CHECK((param->vui.aspectRatioIdc < 0
            || param->vui.aspectRatioIdc > 16)
           && param->vui.aspectRatioIdc != X265_EXTENDED_SAR,
@@ -2421,6 +2457,8 @@ void x265_print_params(x265_param* param)
     TOOLVAL(param->recursionSkipMode, "rskip mode=%d");
     if (param->recursionSkipMode == EDGE_BASED_RSKIP)
         TOOLVAL(param->edgeVarThreshold, "rskip-edge-threshold=%.2f");
+    if (param->bSplitPredict)
+        TOOLVAL(param->splitPredictThreshold, "split-predict=%.2f");
     TOOLOPT(param->bEnableSplitRdSkip, "splitrd-skip");
     TOOLVAL(param->noiseReductionIntra, "nr-intra=%d");
     TOOLVAL(param->noiseReductionInter, "nr-inter=%d");
@@ -2595,7 +2633,20 @@ char *x265_param2string(x265_param* p, int padx, int pady)
     BOOL(p->recursionSkipMode, "rskip");
     if (p->recursionSkipMode == EDGE_BASED_RSKIP)
         s += snprintf(s, bufSize - (s - buf), " rskip-edge-threshold=%f", p->edgeVarThreshold);
+    BOOL(p->bSplitPredict, "split-predict");
+    if (p->bSplitPredict)
+        s += snprintf(s, bufSize - (s - buf), " split-predict-threshold=%.2f", p->splitPredictThreshold);
     BOOL(p->rc.cuTree, "cutree");
+    BOOL(p->bIncrementalCuTree, "cutree-incremental");
+    BOOL(p->bAdaptiveLookahead, "adaptive-lookahead");
+    if (p->bAdaptiveLookahead)
+        s += snprintf(s, bufSize - (s - buf), " lookahead-target-fps=%.3f lookahead-min=%d", p->lookaheadTargetFps, p->lookaheadMinDepth);
+    if (strlen(p->lookaheadSave))
+        s += snprintf(s, bufSize - (s - buf), " lookahead-save");
+    if (strlen(p->lookaheadLoad))
+        s += snprintf(s, bufSize - (s - buf), " lookahead-load");
+    BOOL(p->bLookaheadOnly, "lookahead-only");
+    s += snprintf(s, bufSize - (s - buf), " lookahead-batch=%d", p->lookaheadBatch);
     BOOL(p->bEnableRectInter, "rect");
     BOOL(p->bEnableAMP, "amp");
     s += snprintf(s, bufSize - (s - buf), " scenecut=%d", p->scenecutThreshold);
@@ -2615,6 +2666,7 @@ char *x265_param2string(x265_param* p, int padx, int pady)
     s += snprintf(s, bufSize - (s - buf), " frame-threads=%d", p->frameNumThreads);
     if (strlen(p->numaPools))
         s += snprintf(s, bufSize - (s - buf), " numa-pools=%s", p->numaPools);
+    s += snprintf(s, bufSize - (s - buf), " pool-mode=%s", x265_pool_mode_names[p->poolMode]);
     s += snprintf(s, bufSize - (s - buf), " nr-intra=%d", p->noiseReductionIntra);
     s += snprintf(s, bufSize - (s - buf), " nr-inter=%d", p->noiseReductionInter);
     BOOL(p->bEnableConstrainedIntra, "constrained-intra");
@@ -2769,6 +2821,7 @@ char *x265_param2string(x265_param* p, int padx, int pady)
     if (p->aomFilmGrain)
         s += snprintf(s, bufSize - (s - buf), " aom-film-grain=%s", p->aomFilmGrain);
     BOOL(p->bEnableTemporalFilter, "mcstf");
+    BOOL(p->bShareMotionFields, "share-motion-fields");
 #if ENABLE_ALPHA
     BOOL(p->bEnableAlpha, "alpha");
 #endif
@@ -3051,6 +3104,7 @@ void x265_copy_params(x265_param* dst, x265_param* src)
     dst->lookaheadDepth = src->lookaheadDepth;
     dst->lookaheadSlices = src->lookaheadSlices;
     dst->lookaheadThreads = src->lookaheadThreads;
+    dst->poolMode = src->poolMode;
     dst->scenecutThreshold = src->scenecutThreshold;
     dst->bHistBasedSceneCut = src->bHistBasedSceneCut;
     dst->bIntraRefresh = src->bIntraRefresh;
@@ -3101,6 +3155,8 @@ void x265_copy_params(x265_param* dst, x265_param* src)
     dst->bEnableEarlySkip = src->bEnableEarlySkip;
     dst->recursionSkipMode = src->recursionSkipMode;
     dst->edgeVarThreshold = src->edgeVarThreshold;
+    dst->bSplitPredict = src->bSplitPredict;
+    dst->splitPredictThreshold = src->splitPredictThreshold;
     dst->bEnableFastIntra = src->bEnableFastIntra;
     dst->bEnableTSkipFast = src->bEnableTSkipFast;
     dst->bCULossless = src->bCULossless;
@@ -3136,6 +3192,16 @@ void x265_copy_params(x265_param* dst, x265_param* src)
     dst->minVbvFullness = src->minVbvFullness;
     dst->maxVbvFullness = src->maxVbvFullness;
     dst->rc.cuTree = src->rc.cuTree;
+    dst->bIncrementalCuTree = src->bIncrementalCuTree;
+    dst->bAdaptiveLookahead = src->bAdaptiveLookahead;
+    dst->lookaheadTargetFps = src->lookaheadTargetFps;
+    dst->lookaheadMinDepth = src->lookaheadMinDepth;
+    if (strlen(src->lookaheadSave)) snprintf(dst->lookaheadSave, X265_MAX_STRING_SIZE, "%s", src->lookaheadSave);
+    else dst->lookaheadSave[0] = 0;
+    if (strlen(src->lookaheadLoad)) snprintf(dst->lookaheadLoad, X265_MAX_STRING_SIZE, "%s", src->lookaheadLoad);
+    else dst->lookaheadLoad[0] = 0;
+    dst->bLookaheadOnly = src->bLookaheadOnly;
+    dst->lookaheadBatch = src->lookaheadBatch;
     dst->rc.rfConstantMax = src->rc.rfConstantMax;
     dst->rc.rfConstantMin = src->rc.rfConstantMin;
     dst->rc.bStatWrite = src->rc.bStatWrite;
@@ -3298,6 +3364,7 @@ void x265_copy_params(x265_param* dst, x265_param* src)
     }
     dst->bField = src->bField;
     dst->bEnableTemporalFilter = src->bEnableTemporalFilter;
+    dst->bShareMotionFields = src->bShareMotionFields;
     dst->temporalFilterStrength = src->temporalFilterStrength;
     dst->searchRangeForLayer0 = src->searchRangeForLayer0;
     dst->searchRangeForLayer1 = src->searchRangeForLayer1;
@@ -69,7 +69,7 @@ PicYuv::PicYuv()
     m_vChromaShift = 0;
 }
 
-bool PicYuv::create(x265_param* param, bool picAlloc, pixel *pixelbuf)
+bool PicYuv::create(x265_param* param, bool picAlloc, pixel *pixelbuf, int numaNode)
 {
     m_param = param;
     uint32_t picWidth = m_param->sourceWidth;
@@ -95,7 +95,7 @@ bool PicYuv::create(x265_param* param, bool picAlloc, pixel *pixelbuf)
     {
         if (picAlloc)
         {
-            CHECKED_MALLOC(m_picBuf[0], pixel, m_stride * (maxHeight + (m_lumaMarginY * 2)));
+            CHECKED_MALLOC_NODE(m_picBuf[0], pixel, m_stride * (maxHeight + (m_lumaMarginY * 2)), numaNode);
             m_picOrg[0] = m_picBuf[0] + m_lumaMarginY * m_stride + m_lumaMarginX;
         }
     }
@@ -107,8 +107,8 @@ bool PicYuv::create(x265_param* param, bool picAlloc, pixel *pixelbuf)
         m_strideC = ((numCuInWidth * m_param->maxCUSize) >> m_hChromaShift) + (m_chromaMarginX * 2);
         if (picAlloc)
         {
-            CHECKED_MALLOC(m_picBuf[1], pixel, m_strideC * ((maxHeight >> m_vChromaShift) + (m_chromaMarginY * 2)));
-            CHECKED_MALLOC(m_picBuf[2], pixel, m_strideC * ((maxHeight >> m_vChromaShift) + (m_chromaMarginY * 2)));
+            CHECKED_MALLOC_NODE(m_picBuf[1], pixel, m_strideC * ((maxHeight >> m_vChromaShift) + (m_chromaMarginY * 2)), numaNode);
+            CHECKED_MALLOC_NODE(m_picBuf[2], pixel, m_strideC * ((maxHeight >> m_vChromaShift) + (m_chromaMarginY * 2)), numaNode);
 
             m_picOrg[1] = m_picBuf[1] + m_chromaMarginY * m_strideC + m_chromaMarginX;
             m_picOrg[2] = m_picBuf[2] + m_chromaMarginY * m_strideC + m_chromaMarginX;
@@ -297,7 +297,12 @@ void PicYuv::copyFromPicture(const x265_picture& pic, const x265_param& param, i
     uint64_t crSum;
     lumaSum = cbSum = crSum = 0;
 
-    if (m_param->bCopyPicToFrame)
+    if (m_param->bCopyPicToFrame && pic.planes[0] == m_picOrg[0])
+    {
+        /* samples were written in place through x265_encoder_get_input_buffer(),
+         * only the padding and statistics below remain to be done */
+    }
+    else if (m_param->bCopyPicToFrame)
     {
         if (pic.bitDepth == 8)
         {
@@ -118,6 +118,13 @@ void sad_x4(const pixel* pix1, const pixel* pix2, const pixel* pix3, const pixel
     }
 }
 
+template<int lx, int ly>
+void sad_xn(const pixel* pix1, const pixel* const* fref, int count, intptr_t frefstride, int32_t* res)
+{
+    for (int i = 0; i < count; i++)
+        res[i] = sad<lx, ly>(pix1, FENC_STRIDE, fref[i], frefstride);
+}
+
 template<int lx, int ly>
 int ads_x4(int encDC[4], uint32_t *sums, int delta, uint16_t *costMvX, int16_t *mvs, int width, int thresh)
 {
@@ -288,6 +295,14 @@ int satd8(const pixel* pix1, intptr_t stride_pix1, const pixel* pix2, intptr_t s
     return satd;
 }
 
+template<int w, int h>
+void satd_xn(const pixel* pix1, const pixel* const* fref, int count, intptr_t frefstride, int32_t* res)
+{
+    for (int i = 0; i < count; i++)
+        res[i] = (w % 8) ? satd4<w, h>(pix1, FENC_STRIDE, fref[i], frefstride)
+                         : satd8<w, h>(pix1, FENC_STRIDE, fref[i], frefstride);
+}
+
 inline int _sa8d_8x8(const pixel* pix1, intptr_t i_pix1, const pixel* pix2, intptr_t i_pix2)
 {
     sum2_t tmp[8][4];
@@ -1002,6 +1017,152 @@ static void normFact_c(const pixel* src, uint32_t blockSize, int shift, uint64_t
     }
 }
 
+static void edgeGaussian_c(pixel* dst, const pixel* src, intptr_t stride, int width, int height)
+{
+    /*  5x5 Gaussian filter
+        [2   4   5   4   2]
+     1  [4   9   12  9   4]
+    --- [5   12  15  12  5]
+    159 [4   9   12  9   4]
+        [2   4   5   4   2]*/
+    for (int y = 2; y < height - 2; y++)
+    {
+        const pixel* s0 = src + (y - 2) * stride;
+        const pixel* s1 = s0 + stride;
+        const pixel* s2 = s1 + stride;
+        const pixel* s3 = s2 + stride;
+        const pixel* s4 = s3 + stride;
+
+        for (int x = 2; x < width - 2; x++)
+        {
+            int sum = 2 * (s0[x - 2] + s0[x + 2] + s4[x - 2] + s4[x + 2]) +
+                      4 * (s0[x - 1] + s0[x + 1] + s4[x - 1] + s4[x + 1] + s1[x - 2] + s1[x + 2] + s3[x - 2] + s3[x + 2]) +
+                      5 * (s0[x] + s4[x] + s2[x - 2] + s2[x + 2]) +
+                      9 * (s1[x - 1] + s1[x + 1] + s3[x - 1] + s3[x + 1]) +
+                      12 * (s1[x] + s3[x] + s2[x - 1] + s2[x + 1]) +
+                      15 * s2[x];
+            dst[y * stride + x] = (pixel)(sum / 159);
+        }
+    }
+}
+
+static void edgeSobel_c(pixel* edge, pixel* theta, const pixel* src, intptr_t stride, int width, int height, pixel whitePixel)
+{
+    /*  Horizontal and vertical gradients
+        [ -3   0   3 ]        [-3   -10  -3 ]
+    gH =[ -10  0   10]   gV = [ 0    0    0 ]
+        [ -3   0   3 ]        [ 3    10   3 ]
+
+    The magnitude sqrt(gH^2 + gV^2) is compared against the threshold squared,
+    which is exact in integers */
+    const int64_t threshold = (int64_t)(EDGE_THRESHOLD * EDGE_THRESHOLD);
+
+    for (int y = 1; y < height - 1; y++)
+    {
+        const pixel* s0 = src + (y - 1) * stride;
+        const pixel* s1 = s0 + stride;
+        const pixel* s2 = s1 + stride;
+
+        for (int x = 1; x < width - 1; x++)
+        {
+            int gradientH = 3 * (s0[x + 1] - s0[x - 1]) + 10 * (s1[x + 1] - s1[x - 1]) + 3 * (s2[x + 1] - s2[x - 1]);
+            int gradientV = 3 * (s2[x - 1] - s0[x - 1]) + 10 * (s2[x] - s0[x]) + 3 * (s2[x + 1] - s0[x + 1]);
+            int64_t magnitude = (int64_t)gradientH * gradientH + (int64_t)gradientV * gradientV;
+
+            if (theta)
+                theta[y * stride + x] = edgeThetaDegrees(gradientH, gradientV);
+            edge[y * stride + x] = magnitude >= threshold ? whitePixel : 0;
+        }
+    }
+}
+
+static void intensityHistogram_c(const pixel* src, intptr_t stride, int width, int height, int dsFactor, uint32_t* histogram, uint64_t* sum)
+{
+    /* high bit depth pixels are binned by their 8 most significant bits */
+    const int shift = X265_DEPTH - 8;
+    uint64_t total = 0;
+
+    for (int y = 0; y < height; y += dsFactor)
+    {
+        for (int x = 0; x < width; x += dsFactor)
+        {
+            histogram[src[x] >> shift]++;
+            total += src[x];
+        }
+        src += stride * dsFactor;
+    }
+
+    *sum = total;
+}
+
+static void temporalFilterInterp_c(pixel* dst, intptr_t dstStride, const pixel* src, intptr_t srcStride, int width, int height, const int* xFilter, const int* yFilter)
+{
+    int tempArray[8 + 6][8];
+
+    /* taps 0 and 7 of the MCSTF filters are always zero */
+    src -= 2 * srcStride;
+    for (int by = 0; by < height + 5; by++, src += srcStride)
+    {
+        for (int bx = 0; bx < width; bx++)
+        {
+            const pixel* rowStart = src + bx - 3;
+            int sum = 0;
+            sum += xFilter[1] * rowStart[1];
+            sum += xFilter[2] * rowStart[2];
+            sum += xFilter[3] * rowStart[3];
+            sum += xFilter[4] * rowStart[4];
+            sum += xFilter[5] * rowStart[5];
+            sum += xFilter[6] * rowStart[6];
+            tempArray[by][bx] = sum;
+        }
+    }
+
+    for (int by = 0; by < height; by++, dst += dstStride)
+    {
+        for (int bx = 0; bx < width; bx++)
+        {
+            int sum = 0;
+            sum += yFilter[1] * tempArray[by + 0][bx];
+            sum += yFilter[2] * tempArray[by + 1][bx];
+            sum += yFilter[3] * tempArray[by + 2][bx];
+            sum += yFilter[4] * tempArray[by + 3][bx];
+            sum += yFilter[5] * tempArray[by + 4][bx];
+            sum += yFilter[6] * tempArray[by + 5][bx];
+
+            sum = (sum + (1 << 11)) >> 12;
+            dst[bx] = (pixel)x265_clip3(0, (1 << X265_DEPTH) - 1, sum);
+        }
+    }
+}
+
+static void temporalFilterBlend_c(pixel* dst, intptr_t dstStride, const pixel* const* ref, intptr_t refStride, int numRefs, const double* refWeight, const double* const* weightLut, int width, int height)
+{
+    const double maxSampleValue = (1 << X265_DEPTH) - 1;
+
+    for (int y = 0; y < height; y++, dst += dstStride)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            const int orgVal = (int)dst[x];
+            double temporalWeightSum = 1.0;
+            double newVal = (double)orgVal;
+
+            for (int i = 0; i < numRefs; i++)
+            {
+                const int refVal = (int)ref[i][y * refStride + x];
+                const double weight = refWeight[i] * weightLut[i][abs(refVal - orgVal)];
+
+                newVal += weight * refVal;
+                temporalWeightSum += weight;
+            }
+            newVal /= temporalWeightSum;
+            double sampleVal = round(newVal);
+            sampleVal = (sampleVal < 0 ? 0 : (sampleVal > maxSampleValue ? maxSampleValue : sampleVal));
+            dst[x] = (pixel)sampleVal;
+        }
+    }
+}
+
 #if HIGH_BIT_DEPTH
 static pixel planeClipAndMax_c(pixel *src, intptr_t stride, int width, int height, uint64_t *outsum, 
                                const pixel minPix, const pixel maxPix)
@@ -1059,6 +1220,8 @@ void setupPixelPrimitives_c(EncoderPrimitives &p)
     p.pu[LUMA_ ## W ## x ## H].sad = sad<W, H>; \
     p.pu[LUMA_ ## W ## x ## H].sad_x3 = sad_x3<W, H>; \
     p.pu[LUMA_ ## W ## x ## H].sad_x4 = sad_x4<W, H>; \
+    p.pu[LUMA_ ## W ## x ## H].sad_xn = sad_xn<W, H>; \
+    p.pu[LUMA_ ## W ## x ## H].satd_xn = satd_xn<W, H>; \
     p.pu[LUMA_ ## W ## x ## H].pixelavg_pp[NONALIGNED] = pixelavg_pp<W, H>; \
     p.pu[LUMA_ ## W ## x ## H].pixelavg_pp[ALIGNED] = pixelavg_pp<W, H>;
 #define LUMA_CU(W, H) \
@@ -1366,5 +1529,11 @@ void setupPixelPrimitives_c(EncoderPrimitives &p)
     p.cu[BLOCK_64x64].normFact = normFact_c;
     /* SubSample Luma*/
     p.frameSubSampleLuma = frame_subsample_luma;
+
+    p.edgeGaussian = edgeGaussian_c;
+    p.edgeSobel = edgeSobel_c;
+    p.intensityHistogram = intensityHistogram_c;
+    p.temporalFilterInterp = temporalFilterInterp_c;
+    p.temporalFilterBlend = temporalFilterBlend_c;
 }
 }
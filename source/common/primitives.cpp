@@ -259,6 +259,15 @@ void x265_setup_primitives(x265_param *param)
         for (int i = 0; i < NUM_TR_SIZE; i++)
             primitives.cu[i].intra_pred_allangs = NULL;
 
+        /* Likewise the batched block comparisons are only worth using where
+         * they are vectorized, motion search falls back to one block at a
+         * time with the single block primitives otherwise */
+        for (int i = 0; i < NUM_PU_SIZES; i++)
+        {
+            primitives.pu[i].sad_xn = NULL;
+            primitives.pu[i].satd_xn = NULL;
+        }
+
 #if ENABLE_ASSEMBLY
 #if defined(X265_ARCH_X86) || defined(X265_ARCH_ARM64)
         setupIntrinsicPrimitives(primitives, param->cpuid);
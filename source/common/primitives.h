@@ -138,6 +138,7 @@ typedef sse_t (*pixel_ssd_s_t)(const int16_t* fenc, intptr_t fencstride);
 typedef int(*pixelcmp_ads_t)(int encDC[], uint32_t *sums, int delta, uint16_t *costMvX, int16_t *mvs, int width, int thresh);
 typedef void (*pixelcmp_x4_t)(const pixel* fenc, const pixel* fref0, const pixel* fref1, const pixel* fref2, const pixel* fref3, intptr_t frefstride, int32_t* res);
 typedef void (*pixelcmp_x3_t)(const pixel* fenc, const pixel* fref0, const pixel* fref1, const pixel* fref2, intptr_t frefstride, int32_t* res);
+typedef void (*pixelcmp_xn_t)(const pixel* fenc, const pixel* const* fref, int count, intptr_t frefstride, int32_t* res);
 typedef void (*blockfill_s_t)(int16_t* dst, intptr_t dstride, int16_t val);
 
 typedef void (*intra_pred_t)(pixel* dst, intptr_t dstStride, const pixel *srcPix, int dirMode, int bFilter);
@@ -234,6 +235,28 @@ typedef void(*ssimDistortion_t)(const pixel *fenc, uint32_t fStride, const pixel
 typedef void(*normFactor_t)(const pixel *src, uint32_t blockSize, int shift, uint64_t *z_k);
 /* SubSampling Luma */
 typedef void (*downscaleluma_t)(const pixel* src0, pixel* dstf, intptr_t src_stride, intptr_t dst_stride, int width, int height);
+
+/* Lookahead picture statistics. edgeGaussian writes the 5x5 Gaussian blur of
+ * src to dst, leaving the two pixel border of dst untouched. edgeSobel marks
+ * pixels with a Sobel gradient of at least EDGE_THRESHOLD as whitePixel (else
+ * 0) and, if theta is not NULL, stores the gradient angle in degrees; the one
+ * pixel border is untouched. intensityHistogram adds every dsFactor'th pixel
+ * of every dsFactor'th row to one of 256 bins and returns their sum */
+typedef void (*edge_gaussian_t)(pixel* dst, const pixel* src, intptr_t stride, int width, int height);
+typedef void (*edge_sobel_t)(pixel* edge, pixel* theta, const pixel* src, intptr_t stride, int width, int height, pixel whitePixel);
+typedef void (*intensity_histogram_t)(const pixel* src, intptr_t stride, int width, int height, int dsFactor, uint32_t* histogram, uint64_t* sum);
+
+/* MCSTF. temporalFilterInterp motion compensates one block with the separable
+ * 1/16 pel filters xFilter and yFilter (taps 1 to 6 of an 8 entry row); src is
+ * the block origin moved by the integer part of the vector and rows -2 to
+ * height + 2 and columns -2 to width + 2 around it are read.
+ * temporalFilterBlend replaces each pixel of a block of dst with the weighted
+ * average of itself (weight 1) and the co-located pixels of numRefs motion
+ * compensated references, reference i weighing refWeight[i] * weightLut[i][d]
+ * where d is the absolute pixel difference. MCSTF blocks are 4 or 8 pixels
+ * wide and high, blend blocks may be cut by the picture edge */
+typedef void (*temporal_filter_interp_t)(pixel* dst, intptr_t dstStride, const pixel* src, intptr_t srcStride, int width, int height, const int* xFilter, const int* yFilter);
+typedef void (*temporal_filter_blend_t)(pixel* dst, intptr_t dstStride, const pixel* const* ref, intptr_t refStride, int numRefs, const double* refWeight, const double* const* weightLut, int width, int height);
 /* Function pointers to optimized encoder primitives. Each pointer can reference
  * either an assembly routine, a SIMD intrinsic primitive, or a C function */
 struct EncoderPrimitives
@@ -249,8 +272,10 @@ struct EncoderPrimitives
         pixelcmp_t     sad;         // Sum of Absolute Differences
         pixelcmp_x3_t  sad_x3;      // Sum of Absolute Differences, 3 mv offsets at once
         pixelcmp_x4_t  sad_x4;      // Sum of Absolute Differences, 4 mv offsets at once
+        pixelcmp_xn_t  sad_xn;      // Sum of Absolute Differences, any number of blocks at once
         pixelcmp_ads_t ads;         // Absolute Differences sum
         pixelcmp_t     satd;        // Sum of Absolute Transformed Differences (4x4 Hadamard)
+        pixelcmp_xn_t  satd_xn;     // satd, any number of blocks at once
 
         filter_pp_t    luma_hpp;    // 8-tap luma motion compensation interpolation filters
         filter_hps_t   luma_hps;
@@ -357,6 +382,11 @@ struct EncoderPrimitives
     downscale_t           frameInitLowerRes;
     /* Sub Sample Luma */
     downscaleluma_t        frameSubSampleLuma;
+    edge_gaussian_t       edgeGaussian;
+    edge_sobel_t          edgeSobel;
+    intensity_histogram_t intensityHistogram;
+    temporal_filter_interp_t temporalFilterInterp;
+    temporal_filter_blend_t  temporalFilterBlend;
     cutree_propagate_cost propagateCost;
     cutree_fix8_unpack    fix8Unpack;
     cutree_fix8_pack      fix8Pack;
@@ -469,6 +499,18 @@ inline int partitionFromLog2Size(int log2Size)
     return log2Size - 2;
 }
 
+/* Gradient angle in whole degrees [0, 180] as edgeSobel stores it. Vector
+ * implementations use it for lanes whose angle is too close to a whole degree
+ * for their own approximation to be truncated reliably */
+inline pixel edgeThetaDegrees(int gradientH, int gradientV)
+{
+    float radians = atan2((float)gradientV, (float)gradientH);
+    float theta = (float)((radians * 180) / PI);
+    if (theta < 0)
+        theta = 180 + theta;
+    return (pixel)theta;
+}
+
 void setupCPrimitives(EncoderPrimitives &p);
 void setupIntrinsicPrimitives(EncoderPrimitives &p, int cpuMask);
 void setupAssemblyPrimitives(EncoderPrimitives &p, int cpuMask);
@@ -149,12 +149,18 @@ TemporalFilter::TemporalFilter()
     m_chromaFactor = 0.55;
     m_sigmaMultiplier = 9.0;
     m_sigmaZeroPoint = 10.0;
+
+    m_metld = NULL;
+    m_weightLut[0] = m_weightLut[1] = NULL;
+    m_weightLutQP = -1;
 }
 
 TemporalFilter::~TemporalFilter()
 {
     if (m_metld)
         delete m_metld;
+    X265_FREE(m_weightLut[0]);
+    X265_FREE(m_weightLut[1]);
 }
 
 void TemporalFilter::init(const x265_param* param)
@@ -404,7 +410,7 @@ int MotionEstimatorTLD::motionErrorLumaSSD(MotionEstimatorTLD& m_metld,
     return error;
 }
 
-void TemporalFilter::applyMotion(MV *mvs, uint32_t mvsStride, PicYuv *input, PicYuv *output)
+void TemporalFilter::applyMotion(MV *mvs, uint32_t mvsStride, PicYuv *input, PicYuv *output, int blockRowBegin, int blockRowEnd)
 {
     static const int lumaBlockSize = 8;
     int srcStride = 0;
@@ -412,8 +418,6 @@ void TemporalFilter::applyMotion(MV *mvs, uint32_t mvsStride, PicYuv *input, Pic
     int csx = 0, csy = 0;
     for (int c = 0; c < m_numComponents; c++)
     {
-        const pixel maxValue = (1 << X265_DEPTH) - 1;
-
         const pixel *pSrcImage = input->m_picOrg[c];
         pixel *pDstImage = output->m_picOrg[c];
 
@@ -434,7 +438,7 @@ void TemporalFilter::applyMotion(MV *mvs, uint32_t mvsStride, PicYuv *input, Pic
         const int height = input->m_picHeight >> csy;
         const int width = input->m_picWidth >> csx;
 
-        for (int y = 0, blockNumY = 0; y + blockSizeY <= height; y += blockSizeY, blockNumY++)
+        for (int blockNumY = blockRowBegin, y = blockRowBegin * blockSizeY; blockNumY < blockRowEnd && y + blockSizeY <= height; y += blockSizeY, blockNumY++)
         {
             for (int x = 0, blockNumX = 0; x + blockSizeX <= width; x += blockSizeX, blockNumX++)
             {
@@ -447,70 +451,112 @@ void TemporalFilter::applyMotion(MV *mvs, uint32_t mvsStride, PicYuv *input, Pic
 
                 const int *xFilter = s_interpolationFilter[dx & 0xf];
                 const int *yFilter = s_interpolationFilter[dy & 0xf]; // will add 6 bit.
-                const int numFilterTaps = 7;
-                const int centreTapOffset = 3;
 
-                int tempArray[lumaBlockSize + numFilterTaps][lumaBlockSize];
+                primitives.temporalFilterInterp(pDstImage + y * dstStride + x, dstStride,
+                                                pSrcImage + (y + yInt) * srcStride + x + xInt, srcStride,
+                                                blockSizeX, blockSizeY, xFilter, yFilter);
+            }
+        }
+    }
+}
 
-                for (int by = 1; by < blockSizeY + numFilterTaps; by++)
-                {
-                    const int yOffset = y + by + yInt - centreTapOffset;
-                    const pixel *sourceRow = pSrcImage + yOffset * srcStride;
-                    for (int bx = 0; bx < blockSizeX; bx++)
-                    {
-                        int iBase = x + bx + xInt - centreTapOffset;
-                        const pixel *rowStart = sourceRow + iBase;
-
-                        int iSum = 0;
-                        iSum += xFilter[1] * rowStart[1];
-                        iSum += xFilter[2] * rowStart[2];
-                        iSum += xFilter[3] * rowStart[3];
-                        iSum += xFilter[4] * rowStart[4];
-                        iSum += xFilter[5] * rowStart[5];
-                        iSum += xFilter[6] * rowStart[6];
-
-                        tempArray[by][bx] = iSum;
-                    }
-                }
+bool TemporalFilter::initWeightLut()
+{
+    const int lutSize = 4 * (PIXEL_MAX + 1);
+    const double maxSampleValue = (1 << m_bitDepth) - 1;
+    const double bitDepthDiffWeighting = 1024.0 / (maxSampleValue + 1);
 
-                pixel *pDstRow = pDstImage + y * dstStride;
-                for (int by = 0; by < blockSizeY; by++, pDstRow += dstStride)
-                {
-                    pixel *pDstPel = pDstRow + x;
-                    for (int bx = 0; bx < blockSizeX; bx++, pDstPel++)
-                    {
-                        int iSum = 0;
-
-                        iSum += yFilter[1] * tempArray[by + 1][bx];
-                        iSum += yFilter[2] * tempArray[by + 2][bx];
-                        iSum += yFilter[3] * tempArray[by + 3][bx];
-                        iSum += yFilter[4] * tempArray[by + 4][bx];
-                        iSum += yFilter[5] * tempArray[by + 5][bx];
-                        iSum += yFilter[6] * tempArray[by + 6][bx];
-
-                        iSum = (iSum + (1 << 11)) >> 12;
-                        iSum = iSum < 0 ? 0 : (iSum > maxValue ? maxValue : iSum);
-                        *pDstPel = (pixel)iSum;
-                    }
-                }
+    if (!m_weightLut[0])
+    {
+        CHECKED_MALLOC(m_weightLut[0], double, lutSize);
+        CHECKED_MALLOC(m_weightLut[1], double, lutSize);
+        m_weightLutQP = -1;
+    }
+
+    for (int c = 0; c < 2; c++)
+    {
+        if (c ? m_weightLutQP >= 0 : m_weightLutQP == m_QP)
+            continue;
+
+        const double sigmaSq = !c ? (m_QP - m_sigmaZeroPoint) * (m_QP - m_sigmaZeroPoint) * m_sigmaMultiplier : 30 * 30;
+
+        /* table k is for noise < 25 if !(k & 2) and error < 50 if !(k & 1) */
+        for (int k = 0; k < 4; k++)
+        {
+            double sw = 1;
+            sw *= !(k & 2) ? 1.3 : 0.8;
+            sw *= !(k & 1) ? 1.3 : 1;
+
+            double* lut = m_weightLut[c] + k * (PIXEL_MAX + 1);
+            for (int d = 0; d <= PIXEL_MAX; d++)
+            {
+                double diff = (double)d;
+                diff *= bitDepthDiffWeighting;
+                double diffSq = diff * diff;
+                lut[d] = exp(-diffSq / (2 * sw * sigmaSq));
             }
         }
     }
+
+    m_weightLutQP = m_QP;
+    return true;
+
+fail:
+    X265_FREE(m_weightLut[0]);
+    m_weightLut[0] = NULL;
+    return false;
 }
 
 void TemporalFilter::bilateralFilter(Frame* frame,
     TemporalFilterRefPicInfo* m_mcstfRefList,
-    double overallStrength)
+    double overallStrength,
+    JobProvider* jp)
 {
-
     const int numRefs = frame->m_mcstf->m_numRef;
+    if (!numRefs)
+        return;
+
+    if (!initWeightLut())
+    {
+        x265_log(m_param, X265_LOG_ERROR, "unable to allocate MCSTF weight tables, POC %d is not filtered\n", frame->m_poc);
+        return;
+    }
+
+    const int ctuSize = m_param->maxCUSize;
+    PicYuv* orgPic = frame->m_fencPic;
 
-    for (int i = 0; i < numRefs; i++)
     {
-        TemporalFilterRefPicInfo *ref = &m_mcstfRefList[i];
-        applyMotion(m_mcstfRefList[i].mvs, m_mcstfRefList[i].mvsStride, m_mcstfRefList[i].picBuffer, ref->compensatedPic);
+        TemporalFilterGroup mc(*this, frame, m_mcstfRefList, overallStrength);
+        mc.m_bandHeight = ctuSize / 8;
+        mc.m_numBands = (orgPic->m_picHeight + ctuSize - 1) / ctuSize;
+        mc.m_jobTotal = mc.m_numBands * numRefs;
+        mc.run(jp);
     }
 
+    /* the components share the noise tables, so they are filtered in turn */
+    for (int c = 0; c < m_numComponents; c++)
+    {
+        const int csy = c ? CHROMA_V_SHIFT(m_internalCsp) : 0;
+        const int height = orgPic->m_picHeight >> csy;
+
+        TemporalFilterGroup filter(*this, frame, m_mcstfRefList, overallStrength);
+        filter.m_component = c;
+        filter.m_bandHeight = ctuSize >> csy;
+        filter.m_numBands = (height + filter.m_bandHeight - 1) / filter.m_bandHeight;
+        filter.m_jobTotal = filter.m_numBands;
+        filter.run(jp);
+    }
+}
+
+void TemporalFilter::filterRows(Frame* frame,
+    TemporalFilterRefPicInfo* m_mcstfRefList,
+    double overallStrength,
+    int c,
+    int rowBegin,
+    int rowEnd)
+{
+    const int numRefs = frame->m_mcstf->m_numRef;
+
     int refStrengthRow = 2;
     if (numRefs == m_range * 2)
     {
@@ -521,135 +567,138 @@ void TemporalFilter::bilateralFilter(Frame* frame,
         refStrengthRow = 1;
     }
 
-    const double lumaSigmaSq = (m_QP - m_sigmaZeroPoint) * (m_QP - m_sigmaZeroPoint) * m_sigmaMultiplier;
-    const double chromaSigmaSq = 30 * 30;
-
     PicYuv* orgPic = frame->m_fencPic;
 
-    for (int c = 0; c < m_numComponents; c++)
-    {
-        int height, width;
-        pixel *srcPelRow = NULL;
-        intptr_t srcStride, correctedPicsStride = 0;
+    int height, width;
+    intptr_t srcStride, correctedPicsStride;
 
-        if (!c)
-        {
-            height = orgPic->m_picHeight;
-            width = orgPic->m_picWidth;
-            srcPelRow = orgPic->m_picOrg[c];
-            srcStride = orgPic->m_stride;
-        }
-        else
-        {
-            int csx = CHROMA_H_SHIFT(m_internalCsp);
-            int csy = CHROMA_V_SHIFT(m_internalCsp);
+    if (!c)
+    {
+        height = orgPic->m_picHeight;
+        width = orgPic->m_picWidth;
+        srcStride = orgPic->m_stride;
+        correctedPicsStride = m_mcstfRefList[0].compensatedPic->m_stride;
+    }
+    else
+    {
+        int csx = CHROMA_H_SHIFT(m_internalCsp);
+        int csy = CHROMA_V_SHIFT(m_internalCsp);
 
-            height = orgPic->m_picHeight >> csy;
-            width = orgPic->m_picWidth >> csx;
-            srcPelRow = orgPic->m_picOrg[c];
-            srcStride = (int)orgPic->m_strideC;
-        }
+        height = orgPic->m_picHeight >> csy;
+        width = orgPic->m_picWidth >> csx;
+        srcStride = (int)orgPic->m_strideC;
+        correctedPicsStride = m_mcstfRefList[0].compensatedPic->m_strideC;
+    }
+    rowEnd = X265_MIN(rowEnd, height);
 
-        const double sigmaSq = (!c)  ? lumaSigmaSq : chromaSigmaSq;
-        const double weightScaling = overallStrength * ( (!c) ? 0.4 : m_chromaFactor);
+    const double weightScaling = overallStrength * ( (!c) ? 0.4 : m_chromaFactor);
+    const int blkSize = (!c) ? 8 : 4;
 
-        const double maxSampleValue = (1 << m_bitDepth) - 1;
-        const double bitDepthDiffWeighting = 1024.0 / (maxSampleValue + 1);
+    const pixel* refPel[MAX_MCSTF_TEMPORAL_WINDOW_LENGTH];
+    const double* weightLut[MAX_MCSTF_TEMPORAL_WINDOW_LENGTH];
+    double refWeight[MAX_MCSTF_TEMPORAL_WINDOW_LENGTH];
 
-        const int blkSize = (!c) ? 8 : 4;
+    for (int y = rowBegin; y < rowEnd; y += blkSize)
+    {
+        pixel *srcPelRow = orgPic->m_picOrg[c] + y * srcStride;
 
-        for (int y = 0; y < height; y++, srcPelRow += srcStride)
+        for (int x = 0; x < width; x += blkSize)
         {
-            pixel *srcPel = srcPelRow;
+            pixel *srcPel = srcPelRow + x;
+            const intptr_t pelOffset = y * correctedPicsStride + x;
 
-            for (int x = 0; x < width; x++, srcPel++)
+            for (int i = 0; i < numRefs; i++)
             {
-                const int orgVal = (int)*srcPel;
-                double temporalWeightSum = 1.0;
-                double newVal = (double)orgVal;
+                TemporalFilterRefPicInfo *refPicInfo = &m_mcstfRefList[i];
+                const pixel* refBlock = refPicInfo->compensatedPic->m_picOrg[c] + pelOffset;
 
-                if ((y % blkSize == 0) && (x % blkSize == 0))
+                double variance = 0, diffsum = 0;
+                for (int y1 = 0; y1 < blkSize - 1; y1++)
                 {
-                    for (int i = 0; i < numRefs; i++)
+                    for (int x1 = 0; x1 < blkSize - 1; x1++)
                     {
-                        TemporalFilterRefPicInfo *refPicInfo = &m_mcstfRefList[i];
+                        int pix = *(srcPel + x1);
+                        int pixR = *(srcPel + x1 + 1);
+                        int pixD = *(srcPel + x1 + srcStride);
 
-                        if (!c)
-                            correctedPicsStride = refPicInfo->compensatedPic->m_stride;
-                        else
-                            correctedPicsStride = refPicInfo->compensatedPic->m_strideC;
+                        int ref = *(refBlock + ((y1)*correctedPicsStride + x1));
+                        int refR = *(refBlock + ((y1)*correctedPicsStride + x1 + 1));
+                        int refD = *(refBlock + ((y1 + 1) * correctedPicsStride + x1));
 
-                        const intptr_t pelOffset = y * correctedPicsStride + x;
-                        primitives.pu[1].copy_pp(m_metld->me.fencPUYuv.m_buf[0], FENC_STRIDE, refPicInfo->compensatedPic->m_picOrg[c] + pelOffset, correctedPicsStride);
+                        int diff = pix - ref;
+                        int diffR = pixR - refR;
+                        int diffD = pixD - refD;
 
-                        double variance = 0, diffsum = 0;
-                        for (int y1 = 0; y1 < blkSize - 1; y1++)
-                        {
-                            for (int x1 = 0; x1 < blkSize - 1; x1++)
-                            {
-                                int pix = *(srcPel + x1);
-                                int pixR = *(srcPel + x1 + 1);
-                                int pixD = *(srcPel + x1 + srcStride);
+                        variance += diff * diff;
+                        diffsum += (diffR - diff) * (diffR - diff);
+                        diffsum += (diffD - diff) * (diffD - diff);
+                    }
+                }
 
-                                int ref = *(m_metld->me.fencPUYuv.m_buf[0] + ((y1)*FENC_STRIDE + x1));
-                                int refR = *(m_metld->me.fencPUYuv.m_buf[0] + ((y1)*FENC_STRIDE + x1 + 1));
-                                int refD = *(m_metld->me.fencPUYuv.m_buf[0] + ((y1 + 1) * FENC_STRIDE + x1));
+                refPicInfo->noise[(y / blkSize) * refPicInfo->mvsStride + (x / blkSize)] = (int)round((300 * variance + 50) / (10 * diffsum + 50));
+            }
 
-                                int diff = pix - ref;
-                                int diffR = pixR - refR;
-                                int diffD = pixD - refD;
+            double minError = 9999999;
+            for (int i = 0; i < numRefs; i++)
+            {
+                TemporalFilterRefPicInfo *refPicInfo = &m_mcstfRefList[i];
+                minError = X265_MIN(minError, (double)refPicInfo->error[(y / blkSize) * refPicInfo->mvsStride + (x / blkSize)]);
+            }
 
-                                variance += diff * diff;
-                                diffsum += (diffR - diff) * (diffR - diff);
-                                diffsum += (diffD - diff) * (diffD - diff);
-                            }
-                        }
+            for (int i = 0; i < numRefs; i++)
+            {
+                TemporalFilterRefPicInfo *refPicInfo = &m_mcstfRefList[i];
 
-                        refPicInfo->noise[(y / blkSize) * refPicInfo->mvsStride + (x / blkSize)] = (int)round((300 * variance + 50) / (10 * diffsum + 50));
-                    }
-                }
+                const int error = refPicInfo->error[(y / blkSize) * refPicInfo->mvsStride + (x / blkSize)];
+                const int noise = refPicInfo->noise[(y / blkSize) * refPicInfo->mvsStride + (x / blkSize)];
 
-                double minError = 9999999;
-                for (int i = 0; i < numRefs; i++)
-                {
-                    TemporalFilterRefPicInfo *refPicInfo = &m_mcstfRefList[i];
-                    minError = X265_MIN(minError, (double)refPicInfo->error[(y / blkSize) * refPicInfo->mvsStride + (x / blkSize)]);
-                }
+                const int index = X265_MIN(3, std::abs(refPicInfo->origOffset) - 1);
+                double ww = 1;
+                ww *= (noise < 25) ? 1 : 1.2;
+                ww *= (error < 50) ? 1.2 : ((error > 100) ? 0.8 : 1);
+                ww *= ((minError + 1) / (error + 1));
 
-                for (int i = 0; i < numRefs; i++)
-                {
-                    TemporalFilterRefPicInfo *refPicInfo = &m_mcstfRefList[i];
-
-                    const int error = refPicInfo->error[(y / blkSize) * refPicInfo->mvsStride + (x / blkSize)];
-                    const int noise = refPicInfo->noise[(y / blkSize) * refPicInfo->mvsStride + (x / blkSize)];
-
-                    const pixel *pCorrectedPelPtr = refPicInfo->compensatedPic->m_picOrg[c] + (y * correctedPicsStride + x);
-                    const int refVal = (int)*pCorrectedPelPtr;
-                    double diff = (double)(refVal - orgVal);
-                    diff *= bitDepthDiffWeighting;
-                    double diffSq = diff * diff;
-
-                    const int index = X265_MIN(3, std::abs(refPicInfo->origOffset) - 1);
-                    double ww = 1, sw = 1;
-                    ww *= (noise < 25) ? 1 : 1.2;
-                    sw *= (noise < 25) ? 1.3 : 0.8;
-                    ww *= (error < 50) ? 1.2 : ((error > 100) ? 0.8 : 1);
-                    sw *= (error < 50) ? 1.3 : 1;
-                    ww *= ((minError + 1) / (error + 1));
-                    const double weight = weightScaling * s_refStrengths[refStrengthRow][index] * ww * exp(-diffSq / (2 * sw * sigmaSq));
-
-                    newVal += weight * refVal;
-                    temporalWeightSum += weight;
-                }
-                newVal /= temporalWeightSum;
-                double sampleVal = round(newVal);
-                sampleVal = (sampleVal < 0 ? 0 : (sampleVal > maxSampleValue ? maxSampleValue : sampleVal));
-                *srcPel = (pixel)sampleVal;
+                refPel[i] = refPicInfo->compensatedPic->m_picOrg[c] + pelOffset;
+                refWeight[i] = weightScaling * s_refStrengths[refStrengthRow][index] * ww;
+                weightLut[i] = m_weightLut[!!c] + (((noise >= 25) << 1) + (error >= 50)) * (PIXEL_MAX + 1);
             }
+
+            primitives.temporalFilterBlend(srcPel, srcStride, refPel, correctedPicsStride, numRefs, refWeight, weightLut,
+                                           X265_MIN(blkSize, width - x), X265_MIN(blkSize, rowEnd - y));
         }
     }
 }
 
+void TemporalFilterGroup::run(JobProvider* jp)
+{
+    if (jp && jp->m_pool && m_jobTotal > 1)
+        tryBondPeers(*jp, m_jobTotal - 1);
+    processTasks(-1);
+    waitForExit();
+}
+
+void TemporalFilterGroup::processTasks(int /* workerThreadId */)
+{
+    m_lock.acquire();
+    while (m_jobAcquired < m_jobTotal)
+    {
+        int job = m_jobAcquired++;
+        m_lock.release();
+
+        int band = job % m_numBands;
+        if (m_component < 0)
+        {
+            TemporalFilterRefPicInfo* ref = &m_refList[job / m_numBands];
+            m_filter.applyMotion(ref->mvs, ref->mvsStride, ref->picBuffer, ref->compensatedPic, band * m_bandHeight, (band + 1) * m_bandHeight);
+        }
+        else
+            m_filter.filterRows(m_frame, m_refList, m_overallStrength, m_component, band * m_bandHeight, (band + 1) * m_bandHeight);
+
+        m_lock.acquire();
+    }
+    m_lock.release();
+}
+
 void MotionEstimatorTLD::motionEstimationLuma(MotionEstimatorTLD& m_metld, MV *mvs, uint32_t mvStride, pixel* src,int stride, int height, int width, pixel* buf, int blockSize,
     int sRange, MV* previous, uint32_t prevMvStride, int factor)
 {
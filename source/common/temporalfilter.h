@@ -30,6 +30,7 @@
 #include "piclist.h"
 #include "yuv.h"
 #include "motion.h"
+#include "threadpool.h"
 
 const int s_interpolationFilter[16][8] =
 {
@@ -186,14 +187,57 @@ namespace X265_NS {
 
         MotionEstimatorTLD* m_metld;
 
+        /* exp() weights of the bilateral filter by absolute pixel difference,
+         * for the four combinations of block noise and error classes; luma
+         * tables depend on m_QP and are rebuilt when it changes */
+        double* m_weightLut[2];
+        int     m_weightLutQP;
+
         int createRefPicInfo(TemporalFilterRefPicInfo* refFrame, x265_param* param);
 
-        void bilateralFilter(Frame* frame, TemporalFilterRefPicInfo* mctfRefList, double overallStrength);
+        /* filters frame in place. Motion compensation and filtering are split
+         * into CTU row tasks which idle workers of jp's pool help with */
+        void bilateralFilter(Frame* frame, TemporalFilterRefPicInfo* mctfRefList, double overallStrength, JobProvider* jp = NULL);
 
         void destroyRefPicInfo(TemporalFilterRefPicInfo* curFrame);
 
-        void applyMotion(MV *mvs, uint32_t mvsStride, PicYuv *input, PicYuv *output);
+        /* compensates the 8x8 luma block rows [blockRowBegin, blockRowEnd) of
+         * all components */
+        void applyMotion(MV *mvs, uint32_t mvsStride, PicYuv *input, PicYuv *output, int blockRowBegin, int blockRowEnd);
+
+        /* bilateral filter of rows [rowBegin, rowEnd) of component c */
+        void filterRows(Frame* frame, TemporalFilterRefPicInfo* mctfRefList, double overallStrength, int c, int rowBegin, int rowEnd);
+
+    protected:
+
+        bool initWeightLut();
+    };
+
+    class TemporalFilterGroup : public BondedTaskGroup
+    {
+    public:
+
+        TemporalFilter&            m_filter;
+        Frame*                     m_frame;
+        TemporalFilterRefPicInfo*  m_refList;
+        double                     m_overallStrength;
+        int                        m_component; // -1 for motion compensation
+        int                        m_numBands;
+        int                        m_bandHeight; // in block rows or rows of m_component
+
+        TemporalFilterGroup(TemporalFilter& filter, Frame* frame, TemporalFilterRefPicInfo* refList, double overallStrength)
+            : m_filter(filter), m_frame(frame), m_refList(refList), m_overallStrength(overallStrength)
+        {
+            m_component = -1;
+            m_numBands = m_bandHeight = 0;
+        }
+
+        void run(JobProvider* jp);
+        void processTasks(int workerThreadId);
+
+    protected:
 
+        TemporalFilterGroup& operator=(const TemporalFilterGroup&);
     };
 }
 #endif
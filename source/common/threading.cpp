@@ -147,7 +147,10 @@ bool Thread::start()
 void Thread::stop()
 {
     if (thread)
+    {
         pthread_join(thread, NULL);
+        thread = 0;
+    }
 }
 
 Thread::~Thread() {}
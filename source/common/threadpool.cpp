@@ -43,8 +43,8 @@
 #elif defined(_MSC_VER)
 
 #define SLEEPBITMAP_CTZ(id, x)     _BitScanForward64(&id, x)
-#define SLEEPBITMAP_OR(ptr, mask)  InterlockedOr64((volatile LONG64*)ptr, (LONG)mask)
-#define SLEEPBITMAP_AND(ptr, mask) InterlockedAnd64((volatile LONG64*)ptr, (LONG)mask)
+#define SLEEPBITMAP_OR(ptr, mask)  InterlockedOr64((volatile LONG64*)ptr, (LONG64)mask)
+#define SLEEPBITMAP_AND(ptr, mask) InterlockedAnd64((volatile LONG64*)ptr, (LONG64)mask)
 
 #endif // ifdef __GNUC__
 
@@ -89,6 +89,126 @@ static int popCount(uint64_t x)
 namespace X265_NS {
 // x265 private namespace
 
+void SleepBitmap::set(int id)
+{
+    int w = id / SLEEPBITMAP_WORD_BITS;
+    sleepbitmap_t bit = (sleepbitmap_t)1 << (id % SLEEPBITMAP_WORD_BITS);
+    sleepbitmap_t wordBit = (sleepbitmap_t)1 << w;
+
+    if (!(SLEEPBITMAP_OR(&m_words[w], bit) & ~bit) || !(m_summary & wordBit))
+        SLEEPBITMAP_OR(&m_summary, wordBit);
+}
+
+void SleepBitmap::clear(int id)
+{
+    int w = id / SLEEPBITMAP_WORD_BITS;
+    sleepbitmap_t bit = (sleepbitmap_t)1 << (id % SLEEPBITMAP_WORD_BITS);
+
+    if (SLEEPBITMAP_AND(&m_words[w], ~bit) == bit)
+    {
+        /* we cleared the last bit of the word; clear its summary bit unless
+         * another thread has set a bit in the meantime */
+        sleepbitmap_t wordBit = (sleepbitmap_t)1 << w;
+        SLEEPBITMAP_AND(&m_summary, ~wordBit);
+        if (m_words[w])
+            SLEEPBITMAP_OR(&m_summary, wordBit);
+    }
+}
+
+int SleepBitmap::acquire(const SleepBitmap* mask)
+{
+    unsigned long w, id;
+
+    sleepbitmap_t summary = m_summary;
+    while (summary)
+    {
+        SLEEPBITMAP_CTZ(w, summary);
+        summary &= summary - 1;
+
+        sleepbitmap_t wordMask = mask ? mask->m_words[w] : (sleepbitmap_t)-1;
+        sleepbitmap_t masked = m_words[w] & wordMask;
+        while (masked)
+        {
+            SLEEPBITMAP_CTZ(id, masked);
+
+            sleepbitmap_t bit = (sleepbitmap_t)1 << id;
+            sleepbitmap_t prev = SLEEPBITMAP_AND(&m_words[w], ~bit);
+            if (prev & bit)
+            {
+                if (prev == bit)
+                {
+                    sleepbitmap_t wordBit = (sleepbitmap_t)1 << w;
+                    SLEEPBITMAP_AND(&m_summary, ~wordBit);
+                    if (m_words[w])
+                        SLEEPBITMAP_OR(&m_summary, wordBit);
+                }
+                return (int)(w * SLEEPBITMAP_WORD_BITS + id);
+            }
+
+            masked = m_words[w] & wordMask;
+        }
+    }
+
+    return -1;
+}
+
+enum { STEAL_QUEUE_SIZE = 32 };
+
+/* Per-worker deque of job providers which have asked for help, used by the
+ * work-stealing scheduler. The owning worker pops the most recently pushed
+ * provider (whose data is most likely still in its cache) while idle peers
+ * steal the oldest entry. The deques are short and each has its own lock, so
+ * contention is spread across workers instead of a single pool-wide bitmap */
+class StealQueue
+{
+public:
+
+    Lock          m_lock;
+    JobProvider*  m_jobs[STEAL_QUEUE_SIZE];
+    int           m_head;
+    volatile int  m_count;
+
+    StealQueue() : m_head(0), m_count(0) {}
+
+    /* returns false if the queue is full; a provider is only queued once */
+    bool push(JobProvider* jp)
+    {
+        ScopedLock qlock(m_lock);
+        for (int i = 0; i < m_count; i++)
+            if (m_jobs[(m_head + i) % STEAL_QUEUE_SIZE] == jp)
+                return true;
+        if (m_count == STEAL_QUEUE_SIZE)
+            return false;
+        m_jobs[(m_head + m_count) % STEAL_QUEUE_SIZE] = jp;
+        m_count++;
+        return true;
+    }
+
+    JobProvider* popBack()
+    {
+        if (!m_count)
+            return NULL;
+        ScopedLock qlock(m_lock);
+        if (!m_count)
+            return NULL;
+        m_count--;
+        return m_jobs[(m_head + m_count) % STEAL_QUEUE_SIZE];
+    }
+
+    JobProvider* stealFront()
+    {
+        if (!m_count)
+            return NULL;
+        ScopedLock qlock(m_lock);
+        if (!m_count)
+            return NULL;
+        JobProvider* jp = m_jobs[m_head];
+        m_head = (m_head + 1) % STEAL_QUEUE_SIZE;
+        m_count--;
+        return jp;
+    }
+};
+
 class WorkerThread : public Thread
 {
 private:
@@ -99,16 +219,27 @@ private:
 
     WorkerThread& operator =(const WorkerThread&);
 
+    void         stealMain();
+    JobProvider* findStealJob();
+    bool         hasStealJob() const;
+
 public:
 
     JobProvider*     m_curJobProvider;
     BondedTaskGroup* m_bondMaster;
 
-    WorkerThread(ThreadPool& pool, int id) : m_pool(pool), m_id(id) {}
+    /* work-stealing mode only */
+    StealQueue       m_queue;
+    volatile int32_t m_sleeping;
+
+    WorkerThread(ThreadPool& pool, int id) : m_pool(pool), m_id(id), m_sleeping(0) {}
     virtual ~WorkerThread() {}
 
     void threadMain();
     void awaken()           { m_wakeEvent.trigger(); }
+
+    /* atomically claim this worker if it is idle, the caller must then awaken it */
+    bool tryAcquire()       { return m_sleeping && (ATOMIC_AND(&m_sleeping, 0) & 1); }
 };
 
 void WorkerThread::threadMain()
@@ -123,12 +254,17 @@ void WorkerThread::threadMain()
 
     m_pool.setCurrentThreadAffinity();
 
-    sleepbitmap_t idBit = (sleepbitmap_t)1 << m_id;
+    if (m_pool.m_bWorkStealing)
+    {
+        stealMain();
+        return;
+    }
+
     m_curJobProvider = m_pool.m_jpTable[0];
     m_bondMaster = NULL;
 
-    SLEEPBITMAP_OR(&m_curJobProvider->m_ownerBitmap, idBit);
-    SLEEPBITMAP_OR(&m_pool.m_sleepBitmap, idBit);
+    m_curJobProvider->m_ownerBitmap.set(m_id);
+    m_pool.m_sleepBitmap.set(m_id);
     m_wakeEvent.wait();
 
     while (m_pool.m_isActive)
@@ -162,9 +298,9 @@ void WorkerThread::threadMain()
             }
             if (nextProvider != -1 && m_curJobProvider != m_pool.m_jpTable[nextProvider])
             {
-                SLEEPBITMAP_AND(&m_curJobProvider->m_ownerBitmap, ~idBit);
+                m_curJobProvider->m_ownerBitmap.clear(m_id);
                 m_curJobProvider = m_pool.m_jpTable[nextProvider];
-                SLEEPBITMAP_OR(&m_curJobProvider->m_ownerBitmap, idBit);
+                m_curJobProvider->m_ownerBitmap.set(m_id);
             }
         }
         while (m_curJobProvider->m_helpWanted);
@@ -172,70 +308,145 @@ void WorkerThread::threadMain()
         /* While the worker sleeps, a job-provider or bond-group may acquire this
          * worker's sleep bitmap bit. Once acquired, that thread may modify 
          * m_bondMaster or m_curJobProvider, then waken the thread */
-        SLEEPBITMAP_OR(&m_pool.m_sleepBitmap, idBit);
+        m_pool.m_sleepBitmap.set(m_id);
         m_wakeEvent.wait();
     }
 
-    SLEEPBITMAP_OR(&m_pool.m_sleepBitmap, idBit);
+    m_pool.m_sleepBitmap.set(m_id);
 }
 
-void JobProvider::tryWakeOne()
+/* Work-stealing worker loop. Work is taken from this worker's own deque first,
+ * then stolen from peers, and finally any provider with the help-wanted flag
+ * set is serviced (the flag is set when every deque was full or no worker was
+ * idle at wake time). The provider keeps the worker for as long as it wants
+ * help, just as in the bitmap scheduler */
+void WorkerThread::stealMain()
 {
-    int id = m_pool->tryAcquireSleepingThread(m_ownerBitmap, ALL_POOL_THREADS);
-    if (id < 0)
+    m_curJobProvider = m_pool.m_jpTable[0];
+    m_bondMaster = NULL;
+
+    ATOMIC_INC(&m_pool.m_numSleeping);
+    ATOMIC_OR(&m_sleeping, 1);
+    m_wakeEvent.wait();
+
+    while (m_pool.m_isActive)
     {
-        m_helpWanted = true;
-        return;
+        if (m_bondMaster)
+        {
+            m_bondMaster->processTasks(m_id);
+            m_bondMaster->m_exitedPeerCount.incr();
+            m_bondMaster = NULL;
+        }
+
+        JobProvider* jp;
+        while ((jp = findStealJob()) != NULL)
+        {
+            m_curJobProvider = jp;
+            jp->m_lastWorkerId = m_id;
+            do
+                jp->findJob(m_id);
+            while (jp->m_helpWanted && m_pool.m_isActive);
+        }
+
+        /* Announce we are idle, then look once more for work which may have
+         * been queued or asked for after our last check, in any deque or by a
+         * provider which found no idle worker. If we reclaim our own idle flag
+         * nobody has acquired us and we may go back to work; otherwise the
+         * thread which acquired us will trigger m_wakeEvent */
+        ATOMIC_INC(&m_pool.m_numSleeping);
+        ATOMIC_OR(&m_sleeping, 1);
+        if (hasStealJob() && (ATOMIC_AND(&m_sleeping, 0) & 1))
+        {
+            ATOMIC_DEC(&m_pool.m_numSleeping);
+            continue;
+        }
+        m_wakeEvent.wait();
     }
 
-    WorkerThread& worker = m_pool->m_workers[id];
-    if (worker.m_curJobProvider != this) /* poaching */
+    ATOMIC_OR(&m_sleeping, 1);
+}
+
+JobProvider* WorkerThread::findStealJob()
+{
+    JobProvider* jp = m_queue.popBack();
+    if (jp)
+        return jp;
+
+    for (int i = 1; i < m_pool.m_numWorkers; i++)
     {
-        sleepbitmap_t bit = (sleepbitmap_t)1 << id;
-        SLEEPBITMAP_AND(&worker.m_curJobProvider->m_ownerBitmap, ~bit);
-        worker.m_curJobProvider = this;
-        SLEEPBITMAP_OR(&worker.m_curJobProvider->m_ownerBitmap, bit);
+        int victim = (m_id + i) % m_pool.m_numWorkers;
+        jp = m_pool.m_workers[victim].m_queue.stealFront();
+        if (jp)
+            return jp;
     }
-    worker.awaken();
+
+    /* highest priority (lowest slice type) provider still asking for help */
+    int bestPriority = INVALID_SLICE_PRIORITY + 1;
+    for (int i = 0; i < m_pool.m_numProviders; i++)
+    {
+        JobProvider* cand = m_pool.m_jpTable[i];
+        if (cand->m_helpWanted && cand->m_sliceType < bestPriority)
+        {
+            jp = cand;
+            bestPriority = cand->m_sliceType;
+        }
+    }
+    return jp;
 }
 
-int ThreadPool::tryAcquireSleepingThread(sleepbitmap_t firstTryBitmap, sleepbitmap_t secondTryBitmap)
+/* whether findStealJob() would find work, without taking it */
+bool WorkerThread::hasStealJob() const
 {
-    unsigned long id;
+    for (int i = 0; i < m_pool.m_numWorkers; i++)
+        if (m_pool.m_workers[i].m_queue.m_count)
+            return true;
 
-    sleepbitmap_t masked = m_sleepBitmap & firstTryBitmap;
-    while (masked)
-    {
-        SLEEPBITMAP_CTZ(id, masked);
+    for (int i = 0; i < m_pool.m_numProviders; i++)
+        if (m_pool.m_jpTable[i]->m_helpWanted)
+            return true;
 
-        sleepbitmap_t bit = (sleepbitmap_t)1 << id;
-        if (SLEEPBITMAP_AND(&m_sleepBitmap, ~bit) & bit)
-            return (int)id;
+    return false;
+}
 
-        masked = m_sleepBitmap & firstTryBitmap;
+void JobProvider::tryWakeOne(int workerHint)
+{
+    if (m_pool->m_bWorkStealing)
+    {
+        m_pool->pushAndWake(*this, workerHint >= 0 ? workerHint : m_lastWorkerId);
+        return;
     }
 
-    masked = m_sleepBitmap & secondTryBitmap;
-    while (masked)
+    int id = m_pool->tryAcquireSleepingThread(&m_ownerBitmap, true);
+    if (id < 0)
     {
-        SLEEPBITMAP_CTZ(id, masked);
-
-        sleepbitmap_t bit = (sleepbitmap_t)1 << id;
-        if (SLEEPBITMAP_AND(&m_sleepBitmap, ~bit) & bit)
-            return (int)id;
+        m_helpWanted = true;
+        return;
+    }
 
-        masked = m_sleepBitmap & secondTryBitmap;
+    WorkerThread& worker = m_pool->m_workers[id];
+    if (worker.m_curJobProvider != this) /* poaching */
+    {
+        worker.m_curJobProvider->m_ownerBitmap.clear(id);
+        worker.m_curJobProvider = this;
+        worker.m_curJobProvider->m_ownerBitmap.set(id);
     }
+    worker.awaken();
+}
 
-    return -1;
+int ThreadPool::tryAcquireSleepingThread(const SleepBitmap* firstTryBitmap, bool bTryAnyThread)
+{
+    int id = firstTryBitmap ? m_sleepBitmap.acquire(firstTryBitmap) : -1;
+    if (id < 0 && bTryAnyThread)
+        id = m_sleepBitmap.acquire(NULL);
+    return id;
 }
 
-int ThreadPool::tryBondPeers(int maxPeers, sleepbitmap_t peerBitmap, BondedTaskGroup& master)
+int ThreadPool::tryBondPeers(int maxPeers, const SleepBitmap* peerBitmap, BondedTaskGroup& master, JobProvider* owner)
 {
     int bondCount = 0;
     do
     {
-        int id = tryAcquireSleepingThread(peerBitmap, 0);
+        int id = m_bWorkStealing ? tryAcquireIdleWorker(-1, owner) : tryAcquireSleepingThread(peerBitmap, true);
         if (id < 0)
             return bondCount;
 
@@ -247,6 +458,66 @@ int ThreadPool::tryBondPeers(int maxPeers, sleepbitmap_t peerBitmap, BondedTaskG
 
     return bondCount;
 }
+
+/* Claim an idle worker in work-stealing mode. The preferred worker is tried
+ * first, then idle workers which last served the given provider, then any idle
+ * worker. Returns -1 if no worker could be acquired */
+int ThreadPool::tryAcquireIdleWorker(int preferredId, JobProvider* owner)
+{
+    if (!m_numSleeping)
+        return -1;
+
+    if (preferredId >= 0 && preferredId < m_numWorkers && m_workers[preferredId].tryAcquire())
+    {
+        ATOMIC_DEC(&m_numSleeping);
+        return preferredId;
+    }
+
+    int start = (m_scanStart++ & 0x7fffffff) % m_numWorkers; // races are harmless, it is only a hint
+    for (int pass = owner ? 0 : 1; pass < 2; pass++)
+    {
+        for (int i = 0; i < m_numWorkers; i++)
+        {
+            int id = (start + i) % m_numWorkers;
+            if (!pass && m_workers[id].m_curJobProvider != owner)
+                continue;
+            if (m_workers[id].tryAcquire())
+            {
+                ATOMIC_DEC(&m_numSleeping);
+                return id;
+            }
+        }
+    }
+
+    return -1;
+}
+
+void ThreadPool::pushAndWake(JobProvider& jp, int preferredId)
+{
+    if (preferredId < 0 || preferredId >= m_numWorkers)
+        preferredId = (m_scanStart++ & 0x7fffffff) % m_numWorkers;
+
+    /* The provider is queued before looking for an idle worker; a worker going
+     * idle sets its idle flag before checking its deque one last time, so the
+     * work can not be missed by both sides. If the preferred worker is busy,
+     * whichever worker we wake will steal the provider from its deque */
+    if (!m_workers[preferredId].m_queue.push(&jp))
+        jp.m_helpWanted = true;
+
+    int id = tryAcquireIdleWorker(preferredId, &jp);
+    if (id >= 0)
+        m_workers[id].awaken();
+    else
+        jp.m_helpWanted = true;
+}
+
+bool ThreadPool::isWorkerIdle(int id) const
+{
+    if (m_bWorkStealing)
+        return !!m_workers[id].m_sleeping;
+    return m_sleepBitmap.test(id);
+}
+
 ThreadPool* ThreadPool::allocThreadPools(x265_param* p, int& numPools, bool isThreadsReserved)
 {
     enum { MAX_NODE_NUM = 127 };
@@ -261,6 +532,7 @@ ThreadPool* ThreadPool::allocThreadPools(x265_param* p, int& numPools, bool isTh
 
     int numNumaNodes = X265_MIN(getNumaNodeCount(), MAX_NODE_NUM);
     bool bNumaSupport = false;
+    bool bWorkStealing = p->poolMode == X265_POOL_STEAL;
 
 #if defined(_WIN32_WINNT) && _WIN32_WINNT >= _WIN32_WINNT_WIN7 
     bNumaSupport = true;
@@ -440,7 +712,7 @@ ThreadPool* ThreadPool::allocThreadPools(x265_param* p, int& numPools, bool isTh
 
             else if (i == 0)
                 numThreads -= p->lookaheadThreads;
-            if (!pools[i].create(numThreads, maxProviders, nodeMaskPerPool[node]))
+            if (!pools[i].create(numThreads, maxProviders, nodeMaskPerPool[node], bWorkStealing))
             {
                 X265_FREE(pools);
                 numPools = 0;
@@ -457,7 +729,8 @@ ThreadPool* ThreadPool::allocThreadPools(x265_param* p, int& numPools, bool isTh
                 delete[] nodesstr;
             }
             else
-                x265_log(p, X265_LOG_INFO, "Thread pool created using %d threads\n", numThreads);
+                x265_log(p, X265_LOG_INFO, "Thread pool created using %d threads%s\n", numThreads,
+                         bWorkStealing ? " (work-stealing)" : "");
             threadsPerPool[node] -= origNumThreads;
         }
     }
@@ -471,10 +744,23 @@ ThreadPool::ThreadPool()
     memset(this, 0, sizeof(*this));
 }
 
-bool ThreadPool::create(int numThreads, int maxProviders, uint64_t nodeMask)
+bool ThreadPool::create(int numThreads, int maxProviders, uint64_t nodeMask, bool bWorkStealing)
 {
     X265_CHECK(numThreads <= MAX_POOL_THREADS, "a single thread pool cannot have more than MAX_POOL_THREADS threads\n");
 
+    m_bWorkStealing = bWorkStealing;
+
+    /* buffers owned by a pool bound to exactly one node are allocated there */
+    m_numaNode = -1;
+#if HAVE_LIBNUMA
+    if (nodeMask && !(nodeMask & (nodeMask - 1)) && numa_available() >= 0 && getNumaNodeCount() > 1)
+    {
+        m_numaNode = 0;
+        while (!((nodeMask >> m_numaNode) & 1))
+            m_numaNode++;
+    }
+#endif
+
 #if defined(_WIN32_WINNT) && _WIN32_WINNT >= _WIN32_WINNT_WIN7 
     memset(&m_groupAffinity, 0, sizeof(GROUP_AFFINITY));
     for (int i = 0; i < getNumaNodeCount(); i++)
@@ -536,7 +822,7 @@ void ThreadPool::stopWorkers()
         m_isActive = false;
         for (int i = 0; i < m_numWorkers; i++)
         {
-            while (!(m_sleepBitmap & ((sleepbitmap_t)1 << i)))
+            while (!isWorkerIdle(i))
                 GIVE_UP_TIME();
             m_workers[i].awaken();
             m_workers[i].stop();
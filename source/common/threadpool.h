@@ -40,10 +40,34 @@ typedef uint64_t sleepbitmap_t;
 typedef uint32_t sleepbitmap_t;
 #endif
 
-static const sleepbitmap_t ALL_POOL_THREADS = (sleepbitmap_t)-1;
-enum { MAX_POOL_THREADS = sizeof(sleepbitmap_t) * 8 };
+enum { SLEEPBITMAP_WORD_BITS = sizeof(sleepbitmap_t) * 8 };
+enum { MAX_POOL_THREADS = 256 };
+enum { SLEEPBITMAP_WORDS = MAX_POOL_THREADS / SLEEPBITMAP_WORD_BITS };
 enum { INVALID_SLICE_PRIORITY = 10 }; // a value larger than any X265_TYPE_* macro
 
+/* Two level bitmap of worker thread IDs, used to track sleeping workers and
+ * the workers owned by each job provider. Each word holds the bits of
+ * SLEEPBITMAP_WORD_BITS workers and m_summary has one bit per word which may
+ * be non-zero, so scans skip empty words. All updates are lock-free atomic
+ * operations; the summary is only a hint which is repaired by the thread that
+ * clears the last bit of a word. Plain data, zero-initialized by its owner */
+struct SleepBitmap
+{
+    volatile sleepbitmap_t m_summary;
+    volatile sleepbitmap_t m_words[SLEEPBITMAP_WORDS];
+
+    void set(int id);
+    void clear(int id);
+    bool test(int id) const
+    {
+        return !!(m_words[id / SLEEPBITMAP_WORD_BITS] & ((sleepbitmap_t)1 << (id % SLEEPBITMAP_WORD_BITS)));
+    }
+
+    /* Atomically clear and return the lowest bit which is also set in mask (any
+     * set bit if mask is NULL). Returns -1 if no such bit could be claimed */
+    int  acquire(const SleepBitmap* mask);
+};
+
 // Frame level job providers. FrameEncoder and Lookahead derive from
 // this class and implement findJob()
 class JobProvider
@@ -51,20 +75,23 @@ class JobProvider
 public:
 
     ThreadPool*   m_pool;
-    sleepbitmap_t m_ownerBitmap;
+    SleepBitmap   m_ownerBitmap;
     int           m_jpId;
     int           m_sliceType;
+    int           m_lastWorkerId;   /* work-stealing mode affinity, in place of m_ownerBitmap */
     bool          m_helpWanted;
     bool          m_isFrameEncoder; /* rather ugly hack, but nothing better presents itself */
 
     JobProvider()
         : m_pool(NULL)
-        , m_ownerBitmap(0)
         , m_jpId(-1)
         , m_sliceType(INVALID_SLICE_PRIORITY)
+        , m_lastWorkerId(-1)
         , m_helpWanted(false)
         , m_isFrameEncoder(false)
-    {}
+    {
+        memset((void*)&m_ownerBitmap, 0, sizeof(m_ownerBitmap));
+    }
 
     virtual ~JobProvider() {}
 
@@ -72,22 +99,27 @@ public:
     virtual void findJob(int workerThreadId) = 0;
 
     // Will awaken one idle thread, preferring a thread which most recently
-    // performed work for this provider.
-    void tryWakeOne();
+    // performed work for this provider. In work-stealing mode workerHint may
+    // name the worker which should preferably pick up the work.
+    void tryWakeOne(int workerHint = -1);
 };
 
 class ThreadPool
 {
 public:
 
-    sleepbitmap_t m_sleepBitmap;
+    SleepBitmap   m_sleepBitmap;
     int           m_numProviders;
     int           m_numWorkers;
     void*         m_numaMask; // node mask in linux, cpu mask in windows
+    int           m_numaNode; // node of a single-node pool, -1 if the pool spans nodes
 #if defined(_WIN32_WINNT) && _WIN32_WINNT >= _WIN32_WINNT_WIN7 
     GROUP_AFFINITY m_groupAffinity;
 #endif
     bool          m_isActive;
+    bool          m_bWorkStealing;
+    volatile int32_t m_numSleeping; // idle worker count, work-stealing mode only
+    int           m_scanStart;      // rotates the starting point of idle worker scans
 
     JobProvider** m_jpTable;
     WorkerThread* m_workers;
@@ -95,13 +127,18 @@ public:
     ThreadPool();
     ~ThreadPool();
 
-    bool create(int numThreads, int maxProviders, uint64_t nodeMask);
+    bool create(int numThreads, int maxProviders, uint64_t nodeMask, bool bWorkStealing = false);
     bool start();
     void stopWorkers();
     void setCurrentThreadAffinity();
     void setThreadNodeAffinity(void *numaMask);
-    int  tryAcquireSleepingThread(sleepbitmap_t firstTryBitmap, sleepbitmap_t secondTryBitmap);
-    int  tryBondPeers(int maxPeers, sleepbitmap_t peerBitmap, BondedTaskGroup& master);
+    int  tryAcquireSleepingThread(const SleepBitmap* firstTryBitmap, bool bTryAnyThread);
+    int  tryBondPeers(int maxPeers, const SleepBitmap* peerBitmap, BondedTaskGroup& master, JobProvider* owner = NULL);
+
+    /* work-stealing mode */
+    int  tryAcquireIdleWorker(int preferredId, JobProvider* owner);
+    void pushAndWake(JobProvider& jp, int preferredId);
+    bool isWorkerIdle(int id) const;
     static ThreadPool* allocThreadPools(x265_param* p, int& numPools, bool isThreadsReserved);
     static int  getCpuCount();
     static int  getNumaNodeCount();
@@ -134,12 +171,13 @@ public:
      * exited processTasks() */
     ~BondedTaskGroup() { waitForExit(); }
 
-    /* Try to enlist the help of idle worker threads on most recently associated
-     * with the given job provider and "bond" them to work on your tasks. Up to
-     * maxPeers worker threads will call your processTasks() method. */
+    /* Try to enlist the help of idle worker threads most recently associated
+     * with the given job provider, then of any idle worker thread of its pool,
+     * and "bond" them to work on your tasks. Up to maxPeers worker threads
+     * will call your processTasks() method. */
     int tryBondPeers(JobProvider& jp, int maxPeers)
     {
-        int count = jp.m_pool->tryBondPeers(maxPeers, jp.m_ownerBitmap, *this);
+        int count = jp.m_pool->tryBondPeers(maxPeers, &jp.m_ownerBitmap, *this, &jp);
         m_bondedPeerCount += count;
         return count;
     }
@@ -149,7 +187,7 @@ public:
      * processTasks() method. */
     int tryBondPeers(ThreadPool& pool, int maxPeers)
     {
-        int count = pool.tryBondPeers(maxPeers, ALL_POOL_THREADS, *this);
+        int count = pool.tryBondPeers(maxPeers, NULL, *this);
         m_bondedPeerCount += count;
         return count;
     }
@@ -0,0 +1,377 @@
+/*****************************************************************************
+ * Copyright (C) 2013-2020 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+
+#include "common.h"
+#include "primitives.h"
+#include <immintrin.h> // AVX2
+
+using namespace X265_NS;
+
+namespace {
+
+/* The vector angle is within 1e-4 degrees of the C reference, lanes closer
+ * than this to a whole degree are recomputed with edgeThetaDegrees() */
+#define THETA_EPSILON 1e-3f
+
+static inline int gaussianPixel(const pixel* s0, const pixel* s1, const pixel* s2, const pixel* s3, const pixel* s4, int x)
+{
+    int sum = 2 * (s0[x - 2] + s0[x + 2] + s4[x - 2] + s4[x + 2]) +
+              4 * (s0[x - 1] + s0[x + 1] + s4[x - 1] + s4[x + 1] + s1[x - 2] + s1[x + 2] + s3[x - 2] + s3[x + 2]) +
+              5 * (s0[x] + s4[x] + s2[x - 2] + s2[x + 2]) +
+              9 * (s1[x - 1] + s1[x + 1] + s3[x - 1] + s3[x + 1]) +
+              12 * (s1[x] + s3[x] + s2[x - 1] + s2[x + 1]) +
+              15 * s2[x];
+    return sum / 159;
+}
+
+/* 8 pixels widened to 32 bits */
+static inline __m256i load8(const pixel* p)
+{
+#if HIGH_BIT_DEPTH
+    return _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)p));
+#else
+    return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)p));
+#endif
+}
+
+/* store 8 32-bit lanes which are within pixel range */
+static inline void store8(pixel* p, __m256i v)
+{
+    __m128i w = _mm_packus_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+#if HIGH_BIT_DEPTH
+    _mm_storeu_si128((__m128i*)p, w);
+#else
+    _mm_storel_epi64((__m128i*)p, _mm_packus_epi16(w, w));
+#endif
+}
+
+#if HIGH_BIT_DEPTH
+static void edgeGaussian_avx2(pixel* dst, const pixel* src, intptr_t stride, int width, int height)
+{
+    const __m256 divisor = _mm256_set1_ps(159.0f);
+
+    for (int y = 2; y < height - 2; y++)
+    {
+        const pixel* s0 = src + (y - 2) * stride;
+        const pixel* s1 = s0 + stride;
+        const pixel* s2 = s1 + stride;
+        const pixel* s3 = s2 + stride;
+        const pixel* s4 = s3 + stride;
+        pixel* d = dst + y * stride;
+
+        int x = 2;
+        for (; x + 8 <= width - 2; x += 8)
+        {
+            __m256i outerA = _mm256_add_epi32(_mm256_add_epi32(load8(s0 + x - 2), load8(s0 + x + 2)), _mm256_add_epi32(load8(s4 + x - 2), load8(s4 + x + 2)));
+            __m256i innerA = _mm256_add_epi32(_mm256_add_epi32(load8(s0 + x - 1), load8(s0 + x + 1)), _mm256_add_epi32(load8(s4 + x - 1), load8(s4 + x + 1)));
+            __m256i midA   = _mm256_add_epi32(load8(s0 + x), load8(s4 + x));
+            __m256i outerB = _mm256_add_epi32(_mm256_add_epi32(load8(s1 + x - 2), load8(s1 + x + 2)), _mm256_add_epi32(load8(s3 + x - 2), load8(s3 + x + 2)));
+            __m256i innerB = _mm256_add_epi32(_mm256_add_epi32(load8(s1 + x - 1), load8(s1 + x + 1)), _mm256_add_epi32(load8(s3 + x - 1), load8(s3 + x + 1)));
+            __m256i midB   = _mm256_add_epi32(load8(s1 + x), load8(s3 + x));
+            __m256i outerC = _mm256_add_epi32(load8(s2 + x - 2), load8(s2 + x + 2));
+            __m256i innerC = _mm256_add_epi32(load8(s2 + x - 1), load8(s2 + x + 1));
+            __m256i midC   = load8(s2 + x);
+
+            __m256i sum = _mm256_slli_epi32(outerA, 1);
+            sum = _mm256_add_epi32(sum, _mm256_slli_epi32(_mm256_add_epi32(innerA, outerB), 2));
+            sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(_mm256_add_epi32(midA, outerC), _mm256_set1_epi32(5)));
+            sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(innerB, _mm256_set1_epi32(9)));
+            sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(_mm256_add_epi32(midB, innerC), _mm256_set1_epi32(12)));
+            sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(midC, _mm256_set1_epi32(15)));
+
+            /* the float quotient may be one off either way, fix it up */
+            __m256i q = _mm256_cvttps_epi32(_mm256_div_ps(_mm256_cvtepi32_ps(sum), divisor));
+            __m256i r = _mm256_sub_epi32(sum, _mm256_mullo_epi32(q, _mm256_set1_epi32(159)));
+            q = _mm256_add_epi32(q, _mm256_srai_epi32(r, 31));
+            q = _mm256_sub_epi32(q, _mm256_cmpgt_epi32(r, _mm256_set1_epi32(158)));
+            store8(d + x, q);
+        }
+
+        for (; x < width - 2; x++)
+            d[x] = (pixel)gaussianPixel(s0, s1, s2, s3, s4, x);
+    }
+}
+#else
+/* 16 pixels widened to 16 bits */
+static inline __m256i load16(const pixel* p)
+{
+    return _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)p));
+}
+
+static void edgeGaussian_avx2(pixel* dst, const pixel* src, intptr_t stride, int width, int height)
+{
+    /* the sums fit 16 unsigned bits and x / 159 == (x * 52759) >> 23 for all
+     * of them */
+    const __m256i magic = _mm256_set1_epi16((int16_t)52759);
+
+    for (int y = 2; y < height - 2; y++)
+    {
+        const pixel* s0 = src + (y - 2) * stride;
+        const pixel* s1 = s0 + stride;
+        const pixel* s2 = s1 + stride;
+        const pixel* s3 = s2 + stride;
+        const pixel* s4 = s3 + stride;
+        pixel* d = dst + y * stride;
+
+        int x = 2;
+        for (; x + 16 <= width - 2; x += 16)
+        {
+            __m256i outerA = _mm256_add_epi16(_mm256_add_epi16(load16(s0 + x - 2), load16(s0 + x + 2)), _mm256_add_epi16(load16(s4 + x - 2), load16(s4 + x + 2)));
+            __m256i innerA = _mm256_add_epi16(_mm256_add_epi16(load16(s0 + x - 1), load16(s0 + x + 1)), _mm256_add_epi16(load16(s4 + x - 1), load16(s4 + x + 1)));
+            __m256i midA   = _mm256_add_epi16(load16(s0 + x), load16(s4 + x));
+            __m256i outerB = _mm256_add_epi16(_mm256_add_epi16(load16(s1 + x - 2), load16(s1 + x + 2)), _mm256_add_epi16(load16(s3 + x - 2), load16(s3 + x + 2)));
+            __m256i innerB = _mm256_add_epi16(_mm256_add_epi16(load16(s1 + x - 1), load16(s1 + x + 1)), _mm256_add_epi16(load16(s3 + x - 1), load16(s3 + x + 1)));
+            __m256i midB   = _mm256_add_epi16(load16(s1 + x), load16(s3 + x));
+            __m256i outerC = _mm256_add_epi16(load16(s2 + x - 2), load16(s2 + x + 2));
+            __m256i innerC = _mm256_add_epi16(load16(s2 + x - 1), load16(s2 + x + 1));
+            __m256i midC   = load16(s2 + x);
+
+            __m256i sum = _mm256_slli_epi16(outerA, 1);
+            sum = _mm256_add_epi16(sum, _mm256_slli_epi16(_mm256_add_epi16(innerA, outerB), 2));
+            sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(_mm256_add_epi16(midA, outerC), _mm256_set1_epi16(5)));
+            sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(innerB, _mm256_set1_epi16(9)));
+            sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(_mm256_add_epi16(midB, innerC), _mm256_set1_epi16(12)));
+            sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(midC, _mm256_set1_epi16(15)));
+
+            __m256i q = _mm256_srli_epi16(_mm256_mulhi_epu16(sum, magic), 7);
+            _mm_storeu_si128((__m128i*)(d + x), _mm_packus_epi16(_mm256_castsi256_si128(q), _mm256_extracti128_si256(q, 1)));
+        }
+
+        for (; x < width - 2; x++)
+            d[x] = (pixel)gaussianPixel(s0, s1, s2, s3, s4, x);
+    }
+}
+#endif // if HIGH_BIT_DEPTH
+
+/* Gradient angles in whole degrees [0, 180]: the first octant angle of
+ * (|gH|, |gV|) with the Cephes atanf range reduction and polynomial, then
+ * reflected into place */
+static inline void sobelTheta8(pixel* theta, __m256i gh, __m256i gv, __m256 fh, __m256 fv)
+{
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 zero = _mm256_setzero_ps();
+
+    __m256 ax = _mm256_andnot_ps(signMask, fh);
+    __m256 ay = _mm256_andnot_ps(signMask, fv);
+    __m256 lo = _mm256_min_ps(ax, ay);
+    __m256 hi = _mm256_max_ps(ax, ay);
+    __m256 t = _mm256_div_ps(lo, _mm256_max_ps(hi, one)); // gradients are whole numbers
+
+    /* atan(t) = pi/4 + atan((t - 1) / (t + 1)) for t > tan(pi/8) */
+    __m256 big = _mm256_cmp_ps(t, _mm256_set1_ps(0.414213562373095f), _CMP_GT_OQ);
+    t = _mm256_blendv_ps(t, _mm256_div_ps(_mm256_sub_ps(t, one), _mm256_add_ps(t, one)), big);
+    __m256 z = _mm256_mul_ps(t, t);
+    __m256 p = _mm256_set1_ps(8.05374449538e-2f);
+    p = _mm256_sub_ps(_mm256_mul_ps(p, z), _mm256_set1_ps(1.38776856032e-1f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, z), _mm256_set1_ps(1.99777106478e-1f));
+    p = _mm256_sub_ps(_mm256_mul_ps(p, z), _mm256_set1_ps(3.33329491539e-1f));
+    p = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(p, z), t), t);
+
+    __m256 deg = _mm256_add_ps(_mm256_and_ps(big, _mm256_set1_ps(45.0f)), _mm256_mul_ps(p, _mm256_set1_ps((float)(180 / PI))));
+    deg = _mm256_blendv_ps(deg, _mm256_sub_ps(_mm256_set1_ps(90.0f), deg), _mm256_cmp_ps(ay, ax, _CMP_GT_OQ));
+    deg = _mm256_blendv_ps(deg, _mm256_sub_ps(_mm256_set1_ps(180.0f), deg), _mm256_cmp_ps(fh, zero, _CMP_LT_OQ));
+    deg = _mm256_blendv_ps(deg, _mm256_sub_ps(_mm256_set1_ps(180.0f), deg), _mm256_cmp_ps(fv, zero, _CMP_LT_OQ));
+
+    /* gradients along an axis or a diagonal have whole angles, which the
+     * reassociated float math above may miss by an ulp */
+    __m256i absH = _mm256_abs_epi32(gh);
+    __m256i absV = _mm256_abs_epi32(gv);
+    __m256i axisV = _mm256_cmpeq_epi32(gv, _mm256_setzero_si256());
+    __m256i axisH = _mm256_cmpeq_epi32(gh, _mm256_setzero_si256());
+    __m256i diagonal = _mm256_cmpeq_epi32(absH, absV);
+    __m256i exact = _mm256_or_si256(_mm256_or_si256(axisV, axisH), diagonal);
+    __m256 axisAngle = _mm256_blendv_ps(_mm256_and_ps(_mm256_cmp_ps(fh, zero, _CMP_LT_OQ), _mm256_set1_ps(180.0f)),
+                                        _mm256_set1_ps(90.0f), _mm256_castsi256_ps(_mm256_andnot_si256(axisV, axisH)));
+    __m256 diagonalAngle = _mm256_blendv_ps(_mm256_set1_ps(45.0f), _mm256_set1_ps(135.0f), _mm256_xor_ps(fh, fv));
+    __m256 exactAngle = _mm256_blendv_ps(diagonalAngle, axisAngle, _mm256_castsi256_ps(_mm256_or_si256(axisV, axisH)));
+    deg = _mm256_blendv_ps(deg, exactAngle, _mm256_castsi256_ps(exact));
+
+    store8(theta, _mm256_cvttps_epi32(deg));
+
+    /* every other nearly whole angle is left to the reference */
+    __m256 frac = _mm256_andnot_ps(signMask, _mm256_sub_ps(deg, _mm256_round_ps(deg, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)));
+    __m256 redo = _mm256_andnot_ps(_mm256_castsi256_ps(exact), _mm256_cmp_ps(frac, _mm256_set1_ps(THETA_EPSILON), _CMP_LT_OQ));
+    int mask = _mm256_movemask_ps(redo);
+    if (mask)
+    {
+        ALIGN_VAR_32(int32_t, h[8]);
+        ALIGN_VAR_32(int32_t, v[8]);
+        _mm256_store_si256((__m256i*)h, gh);
+        _mm256_store_si256((__m256i*)v, gv);
+        for (int i = 0; i < 8; i++)
+            if (mask & (1 << i))
+                theta[i] = edgeThetaDegrees(h[i], v[i]);
+    }
+}
+
+static void edgeSobel_avx2(pixel* edge, pixel* theta, const pixel* src, intptr_t stride, int width, int height, pixel whitePixel)
+{
+    /* the float magnitude may round above 2^24, but never across the threshold */
+    const __m256 threshold = _mm256_set1_ps((float)(EDGE_THRESHOLD * EDGE_THRESHOLD));
+    const __m256i white = _mm256_set1_epi32(whitePixel);
+    const __m256i three = _mm256_set1_epi32(3);
+    const __m256i ten = _mm256_set1_epi32(10);
+
+    for (int y = 1; y < height - 1; y++)
+    {
+        const pixel* s0 = src + (y - 1) * stride;
+        const pixel* s1 = s0 + stride;
+        const pixel* s2 = s1 + stride;
+
+        int x = 1;
+        for (; x + 8 <= width - 1; x += 8)
+        {
+            __m256i tl = load8(s0 + x - 1), tc = load8(s0 + x), tr = load8(s0 + x + 1);
+            __m256i ml = load8(s1 + x - 1), mr = load8(s1 + x + 1);
+            __m256i bl = load8(s2 + x - 1), bc = load8(s2 + x), br = load8(s2 + x + 1);
+
+            __m256i gh = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_add_epi32(_mm256_sub_epi32(tr, tl), _mm256_sub_epi32(br, bl)), three),
+                                          _mm256_mullo_epi32(_mm256_sub_epi32(mr, ml), ten));
+            __m256i gv = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_add_epi32(_mm256_sub_epi32(bl, tl), _mm256_sub_epi32(br, tr)), three),
+                                          _mm256_mullo_epi32(_mm256_sub_epi32(bc, tc), ten));
+            __m256 fh = _mm256_cvtepi32_ps(gh);
+            __m256 fv = _mm256_cvtepi32_ps(gv);
+            __m256 magnitude = _mm256_add_ps(_mm256_mul_ps(fh, fh), _mm256_mul_ps(fv, fv));
+
+            __m256i isEdge = _mm256_castps_si256(_mm256_cmp_ps(magnitude, threshold, _CMP_GE_OQ));
+            store8(edge + y * stride + x, _mm256_and_si256(isEdge, white));
+            if (theta)
+                sobelTheta8(theta + y * stride + x, gh, gv, fh, fv);
+        }
+
+        for (; x < width - 1; x++)
+        {
+            int gradientH = 3 * (s0[x + 1] - s0[x - 1]) + 10 * (s1[x + 1] - s1[x - 1]) + 3 * (s2[x + 1] - s2[x - 1]);
+            int gradientV = 3 * (s2[x - 1] - s0[x - 1]) + 10 * (s2[x] - s0[x]) + 3 * (s2[x + 1] - s0[x + 1]);
+            int64_t magnitude = (int64_t)gradientH * gradientH + (int64_t)gradientV * gradientV;
+
+            if (theta)
+                theta[y * stride + x] = edgeThetaDegrees(gradientH, gradientV);
+            edge[y * stride + x] = magnitude >= (int64_t)(EDGE_THRESHOLD * EDGE_THRESHOLD) ? whitePixel : 0;
+        }
+    }
+}
+
+/* The sums are vectorized, the bins are counted in four interleaved tables
+ * so runs of equal pixels do not serialize on one counter */
+static void intensityHistogram_avx2(const pixel* src, intptr_t stride, int width, int height, int dsFactor, uint32_t* histogram, uint64_t* sum)
+{
+    const int shift = X265_DEPTH - 8;
+    uint64_t total = 0;
+
+    if (dsFactor != 1 && dsFactor != 4)
+    {
+        for (int y = 0; y < height; y += dsFactor)
+        {
+            for (int x = 0; x < width; x += dsFactor)
+            {
+                histogram[src[x] >> shift]++;
+                total += src[x];
+            }
+            src += stride * dsFactor;
+        }
+        *sum = total;
+        return;
+    }
+
+    ALIGN_VAR_32(uint32_t, bins[4][256]);
+    if (dsFactor == 1)
+        memset(bins, 0, sizeof(bins));
+
+    __m256i acc = _mm256_setzero_si256();
+#if HIGH_BIT_DEPTH
+    const __m256i ones = _mm256_set1_epi16(1);
+    const __m256i sampleMask = dsFactor == 1 ? _mm256_set1_epi16(-1) : _mm256_set1_epi64x(0xFFFF);
+#else
+    const __m256i sampleMask = dsFactor == 1 ? _mm256_set1_epi8(-1) : _mm256_set1_epi32(0xFF);
+#endif
+    const int step = 32 / sizeof(pixel);
+
+    for (int y = 0; y < height; y += dsFactor)
+    {
+        int x = 0;
+#if HIGH_BIT_DEPTH
+        __m256i rowAcc = _mm256_setzero_si256();
+        for (; x + step <= width; x += step)
+        {
+            __m256i v = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(src + x)), sampleMask);
+            rowAcc = _mm256_add_epi32(rowAcc, _mm256_madd_epi16(v, ones));
+        }
+        acc = _mm256_add_epi64(acc, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(rowAcc)));
+        acc = _mm256_add_epi64(acc, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(rowAcc, 1)));
+#else
+        for (; x + step <= width; x += step)
+        {
+            __m256i v = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(src + x)), sampleMask);
+            acc = _mm256_add_epi64(acc, _mm256_sad_epu8(v, _mm256_setzero_si256()));
+        }
+#endif
+        for (; x < width; x += dsFactor)
+            total += src[x];
+
+        if (dsFactor == 1)
+        {
+            x = 0;
+            for (; x + 4 <= width; x += 4)
+            {
+                bins[0][src[x] >> shift]++;
+                bins[1][src[x + 1] >> shift]++;
+                bins[2][src[x + 2] >> shift]++;
+                bins[3][src[x + 3] >> shift]++;
+            }
+            for (; x < width; x++)
+                bins[0][src[x] >> shift]++;
+        }
+        else
+        {
+            for (x = 0; x < width; x += dsFactor)
+                histogram[src[x] >> shift]++;
+        }
+        src += stride * dsFactor;
+    }
+
+    if (dsFactor == 1)
+    {
+        for (int i = 0; i < 256; i += 8)
+        {
+            __m256i h = _mm256_loadu_si256((const __m256i*)(histogram + i));
+            h = _mm256_add_epi32(h, _mm256_add_epi32(_mm256_load_si256((const __m256i*)(bins[0] + i)), _mm256_load_si256((const __m256i*)(bins[1] + i))));
+            h = _mm256_add_epi32(h, _mm256_add_epi32(_mm256_load_si256((const __m256i*)(bins[2] + i)), _mm256_load_si256((const __m256i*)(bins[3] + i))));
+            _mm256_storeu_si256((__m256i*)(histogram + i), h);
+        }
+    }
+
+    __m128i s = _mm_add_epi64(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    s = _mm_add_epi64(s, _mm_unpackhi_epi64(s, s));
+    *sum = total + (uint64_t)_mm_cvtsi128_si64(s);
+}
+
+}
+
+namespace X265_NS {
+void setupIntrinsicLookahead_avx2(EncoderPrimitives &p)
+{
+    p.edgeGaussian = edgeGaussian_avx2;
+    p.edgeSobel = edgeSobel_avx2;
+    p.intensityHistogram = intensityHistogram_avx2;
+}
+}
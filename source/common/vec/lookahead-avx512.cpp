@@ -0,0 +1,273 @@
+/*****************************************************************************
+ * Copyright (C) 2013-2020 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+
+#include "common.h"
+#include "primitives.h"
+#include <immintrin.h> // AVX-512 F, BW
+
+using namespace X265_NS;
+
+/* 512 bit versions of the edge filters in lookahead-avx2.cpp, the histogram
+ * is left to the AVX2 primitive */
+namespace {
+
+#define THETA_EPSILON 1e-3f
+
+static inline int gaussianPixel(const pixel* s0, const pixel* s1, const pixel* s2, const pixel* s3, const pixel* s4, int x)
+{
+    int sum = 2 * (s0[x - 2] + s0[x + 2] + s4[x - 2] + s4[x + 2]) +
+              4 * (s0[x - 1] + s0[x + 1] + s4[x - 1] + s4[x + 1] + s1[x - 2] + s1[x + 2] + s3[x - 2] + s3[x + 2]) +
+              5 * (s0[x] + s4[x] + s2[x - 2] + s2[x + 2]) +
+              9 * (s1[x - 1] + s1[x + 1] + s3[x - 1] + s3[x + 1]) +
+              12 * (s1[x] + s3[x] + s2[x - 1] + s2[x + 1]) +
+              15 * s2[x];
+    return sum / 159;
+}
+
+/* 16 pixels widened to 32 bits */
+static inline __m512i load16(const pixel* p)
+{
+#if HIGH_BIT_DEPTH
+    return _mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i*)p));
+#else
+    return _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i*)p));
+#endif
+}
+
+/* store 16 32-bit lanes which are within pixel range */
+static inline void store16(pixel* p, __m512i v)
+{
+#if HIGH_BIT_DEPTH
+    _mm256_storeu_si256((__m256i*)p, _mm512_cvtepi32_epi16(v));
+#else
+    _mm_storeu_si128((__m128i*)p, _mm512_cvtepi32_epi8(v));
+#endif
+}
+
+#if HIGH_BIT_DEPTH
+static void edgeGaussian_avx512(pixel* dst, const pixel* src, intptr_t stride, int width, int height)
+{
+    const __m512 divisor = _mm512_set1_ps(159.0f);
+
+    for (int y = 2; y < height - 2; y++)
+    {
+        const pixel* s0 = src + (y - 2) * stride;
+        const pixel* s1 = s0 + stride;
+        const pixel* s2 = s1 + stride;
+        const pixel* s3 = s2 + stride;
+        const pixel* s4 = s3 + stride;
+        pixel* d = dst + y * stride;
+
+        int x = 2;
+        for (; x + 16 <= width - 2; x += 16)
+        {
+            __m512i outerA = _mm512_add_epi32(_mm512_add_epi32(load16(s0 + x - 2), load16(s0 + x + 2)), _mm512_add_epi32(load16(s4 + x - 2), load16(s4 + x + 2)));
+            __m512i innerA = _mm512_add_epi32(_mm512_add_epi32(load16(s0 + x - 1), load16(s0 + x + 1)), _mm512_add_epi32(load16(s4 + x - 1), load16(s4 + x + 1)));
+            __m512i midA   = _mm512_add_epi32(load16(s0 + x), load16(s4 + x));
+            __m512i outerB = _mm512_add_epi32(_mm512_add_epi32(load16(s1 + x - 2), load16(s1 + x + 2)), _mm512_add_epi32(load16(s3 + x - 2), load16(s3 + x + 2)));
+            __m512i innerB = _mm512_add_epi32(_mm512_add_epi32(load16(s1 + x - 1), load16(s1 + x + 1)), _mm512_add_epi32(load16(s3 + x - 1), load16(s3 + x + 1)));
+            __m512i midB   = _mm512_add_epi32(load16(s1 + x), load16(s3 + x));
+            __m512i outerC = _mm512_add_epi32(load16(s2 + x - 2), load16(s2 + x + 2));
+            __m512i innerC = _mm512_add_epi32(load16(s2 + x - 1), load16(s2 + x + 1));
+            __m512i midC   = load16(s2 + x);
+
+            __m512i sum = _mm512_slli_epi32(outerA, 1);
+            sum = _mm512_add_epi32(sum, _mm512_slli_epi32(_mm512_add_epi32(innerA, outerB), 2));
+            sum = _mm512_add_epi32(sum, _mm512_mullo_epi32(_mm512_add_epi32(midA, outerC), _mm512_set1_epi32(5)));
+            sum = _mm512_add_epi32(sum, _mm512_mullo_epi32(innerB, _mm512_set1_epi32(9)));
+            sum = _mm512_add_epi32(sum, _mm512_mullo_epi32(_mm512_add_epi32(midB, innerC), _mm512_set1_epi32(12)));
+            sum = _mm512_add_epi32(sum, _mm512_mullo_epi32(midC, _mm512_set1_epi32(15)));
+
+            /* the float quotient may be one off either way, fix it up */
+            __m512i q = _mm512_cvttps_epi32(_mm512_div_ps(_mm512_cvtepi32_ps(sum), divisor));
+            __m512i r = _mm512_sub_epi32(sum, _mm512_mullo_epi32(q, _mm512_set1_epi32(159)));
+            q = _mm512_mask_sub_epi32(q, _mm512_cmplt_epi32_mask(r, _mm512_setzero_si512()), q, _mm512_set1_epi32(1));
+            q = _mm512_mask_add_epi32(q, _mm512_cmpgt_epi32_mask(r, _mm512_set1_epi32(158)), q, _mm512_set1_epi32(1));
+            store16(d + x, q);
+        }
+
+        for (; x < width - 2; x++)
+            d[x] = (pixel)gaussianPixel(s0, s1, s2, s3, s4, x);
+    }
+}
+#else
+/* 32 pixels widened to 16 bits */
+static inline __m512i load32(const pixel* p)
+{
+    return _mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i*)p));
+}
+
+static void edgeGaussian_avx512(pixel* dst, const pixel* src, intptr_t stride, int width, int height)
+{
+    const __m512i magic = _mm512_set1_epi16((int16_t)52759); // x / 159 == (x * 52759) >> 23
+
+    for (int y = 2; y < height - 2; y++)
+    {
+        const pixel* s0 = src + (y - 2) * stride;
+        const pixel* s1 = s0 + stride;
+        const pixel* s2 = s1 + stride;
+        const pixel* s3 = s2 + stride;
+        const pixel* s4 = s3 + stride;
+        pixel* d = dst + y * stride;
+
+        int x = 2;
+        for (; x + 32 <= width - 2; x += 32)
+        {
+            __m512i outerA = _mm512_add_epi16(_mm512_add_epi16(load32(s0 + x - 2), load32(s0 + x + 2)), _mm512_add_epi16(load32(s4 + x - 2), load32(s4 + x + 2)));
+            __m512i innerA = _mm512_add_epi16(_mm512_add_epi16(load32(s0 + x - 1), load32(s0 + x + 1)), _mm512_add_epi16(load32(s4 + x - 1), load32(s4 + x + 1)));
+            __m512i midA   = _mm512_add_epi16(load32(s0 + x), load32(s4 + x));
+            __m512i outerB = _mm512_add_epi16(_mm512_add_epi16(load32(s1 + x - 2), load32(s1 + x + 2)), _mm512_add_epi16(load32(s3 + x - 2), load32(s3 + x + 2)));
+            __m512i innerB = _mm512_add_epi16(_mm512_add_epi16(load32(s1 + x - 1), load32(s1 + x + 1)), _mm512_add_epi16(load32(s3 + x - 1), load32(s3 + x + 1)));
+            __m512i midB   = _mm512_add_epi16(load32(s1 + x), load32(s3 + x));
+            __m512i outerC = _mm512_add_epi16(load32(s2 + x - 2), load32(s2 + x + 2));
+            __m512i innerC = _mm512_add_epi16(load32(s2 + x - 1), load32(s2 + x + 1));
+            __m512i midC   = load32(s2 + x);
+
+            __m512i sum = _mm512_slli_epi16(outerA, 1);
+            sum = _mm512_add_epi16(sum, _mm512_slli_epi16(_mm512_add_epi16(innerA, outerB), 2));
+            sum = _mm512_add_epi16(sum, _mm512_mullo_epi16(_mm512_add_epi16(midA, outerC), _mm512_set1_epi16(5)));
+            sum = _mm512_add_epi16(sum, _mm512_mullo_epi16(innerB, _mm512_set1_epi16(9)));
+            sum = _mm512_add_epi16(sum, _mm512_mullo_epi16(_mm512_add_epi16(midB, innerC), _mm512_set1_epi16(12)));
+            sum = _mm512_add_epi16(sum, _mm512_mullo_epi16(midC, _mm512_set1_epi16(15)));
+
+            __m512i q = _mm512_srli_epi16(_mm512_mulhi_epu16(sum, magic), 7);
+            _mm256_storeu_si256((__m256i*)(d + x), _mm512_cvtepi16_epi8(q));
+        }
+
+        for (; x < width - 2; x++)
+            d[x] = (pixel)gaussianPixel(s0, s1, s2, s3, s4, x);
+    }
+}
+#endif // if HIGH_BIT_DEPTH
+
+static inline __m512 absf(__m512 v)
+{
+    return _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(v), _mm512_set1_epi32(0x7FFFFFFF)));
+}
+
+/* see sobelTheta8() in lookahead-avx2.cpp */
+static inline void sobelTheta16(pixel* theta, __m512i gh, __m512i gv, __m512 fh, __m512 fv)
+{
+    const __m512 one = _mm512_set1_ps(1.0f);
+    const __m512 zero = _mm512_setzero_ps();
+    const __m512i izero = _mm512_setzero_si512();
+
+    __m512 ax = absf(fh);
+    __m512 ay = absf(fv);
+    __m512 t = _mm512_div_ps(_mm512_min_ps(ax, ay), _mm512_max_ps(_mm512_max_ps(ax, ay), one));
+
+    __mmask16 big = _mm512_cmp_ps_mask(t, _mm512_set1_ps(0.414213562373095f), _CMP_GT_OQ);
+    t = _mm512_mask_div_ps(t, big, _mm512_sub_ps(t, one), _mm512_add_ps(t, one));
+    __m512 z = _mm512_mul_ps(t, t);
+    __m512 p = _mm512_set1_ps(8.05374449538e-2f);
+    p = _mm512_sub_ps(_mm512_mul_ps(p, z), _mm512_set1_ps(1.38776856032e-1f));
+    p = _mm512_add_ps(_mm512_mul_ps(p, z), _mm512_set1_ps(1.99777106478e-1f));
+    p = _mm512_sub_ps(_mm512_mul_ps(p, z), _mm512_set1_ps(3.33329491539e-1f));
+    p = _mm512_add_ps(_mm512_mul_ps(_mm512_mul_ps(p, z), t), t);
+
+    __m512 deg = _mm512_mul_ps(p, _mm512_set1_ps((float)(180 / PI)));
+    deg = _mm512_mask_add_ps(deg, big, deg, _mm512_set1_ps(45.0f));
+    deg = _mm512_mask_sub_ps(deg, _mm512_cmp_ps_mask(ay, ax, _CMP_GT_OQ), _mm512_set1_ps(90.0f), deg);
+    deg = _mm512_mask_sub_ps(deg, _mm512_cmp_ps_mask(fh, zero, _CMP_LT_OQ), _mm512_set1_ps(180.0f), deg);
+    deg = _mm512_mask_sub_ps(deg, _mm512_cmp_ps_mask(fv, zero, _CMP_LT_OQ), _mm512_set1_ps(180.0f), deg);
+
+    /* whole angles of the axes and diagonals */
+    __mmask16 axisV = _mm512_cmpeq_epi32_mask(gv, izero);
+    __mmask16 axisH = _mm512_cmpeq_epi32_mask(gh, izero);
+    __mmask16 diagonal = _mm512_cmpeq_epi32_mask(_mm512_abs_epi32(gh), _mm512_abs_epi32(gv));
+    __mmask16 oppositeSigns = _mm512_cmplt_epi32_mask(_mm512_xor_si512(gh, gv), izero);
+    deg = _mm512_mask_mov_ps(deg, diagonal, _mm512_mask_mov_ps(_mm512_set1_ps(45.0f), oppositeSigns, _mm512_set1_ps(135.0f)));
+    deg = _mm512_mask_mov_ps(deg, axisH, _mm512_set1_ps(90.0f));
+    deg = _mm512_mask_mov_ps(deg, axisV, _mm512_mask_mov_ps(zero, _mm512_cmplt_epi32_mask(gh, izero), _mm512_set1_ps(180.0f)));
+    __mmask16 exact = (__mmask16)(axisV | axisH | diagonal);
+
+    store16(theta, _mm512_cvttps_epi32(deg));
+
+    __m512 frac = absf(_mm512_sub_ps(deg, _mm512_roundscale_ps(deg, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)));
+    int mask = _mm512_mask_cmp_ps_mask((__mmask16)~exact, frac, _mm512_set1_ps(THETA_EPSILON), _CMP_LT_OQ);
+    if (mask)
+    {
+        ALIGN_VAR_64(int32_t, h[16]);
+        ALIGN_VAR_64(int32_t, v[16]);
+        _mm512_store_si512(h, gh);
+        _mm512_store_si512(v, gv);
+        for (int i = 0; i < 16; i++)
+            if (mask & (1 << i))
+                theta[i] = edgeThetaDegrees(h[i], v[i]);
+    }
+}
+
+static void edgeSobel_avx512(pixel* edge, pixel* theta, const pixel* src, intptr_t stride, int width, int height, pixel whitePixel)
+{
+    const __m512 threshold = _mm512_set1_ps((float)(EDGE_THRESHOLD * EDGE_THRESHOLD));
+    const __m512i white = _mm512_set1_epi32(whitePixel);
+    const __m512i three = _mm512_set1_epi32(3);
+    const __m512i ten = _mm512_set1_epi32(10);
+
+    for (int y = 1; y < height - 1; y++)
+    {
+        const pixel* s0 = src + (y - 1) * stride;
+        const pixel* s1 = s0 + stride;
+        const pixel* s2 = s1 + stride;
+
+        int x = 1;
+        for (; x + 16 <= width - 1; x += 16)
+        {
+            __m512i tl = load16(s0 + x - 1), tc = load16(s0 + x), tr = load16(s0 + x + 1);
+            __m512i ml = load16(s1 + x - 1), mr = load16(s1 + x + 1);
+            __m512i bl = load16(s2 + x - 1), bc = load16(s2 + x), br = load16(s2 + x + 1);
+
+            __m512i gh = _mm512_add_epi32(_mm512_mullo_epi32(_mm512_add_epi32(_mm512_sub_epi32(tr, tl), _mm512_sub_epi32(br, bl)), three),
+                                          _mm512_mullo_epi32(_mm512_sub_epi32(mr, ml), ten));
+            __m512i gv = _mm512_add_epi32(_mm512_mullo_epi32(_mm512_add_epi32(_mm512_sub_epi32(bl, tl), _mm512_sub_epi32(br, tr)), three),
+                                          _mm512_mullo_epi32(_mm512_sub_epi32(bc, tc), ten));
+            __m512 fh = _mm512_cvtepi32_ps(gh);
+            __m512 fv = _mm512_cvtepi32_ps(gv);
+            __m512 magnitude = _mm512_add_ps(_mm512_mul_ps(fh, fh), _mm512_mul_ps(fv, fv));
+
+            __mmask16 isEdge = _mm512_cmp_ps_mask(magnitude, threshold, _CMP_GE_OQ);
+            store16(edge + y * stride + x, _mm512_maskz_mov_epi32(isEdge, white));
+            if (theta)
+                sobelTheta16(theta + y * stride + x, gh, gv, fh, fv);
+        }
+
+        for (; x < width - 1; x++)
+        {
+            int gradientH = 3 * (s0[x + 1] - s0[x - 1]) + 10 * (s1[x + 1] - s1[x - 1]) + 3 * (s2[x + 1] - s2[x - 1]);
+            int gradientV = 3 * (s2[x - 1] - s0[x - 1]) + 10 * (s2[x] - s0[x]) + 3 * (s2[x + 1] - s0[x + 1]);
+            int64_t magnitude = (int64_t)gradientH * gradientH + (int64_t)gradientV * gradientV;
+
+            if (theta)
+                theta[y * stride + x] = edgeThetaDegrees(gradientH, gradientV);
+            edge[y * stride + x] = magnitude >= (int64_t)(EDGE_THRESHOLD * EDGE_THRESHOLD) ? whitePixel : 0;
+        }
+    }
+}
+
+}
+
+namespace X265_NS {
+void setupIntrinsicLookahead_avx512(EncoderPrimitives &p)
+{
+    p.edgeGaussian = edgeGaussian_avx512;
+    p.edgeSobel = edgeSobel_avx512;
+}
+}
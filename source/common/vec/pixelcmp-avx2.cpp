@@ -0,0 +1,339 @@
+/*****************************************************************************
+ * Copyright (C) 2013-2020 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+
+#include "common.h"
+#include "primitives.h"
+#include <immintrin.h> // AVX2
+
+using namespace X265_NS;
+
+namespace {
+#if !HIGH_BIT_DEPTH
+
+/* candidates whose partial sums are kept in registers at once */
+const int XN_BATCH = 8;
+
+/* first w (4, 8, 12 or 16) pixels of a row, the other bytes are zero */
+template<int w>
+static inline __m128i loadPartial(const pixel* p)
+{
+    if (w == 16)
+        return _mm_loadu_si128((const __m128i*)p);
+
+    int32_t v;
+    if (w == 4)
+    {
+        memcpy(&v, p, sizeof(v));
+        return _mm_cvtsi32_si128(v);
+    }
+
+    __m128i x = _mm_loadl_epi64((const __m128i*)p);
+    if (w == 12)
+    {
+        memcpy(&v, p + 8, sizeof(v));
+        x = _mm_insert_epi32(x, v, 2);
+    }
+    return x;
+}
+
+/* the pixels of two rows beyond their last multiple of 32 columns */
+template<int w>
+static inline __m256i loadTail(const pixel* p, intptr_t stride, int row)
+{
+    const int x = w & ~31;
+    const pixel* q = p + row * stride + x;
+
+    if ((w & 31) == 24)
+        return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)q)),
+                                       _mm_loadl_epi64((const __m128i*)(q + 16)), 1);
+
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(loadPartial<w & 31>(q)),
+                                   loadPartial<w & 31>(q + stride), 1);
+}
+
+static inline int32_t sum32(__m256i v)
+{
+    __m128i x = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    x = _mm_add_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2)));
+    x = _mm_add_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(x);
+}
+
+/* fenc rows y0 to y0 + 2 * pairs - 1, which fit in 8 registers */
+template<int lx, int pairs>
+static inline void loadFencRows(__m256i* f, const pixel* fenc, int y0)
+{
+    enum { FULL = lx >> 5, TAIL = (lx & 31) ? ((lx & 31) == 24 ? 2 : 1) : 0 };
+
+    for (int y = y0; y < y0 + 2 * pairs; y += 2)
+    {
+        for (int row = 0; row < 2; row++)
+            for (int x = 0; x < FULL * 32; x += 32)
+                *f++ = _mm256_loadu_si256((const __m256i*)(fenc + (y + row) * FENC_STRIDE + x));
+        for (int row = 0; row < TAIL; row++)
+            *f++ = loadTail<lx>(fenc + y * FENC_STRIDE, FENC_STRIDE, row);
+    }
+}
+
+/* sad of the same rows of a candidate added to sum */
+template<int lx, int pairs>
+static inline __m256i sadRows(__m256i sum, const __m256i* f, const pixel* fref, intptr_t frefstride, int y0)
+{
+    enum { FULL = lx >> 5, TAIL = (lx & 31) ? ((lx & 31) == 24 ? 2 : 1) : 0 };
+
+    for (int y = y0; y < y0 + 2 * pairs; y += 2)
+    {
+        const pixel* r = fref + y * frefstride;
+        for (int row = 0; row < 2; row++)
+            for (int x = 0; x < FULL * 32; x += 32)
+                sum = _mm256_add_epi32(sum, _mm256_sad_epu8(*f++, _mm256_loadu_si256((const __m256i*)(r + row * frefstride + x))));
+        for (int row = 0; row < TAIL; row++)
+            sum = _mm256_add_epi32(sum, _mm256_sad_epu8(*f++, loadTail<lx>(r, frefstride, row)));
+    }
+
+    return sum;
+}
+
+/* The fenc rows are loaded up to 8 registers at a time and compared with the
+ * same rows of every candidate. A 24 column tail takes one register per row,
+ * narrower tails of both rows share one register */
+template<int lx, int ly>
+void sad_xn_avx2(const pixel* fenc, const pixel* const* fref, int count, intptr_t frefstride, int32_t* res)
+{
+    enum { PER_PAIR = 2 * (lx >> 5) + ((lx & 31) ? ((lx & 31) == 24 ? 2 : 1) : 0) };
+    enum { PAIRS = PER_PAIR >= 8 ? 1 : (8 / PER_PAIR < ly / 2 ? 8 / PER_PAIR : ly / 2) };
+    __m256i f[PAIRS * PER_PAIR];
+
+    if (2 * PAIRS == ly)
+    {
+        /* the whole block is held in registers */
+        loadFencRows<lx, PAIRS>(f, fenc, 0);
+        for (int i = 0; i < count; i++)
+            res[i] = sum32(sadRows<lx, PAIRS>(_mm256_setzero_si256(), f, fref[i], frefstride, 0));
+        return;
+    }
+
+    for (int base = 0; base < count; base += XN_BATCH)
+    {
+        const int n = X265_MIN(count - base, XN_BATCH);
+        const pixel* const* ref = fref + base;
+        __m256i acc[XN_BATCH];
+
+        for (int i = 0; i < n; i++)
+            acc[i] = _mm256_setzero_si256();
+
+        for (int y0 = 0; y0 < ly; y0 += 2 * PAIRS)
+        {
+            loadFencRows<lx, PAIRS>(f, fenc, y0);
+            for (int i = 0; i < n; i++)
+                acc[i] = sadRows<lx, PAIRS>(acc[i], f, ref[i], frefstride, y0);
+        }
+
+        for (int i = 0; i < n; i++)
+            res[base + i] = sum32(acc[i]);
+    }
+}
+
+/* Four rows of 16 pixels widened to 16 bits, made of 4x4 blocks laid side
+ * by side. Strips of 16 columns hold four horizontally adjacent blocks, 8
+ * column strips two vertically adjacent 8x4 blocks and 4 column strips up to
+ * four vertically adjacent 4x4 blocks. Missing blocks are zero */
+struct Rows
+{
+    __m256i r[4];
+};
+
+static inline __m256i widen(__m128i lo, __m128i hi)
+{
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_cvtepu8_epi16(lo)), _mm_cvtepu8_epi16(hi), 1);
+}
+
+static inline void load16x4(Rows& rows, const pixel* p, intptr_t stride)
+{
+    for (int i = 0; i < 4; i++)
+        rows.r[i] = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(p + i * stride)));
+}
+
+static inline void load8x8(Rows& rows, const pixel* p, intptr_t stride, int blocks)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        __m128i lo = _mm_loadl_epi64((const __m128i*)(p + i * stride));
+        __m128i hi = blocks > 1 ? _mm_loadl_epi64((const __m128i*)(p + (i + 4) * stride)) : _mm_setzero_si128();
+        rows.r[i] = widen(lo, hi);
+    }
+}
+
+static inline void load4x16(Rows& rows, const pixel* p, intptr_t stride, int blocks)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        int32_t v[4] = { 0, 0, 0, 0 };
+        for (int b = 0; b < blocks; b++)
+            memcpy(&v[b], p + (i + 4 * b) * stride, sizeof(int32_t));
+        __m128i x = _mm_setr_epi32(v[0], v[1], v[2], v[3]);
+        rows.r[i] = widen(x, _mm_srli_si128(x, 8));
+    }
+}
+
+/* satd of the 4x4 blocks of one strip of fenc and candidate rows, as eight
+ * partial sums. The 2D Hadamard transform is linear and its coefficients of
+ * one block all have the parity of the sum of the differences, so each block
+ * sum is even and the satd of a block, (sum of |coefficients|) >> 1, equals
+ * the sum of the halved block sums. The halving is folded into the last
+ * butterfly stage by |x + y| + |x - y| = 2 * max(|x|, |y|) */
+static inline __m256i satdRows(const Rows& f, const Rows& r)
+{
+    __m256i d0 = _mm256_sub_epi16(f.r[0], r.r[0]);
+    __m256i d1 = _mm256_sub_epi16(f.r[1], r.r[1]);
+    __m256i d2 = _mm256_sub_epi16(f.r[2], r.r[2]);
+    __m256i d3 = _mm256_sub_epi16(f.r[3], r.r[3]);
+
+    /* vertical transform */
+    __m256i a0 = _mm256_add_epi16(d0, d1);
+    __m256i a1 = _mm256_sub_epi16(d0, d1);
+    __m256i a2 = _mm256_add_epi16(d2, d3);
+    __m256i a3 = _mm256_sub_epi16(d2, d3);
+    __m256i b0 = _mm256_add_epi16(a0, a2);
+    __m256i b1 = _mm256_add_epi16(a1, a3);
+    __m256i b2 = _mm256_sub_epi16(a0, a2);
+    __m256i b3 = _mm256_sub_epi16(a1, a3);
+
+    /* first horizontal stage, leaves the pairs of the last stage adjacent */
+    __m256i h0 = _mm256_abs_epi16(_mm256_hadd_epi16(b0, b1));
+    __m256i h1 = _mm256_abs_epi16(_mm256_hsub_epi16(b0, b1));
+    __m256i h2 = _mm256_abs_epi16(_mm256_hadd_epi16(b2, b3));
+    __m256i h3 = _mm256_abs_epi16(_mm256_hsub_epi16(b2, b3));
+
+    /* max of each pair in the low word, the high word is multiplied by 0 */
+    const __m256i one = _mm256_set1_epi32(1);
+    __m256i m0 = _mm256_madd_epi16(_mm256_max_epi16(h0, _mm256_srli_epi32(h0, 16)), one);
+    __m256i m1 = _mm256_madd_epi16(_mm256_max_epi16(h1, _mm256_srli_epi32(h1, 16)), one);
+    __m256i m2 = _mm256_madd_epi16(_mm256_max_epi16(h2, _mm256_srli_epi32(h2, 16)), one);
+    __m256i m3 = _mm256_madd_epi16(_mm256_max_epi16(h3, _mm256_srli_epi32(h3, 16)), one);
+
+    return _mm256_add_epi32(_mm256_add_epi32(m0, m1), _mm256_add_epi32(m2, m3));
+}
+
+/* The fenc strip is loaded once and compared with the same strip of every
+ * candidate */
+template<int w, int h>
+void satd_xn_avx2(const pixel* fenc, const pixel* const* fref, int count, intptr_t frefstride, int32_t* res)
+{
+    for (int base = 0; base < count; base += XN_BATCH)
+    {
+        const int n = X265_MIN(count - base, XN_BATCH);
+        const pixel* const* ref = fref + base;
+        __m256i acc[XN_BATCH];
+        Rows f, r;
+
+        for (int i = 0; i < n; i++)
+            acc[i] = _mm256_setzero_si256();
+
+        for (int x = 0; x + 16 <= w; x += 16)
+        {
+            for (int y = 0; y < h; y += 4)
+            {
+                load16x4(f, fenc + y * FENC_STRIDE + x, FENC_STRIDE);
+                for (int i = 0; i < n; i++)
+                {
+                    load16x4(r, ref[i] + y * frefstride + x, frefstride);
+                    acc[i] = _mm256_add_epi32(acc[i], satdRows(f, r));
+                }
+            }
+        }
+
+        if (w & 8)
+        {
+            const int x = w & ~15;
+            for (int y = 0; y < h; y += 8)
+            {
+                const int blocks = X265_MIN((h - y) >> 2, 2);
+                load8x8(f, fenc + y * FENC_STRIDE + x, FENC_STRIDE, blocks);
+                for (int i = 0; i < n; i++)
+                {
+                    load8x8(r, ref[i] + y * frefstride + x, frefstride, blocks);
+                    acc[i] = _mm256_add_epi32(acc[i], satdRows(f, r));
+                }
+            }
+        }
+
+        if (w & 4)
+        {
+            const int x = w & ~7;
+            for (int y = 0; y < h; y += 16)
+            {
+                const int blocks = X265_MIN((h - y) >> 2, 4);
+                load4x16(f, fenc + y * FENC_STRIDE + x, FENC_STRIDE, blocks);
+                for (int i = 0; i < n; i++)
+                {
+                    load4x16(r, ref[i] + y * frefstride + x, frefstride, blocks);
+                    acc[i] = _mm256_add_epi32(acc[i], satdRows(f, r));
+                }
+            }
+        }
+
+        for (int i = 0; i < n; i++)
+            res[base + i] = sum32(acc[i]);
+    }
+}
+
+#endif // if !HIGH_BIT_DEPTH
+}
+
+namespace X265_NS {
+void setupIntrinsicPixelCmp_avx2(EncoderPrimitives &p)
+{
+#if HIGH_BIT_DEPTH
+    (void)p;
+#else
+#define LUMA_PU(W, H) \
+    p.pu[LUMA_ ## W ## x ## H].sad_xn = sad_xn_avx2<W, H>; \
+    p.pu[LUMA_ ## W ## x ## H].satd_xn = satd_xn_avx2<W, H>;
+
+    LUMA_PU(8, 8);
+    LUMA_PU(16, 16);
+    LUMA_PU(32, 32);
+    LUMA_PU(64, 64);
+    LUMA_PU(4, 8);
+    LUMA_PU(8, 4);
+    LUMA_PU(16, 8);
+    LUMA_PU(8, 16);
+    LUMA_PU(16, 12);
+    LUMA_PU(12, 16);
+    LUMA_PU(16, 4);
+    LUMA_PU(4, 16);
+    LUMA_PU(32, 16);
+    LUMA_PU(16, 32);
+    LUMA_PU(32, 24);
+    LUMA_PU(24, 32);
+    LUMA_PU(32, 8);
+    LUMA_PU(8, 32);
+    LUMA_PU(64, 32);
+    LUMA_PU(32, 64);
+    LUMA_PU(64, 48);
+    LUMA_PU(48, 64);
+    LUMA_PU(64, 16);
+    LUMA_PU(16, 64);
+#undef LUMA_PU
+#endif
+}
+}
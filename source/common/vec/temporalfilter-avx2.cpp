@@ -0,0 +1,202 @@
+/*****************************************************************************
+ * Copyright (C) 2013-2020 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+
+#include "common.h"
+#include "primitives.h"
+#include <immintrin.h> // AVX2
+
+using namespace X265_NS;
+
+namespace {
+
+/* 8 pixels widened to 32 bits */
+static inline __m256i load8(const pixel* p)
+{
+#if HIGH_BIT_DEPTH
+    return _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)p));
+#else
+    return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)p));
+#endif
+}
+
+/* 4 pixels widened to 32 bits */
+static inline __m128i load4(const pixel* p)
+{
+#if HIGH_BIT_DEPTH
+    return _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*)p));
+#else
+    int32_t v;
+    memcpy(&v, p, sizeof(v));
+    return _mm_cvtepu8_epi32(_mm_cvtsi32_si128(v));
+#endif
+}
+
+/* store 4 32-bit lanes which are within pixel range */
+static inline void store4(pixel* p, __m128i v)
+{
+    __m128i w = _mm_packus_epi32(v, v);
+#if HIGH_BIT_DEPTH
+    _mm_storel_epi64((__m128i*)p, w);
+#else
+    int32_t b = _mm_cvtsi128_si32(_mm_packus_epi16(w, w));
+    memcpy(p, &b, sizeof(b));
+#endif
+}
+
+static inline void store8(pixel* p, __m256i v)
+{
+    __m128i w = _mm_packus_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+#if HIGH_BIT_DEPTH
+    _mm_storeu_si128((__m128i*)p, w);
+#else
+    _mm_storel_epi64((__m128i*)p, _mm_packus_epi16(w, w));
+#endif
+}
+
+/* MCSTF blocks are 8 or 4 pixels wide */
+static void temporalFilterInterp_avx2(pixel* dst, intptr_t dstStride, const pixel* src, intptr_t srcStride, int width, int height, const int* xFilter, const int* yFilter)
+{
+    X265_CHECK(width == 8 || width == 4, "temporalFilterInterp width must be 4 or 8\n");
+    X265_CHECK(height <= 8, "temporalFilterInterp height must not exceed 8\n");
+
+    const __m256i round = _mm256_set1_epi32(1 << 11);
+    const __m256i maxVal = _mm256_set1_epi32((1 << X265_DEPTH) - 1);
+    const __m256i zero = _mm256_setzero_si256();
+
+    src -= 2 * srcStride;
+    if (width == 8)
+    {
+        __m256i temp[8 + 5];
+        for (int by = 0; by < height + 5; by++, src += srcStride)
+        {
+            __m256i sum = _mm256_mullo_epi32(_mm256_set1_epi32(xFilter[1]), load8(src - 2));
+            sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(_mm256_set1_epi32(xFilter[2]), load8(src - 1)));
+            sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(_mm256_set1_epi32(xFilter[3]), load8(src)));
+            sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(_mm256_set1_epi32(xFilter[4]), load8(src + 1)));
+            sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(_mm256_set1_epi32(xFilter[5]), load8(src + 2)));
+            sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(_mm256_set1_epi32(xFilter[6]), load8(src + 3)));
+            temp[by] = sum;
+        }
+
+        for (int by = 0; by < height; by++, dst += dstStride)
+        {
+            __m256i sum = _mm256_mullo_epi32(_mm256_set1_epi32(yFilter[1]), temp[by]);
+            for (int k = 2; k <= 6; k++)
+                sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(_mm256_set1_epi32(yFilter[k]), temp[by + k - 1]));
+            sum = _mm256_srai_epi32(_mm256_add_epi32(sum, round), 12);
+            store8(dst, _mm256_min_epi32(_mm256_max_epi32(sum, zero), maxVal));
+        }
+    }
+    else
+    {
+        __m128i temp[8 + 5];
+        for (int by = 0; by < height + 5; by++, src += srcStride)
+        {
+            __m128i sum = _mm_mullo_epi32(_mm_set1_epi32(xFilter[1]), load4(src - 2));
+            sum = _mm_add_epi32(sum, _mm_mullo_epi32(_mm_set1_epi32(xFilter[2]), load4(src - 1)));
+            sum = _mm_add_epi32(sum, _mm_mullo_epi32(_mm_set1_epi32(xFilter[3]), load4(src)));
+            sum = _mm_add_epi32(sum, _mm_mullo_epi32(_mm_set1_epi32(xFilter[4]), load4(src + 1)));
+            sum = _mm_add_epi32(sum, _mm_mullo_epi32(_mm_set1_epi32(xFilter[5]), load4(src + 2)));
+            sum = _mm_add_epi32(sum, _mm_mullo_epi32(_mm_set1_epi32(xFilter[6]), load4(src + 3)));
+            temp[by] = sum;
+        }
+
+        for (int by = 0; by < height; by++, dst += dstStride)
+        {
+            __m128i sum = _mm_mullo_epi32(_mm_set1_epi32(yFilter[1]), temp[by]);
+            for (int k = 2; k <= 6; k++)
+                sum = _mm_add_epi32(sum, _mm_mullo_epi32(_mm_set1_epi32(yFilter[k]), temp[by + k - 1]));
+            sum = _mm_srai_epi32(_mm_add_epi32(sum, _mm256_castsi256_si128(round)), 12);
+            store4(dst, _mm_min_epi32(_mm_max_epi32(sum, _mm256_castsi256_si128(zero)), _mm256_castsi256_si128(maxVal)));
+        }
+    }
+}
+
+/* Four pixels per iteration in double precision, in the same order of
+ * operations as the C primitive. round() is emulated exactly for the non
+ * negative averages: the fraction q - trunc(q) is exact, so comparing it with
+ * 0.5 rounds halves away from zero */
+static void temporalFilterBlend_avx2(pixel* dst, intptr_t dstStride, const pixel* const* ref, intptr_t refStride, int numRefs, const double* refWeight, const double* const* weightLut, int width, int height)
+{
+    const double maxSampleValue = (1 << X265_DEPTH) - 1;
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d half = _mm256_set1_pd(0.5);
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d maxVal = _mm256_set1_pd(maxSampleValue);
+
+    for (int y = 0; y < height; y++, dst += dstStride)
+    {
+        int x = 0;
+        for (; x + 4 <= width; x += 4)
+        {
+            const __m128i org = load4(dst + x);
+            __m256d newVal = _mm256_cvtepi32_pd(org);
+            __m256d temporalWeightSum = one;
+
+            for (int i = 0; i < numRefs; i++)
+            {
+                const __m128i refVal = load4(ref[i] + y * refStride + x);
+                const __m128i diff = _mm_abs_epi32(_mm_sub_epi32(refVal, org));
+                const __m256d weight = _mm256_mul_pd(_mm256_set1_pd(refWeight[i]), _mm256_i32gather_pd(weightLut[i], diff, 8));
+
+                newVal = _mm256_add_pd(newVal, _mm256_mul_pd(weight, _mm256_cvtepi32_pd(refVal)));
+                temporalWeightSum = _mm256_add_pd(temporalWeightSum, weight);
+            }
+            newVal = _mm256_div_pd(newVal, temporalWeightSum);
+
+            __m256d sampleVal = _mm256_round_pd(newVal, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+            __m256d frac = _mm256_sub_pd(newVal, sampleVal);
+            sampleVal = _mm256_add_pd(sampleVal, _mm256_and_pd(_mm256_cmp_pd(frac, half, _CMP_GE_OQ), one));
+            sampleVal = _mm256_min_pd(_mm256_max_pd(sampleVal, zero), maxVal);
+            store4(dst + x, _mm256_cvttpd_epi32(sampleVal));
+        }
+
+        for (; x < width; x++)
+        {
+            const int orgVal = (int)dst[x];
+            double temporalWeightSum = 1.0;
+            double newVal = (double)orgVal;
+
+            for (int i = 0; i < numRefs; i++)
+            {
+                const int refVal = (int)ref[i][y * refStride + x];
+                const double weight = refWeight[i] * weightLut[i][abs(refVal - orgVal)];
+
+                newVal += weight * refVal;
+                temporalWeightSum += weight;
+            }
+            newVal /= temporalWeightSum;
+            double sampleVal = round(newVal);
+            sampleVal = (sampleVal < 0 ? 0 : (sampleVal > maxSampleValue ? maxSampleValue : sampleVal));
+            dst[x] = (pixel)sampleVal;
+        }
+    }
+}
+
+}
+
+namespace X265_NS {
+void setupIntrinsicTemporalFilter_avx2(EncoderPrimitives &p)
+{
+    p.temporalFilterInterp = temporalFilterInterp_avx2;
+    p.temporalFilterBlend = temporalFilterBlend_avx2;
+}
+}
@@ -31,6 +31,7 @@
 #define HAVE_SSSE3
 #define HAVE_SSE4
 #define HAVE_AVX2
+#define HAVE_AVX512
 #elif defined(__GNUC__)
 #define GCC_VERSION (__GNUC__ * 10000 + __GNUC_MINOR__ * 100 + __GNUC_PATCHLEVEL__)
 #if __clang__ || GCC_VERSION >= 40300 /* gcc_version >= gcc-4.3.0 */
@@ -41,6 +42,9 @@
 #if __clang__ || GCC_VERSION >= 40700 /* gcc_version >= gcc-4.7.0 */
 #define HAVE_AVX2
 #endif
+#if __clang__ || GCC_VERSION >= 50100 /* gcc_version >= gcc-5.1.0 */
+#define HAVE_AVX512
+#endif
 #elif defined(_MSC_VER)
 #define HAVE_SSE3
 #define HAVE_SSSE3
@@ -48,6 +52,9 @@
 #if _MSC_VER >= 1700 // VC11
 #define HAVE_AVX2
 #endif
+#if _MSC_VER >= 1920 // VC16
+#define HAVE_AVX512
+#endif
 #endif // compiler checks
 #endif // if X265_ARCH_X86
 
@@ -57,6 +64,10 @@ namespace X265_NS {
 void setupIntrinsicDCT_sse3(EncoderPrimitives&);
 void setupIntrinsicDCT_ssse3(EncoderPrimitives&);
 void setupIntrinsicDCT_sse41(EncoderPrimitives&);
+void setupIntrinsicLookahead_avx2(EncoderPrimitives&);
+void setupIntrinsicTemporalFilter_avx2(EncoderPrimitives&);
+void setupIntrinsicPixelCmp_avx2(EncoderPrimitives&);
+void setupIntrinsicLookahead_avx512(EncoderPrimitives&);
 
 /* Use primitives for the best available vector architecture */
 void setupIntrinsicPrimitives(EncoderPrimitives &p, int cpuMask)
@@ -78,6 +89,20 @@ void setupIntrinsicPrimitives(EncoderPrimitives &p, int cpuMask)
     {
         setupIntrinsicDCT_sse41(p);
     }
+#endif
+#ifdef HAVE_AVX2
+    if (cpuMask & X265_CPU_AVX2)
+    {
+        setupIntrinsicLookahead_avx2(p);
+        setupIntrinsicTemporalFilter_avx2(p);
+        setupIntrinsicPixelCmp_avx2(p);
+    }
+#endif
+#ifdef HAVE_AVX512
+    if (cpuMask & X265_CPU_AVX512)
+    {
+        setupIntrinsicLookahead_avx512(p);
+    }
 #endif
     (void)p;
     (void)cpuMask;
@@ -46,13 +46,23 @@ bool WaveFront::init(int numRows)
     m_row_to_idx = X265_MALLOC(uint32_t, m_numRows);
     m_idx_to_row = X265_MALLOC(uint32_t, m_numRows);
 
-    return m_internalDependencyBitmap && m_externalDependencyBitmap;
+    m_rowWorker = X265_MALLOC(int, m_numRows);
+    if (m_rowWorker)
+        memset(m_rowWorker, -1, sizeof(int) * m_numRows);
+
+    m_externalDependencyCount = X265_MALLOC(int32_t, m_numRows);
+    if (m_externalDependencyCount)
+        memset((void*)m_externalDependencyCount, 0, sizeof(int32_t) * m_numRows);
+
+    return m_internalDependencyBitmap && m_externalDependencyBitmap && m_rowWorker && m_externalDependencyCount;
 }
 
 WaveFront::~WaveFront()
 {
     x265_free((void*)m_row_to_idx);
     x265_free((void*)m_idx_to_row);
+    x265_free((void*)m_rowWorker);
+    x265_free((void*)m_externalDependencyCount);
 
     x265_free((void*)m_internalDependencyBitmap);
     x265_free((void*)m_externalDependencyBitmap);
@@ -86,6 +96,17 @@ void WaveFront::enableAllRows()
     memset((void*)m_externalDependencyBitmap, ~0, sizeof(uint32_t) * m_numWords);
 }
 
+bool WaveFront::resolveExternalDependency(int row)
+{
+    if (ATOMIC_DEC(&m_externalDependencyCount[row]))
+        return false;
+
+    externalDependenciesResolved(row);
+    enableRow(row);
+    tryWakeOne(lastRowWorker(row));
+    return true;
+}
+
 bool WaveFront::dequeueRow(int row)
 {
     uint32_t bit = 1 << (row & 31);
@@ -108,6 +129,8 @@ void WaveFront::findJob(int threadId)
             if (ATOMIC_AND(&m_internalDependencyBitmap[w], ~bit) & bit)
             {
                 /* we cleared the bit, we get to process the row */
+                if (m_rowWorker)
+                    m_rowWorker[w * 32 + id] = threadId;
                 processRow(w * 32 + id, threadId, m_sLayerId);
                 m_helpWanted = true;
                 return; /* check for a higher priority task */
@@ -119,4 +142,91 @@ void WaveFront::findJob(int threadId)
 
     m_helpWanted = false;
 }
+
+bool RowDependencyGraph::init(int numRows)
+{
+    m_numRows = numRows;
+    m_rowDone = X265_MALLOC(bool, numRows);
+    m_waiters = X265_MALLOC(Edge*, numRows);
+    if (!m_rowDone || !m_waiters)
+        return false;
+
+    memset(m_rowDone, 0, sizeof(bool) * numRows);
+    memset(m_waiters, 0, sizeof(Edge*) * numRows);
+    return true;
+}
+
+void RowDependencyGraph::destroy()
+{
+    while (m_freeEdges)
+    {
+        Edge* next = m_freeEdges->next;
+        delete m_freeEdges;
+        m_freeEdges = next;
+    }
+
+    X265_FREE_ZERO(m_rowDone);
+    X265_FREE_ZERO(m_waiters);
+}
+
+void RowDependencyGraph::reset()
+{
+    ScopedLock lock(m_lock);
+#if CHECKED_BUILD || _DEBUG
+    for (int row = 0; row < m_numRows; row++)
+        X265_CHECK(!m_waiters[row], "recycled frame still has dependent rows\n");
+#endif
+    memset(m_rowDone, 0, sizeof(bool) * m_numRows);
+}
+
+bool RowDependencyGraph::addDependent(int producerRow, WaveFront& consumer, int consumerRow)
+{
+    ScopedLock lock(m_lock);
+
+    if (m_rowDone[producerRow])
+        return false;
+
+    Edge* edge = m_freeEdges;
+    if (edge)
+        m_freeEdges = edge->next;
+    else
+        edge = new Edge;
+
+    edge->consumer = &consumer;
+    edge->row = consumerRow;
+    edge->next = m_waiters[producerRow];
+    m_waiters[producerRow] = edge;
+
+    /* counted while the lock is held so rowCompleted() cannot resolve the
+     * dependency before it is added */
+    consumer.addExternalDependency(consumerRow);
+    return true;
+}
+
+void RowDependencyGraph::rowCompleted(int producerRow)
+{
+    Edge* waiters;
+    {
+        ScopedLock lock(m_lock);
+        m_rowDone[producerRow] = true;
+        waiters = m_waiters[producerRow];
+        m_waiters[producerRow] = NULL;
+    }
+
+    /* resolve outside of the lock, consumers may take their own locks and
+     * wake workers */
+    Edge* last = NULL;
+    for (Edge* edge = waiters; edge; edge = edge->next)
+    {
+        edge->consumer->resolveExternalDependency(edge->row);
+        last = edge;
+    }
+
+    if (last)
+    {
+        ScopedLock lock(m_lock);
+        last->next = m_freeEdges;
+        m_freeEdges = waiters;
+    }
+}
 }
@@ -54,6 +54,14 @@ private:
 
     int m_sLayerId;
 
+    // worker thread which last processed each row, used as an affinity hint
+    // when waking workers in work-stealing mode
+    int* m_rowWorker;
+
+    // count of unresolved external dependencies of each row, see
+    // setExternalDependencies() and RowDependencyGraph
+    int32_t volatile *m_externalDependencyCount;
+
 protected:
     uint32_t *m_row_to_idx;
     uint32_t *m_idx_to_row;
@@ -63,6 +71,8 @@ public:
     WaveFront()
         : m_internalDependencyBitmap(NULL)
         , m_externalDependencyBitmap(NULL)
+        , m_rowWorker(NULL)
+        , m_externalDependencyCount(NULL)
     {}
 
     virtual ~WaveFront();
@@ -90,6 +100,21 @@ public:
     // resolved before each row may proceed.
     void clearEnabledRowMask();
 
+    // Event driven external dependencies. The row starts with a single guard
+    // dependency; each RowDependencyGraph edge registered for the row adds
+    // one more. The row is enabled, and a worker woken, when the count drops
+    // to zero, so the caller must resolve the guard once all edges are added.
+    void setExternalDependencies(int row)    { m_externalDependencyCount[row] = 1; }
+    void addExternalDependency(int row)      { ATOMIC_INC(&m_externalDependencyCount[row]); }
+    bool resolveExternalDependency(int row);
+
+    // Called by resolveExternalDependency() once all external dependencies
+    // of the row are resolved, before any worker is woken for it
+    virtual void externalDependenciesResolved(int /*row*/) {}
+
+    // Returns the worker thread which last processed this row, or -1
+    int lastRowWorker(int row) const { return m_rowWorker ? m_rowWorker[row] : -1; }
+
     // WaveFront's implementation of JobProvider::findJob. Consults
     // m_queuedBitmap and calls ProcessRow(row) for lowest numbered queued row
     // processes available rows and returns when no work remains
@@ -101,6 +126,52 @@ public:
 
     void setLayerId(int layer);
 };
+
+// Edges from the rows of a producer (a frame whose reconstructed rows are
+// referenced by other frames) to the wavefront rows which wait on them. Each
+// completed producer row resolves one external dependency of every waiting
+// row directly, across all in-flight frames, so no thread blocks on the
+// producer and a consumer row becomes runnable as soon as its last
+// reference row is reconstructed.
+class RowDependencyGraph
+{
+public:
+
+    RowDependencyGraph() : m_numRows(0), m_rowDone(NULL), m_waiters(NULL), m_freeEdges(NULL) {}
+
+    ~RowDependencyGraph() { destroy(); }
+
+    bool init(int numRows);
+
+    void destroy();
+
+    // Forget all completed rows, the producer is about to be reused. No
+    // edges may be outstanding
+    void reset();
+
+    // Make consumer row consumerRow wait on producerRow. Returns false, and
+    // records nothing, if producerRow is already complete
+    bool addDependent(int producerRow, WaveFront& consumer, int consumerRow);
+
+    // Mark producerRow complete and resolve the dependencies waiting on it.
+    // Must be called after the row's data is visible to the consumers
+    void rowCompleted(int producerRow);
+
+protected:
+
+    struct Edge
+    {
+        WaveFront* consumer;
+        int        row;
+        Edge*      next;
+    };
+
+    Lock   m_lock;
+    int    m_numRows;
+    bool*  m_rowDone;
+    Edge** m_waiters;
+    Edge*  m_freeEdges;
+};
 } // end namespace X265_NS
 
 #endif // ifndef X265_WAVEFRONT_H
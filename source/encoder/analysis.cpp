@@ -80,6 +80,9 @@ Analysis::Analysis()
     m_checkMergeAndSkipOnly[0] = false;
     m_checkMergeAndSkipOnly[1] = false;
     m_evaluateInter = 0;
+    m_splitModel = NULL;
+    m_splitStats = NULL;
+    m_bSplitTraining = false;
 }
 
 bool Analysis::create(ThreadLocalData *tld)
@@ -221,6 +224,10 @@ Mode& Analysis::compressCTU(CUData& ctu, Frame& frame, const CUGeom& cuGeom, con
             for (int i = 0; i < X265_MAX_PRED_MODE_PER_CTU * numPredDir; i++)
                 m_reuseRef[i] = -1;
     }
+    /* one CTU in eight is analysed without split predictions so the models
+     * keep seeing unbiased decisions, the pattern shifts from frame to frame */
+    m_bSplitTraining = m_splitModel && !((ctu.m_cuAddr + m_slice->m_poc) & 7);
+
     ProfileCUScope(ctu, totalCTUTime, totalCTUs);
 
 #if  ENABLE_SCC_EXT
@@ -228,6 +235,15 @@ Mode& Analysis::compressCTU(CUData& ctu, Frame& frame, const CUGeom& cuGeom, con
     memset(m_ibc.m_lastIntraBCMv, 0, sizeof(m_ibc.m_lastIntraBCMv));
     m_ibc.m_numBV16s = 0; m_ibc.m_numBVs = 0;
 #endif
+    /* the motion candidate data is derived once per CTU, except when the
+     * modes are analysed by several threads (pmode) or may refer to this
+     * picture */
+    if (m_slice->m_sliceType != I_SLICE && !m_param->bDistributeModeAnalysis && !m_param->bEnableSCC && m_param->numViews <= 1)
+    {
+        m_mvCandCache.reset(ctu.m_cuAddr);
+        ctu.m_mvCandCache = &m_mvCandCache;
+    }
+
     if (m_slice->m_sliceType == I_SLICE || (m_param->bEnableSCC && (m_slice->m_numRefIdx[0] == 1) && m_slice->m_refPOCList[0][0] == m_slice->m_poc))
     {
         x265_analysis_intra_data* intraDataCTU = m_frame->m_analysisData.intraData;
@@ -543,6 +559,8 @@ uint64_t Analysis::compressIntraCU(const CUData& parentCTU, const CUGeom& cuGeom
     bool bAlreadyDecided = m_param->intraRefine != 4 && parentCTU.m_lumaIntraDir[cuGeom.absPartIdx] != (uint8_t)ALL_IDX && !(m_param->bAnalysisType == HEVC_INFO);
     bool bDecidedDepth = m_param->intraRefine != 4 && parentCTU.m_cuDepth[cuGeom.absPartIdx] == depth;
     int split = 0;
+    uint8_t splitFeatures[SplitStats::NUM_FEATURES];
+    bool bSplitTrain = false, skipIntra = false, skipRecursion = false;
     if (m_param->intraRefine && m_param->intraRefine != 4)
     {
         split = m_param->scaleFactor && bDecidedDepth && (!mightNotSplit || 
@@ -551,6 +569,21 @@ uint64_t Analysis::compressIntraCU(const CUData& parentCTU, const CUGeom& cuGeom
             bAlreadyDecided = false;
     }
 
+    /* Skip the current depth or the recursion when the split classifier is
+     * confident, else train it with the decision. 64x64 CUs are never coded
+     * at the current depth */
+    if (m_splitModel && !bAlreadyDecided && m_slice->isIntra() && mightSplit && mightNotSplit &&
+        cuGeom.log2CUSize >= 4 && cuGeom.log2CUSize != MAX_LOG2_CU_SIZE)
+    {
+        int splitPrediction = predictSplit(parentCTU, cuGeom, NULL, splitFeatures);
+        if (splitPrediction < 0)
+            bSplitTrain = true;
+        else if (splitPrediction)
+            skipIntra = true;
+        else
+            skipRecursion = true;
+    }
+
     if (bAlreadyDecided)
     {
         if (bDecidedDepth && mightNotSplit)
@@ -574,7 +607,7 @@ uint64_t Analysis::compressIntraCU(const CUData& parentCTU, const CUGeom& cuGeom
                 addSplitFlagCost(*md.bestMode, cuGeom.depth);
         }
     }
-    else if (cuGeom.log2CUSize != MAX_LOG2_CU_SIZE && mightNotSplit)
+    else if (cuGeom.log2CUSize != MAX_LOG2_CU_SIZE && mightNotSplit && !skipIntra)
     {
         md.pred[PRED_INTRA].cu.initSubCU(parentCTU, cuGeom, qp);
         checkIntra(md.pred[PRED_INTRA], cuGeom, SIZE_2Nx2N);
@@ -718,6 +751,7 @@ uint64_t Analysis::compressIntraCU(const CUData& parentCTU, const CUGeom& cuGeom
 
     // stop recursion if we reach the depth of previous analysis decision
     mightSplit &= !(bAlreadyDecided && bDecidedDepth) || split;
+    mightSplit &= !skipRecursion;
 
     if (mightSplit)
     {
@@ -802,6 +836,8 @@ uint64_t Analysis::compressIntraCU(const CUData& parentCTU, const CUGeom& cuGeom
             checkBestMode(*splitPred, depth);
         }
     }
+    if (bSplitTrain)
+        trainSplit(cuGeom, splitFeatures, md.bestMode == &md.pred[PRED_SPLIT]);
 
     if (m_param->bEnableRdRefine && depth <= m_slice->m_pps->maxCuDQPDepth)
     {
@@ -1497,6 +1533,20 @@ SplitData Analysis::compressInterCU_rd0_4(const CUData& parentCTU, const CUGeom&
         }
         if (m_param->bAnalysisType == AVC_INFO && md.bestMode && cuGeom.numPartitions <= 16 && m_param->analysisLoadReuseLevel == 7)
             skipRecursion = true;
+        /* Skip the branch the split classifier is confident about, else
+         * train it with the decision */
+        uint8_t splitFeatures[SplitStats::NUM_FEATURES];
+        bool bSplitTrain = false;
+        if (m_splitModel && mightSplit && mightNotSplit && !skipRecursion && md.bestMode && cuGeom.log2CUSize >= 4)
+        {
+            int splitPrediction = predictSplit(parentCTU, cuGeom, md.bestMode, splitFeatures);
+            if (splitPrediction < 0)
+                bSplitTrain = true;
+            else if (splitPrediction)
+                skipModes = true;
+            else
+                skipRecursion = true;
+        }
         /* Step 2. Evaluate each of the 4 split sub-blocks in series */
         if (mightSplit && !skipRecursion)
         {
@@ -1916,6 +1966,8 @@ SplitData Analysis::compressInterCU_rd0_4(const CUData& parentCTU, const CUGeom&
 
             checkDQPForSplitPred(*md.bestMode, cuGeom);
         }
+        if (bSplitTrain)
+            trainSplit(cuGeom, splitFeatures, md.bestMode == &md.pred[PRED_SPLIT]);
 
         /* determine which motion references the parent CU should search */
         splitCUData.initSplitCUData();
@@ -2219,6 +2271,20 @@ SplitData Analysis::compressInterCU_rd5_6(const CUData& parentCTU, const CUGeom&
         }
         if (m_param->bAnalysisType == AVC_INFO && md.bestMode && cuGeom.numPartitions <= 16 && m_param->analysisLoadReuseLevel == 7)
             skipRecursion = true;
+        /* Skip the branch the split classifier is confident about, else
+         * train it with the decision */
+        uint8_t splitFeatures[SplitStats::NUM_FEATURES];
+        bool bSplitTrain = false;
+        if (m_splitModel && mightSplit && mightNotSplit && !skipRecursion && md.bestMode && cuGeom.log2CUSize >= 4)
+        {
+            int splitPrediction = predictSplit(parentCTU, cuGeom, md.bestMode, splitFeatures);
+            if (splitPrediction < 0)
+                bSplitTrain = true;
+            else if (splitPrediction)
+                skipModes = true;
+            else
+                skipRecursion = true;
+        }
         // estimate split cost
         /* Step 2. Evaluate each of the 4 split sub-blocks in series */
         if (mightSplit && !skipRecursion)
@@ -2709,6 +2775,8 @@ SplitData Analysis::compressInterCU_rd5_6(const CUData& parentCTU, const CUGeom&
         /* compare split RD cost against best cost */
         if (mightSplit && !skipRecursion)
             checkBestMode(md.pred[PRED_SPLIT], depth);
+        if (bSplitTrain)
+            trainSplit(cuGeom, splitFeatures, md.bestMode == &md.pred[PRED_SPLIT]);
 
         if (m_param->bEnableRdRefine && depth <= m_slice->m_pps->maxCuDQPDepth)
         {
@@ -4096,6 +4164,129 @@ uint32_t Analysis::calculateCUVariance(const CUData& ctu, const CUGeom& cuGeom)
     return cuVariance / cnt;
 }
 
+/* floor(log2(value + 1)) */
+static int splitLog2(uint64_t value)
+{
+    int log2 = 0;
+    for (value++; value > 1; value >>= 1)
+        log2++;
+    return log2;
+}
+
+static uint8_t splitBin(int bin)
+{
+    return (uint8_t)x265_clip3(0, SplitStats::NUM_BINS - 1, bin);
+}
+
+int Analysis::predictSplit(const CUData& ctu, const CUGeom& cuGeom, const Mode* bestMode, uint8_t* features)
+{
+    const Lowres& lowres = m_frame->m_lowres;
+    uint32_t width = m_frame->m_fencPic->m_picWidth;
+    uint32_t height = m_frame->m_fencPic->m_picHeight;
+    uint32_t cuX = ctu.m_cuPelX + g_zscanToPelX[cuGeom.absPartIdx];
+    uint32_t cuY = ctu.m_cuPelY + g_zscanToPelY[cuGeom.absPartIdx];
+    uint32_t cuSize = 1 << cuGeom.log2CUSize;
+
+    /* lowres intra cost and L0 vector length over the 16x16 blocks of the CU */
+    MV* mvs = NULL;
+    if (!m_slice->isIntra())
+    {
+        int dist = m_slice->m_poc - m_slice->m_refPOCList[0][0];
+        if (dist > 0 && dist <= m_param->bframes + 1)
+            mvs = lowres.lowresMvs[0][dist];
+    }
+    uint64_t intraCost = 0, mvLength = 0;
+    uint32_t blocks = 0;
+    for (uint32_t y = cuY; y < cuY + cuSize && y < height; y += 16)
+    {
+        for (uint32_t x = cuX; x < cuX + cuSize && x < width; x += 16)
+        {
+            uint32_t idx = (y >> 4) * lowres.maxBlocksInRow + (x >> 4);
+            intraCost += lowres.intraCost[idx];
+            if (mvs)
+                mvLength += abs(mvs[idx].x) + abs(mvs[idx].y);
+            blocks++;
+        }
+    }
+    features[SplitStats::FEATURE_INTRA_COST] = splitBin(splitLog2(intraCost / blocks) - 3);
+    features[SplitStats::FEATURE_MOTION] = mvs ? splitBin(splitLog2(mvLength / blocks) + 1) : 0;
+
+    /* cuTree offset of referenced pictures, else the AQ offset, in steps of 1.5 */
+    int loopIncr = (m_param->rc.qgSize == 8) ? 8 : 16;
+    double* qpoffs = IS_REFERENCED(m_frame) && m_param->rc.cuTree ? lowres.qpCuTreeOffset : lowres.qpAqOffset;
+    double qpOffset = 0;
+    if (qpoffs)
+    {
+        uint32_t maxCols = (width + loopIncr - 1) / loopIncr;
+        uint32_t cnt = 0;
+        for (uint32_t y = cuY; y < cuY + cuSize && y < height; y += loopIncr)
+        {
+            for (uint32_t x = cuX; x < cuX + cuSize && x < width; x += loopIncr)
+            {
+                qpOffset += qpoffs[(y / loopIncr) * maxCols + x / loopIncr];
+                cnt++;
+            }
+        }
+        qpOffset /= cnt;
+    }
+    features[SplitStats::FEATURE_QP_OFFSET] = splitBin((int)floor(qpOffset / 1.5) + 7);
+
+    features[SplitStats::FEATURE_VARIANCE] = splitBin(splitLog2(calculateCUVariance(ctu, cuGeom)) / 2);
+
+    /* whether the left CTU along the rows of the CU and the above CTU along
+     * its columns were coded deeper than this CU */
+    uint32_t raster = g_zscanToRaster[cuGeom.absPartIdx];
+    uint32_t stride = ctu.s_numPartInCUSize;
+    uint32_t row = raster / stride, col = raster % stride;
+    uint32_t numParts = cuSize >> LOG2_UNIT_SIZE;
+    int deeper = 0, shallower = 0;
+    if (ctu.m_cuLeft)
+    {
+        uint8_t depth = 0;
+        for (uint32_t i = 0; i < numParts; i++)
+            depth = X265_MAX(depth, ctu.m_cuLeft->m_cuDepth[g_rasterToZscan[(row + i) * stride + stride - 1]]);
+        depth > cuGeom.depth ? deeper++ : shallower++;
+    }
+    if (ctu.m_cuAbove)
+    {
+        uint8_t depth = 0;
+        for (uint32_t i = 0; i < numParts; i++)
+            depth = X265_MAX(depth, ctu.m_cuAbove->m_cuDepth[g_rasterToZscan[(stride - 1) * stride + col + i]]);
+        depth > cuGeom.depth ? deeper++ : shallower++;
+    }
+    features[SplitStats::FEATURE_NEIGHBOURS] = (uint8_t)(deeper * 3 + shallower);
+
+    /* the best mode found at this depth so far: skip, else its cost per pixel */
+    if (!bestMode)
+        features[SplitStats::FEATURE_BEST_MODE] = 0;
+    else if (bestMode->cu.isSkipped(0))
+        features[SplitStats::FEATURE_BEST_MODE] = 1;
+    else
+    {
+        uint64_t cost = m_param->rdLevel >= 2 ? bestMode->rdCost : bestMode->sa8dCost;
+        features[SplitStats::FEATURE_BEST_MODE] = splitBin(2 + splitLog2(cost >> (2 * cuGeom.log2CUSize)));
+    }
+
+    /* in training CTUs the prediction is only checked against the decision */
+    int prediction = m_splitModel->predict(cuGeom.log2CUSize - 4, features, m_param->splitPredictThreshold);
+    if (m_bSplitTraining)
+    {
+        m_splitChecked[cuGeom.depth] = (int8_t)prediction;
+        return -1;
+    }
+    if (prediction < 0 || !m_splitModel->trusted(cuGeom.log2CUSize - 4, prediction, m_param->splitPredictThreshold))
+        return -1;
+    return prediction;
+}
+
+void Analysis::trainSplit(const CUGeom& cuGeom, const uint8_t* features, bool bSplit)
+{
+    int size = cuGeom.log2CUSize - 4;
+    m_splitStats->add(size, features, bSplit);
+    if (m_bSplitTraining && m_splitChecked[cuGeom.depth] >= 0)
+        m_splitStats->check(size, !!m_splitChecked[cuGeom.depth], bSplit);
+}
+
 double Analysis::aqQPOffset(const CUData& ctu, const CUGeom& cuGeom)
 {
     uint32_t aqDepth = X265_MIN(cuGeom.depth, m_frame->m_lowres.maxAQDepth - 1);
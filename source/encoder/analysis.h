@@ -35,6 +35,7 @@
 
 #include "entropy.h"
 #include "search.h"
+#include "splitpredict.h"
 
 namespace X265_NS {
 // private namespace
@@ -122,6 +123,12 @@ public:
     bool      m_checkMergeAndSkipOnly[2];
 
     IBC       m_ibc;
+
+    /* split-predict model of the frame and split decisions of the CTU row,
+     * set by the frame encoder before each CTU. NULL model: disabled */
+    const SplitModel* m_splitModel;
+    SplitStats*       m_splitStats;
+
     Analysis();
 
     bool create(ThreadLocalData* tld);
@@ -150,6 +157,11 @@ protected:
     uint8_t*                m_additionalCtuInfo;
     int*                    m_prevCtuInfoChange;
 
+    bool                    m_bSplitTraining; /* CTU analysed without split predictions */
+    int8_t                  m_splitChecked[NUM_CU_DEPTH]; /* prediction of a training CU, checked after its analysis */
+
+    MVCandCache             m_mvCandCache;    /* motion candidate data of the CTU, shared by all its modes */
+
     struct TrainingData
     {
         uint32_t cuVariance;
@@ -233,6 +245,12 @@ protected:
 
     void collectPUStatistics(const CUData& ctu, const CUGeom& cuGeom);
 
+    /* split-predict: quantize the features of a CU and predict its split
+     * flag, 1 split, 0 not split, -1 not confident or training CTU. bestMode
+     * is the best mode analysed at the CU's depth, if any */
+    int  predictSplit(const CUData& ctu, const CUGeom& cuGeom, const Mode* bestMode, uint8_t* features);
+    void trainSplit(const CUGeom& cuGeom, const uint8_t* features, bool bSplit);
+
     /* check whether current mode is the new best */
     inline void checkBestMode(Mode& mode, uint32_t depth)
     {
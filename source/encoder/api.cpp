@@ -411,6 +411,24 @@ int x265_encoder_reconfig_zone(x265_encoder* enc, x265_zone* zone_in)
 
     return 0;
 }
+x265_picture *x265_encoder_get_input_buffer(x265_encoder *enc)
+{
+    if (!enc)
+        return NULL;
+
+    Encoder *encoder = static_cast<Encoder*>(enc);
+    return encoder->getInputBuffer();
+}
+
+void x265_encoder_release_input_buffer(x265_encoder *enc, x265_picture *pic)
+{
+    if (!enc || !pic)
+        return;
+
+    Encoder *encoder = static_cast<Encoder*>(enc);
+    encoder->releaseInputBuffer(pic);
+}
+
 void x265_configure_vbv_end(x265_encoder* enc, x265_picture* picture, double totalstreamduration)
 {
     Encoder* encoder = static_cast<Encoder*>(enc);
@@ -1103,7 +1121,9 @@ static const x265_api libapi =
     &x265_calculate_vmaf_framelevelscore,
     &x265_vmaf_encoder_log,
 #endif
-    &PARAM_NS::x265_zone_param_parse
+    &PARAM_NS::x265_zone_param_parse,
+    &x265_encoder_get_input_buffer,
+    &x265_encoder_release_input_buffer
 };
 
 typedef const x265_api* (*api_get_func)(int bitDepth);
@@ -1333,6 +1353,8 @@ FILE* x265_csvlog_open(const x265_param* param)
                 if (param->bEnableSsim)
                     fprintf(csvfp, "SSIM, SSIM(dB), ");
                 fprintf(csvfp, "Latency, ");
+                if (param->bAdaptiveLookahead)
+                    fprintf(csvfp, "Lookahead, Trellis, Lookahead Slices, Lookahead Adapted, ");
                 fprintf(csvfp, "List 0, List 1");
                 uint32_t size = param->maxCUSize;
                 for (uint32_t depth = 0; depth <= param->maxCUDepth; depth++)
@@ -1402,7 +1424,7 @@ FILE* x265_csvlog_open(const x265_param* param)
 
                     /* detailed performance statistics */
                     fprintf(csvfp, ", DecideWait (ms), Row0Wait (ms), Wall time (ms), Ref Wait Wall (ms), Total CTU time (ms),"
-                        "Stall Time (ms), Total frame time (ms), Avg WPP, Row Blocks");
+                        "Stall Time (ms), Total frame time (ms), Avg WPP, Row Blocks, Ref Stall (ms), WPP Stall (ms), Max Row Ref Stall (ms), Max Row WPP Stall (ms)");
 #if ENABLE_LIBVMAF
                     fprintf(csvfp, ", VMAF Frame Score");
 #endif
@@ -1457,6 +1479,9 @@ void x265_csvlog_frame(const x265_param* param, const x265_picture* pic)
     if (param->bEnableSsim)
         fprintf(param->csvfpt, " %.6f, %6.3f,", frameStats->ssim, x265_ssim2dB(frameStats->ssim));
     fprintf(param->csvfpt, "%d, ", frameStats->frameLatency);
+    if (param->bAdaptiveLookahead)
+        fprintf(param->csvfpt, "%d, %d, %d, %d, ", frameStats->lookaheadDepth, frameStats->lookaheadTrellis,
+                                                  frameStats->lookaheadSlices, frameStats->bLookaheadAdapted);
     if (frameStats->sliceType == 'I' || frameStats->sliceType == 'i')
         fputs(" -, -,", param->csvfpt);
     else
@@ -1539,6 +1564,8 @@ void x265_csvlog_frame(const x265_param* param, const x265_picture* pic)
                                                                                      frameStats->totalFrameTime);
 
         fprintf(param->csvfpt, " %.3lf, %d", frameStats->avgWPP, frameStats->countRowBlocks);
+        fprintf(param->csvfpt, ", %.1lf, %.1lf, %.1lf, %.1lf", frameStats->refStallTime, frameStats->wppStallTime,
+                                                            frameStats->maxRowRefStallTime, frameStats->maxRowWppStallTime);
 #if ENABLE_LIBVMAF
         fprintf(param->csvfpt, ", %lf", frameStats->vmafFrameScore);
 #endif
@@ -95,6 +95,7 @@ void DPB::recycleUnreferenced()
                 curFrame->m_reconRowFlag[row].set(0);
                 curFrame->m_reconColCount[row].set(0);
             }
+            curFrame->m_reconRowDeps.reset();
 
             // iterator is invalidated by remove, restart scan
             m_picList.remove(*curFrame);
@@ -106,6 +107,9 @@ void DPB::recycleUnreferenced()
 #endif
             iterFrame = m_picList.first();
 
+            /* the lookahead is done with the picture, its cost and vector
+             * tables go back to the pool for the pictures still in it */
+            curFrame->m_lowres.releaseTables();
             m_freeList.pushBack(*curFrame);
             curFrame->m_encData->m_freeListNext = m_frameDataFreeList;
             m_frameDataFreeList = curFrame->m_encData;
@@ -141,6 +145,27 @@ void DPB::recycleUnreferenced()
     }
 }
 
+/* Take a FrameData instance from the free list which was allocated on the
+ * given NUMA node, so the recon planes and CTU data of a frame end up local
+ * to the thread pool of the frame encoder which encodes it. A node of -1
+ * accepts any instance. Returns NULL if no suitable instance is free */
+FrameData* DPB::popFrameData(int numaNode)
+{
+    FrameData** link = &m_frameDataFreeList;
+    while (*link)
+    {
+        FrameData* encData = *link;
+        if (numaNode < 0 || encData->m_numaNode == numaNode)
+        {
+            *link = encData->m_freeListNext;
+            encData->m_freeListNext = NULL;
+            return encData;
+        }
+        link = &encData->m_freeListNext;
+    }
+    return NULL;
+}
+
 void DPB::prepareEncode(Frame *newFrame)
 {
     Slice* slice = newFrame->m_encData->m_slice;
@@ -77,6 +77,8 @@ public:
 
     void recycleUnreferenced();
 
+    FrameData* popFrameData(int numaNode);
+
 protected:
 
     void computeRPS(int curPoc,int tempId, bool isRAP, RPS * rps, unsigned int maxDecPicBuffer, int sLayerId);
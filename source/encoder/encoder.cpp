@@ -34,6 +34,7 @@
 
 #include "encoder.h"
 #include "slicetype.h"
+#include "lookaheadfile.h"
 #include "frameencoder.h"
 #include "ratecontrol.h"
 #include "dpb.h"
@@ -125,12 +126,18 @@ Encoder::Encoder()
     m_reconfigureRc = false;
     m_encodedFrameNum = 0;
     m_pocLast = -1;
+    memset(m_prevDecideSetting, 0, sizeof(m_prevDecideSetting));
     m_curEncoder = 0;
+    for (int i = 0; i < 3; i++)
+        m_splitModel[i].reset();
     m_numLumaWPFrames = 0;
     m_numChromaWPFrames = 0;
     m_numLumaWPBiFrames = 0;
     m_numChromaWPBiFrames = 0;
     m_lookahead = NULL;
+    m_lookaheadFileOut = NULL;
+    m_lookaheadFileIn = NULL;
+    m_lookaheadOnlyHeld = NULL;
     m_rateControl = NULL;
     m_dpb = NULL;
     m_numDelayedPic = 0;
@@ -472,6 +479,19 @@ void Encoder::create()
     if (!m_lookahead->create())
         m_aborted = true;
 
+    if (strlen(m_param->lookaheadSave))
+    {
+        m_lookaheadFileOut = new LookaheadFile;
+        if (!m_lookaheadFileOut->create(*m_param, m_param->lookaheadSave))
+            m_aborted = true;
+    }
+    if (strlen(m_param->lookaheadLoad))
+    {
+        m_lookaheadFileIn = new LookaheadFile;
+        if (!m_lookaheadFileIn->open(*m_param, m_param->lookaheadLoad))
+            m_aborted = true;
+    }
+
     initRefIdx();
     if (strlen(m_param->analysisSave) && m_param->bUseAnalysisFile)
     {
@@ -926,6 +946,11 @@ void Encoder::destroy()
         delete m_lookahead;
     }
 
+    /* input buffers the caller never submitted are released with the DPB */
+    while (!m_inputBufferList.empty())
+        m_dpb->m_freeList.pushBack(*m_inputBufferList.popFront());
+    if (m_lookaheadOnlyHeld)
+        m_dpb->m_freeList.pushBack(*m_lookaheadOnlyHeld);
     delete m_dpb;
     if (!m_param->bResetZoneConfig && m_param->rc.zonefileCount)
     {
@@ -941,6 +966,9 @@ void Encoder::destroy()
 
     X265_FREE(m_offsetEmergency);
 
+    delete m_lookaheadFileOut;
+    delete m_lookaheadFileIn;
+
     if (m_analysisFileIn)
         fclose(m_analysisFileIn);
 
@@ -1398,6 +1426,194 @@ bool Encoder::isFilterThisframe(uint8_t sliceTypeConfig, int curSliceType)
     return ((sliceTypeConfig & newSliceType) != 0);
 }
 
+/* Take a source frame from the DPB free list, or allocate a new one when the
+ * free list is empty. Called by encode() and, for in-place input, by
+ * getInputBuffer() from the caller's input thread */
+Frame* Encoder::allocSourceFrame(x265_param* p, int layer, float* quantOffsets)
+{
+    ScopedLock lock(m_inputBufferLock);
+
+    Frame* frame;
+#if !ENABLE_MULTIVIEW && !ENABLE_ALPHA
+    (void)layer;
+#endif
+    if (m_dpb->m_freeList.empty())
+    {
+        frame = new Frame;
+        frame->m_encodeStartTime = x265_mdate();
+#if ENABLE_MULTIVIEW
+        frame->m_viewId = m_param->numViews > 1 ? layer : 0;
+#endif
+#if ENABLE_ALPHA
+        frame->m_sLayerId = m_param->numScalableLayers > 1 ? layer : 0;
+#endif
+        frame->m_valid = false;
+        /* source and lowres planes are mostly worked on by the lookahead */
+        int numaNode = m_lookahead->m_pool ? m_lookahead->m_pool->m_numaNode : -1;
+        if (frame->create(p, quantOffsets, numaNode))
+        {
+            /* the first PicYuv created is asked to generate the CU and block unit offset
+             * arrays which are then shared with all subsequent PicYuv (orig and recon)
+             * allocated by this top level encoder */
+            if (m_sps.cuOffsetY)
+            {
+                frame->m_fencPic->m_cuOffsetY = m_sps.cuOffsetY;
+                frame->m_fencPic->m_buOffsetY = m_sps.buOffsetY;
+                if (m_param->internalCsp != X265_CSP_I400)
+                {
+                    frame->m_fencPic->m_cuOffsetC = m_sps.cuOffsetC;
+                    frame->m_fencPic->m_buOffsetC = m_sps.buOffsetC;
+                }
+            }
+            else
+            {
+                if (!frame->m_fencPic->createOffsets(m_sps))
+                {
+                    m_aborted = true;
+                    x265_log(m_param, X265_LOG_ERROR, "memory allocation failure, aborting encode\n");
+                    frame->destroy();
+                    delete frame;
+                    return NULL;
+                }
+                else
+                {
+                    m_sps.cuOffsetY = frame->m_fencPic->m_cuOffsetY;
+                    m_sps.buOffsetY = frame->m_fencPic->m_buOffsetY;
+                    if (m_param->internalCsp != X265_CSP_I400)
+                    {
+                        m_sps.cuOffsetC = frame->m_fencPic->m_cuOffsetC;
+                        m_sps.cuOffsetY = frame->m_fencPic->m_cuOffsetY;
+                        m_sps.buOffsetC = frame->m_fencPic->m_buOffsetC;
+                        m_sps.buOffsetY = frame->m_fencPic->m_buOffsetY;
+                    }
+                }
+            }
+        }
+        else
+        {
+            m_aborted = true;
+            x265_log(m_param, X265_LOG_ERROR, "memory allocation failure, aborting encode\n");
+            frame->destroy();
+            delete frame;
+            return NULL;
+        }
+    }
+    else
+    {
+        frame = m_dpb->m_freeList.popBack();
+        frame->m_encodeStartTime = x265_mdate();
+        /* Set lowres scencut and satdCost here to aovid overwriting ANALYSIS_READ
+           decision by lowres init*/
+        int cuCount = frame->m_lowres.maxBlocksInRow * frame->m_lowres.maxBlocksInCol;
+        memset(frame->m_lowres.intraCost, 0, sizeof(int32_t) * cuCount);
+        frame->m_lowres.bScenecut = false;
+        frame->m_lowres.satdCost = (int64_t)-1;
+        frame->m_lowresInit = false;
+        frame->m_isInsideWindow = 0;
+        frame->m_tempLayer = 0;
+        frame->m_sameLayerRefPic = 0;
+#if ENABLE_MULTIVIEW
+        frame->m_viewId = m_param->numViews > 1 ? layer : 0;
+#endif
+#if ENABLE_ALPHA
+        frame->m_sLayerId = m_param->numScalableLayers > 1 ? layer : 0;
+#endif
+        frame->m_valid = false;
+        frame->m_lowres.bKeyframe = false;
+#if ENABLE_MULTIVIEW
+        //Destroy interlayer References
+        //TODO Move this to end(after compress frame)
+        if (frame->refPicSetInterLayer0.size())
+        {
+            Frame* iterFrame = frame->refPicSetInterLayer0.first();
+
+            while (iterFrame)
+            {
+                Frame* curFrame = iterFrame;
+                iterFrame = iterFrame->m_nextSubDPB;
+                frame->refPicSetInterLayer0.removeSubDPB(*curFrame);
+                iterFrame = frame->refPicSetInterLayer0.first();
+            }
+        }
+
+        if (frame->refPicSetInterLayer1.size())
+        {
+            Frame* iterFrame = frame->refPicSetInterLayer1.first();
+
+            while (iterFrame)
+            {
+                Frame* curFrame = iterFrame;
+                iterFrame = iterFrame->m_nextSubDPB;
+                frame->refPicSetInterLayer1.removeSubDPB(*curFrame);
+                iterFrame = frame->refPicSetInterLayer1.first();
+            }
+        }
+#endif
+    }
+
+    return frame;
+}
+
+x265_picture* Encoder::getInputBuffer()
+{
+    /* in-place input is offered only when encode() would copy into a single
+     * source PicYuv; every other configuration keeps caller-owned pictures */
+    if (!m_param->bCopyPicToFrame || m_param->numLayers > 1 || m_param->bEnableFrameDuplication ||
+        m_param->bEnableSvtHevc || m_aborted)
+        return NULL;
+
+    x265_param* p = (m_reconfigure || m_reconfigureRc || m_param->bConfigRCFrame) ? m_latestParam : m_param;
+    Frame* frame = allocSourceFrame(p, 0, NULL);
+    if (!frame)
+        return NULL;
+
+    PicYuv* fenc = frame->m_fencPic;
+    x265_picture* pic = &frame->m_inputPic;
+    x265_picture_init(m_param, pic);
+    pic->width = m_param->sourceWidth - m_sps.conformanceWindow.rightOffset;
+    pic->height = m_param->sourceHeight - m_sps.conformanceWindow.bottomOffset;
+    pic->planes[0] = fenc->m_picOrg[0];
+    pic->stride[0] = (int)(fenc->m_stride * sizeof(pixel));
+    if (m_param->internalCsp != X265_CSP_I400)
+    {
+        pic->planes[1] = fenc->m_picOrg[1];
+        pic->planes[2] = fenc->m_picOrg[2];
+        pic->stride[1] = pic->stride[2] = (int)(fenc->m_strideC * sizeof(pixel));
+    }
+
+    ScopedLock lock(m_inputBufferLock);
+    m_inputBufferList.pushBack(*frame);
+    return pic;
+}
+
+void Encoder::releaseInputBuffer(x265_picture* pic)
+{
+    Frame* frame = takeInputBuffer(pic);
+    if (frame)
+    {
+        ScopedLock lock(m_inputBufferLock);
+        m_dpb->m_freeList.pushBack(*frame);
+    }
+}
+
+/* Find the outstanding input buffer whose planes the picture points at, and
+ * remove it from the list of buffers owned by the caller */
+Frame* Encoder::takeInputBuffer(const x265_picture* pic)
+{
+    ScopedLock lock(m_inputBufferLock);
+
+    for (Frame* frame = m_inputBufferList.first(); frame; frame = frame->m_next)
+    {
+        if (frame->m_fencPic->m_picOrg[0] == pic->planes[0])
+        {
+            m_inputBufferList.remove(*frame);
+            return frame;
+        }
+    }
+
+    return NULL;
+}
+
 /**
  * Feed one new input frame into the encoder, get one frame out. If pic_in is
  * NULL, a flush condition is implied and pic_in must be NULL for all subsequent
@@ -1436,7 +1652,10 @@ int Encoder::encode(const x265_picture* pic_in, x265_picture* pic_out)
             ATOMIC_DEC(&m_exportedPic[i]->m_countRefEncoders);
             m_exportedPic[i] = NULL;
         }
-        m_dpb->recycleUnreferenced();
+        {
+            ScopedLock lock(m_inputBufferLock);
+            m_dpb->recycleUnreferenced();
+        }
 
         if (m_param->bEnableTemporalFilter)
             m_lookahead->m_origPicBuf->recycleOrigPicList();
@@ -1533,120 +1752,18 @@ int Encoder::encode(const x265_picture* pic_in, x265_picture* pic_out)
         Frame* inFrame[MAX_LAYERS];
         for (int layer = 0; layer < m_param->numLayers; layer++)
         {
-            if (m_dpb->m_freeList.empty())
-            {
-                inFrame[layer] = new Frame;
+            const x265_picture* srcPic = inputPic[!m_param->format ? (m_param->numScalableLayers > 1) ? 0 : layer : 0];
+            /* a picture from getInputBuffer() already lives in its frame's PicYuv */
+            inFrame[layer] = takeInputBuffer(srcPic);
+            if (inFrame[layer])
                 inFrame[layer]->m_encodeStartTime = x265_mdate();
-#if ENABLE_MULTIVIEW
-                inFrame[layer]->m_viewId = m_param->numViews > 1 ? layer : 0;
-#endif
-#if ENABLE_ALPHA
-                inFrame[layer]->m_sLayerId = m_param->numScalableLayers > 1 ? layer : 0;
-#endif
-                inFrame[layer]->m_valid = false;
-                if (inFrame[layer]->create(p, inputPic[!m_param->format ? (m_param->numScalableLayers > 1) ? 0 : layer : 0]->quantOffsets))
-                {
-                    /* the first PicYuv created is asked to generate the CU and block unit offset
-                     * arrays which are then shared with all subsequent PicYuv (orig and recon)
-                     * allocated by this top level encoder */
-                    if (m_sps.cuOffsetY)
-                    {
-                        inFrame[layer]->m_fencPic->m_cuOffsetY = m_sps.cuOffsetY;
-                        inFrame[layer]->m_fencPic->m_buOffsetY = m_sps.buOffsetY;
-                        if (m_param->internalCsp != X265_CSP_I400)
-                        {
-                            inFrame[layer]->m_fencPic->m_cuOffsetC = m_sps.cuOffsetC;
-                            inFrame[layer]->m_fencPic->m_buOffsetC = m_sps.buOffsetC;
-                        }
-                    }
-                    else
-                    {
-                        if (!inFrame[layer]->m_fencPic->createOffsets(m_sps))
-                        {
-                            m_aborted = true;
-                            x265_log(m_param, X265_LOG_ERROR, "memory allocation failure, aborting encode\n");
-                            inFrame[layer]->destroy();
-                            delete inFrame[layer];
-                            return -1;
-                        }
-                        else
-                        {
-                            m_sps.cuOffsetY = inFrame[layer]->m_fencPic->m_cuOffsetY;
-                            m_sps.buOffsetY = inFrame[layer]->m_fencPic->m_buOffsetY;
-                            if (m_param->internalCsp != X265_CSP_I400)
-                            {
-                                m_sps.cuOffsetC = inFrame[layer]->m_fencPic->m_cuOffsetC;
-                                m_sps.cuOffsetY = inFrame[layer]->m_fencPic->m_cuOffsetY;
-                                m_sps.buOffsetC = inFrame[layer]->m_fencPic->m_buOffsetC;
-                                m_sps.buOffsetY = inFrame[layer]->m_fencPic->m_buOffsetY;
-                            }
-                        }
-                    }
-                }
-                else
-                {
-                    m_aborted = true;
-                    x265_log(m_param, X265_LOG_ERROR, "memory allocation failure, aborting encode\n");
-                    inFrame[layer]->destroy();
-                    delete inFrame[layer];
-                    return -1;
-                }
-            }
             else
-            {
-                inFrame[layer] = m_dpb->m_freeList.popBack();
-                inFrame[layer]->m_encodeStartTime = x265_mdate();
-                /* Set lowres scencut and satdCost here to aovid overwriting ANALYSIS_READ
-                   decision by lowres init*/
-                int cuCount = inFrame[layer]->m_lowres.maxBlocksInRow * inFrame[layer]->m_lowres.maxBlocksInCol;
-                memset(inFrame[layer]->m_lowres.intraCost, 0, sizeof(int32_t) * cuCount);
-                inFrame[layer]->m_lowres.bScenecut = false;
-                inFrame[layer]->m_lowres.satdCost = (int64_t)-1;
-                inFrame[layer]->m_lowresInit = false;
-                inFrame[layer]->m_isInsideWindow = 0;
-                inFrame[layer]->m_tempLayer = 0;
-                inFrame[layer]->m_sameLayerRefPic = 0;
-#if ENABLE_MULTIVIEW
-                inFrame[layer]->m_viewId = m_param->numViews > 1 ? layer : 0;
-#endif
-#if ENABLE_ALPHA
-                inFrame[layer]->m_sLayerId = m_param->numScalableLayers > 1 ? layer : 0;
-#endif
-                inFrame[layer]->m_valid = false;
-                inFrame[layer]->m_lowres.bKeyframe = false;
-#if ENABLE_MULTIVIEW
-                //Destroy interlayer References
-                //TODO Move this to end(after compress frame)
-                if (inFrame[layer]->refPicSetInterLayer0.size())
-                {
-                    Frame* iterFrame = inFrame[layer]->refPicSetInterLayer0.first();
-
-                    while (iterFrame)
-                    {
-                        Frame* curFrame = iterFrame;
-                        iterFrame = iterFrame->m_nextSubDPB;
-                        inFrame[layer]->refPicSetInterLayer0.removeSubDPB(*curFrame);
-                        iterFrame = inFrame[layer]->refPicSetInterLayer0.first();
-                    }
-                }
-
-                if (inFrame[layer]->refPicSetInterLayer1.size())
-                {
-                    Frame* iterFrame = inFrame[layer]->refPicSetInterLayer1.first();
-
-                    while (iterFrame)
-                    {
-                        Frame* curFrame = iterFrame;
-                        iterFrame = iterFrame->m_nextSubDPB;
-                        inFrame[layer]->refPicSetInterLayer1.removeSubDPB(*curFrame);
-                        iterFrame = inFrame[layer]->refPicSetInterLayer1.first();
-                    }
-                }
-#endif
-            }
+                inFrame[layer] = allocSourceFrame(p, layer, srcPic->quantOffsets);
+            if (!inFrame[layer])
+                return -1;
 
             /* Copy input picture into a Frame and PicYuv, send to lookahead */
-            inFrame[layer]->m_fencPic->copyFromPicture(*inputPic[!m_param->format ? (m_param->numScalableLayers > 1) ? 0 : layer : 0], *m_param, m_sps.conformanceWindow.rightOffset, m_sps.conformanceWindow.bottomOffset, !layer);
+            inFrame[layer]->m_fencPic->copyFromPicture(*srcPic, *m_param, m_sps.conformanceWindow.rightOffset, m_sps.conformanceWindow.bottomOffset, !layer);
 
             inFrame[layer]->m_poc = (!layer) ? (++m_pocLast) : m_pocLast;
             inFrame[layer]->m_userData = inputPic[0]->userData;
@@ -1705,6 +1822,9 @@ int Encoder::encode(const x265_picture* pic_in, x265_picture* pic_out)
                 cuCount = inFrame[0]->m_lowres.maxBlocksInRowFullRes * inFrame[0]->m_lowres.maxBlocksInColFullRes;
             else
                 cuCount = inFrame[0]->m_lowres.maxBlocksInRow * inFrame[0]->m_lowres.maxBlocksInCol;
+            /* frames handed out by getInputBuffer() are created without quant offsets */
+            if (!inFrame[0]->m_quantOffsets)
+                inFrame[0]->m_quantOffsets = new float[cuCount];
             memcpy(inFrame[0]->m_quantOffsets, inputPic[0]->quantOffsets, cuCount * sizeof(float));
         }
 
@@ -1725,6 +1845,17 @@ int Encoder::encode(const x265_picture* pic_in, x265_picture* pic_out)
 
         /* Use the frame types from the first pass, if available */
         int sliceType = (m_param->rc.bStatRead) ? m_rateControl->rateControlSliceType(inFrame[0]->m_poc) : X265_TYPE_AUTO;
+
+        /* or those of a lookahead analysis file, along with its cuTree offsets */
+        if (m_lookaheadFileIn)
+        {
+            sliceType = m_lookaheadFileIn->loadInput(*inFrame[0]);
+            if (sliceType < 0)
+            {
+                m_aborted = 1;
+                return -1;
+            }
+        }
         inFrame[0]->m_lowres.sliceTypeReq = inputPic[0]->sliceType;
 
         /* In analysisSave mode, x265_analysis_data is allocated in inputPic and inFrame points to this */
@@ -1894,6 +2025,9 @@ int Encoder::encode(const x265_picture* pic_in, x265_picture* pic_out)
     else
         m_lookahead->flush();
 
+    if (m_param->bLookaheadOnly)
+        return outputLookaheadOnly(pic_out);
+
     FrameEncoder *curEncoder = m_frameEncoder[m_curEncoder];
     m_curEncoder = (m_curEncoder + 1) % m_param->frameNumThreads;
     int ret = 0;
@@ -1923,6 +2057,9 @@ int Encoder::encode(const x265_picture* pic_in, x265_picture* pic_out)
                 /* Free up inputPic->analysisData since it has already been used */
                 if ((strlen(m_param->analysisLoad) && !strlen(m_param->analysisSave)) || ((m_param->bAnalysisType == AVC_INFO) && slice->m_sliceType != I_SLICE))
                     x265_free_analysis_data(m_param, &outFrame->m_analysisData);
+                /* no motion search of this picture is left to use its shared motion fields */
+                if (!sLayer && outFrame->m_mvFieldCache)
+                    outFrame->m_mvFieldCache->evict(outFrame->m_poc);
                 if (pic_out)
                 {
                     PicYuv* recpic = outFrame->m_reconPic[0];
@@ -2137,7 +2274,10 @@ int Encoder::encode(const x265_picture* pic_in, x265_picture* pic_out)
                 if (!pic_out)
                 {
                     ATOMIC_DEC(&outFrame->m_countRefEncoders);
-                    m_dpb->recycleUnreferenced();
+                    {
+                        ScopedLock lock(m_inputBufferLock);
+                        m_dpb->recycleUnreferenced();
+                    }
                     if (m_param->bEnableTemporalFilter)
                         m_lookahead->m_origPicBuf->recycleOrigPicList();
                 }
@@ -2158,8 +2298,26 @@ int Encoder::encode(const x265_picture* pic_in, x265_picture* pic_out)
          * curEncoder is guaranteed to be idle at this point */
         if (!pass)
             frameEnc[0] = m_lookahead->getDecidedPicture();
+        if (frameEnc[0] && m_lookahead->m_bFailed)
+        {
+            /* its slice type and costs were decided from incomplete estimates */
+            x265_log(m_param, X265_LOG_ERROR, "lookahead failed, aborting encode\n");
+            {
+                ScopedLock lock(m_inputBufferLock);
+                m_dpb->m_freeList.pushBack(*frameEnc[0]);
+            }
+            m_aborted = true;
+            return -1;
+        }
         if (frameEnc[0] && !pass && (!m_param->chunkEnd || (m_encodedFrameNum < m_param->chunkEnd)))
         {
+            if (m_lookaheadFileOut && !m_lookaheadFileOut->write(*frameEnc[0]))
+            {
+                m_aborted = true;
+                return -1;
+            }
+            if (m_lookaheadFileIn)
+                m_lookaheadFileIn->loadDecided(*frameEnc[0]);
 
 #if ENABLE_ALPHA || ENABLE_MULTIVIEW
             //Pop non base view pictures from DPB piclist
@@ -2258,20 +2416,22 @@ int Encoder::encode(const x265_picture* pic_in, x265_picture* pic_out)
             curEncoder->m_param = m_reconfigure ? m_latestParam : m_param;
             curEncoder->m_reconfigure = m_reconfigure;
 
-            /* give this frame a FrameData instance before encoding */
+            /* give this frame a FrameData instance before encoding, allocated on
+             * the NUMA node of the pool which runs this frame encoder */
+            int numaNode = curEncoder->m_pool ? curEncoder->m_pool->m_numaNode : -1;
             for (int layer = 0; layer < m_param->numLayers; layer++)
             {
-                if (m_dpb->m_frameDataFreeList)
+                FrameData* encData = m_dpb->popFrameData(numaNode);
+                if (encData)
                 {
-                    frameEnc[layer]->m_encData = m_dpb->m_frameDataFreeList;
-                    m_dpb->m_frameDataFreeList = m_dpb->m_frameDataFreeList->m_freeListNext;
+                    frameEnc[layer]->m_encData = encData;
                     frameEnc[layer]->reinit(m_sps);
                     frameEnc[layer]->m_param = m_reconfigure ? m_latestParam : m_param;
                     frameEnc[layer]->m_encData->m_param = m_reconfigure ? m_latestParam : m_param;
                 }
                 else
                 {
-                    frameEnc[layer]->allocEncodeData(m_reconfigure ? m_latestParam : m_param, m_sps);
+                    frameEnc[layer]->allocEncodeData(m_reconfigure ? m_latestParam : m_param, m_sps, numaNode);
                     Slice* slice = frameEnc[layer]->m_encData->m_slice;
                     slice->m_sps = &m_sps;
                     slice->m_pps = &m_pps;
@@ -2312,7 +2472,7 @@ int Encoder::encode(const x265_picture* pic_in, x265_picture* pic_out)
                     int maxHeight = numCuInHeight * m_param->maxCUSize;
                     for (int i = 0; i < INTEGRAL_PLANE_NUM; i++)
                     {
-                        frameEnc[layer]->m_encData->m_meBuffer[i] = X265_MALLOC(uint32_t, frameEnc[layer]->m_reconPic[0]->m_stride * (maxHeight + (2 * padY)));
+                        frameEnc[layer]->m_encData->m_meBuffer[i] = X265_MALLOC_NODE(uint32_t, frameEnc[layer]->m_reconPic[0]->m_stride * (maxHeight + (2 * padY)), frameEnc[layer]->m_encData->m_numaNode);
                         if (frameEnc[layer]->m_encData->m_meBuffer[i])
                         {
                             memset(frameEnc[layer]->m_encData->m_meBuffer[i], 0, sizeof(uint32_t) * frameEnc[layer]->m_reconPic[0]->m_stride * (maxHeight + (2 * padY)));
@@ -2479,9 +2639,26 @@ int Encoder::encode(const x265_picture* pic_in, x265_picture* pic_out)
                 }
             }
 
+            /* the frame this encoder finished last trains the split model of
+             * its slice type. A frame sees the decisions of the frames coded
+             * frameNumThreads or more frames before it, whatever the timing
+             * of the frame threads */
+            if (m_param->bSplitPredict)
+            {
+                if (curEncoder->m_splitSliceType >= 0)
+                {
+                    m_splitModel[curEncoder->m_splitSliceType].update(curEncoder->m_splitFrameStats);
+                    curEncoder->m_splitFrameStats.reset();
+                }
+                curEncoder->m_splitSliceType = frameEnc[0]->m_encData->m_slice->m_sliceType;
+                curEncoder->m_splitModel = m_splitModel[curEncoder->m_splitSliceType];
+            }
+
             /* Allow FrameEncoder::compressFrame() to start in the frame encoder thread */
             if (!curEncoder->startCompressFrame(frameEnc))
                 m_aborted = true;
+            if (m_lookahead->m_bAdaptiveLookahead)
+                m_lookahead->reportThroughput(curEncoder->m_slicetypeWaitTime[0]);
         }
         else if (m_encodedFrameNum)
             m_rateControl->setFinalFrameCount(m_encodedFrameNum);
@@ -2491,6 +2668,65 @@ int Encoder::encode(const x265_picture* pic_in, x265_picture* pic_out)
     return ret;
 }
 
+/* Lookahead-only mode: save the analysis of the next picture leaving the
+ * lookahead and recycle it without encoding. Returns 1 for each picture so
+ * the caller keeps flushing until the lookahead is drained */
+int Encoder::outputLookaheadOnly(x265_picture* pic_out)
+{
+    Frame* frame = m_lookahead->getDecidedPicture();
+    if (!frame)
+        return 0;
+
+    if (m_lookahead->m_bFailed)
+    {
+        x265_log(m_param, X265_LOG_ERROR, "lookahead failed, aborting encode\n");
+        {
+            ScopedLock lock(m_inputBufferLock);
+            m_dpb->m_freeList.pushBack(*frame);
+        }
+        m_aborted = true;
+        return -1;
+    }
+
+    if (m_lookaheadFileOut && !m_lookaheadFileOut->write(*frame))
+    {
+        m_aborted = true;
+        return -1;
+    }
+    if (frame->m_mvFieldCache)
+        frame->m_mvFieldCache->evict(frame->m_poc);
+
+    if (pic_out)
+    {
+        x265_picture_init(m_param, pic_out);
+        pic_out->poc = frame->m_poc;
+        pic_out->pts = frame->m_pts;
+        pic_out->dts = frame->m_reorderedPts;
+        pic_out->sliceType = frame->m_lowres.sliceType;
+        pic_out->planes[0] = pic_out->planes[1] = pic_out->planes[2] = NULL;
+    }
+    m_nalList.m_numNal = 0;
+    m_encodedFrameNum++;
+    m_outputCount++;
+    m_numDelayedPic--;
+
+    /* the last non-B picture is the first reference of the next mini-GOP the
+     * lookahead decides, so its lowres is kept until another one leaves */
+    Frame* recycle = frame;
+    if (!IS_X265_TYPE_B(frame->m_lowres.sliceType))
+    {
+        recycle = m_lookaheadOnlyHeld;
+        m_lookaheadOnlyHeld = frame;
+    }
+    if (recycle)
+    {
+        recycle->m_lowres.releaseTables();
+        ScopedLock lock(m_inputBufferLock);
+        m_dpb->m_freeList.pushBack(*recycle);
+    }
+    return 1;
+}
+
 int Encoder::reconfigureParam(x265_param* encParam, x265_param* param)
 {
     if (isReconfigureRc(encParam, param) && !param->rc.zonefileCount)
@@ -2770,6 +3006,26 @@ void Encoder::printSummary()
                 (float)100.0 * m_numLumaWPBiFrames / m_analyzeB[layer].m_numPics,
                 (float)100.0 * m_numChromaWPBiFrames / m_analyzeB[layer].m_numPics);
         }
+        if (!layer && m_lookahead && m_lookahead->m_tablePool.frameBytes)
+        {
+            const LowresTablePool& pool = m_lookahead->m_tablePool;
+            x265_log(m_param, X265_LOG_INFO, "lowres memory per frame: %.1f KiB fixed, %.1f KiB cost tables (%.1f KiB if allocated up front), %.1f MiB of tables at peak\n",
+                     pool.frameBytes / 1024.0, pool.avgFrameBytes() / 1024.0, pool.fullFrameBytes / 1024.0, pool.peakBytes() / (1024.0 * 1024.0));
+        }
+        if (!layer && m_lookahead && m_lookahead->m_bAdaptiveLookahead)
+        {
+            const LookaheadThroughput& tp = m_lookahead->m_throughput;
+            x265_log(m_param, X265_LOG_INFO, "adaptive lookahead: %u changes, %.1f%% of frames below the %d frame window, ended at window %d trellis %d slices %d\n",
+                     tp.numChanges, tp.numReports ? 100.0 * tp.numReducedFrames / tp.numReports : 0.0, tp.maxDepth, tp.depth, tp.trellis, tp.slices);
+        }
+        if (!layer && m_lookahead && m_lookahead->m_bShareMotionFields)
+        {
+            MotionFieldCache::Stats stats = m_lookahead->m_mvFieldCache.getStats();
+            x265_log(m_param, X265_LOG_INFO, "shared motion fields: %.1f%% of %llu MCSTF searches seeded, %llu of %llu layers skipped, %.1f MiB at peak\n",
+                     stats.seedLookups ? 100.0 * stats.seedHits / stats.seedLookups : 0.0, (unsigned long long)stats.seedLookups,
+                     (unsigned long long)stats.layersSkipped, (unsigned long long)(stats.layersSkipped + stats.layersSearched),
+                     stats.peakBytes / (1024.0 * 1024.0));
+        }
 
         if (m_param->bLossless)
         {
@@ -2787,7 +3043,9 @@ void Encoder::printSummary()
                 (float)100.0 * (m_rateControl->m_numEntries - m_rpsInSpsCount) / m_rateControl->m_numEntries);
         }
 
-        if (m_param->totalFrames && (uint32_t)m_param->totalFrames > m_analyzeAll[layer].m_numPics)
+        if (m_param->bLookaheadOnly)
+            x265_log(m_param, X265_LOG_INFO, "lookahead-only: %d frames analysed\n", m_outputCount);
+        else if (m_param->totalFrames && (uint32_t)m_param->totalFrames > m_analyzeAll[layer].m_numPics)
             x265_log(m_param, X265_LOG_ERROR, "not all %d frames encoded.\n", m_param->totalFrames);
 
         if (m_analyzeAll[layer].m_numPics)
@@ -2836,7 +3094,7 @@ void Encoder::printSummary()
         uint64_t batchCount, coopSliceCount;
         m_lookahead->getWorkerStats(batchElapsedTime, batchCount, coopSliceElapsedTime, coopSliceCount);
         int64_t lookaheadWorkerTime = m_lookahead->m_slicetypeDecideElapsedTime + m_lookahead->m_preLookaheadElapsedTime +
-            batchElapsedTime + coopSliceElapsedTime;
+            m_lookahead->m_cuTreeElapsedTime + batchElapsedTime + coopSliceElapsedTime;
 
         int64_t totalWorkerTime = cuStats.totalCTUTime + cuStats.loopFilterElapsedTime + cuStats.pmodeTime +
             cuStats.pmeTime + lookaheadWorkerTime + cuStats.weightAnalyzeTime;
@@ -2921,6 +3179,10 @@ void Encoder::printSummary()
             100.0 * lookaheadWorkerTime / totalWorkerTime,
             ELAPSED_MSEC(m_lookahead->m_slicetypeDecideElapsedTime) / m_lookahead->m_countSlicetypeDecide,
             ELAPSED_MSEC(m_lookahead->m_preLookaheadElapsedTime) / m_lookahead->m_countPreLookahead);
+        if (m_lookahead->m_countCuTree)
+            x265_log(m_param, X265_LOG_INFO, "CU: %%%05.2lf time spent in the pipelined cuTree/VBV stage (avg %.3lfms)\n",
+                100.0 * m_lookahead->m_cuTreeElapsedTime / totalWorkerTime,
+                ELAPSED_MSEC(m_lookahead->m_cuTreeElapsedTime) / m_lookahead->m_countCuTree);
 
         x265_log(m_param, X265_LOG_INFO, "CU: %%%05.2lf time spent in other tasks\n",
             100.0 * unaccounted / totalWorkerTime);
@@ -3125,6 +3387,16 @@ void Encoder::finishFrameStats(Frame* curFrame, FrameEncoder *curEncoder, x265_f
         if (m_param->csvLogLevel >= 2)
             frameStats->unclippedBufferFillFinal = m_rateControl->m_unclippedBufferFillFinal;
         frameStats->frameLatency = inPoc - poc;
+        frameStats->lookaheadDepth = curFrame->m_decideDepth;
+        frameStats->lookaheadTrellis = curFrame->m_decideTrellis;
+        frameStats->lookaheadSlices = curFrame->m_decideSlices;
+        frameStats->bLookaheadAdapted = 0;
+        if (!layer && curFrame->m_decideDepth)
+        {
+            const int setting[3] = { curFrame->m_decideDepth, curFrame->m_decideTrellis, curFrame->m_decideSlices };
+            frameStats->bLookaheadAdapted = m_prevDecideSetting[0] && memcmp(setting, m_prevDecideSetting, sizeof(setting));
+            memcpy(m_prevDecideSetting, setting, sizeof(setting));
+        }
         if (m_param->rc.rateControlMode == X265_RC_CRF)
             frameStats->rateFactor = curEncData.m_rateFactor;
         frameStats->psnrY = psnrY;
@@ -3163,6 +3435,13 @@ void Encoder::finishFrameStats(Frame* curFrame, FrameEncoder *curEncoder, x265_f
                 frameStats->avgWPP = 1;
             frameStats->countRowBlocks = curEncoder->m_countRowBlocks;
 
+            int64_t refStall, wppStall, maxRowRefStall, maxRowWppStall;
+            curEncoder->getStallStats(refStall, wppStall, maxRowRefStall, maxRowWppStall);
+            frameStats->refStallTime = ELAPSED_MSEC(0, refStall);
+            frameStats->wppStallTime = ELAPSED_MSEC(0, wppStall);
+            frameStats->maxRowRefStallTime = ELAPSED_MSEC(0, maxRowRefStall);
+            frameStats->maxRowWppStallTime = ELAPSED_MSEC(0, maxRowWppStall);
+
             frameStats->avgChromaDistortion = curFrame->m_encData->m_frameStats.avgChromaDistortion;
             frameStats->avgLumaDistortion = curFrame->m_encData->m_frameStats.avgLumaDistortion;
             frameStats->avgPsyEnergy = curFrame->m_encData->m_frameStats.avgPsyEnergy;
@@ -4087,6 +4366,33 @@ void Encoder::configure(x265_param *p)
         p->analysisSave[0] = p->analysisLoad[0] = 0;
         p->analysisMultiPassRefine = p->analysisMultiPassDistortion = 0;
     }
+
+    if (strlen(p->lookaheadLoad) && (p->rc.bStatRead || strlen(p->analysisLoad) || p->bAdaptiveLookahead))
+    {
+        x265_log(p, X265_LOG_WARNING, "lookahead-load is incompatible with pass 2, analysis-load and adaptive-lookahead, disabling lookahead-load\n");
+        p->lookaheadLoad[0] = 0;
+    }
+
+    if (p->bLookaheadOnly)
+    {
+        if (!strlen(p->lookaheadSave))
+            x265_log(p, X265_LOG_WARNING, "lookahead-only without lookahead-save discards the analysis\n");
+        if (p->bEnableFrameDuplication || p->bEnableTemporalFilter || strlen(p->analysisSave) || strlen(p->analysisLoad) || p->rc.bStatWrite)
+        {
+            x265_log(p, X265_LOG_WARNING, "lookahead-only disables mcstf, frame-dup, analysis save/load and stat files\n");
+            p->bEnableFrameDuplication = p->bEnableTemporalFilter = 0;
+            p->analysisSave[0] = p->analysisLoad[0] = 0;
+            p->rc.bStatWrite = 0;
+        }
+        if (p->numLayers > 1)
+        {
+            x265_log(p, X265_LOG_ERROR, "lookahead-only supports a single layer\n");
+            m_aborted = true;
+        }
+
+        /* no picture is encoded, the pool is left to the lookahead */
+        p->frameNumThreads = 1;
+    }
     if (p->scaleFactor)
     {
         if (p->scaleFactor == 1)
@@ -4123,6 +4429,11 @@ void Encoder::configure(x265_param *p)
             p->interRefine = 0;
         }
     }
+    if (p->bSplitPredict && (p->analysisLoadReuseLevel > 1 || p->analysisMultiPassRefine || p->bCTUInfo))
+    {
+        x265_log(p, X265_LOG_WARNING, "split-predict is incompatible with analysis load, multi-pass refine and ctu-info. Disabling split-predict.\n");
+        p->bSplitPredict = 0;
+    }
     if (p->scaleFactor && !p->interRefine && !p->bDynamicRefine && p->analysisLoadReuseLevel == 10)
     {
         x265_log(p, X265_LOG_WARNING, "Inter refinement 0 is not supported with scaling and analysis-reuse-level=10. Enabling refine-inter 1.\n");
@@ -33,6 +33,7 @@
 #include "framedata.h"
 #include "svt.h"
 #include "temporalfilter.h"
+#include "splitpredict.h"
 #ifdef ENABLE_HDR10_PLUS
     #include "dynamicHDR10/hdr10plus.h"
 #endif
@@ -160,6 +161,7 @@ struct AdaptiveFrameDuplication
 class FrameEncoder;
 class DPB;
 class Lookahead;
+class LookaheadFile;
 class RateControl;
 class ThreadPool;
 class FrameData;
@@ -184,6 +186,7 @@ public:
     int64_t            m_encodeStartTime;
 
     int                m_pocLast;         // time index (POC)
+    int                m_prevDecideSetting[3]; // lookahead setting of the previous frame, for x265_frame_stats
     int                m_encodedFrameNum;
     int                m_outputCount;
     int                m_bframeDelay;
@@ -212,6 +215,9 @@ public:
     x265_param*        m_zoneParam;
     RateControl*       m_rateControl;
     Lookahead*         m_lookahead;
+    LookaheadFile*     m_lookaheadFileOut;  // lookahead-save
+    LookaheadFile*     m_lookaheadFileIn;   // lookahead-load
+    Frame*             m_lookaheadOnlyHeld; // last non-B picture output by lookahead-only
     AdaptiveFrameDuplication* m_dupBuffer[DUP_BUFFER];      // picture buffer of size 2
     /*Frame duplication: Two pictures used to compute PSNR */
     pixel*             m_dupPicOne[3];
@@ -280,6 +286,15 @@ public:
     int32_t                 m_startPoint;
     Lock                    m_dynamicRefineLock;
 
+    /* split-predict models per slice type, trained with the split decisions
+     * of completed frames in encode order */
+    SplitModel              m_splitModel[3];
+
+    /* Source frames handed out for in-place input; the lock also protects the
+     * DPB free list since the input layer may request buffers from its own thread */
+    Lock                    m_inputBufferLock;
+    PicList                 m_inputBufferList;
+
     bool                    m_saveCTUSize;
 
 
@@ -305,6 +320,12 @@ public:
 
     int encode(const x265_picture* pic, x265_picture *pic_out);
 
+    int outputLookaheadOnly(x265_picture *pic_out);
+
+    x265_picture* getInputBuffer();
+
+    void releaseInputBuffer(x265_picture* pic);
+
     int reconfigureParam(x265_param* encParam, x265_param* param);
 
     bool isReconfigureRc(x265_param* latestParam, x265_param* param_in);
@@ -388,6 +409,9 @@ protected:
     void initVPS(VPS *vps);
     void initSPS(SPS *sps);
     void initPPS(PPS *pps);
+
+    Frame* allocSourceFrame(x265_param* p, int layer, float* quantOffsets);
+    Frame* takeInputBuffer(const x265_picture* pic);
 };
 }
 
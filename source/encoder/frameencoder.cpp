@@ -58,6 +58,9 @@ FrameEncoder::FrameEncoder()
     m_ctuGeomMap = NULL;
     m_localTldIdx = 0;
     memset(&m_rce, 0, sizeof(RateControlEntry));
+    m_splitModel.reset();
+    m_splitFrameStats.reset();
+    m_splitSliceType = -1;
     for (int layer = 0; layer < MAX_LAYERS; layer++)
     {
         m_prevOutputTime[layer] = x265_mdate();
@@ -163,7 +166,7 @@ bool FrameEncoder::init(Encoder *top, int numRows, int numCols)
 
     /* determine full motion search range */
     int range  = m_param->searchRange;       /* fpel search */
-    range += !!(m_param->searchMethod < 2);  /* diamond/hex range check lag */
+    range += !!(m_param->searchMethod < 2 || m_param->searchMethod == X265_EPZS_SEARCH); /* diamond/hex range check lag */
     range += NTAPS_LUMA / 2;                 /* subpel filter half-length */
     range += 2 + (MotionEstimate::hpelIterationCount(m_param->subpelRefine) + 1) / 2; /* subpel refine steps */
     m_refLagRows = /*(m_param->maxSlices > 1 ? 1 : 0) +*/ 1 + ((range + m_param->maxCUSize - 1) / m_param->maxCUSize);
@@ -573,6 +576,13 @@ void FrameEncoder::compressFrame(int layer)
                 w = slice->m_weightPredTable[l][ref];
             slice->m_refReconPicList[l][ref] = slice->m_refFrameList[l][ref]->m_reconPic[0];
             m_mref[l][ref].init(slice->m_refReconPicList[l][ref], w, *m_param);
+
+            /* global motion for --me epzs, from the lookahead vectors Search::getLowresMV() would use */
+            m_mref[l][ref].globalMV = 0;
+            int diffPoc = abs(slice->m_poc - slice->m_refPOCList[l][ref]);
+            if (m_param->searchMethod == X265_EPZS_SEARCH && !layer && diffPoc <= m_param->bframes + 1 &&
+                !strlen(m_param->analysisSave) && !strlen(m_param->analysisLoad))
+                m_mref[l][ref].globalMV = m_frame[layer]->m_lowres.medianMV(l, diffPoc) << 1;
         }
         if (strlen(m_param->analysisSave) && (bUseWeightP || bUseWeightB))
         {
@@ -657,7 +667,7 @@ void FrameEncoder::compressFrame(int layer)
     if (m_param->bEnableTemporalFilter)
     {
         m_frame[layer]->m_mcstf->m_QP = qp;
-        m_frame[layer]->m_mcstf->bilateralFilter(m_frame[layer], m_frame[layer]->m_mcstfRefList, m_param->temporalFilterStrength);
+        m_frame[layer]->m_mcstf->bilateralFilter(m_frame[layer], m_frame[layer]->m_mcstfRefList, m_param->temporalFilterStrength, m_pool ? this : NULL);
     }
 
     if (m_nr)
@@ -939,6 +949,18 @@ void FrameEncoder::compressFrame(int layer)
 
     if (m_param->bEnableWavefront)
     {
+        /* Weighted references are generated row by row in order, so they are
+         * still waited on by this thread. Otherwise each row registers an edge
+         * on the reference rows it needs and is enabled by the worker which
+         * reconstructs the last of them, without this thread blocking */
+        bool bWeightedRefs = false;
+        for (int l = 0; l < numPredDir; l++)
+            for (int ref = 0; ref < slice->m_numRefIdx[l]; ref++)
+                bWeightedRefs |= (bUseWeightP || bUseWeightB) && m_mref[l][ref].isWeighted;
+
+        m_curLayer = layer;
+        m_rowsAwaitingRefs = m_numRows;
+
         for (uint32_t rowInSlice = 0; rowInSlice < m_sliceGroupSize; rowInSlice++)
         {
             for (uint32_t sliceId = 0; sliceId < m_param->maxSlices; sliceId++)
@@ -952,7 +974,10 @@ void FrameEncoder::compressFrame(int layer)
                 if (row > sliceEndRow)
                     continue;
 
-                // block until all reference frames have reconstructed the rows we need
+                const int waveRow = m_row_to_idx[row] * 2;
+                setExternalDependencies(waveRow);
+
+                // make this row depend on the reference rows it needs
                 for (int l = 0; l < numPredDir; l++)
                 {
                     for (int ref = 0; ref < slice->m_numRefIdx[l]; ref++)
@@ -968,25 +993,32 @@ void FrameEncoder::compressFrame(int layer)
                         // NOTE: we unnecessary wait row that beyond current slice boundary
                         const int rowIdx = X265_MIN(sliceEndRow, (row + m_refLagRows));
 
-                        while (refpic->m_reconRowFlag[rowIdx].get() == 0)
-                            refpic->m_reconRowFlag[rowIdx].waitForChange(0);
+                        if (bWeightedRefs)
+                        {
+                            while (refpic->m_reconRowFlag[rowIdx].get() == 0)
+                                refpic->m_reconRowFlag[rowIdx].waitForChange(0);
 
-                        if ((bUseWeightP || bUseWeightB) && m_mref[l][ref].isWeighted)
-                            m_mref[l][ref].applyWeight(rowIdx, m_numRows, sliceEndRow, sliceId);
+                            if (m_mref[l][ref].isWeighted)
+                                m_mref[l][ref].applyWeight(rowIdx, m_numRows, sliceEndRow, sliceId);
+                        }
+                        else
+                            refpic->m_reconRowDeps.addDependent(rowIdx, *this, waveRow);
                     }
                 }
 
-                enableRowEncoder(m_row_to_idx[row]); /* clear external dependency for this row */
                 if (!rowInSlice)
                 {
-                    m_row0WaitTime[layer] = x265_mdate();
+                    ScopedLock self(m_rows[row].lock);
+                    rowActivated(m_rows[row]);
                     enqueueRowEncoder(m_row_to_idx[row]); /* clear internal dependency, start wavefront */
                 }
-                tryWakeOne();
+
+                /* drop the guard dependency; enables the row and wakes a worker
+                 * if all of its reference rows are already available */
+                resolveExternalDependency(waveRow);
             } // end of loop rowInSlice
         } // end of loop sliceId
 
-        m_allRowsAvailableTime[layer] = x265_mdate();
         tryWakeOne(); /* ensure one thread is active or help-wanted flag is set prior to blocking */
         static const int block_ms = 250;
         while (m_completionEvent.timedWait(block_ms))
@@ -1014,8 +1046,10 @@ void FrameEncoder::compressFrame(int layer)
 #endif
 
                         const int rowIdx = X265_MIN(m_numRows - 1, (i + m_refLagRows));
+                        int64_t waitStart = x265_mdate();
                         while (refpic->m_reconRowFlag[rowIdx].get() == 0)
                             refpic->m_reconRowFlag[rowIdx].waitForChange(0);
+                        m_rows[i].refStallTime += x265_mdate() - waitStart;
 
                         if ((bUseWeightP || bUseWeightB) && m_mref[l][ref].isWeighted)
                             m_mref[list][ref].applyWeight(rowIdx, m_numRows, m_numRows, 0);
@@ -1048,6 +1082,12 @@ void FrameEncoder::compressFrame(int layer)
     if (m_param->bDynamicRefine && m_top->m_startPoint <= m_frame[layer]->m_encodeOrder) //Avoid collecting data that will not be used by future frames.
         collectDynDataFrame(layer);
 
+    if (m_param->bSplitPredict)
+    {
+        for (uint32_t row = 0; row < m_numRows; row++)
+            m_splitFrameStats.add(m_rows[row].splitStats);
+    }
+
     if (m_param->bEnableTemporalFilter && m_top->isFilterThisframe(m_frame[layer]->m_mcstf->m_sliceTypeConfig, m_frame[layer]->m_lowres.sliceType))
     {
         //Reset the MCSTF context in Frame Encoder and Frame
@@ -1486,6 +1526,59 @@ void FrameEncoder::processRow(int row, int threadId, int layer)
     m_totalWorkerElapsedTime[layer] += x265_mdate() - startTime; // not thread safe, but good enough
 }
 
+/* Called once every reference row needed by an encoder row is reconstructed,
+ * from whichever thread resolved the last dependency */
+void FrameEncoder::externalDependenciesResolved(int waveRow)
+{
+    if (waveRow & 1)
+        return; /* filter rows have no reference dependencies */
+
+    const uint32_t row = m_idx_to_row[waveRow >> 1];
+    CTURow& curRow = m_rows[row];
+    int64_t now = x265_mdate();
+    {
+        ScopedLock self(curRow.lock);
+        curRow.refsReadyTime = now;
+        if (curRow.wppReadyTime)
+            curRow.refStallTime += now - curRow.wppReadyTime;
+    }
+
+    if (!(waveRow >> 1))
+        m_row0WaitTime[m_curLayer] = now;
+    if (!ATOMIC_DEC(&m_rowsAwaitingRefs))
+        m_allRowsAvailableTime[m_curLayer] = now;
+}
+
+/* Account for the time a row spent waiting before it became runnable in the
+ * wavefront. Must be called with the row's lock held */
+void FrameEncoder::rowActivated(CTURow& row)
+{
+    int64_t now = x265_mdate();
+    if (row.blockedTime)
+    {
+        row.wppStallTime += now - row.blockedTime;
+        row.blockedTime = 0;
+    }
+    else if (!row.wppReadyTime)
+    {
+        row.wppReadyTime = now;
+        if (row.refsReadyTime)
+            row.wppStallTime += now - row.refsReadyTime;
+    }
+}
+
+void FrameEncoder::getStallStats(int64_t& refStall, int64_t& wppStall, int64_t& maxRowRefStall, int64_t& maxRowWppStall) const
+{
+    refStall = wppStall = maxRowRefStall = maxRowWppStall = 0;
+    for (uint32_t row = 0; row < m_numRows; row++)
+    {
+        refStall += m_rows[row].refStallTime;
+        wppStall += m_rows[row].wppStallTime;
+        maxRowRefStall = X265_MAX(maxRowRefStall, m_rows[row].refStallTime);
+        maxRowWppStall = X265_MAX(maxRowWppStall, m_rows[row].wppStallTime);
+    }
+}
+
 // Called by worker threads
 void FrameEncoder::processRowEncoder(int intRow, ThreadLocalData& tld, int layer)
 {
@@ -1665,6 +1758,9 @@ void FrameEncoder::processRowEncoder(int intRow, ThreadLocalData& tld, int layer
         if (m_param->dynamicRd && (int32_t)(m_rce.qpaRc - m_rce.qpNoVbv) > 0)
             ctu->m_vbvAffected = true;
 
+        tld.analysis.m_splitModel = m_param->bSplitPredict ? &m_splitModel : NULL;
+        tld.analysis.m_splitStats = &curRow.splitStats;
+
         // Does all the CU analysis, returns best top level mode decision
         Mode& best = tld.analysis.compressCTU(*ctu, *m_frame[layer], m_cuGeoms[m_ctuGeomMap[cuAddr]], rowCoder);
 
@@ -1813,6 +1909,7 @@ void FrameEncoder::processRowEncoder(int intRow, ThreadLocalData& tld, int layer
 
                     curRow.completed = 0;
                     memset(&curRow.rowStats, 0, sizeof(curRow.rowStats));
+                    curRow.splitStats.reset();
                     curEncData.m_rowStat[row].numEncodedCUs = 0;
                     curEncData.m_rowStat[row].encodedBits = 0;
                     curEncData.m_rowStat[row].rowSatd = 0;
@@ -1900,6 +1997,7 @@ void FrameEncoder::processRowEncoder(int intRow, ThreadLocalData& tld, int layer
                         m_outStreams[r].resetBits();
                         stopRow.completed = 0;
                         memset(&stopRow.rowStats, 0, sizeof(stopRow.rowStats));
+                        stopRow.splitStats.reset();
                         curEncData.m_rowStat[r].numEncodedCUs = 0;
                         curEncData.m_rowStat[r].encodedBits = 0;
                         curEncData.m_rowStat[r].rowSatd = 0;
@@ -1923,8 +2021,9 @@ void FrameEncoder::processRowEncoder(int intRow, ThreadLocalData& tld, int layer
                 m_rows[row + 1].completed + 2 <= curRow.completed)
             {
                 m_rows[row + 1].active = true;
+                rowActivated(m_rows[row + 1]);
                 enqueueRowEncoder(m_row_to_idx[row + 1]);
-                tryWakeOne(); /* wake up a sleeping thread or set the help wanted flag */
+                tryWakeOne(lastRowEncoderWorker(m_row_to_idx[row + 1])); /* wake up a sleeping thread or set the help wanted flag */
             }
         }
 
@@ -1934,6 +2033,7 @@ void FrameEncoder::processRowEncoder(int intRow, ThreadLocalData& tld, int layer
         {
             curRow.active = false;
             curRow.busy = false;
+            curRow.blockedTime = x265_mdate();
             ATOMIC_INC(&m_countRowBlocks);
             return;
         }
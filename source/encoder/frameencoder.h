@@ -33,6 +33,7 @@
 #include "md5.h"
 
 #include "analysis.h"
+#include "splitpredict.h"
 #include "sao.h"
 
 #include "entropy.h"
@@ -77,6 +78,7 @@ struct CTURow
     unsigned int      sliceId;          /* store current row slice id */
 
     FrameStats        rowStats;
+    SplitStats        splitStats;       /* split decisions for split-predict training */
 
     /* Threading variables */
 
@@ -100,6 +102,13 @@ struct CTURow
 
     volatile int      reEncode;
 
+    /* stall instrumentation, protected by lock */
+    int64_t           refsReadyTime;    /* when all reference rows became available, 0 until then */
+    int64_t           wppReadyTime;     /* when the row was first activated in the wavefront, 0 until then */
+    int64_t           blockedTime;      /* when the row was abandoned because of its top dependency, 0 if not */
+    int64_t           refStallTime;     /* time activated but waiting on reference rows */
+    int64_t           wppStallTime;     /* time with references available but waiting on the row above */
+
     /* called at the start of each frame to initialize state */
     void init(Entropy& initContext, unsigned int sid)
     {
@@ -109,7 +118,10 @@ struct CTURow
         avgQPComputed = 0;
         sliceId = sid;
         reEncode = 0;
+        refsReadyTime = wppReadyTime = blockedTime = 0;
+        refStallTime = wppStallTime = 0;
         memset(&rowStats, 0, sizeof(rowStats));
+        splitStats.reset();
         rowGoOnCoder.load(initContext);
     }
 };
@@ -191,6 +203,9 @@ public:
     /* blocks until worker thread is done, returns access unit */
     Frame **getEncodedPicture(NALList& list);
 
+    /* sums and per-row maxima of CTU row stall times of the last frame, in microseconds */
+    void getStallStats(int64_t& refStall, int64_t& wppStall, int64_t& maxRowRefStall, int64_t& maxRowWppStall) const;
+
     void initDecodedPictureHashSEI(int row, int cuAddr, int height, int layer);
 
     Event                    m_enable;
@@ -218,6 +233,13 @@ public:
     uint32_t*                m_sliceMaxBlockRow;
     int64_t                  m_rowSliceTotalBits[2];
     RateControlEntry         m_rce;
+
+    /* split-predict: the model of the frame's slice type as of the frame's
+     * start, and the split decisions of the frame, read by the Encoder once
+     * the frame is done */
+    SplitModel               m_splitModel;
+    SplitStats               m_splitFrameStats;
+    int                      m_splitSliceType; /* slice type of m_splitFrameStats, -1 if none */
     SEIDecodedPictureHash    m_seiReconPictureDigest;
 
     uint64_t                 m_SSDY[MAX_LAYERS];
@@ -231,6 +253,8 @@ public:
     volatile int             m_totalActiveWorkerCount;   // sum of m_activeWorkerCount sampled at end of each CTU
     volatile int             m_activeWorkerCountSamples; // count of times m_activeWorkerCount was sampled (think vbv restarts)
     volatile int             m_countRowBlocks;           // count of workers forced to abandon a row because of top dependency
+    volatile int32_t         m_rowsAwaitingRefs;         // count of CTU rows with unresolved reference row dependencies
+    int                      m_curLayer;                 // layer being compressed, for reference row callbacks
     int64_t                  m_startCompressTime[MAX_LAYERS];        // timestamp when frame encoder is given a frame
     int64_t                  m_row0WaitTime[MAX_LAYERS];             // timestamp when row 0 is allowed to start
     int64_t                  m_allRowsAvailableTime[MAX_LAYERS];     // timestamp when all reference dependencies are resolved
@@ -302,10 +326,15 @@ protected:
     virtual void processRow(int row, int threadId, int layer);
     virtual void processRowEncoder(int row, ThreadLocalData& tld, int layer);
 
+    /* Called by WaveFront::resolveExternalDependency() */
+    virtual void externalDependenciesResolved(int row);
+    void rowActivated(CTURow& row);
+
     void enqueueRowEncoder(int row) { WaveFront::enqueueRow(row * 2 + 0); }
     void enqueueRowFilter(int row)  { WaveFront::enqueueRow(row * 2 + 1); }
     void enableRowEncoder(int row)  { WaveFront::enableRow(row * 2 + 0); }
     void enableRowFilter(int row)   { WaveFront::enableRow(row * 2 + 1); }
+    int  lastRowEncoderWorker(int row) const { return WaveFront::lastRowWorker(row * 2 + 0); }
 #if ENABLE_LIBVMAF
     void vmafFrameLevelScore();
 #endif
@@ -659,6 +659,7 @@ void FrameFilter::processPostRow(int row, int layer)
         computeMEIntegral(row, layer);
     // Notify other FrameEncoders that this row of reconstructed pixels is available
     m_frame->m_reconRowFlag[row].set(1);
+    m_frame->m_reconRowDeps.rowCompleted(row);
 
     uint32_t cuAddr = lineStartCUAddr;
     if (m_param->bEnablePsnr)
@@ -0,0 +1,320 @@
+/*****************************************************************************
+ * Copyright (C) 2013-2020 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+
+#include "common.h"
+#include "frame.h"
+#include "lookaheadfile.h"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace X265_NS;
+
+LookaheadFile::LookaheadFile()
+{
+    m_param = NULL;
+    m_filename = NULL;
+    m_fileOut = NULL;
+    m_record = NULL;
+    m_data = NULL;
+    m_dataSize = 0;
+    m_bMapped = false;
+    memset(&m_header, 0, sizeof(m_header));
+    m_plannedSatdOffset = m_qpOffset = m_plannedTypeOffset = m_intraCostOffset = 0;
+    m_numPlanned = 0;
+}
+
+void LookaheadFile::initHeader(const x265_param& param)
+{
+    int lowresCuWidth = ((param.sourceWidth / 2) + X265_LOWRES_CU_SIZE - 1) >> X265_LOWRES_CU_BITS;
+    int lowresCuHeight = ((param.sourceHeight / 2) + X265_LOWRES_CU_SIZE - 1) >> X265_LOWRES_CU_BITS;
+    bool bQpOffsets = param.rc.aqMode || param.rc.hevcAq || param.bAQMotion || param.bEnableWeightedPred || param.bEnableWeightedBiPred;
+    bool bIsVbv = param.rc.vbvBufferSize > 0 && param.rc.vbvMaxBitrate > 0;
+
+    memset(&m_header, 0, sizeof(m_header));
+    m_header.magic = X265_LOOKAHEAD_FILE_MAGIC;
+    m_header.version = X265_LOOKAHEAD_FILE_VERSION;
+    m_header.headerSize = sizeof(x265_lookahead_file_header);
+    m_header.sourceWidth = param.sourceWidth;
+    m_header.sourceHeight = param.sourceHeight;
+    m_header.fpsNum = param.fpsNum;
+    m_header.fpsDenom = param.fpsDenom;
+    m_header.numPlanned = bIsVbv ? X265_MIN(param.lookaheadDepth + param.bframes + 2, X265_LOOKAHEAD_MAX + 1) : 0;
+    m_header.numLowresCUs = lowresCuWidth * lowresCuHeight;
+    m_header.numQpOffsets = bQpOffsets ? m_header.numLowresCUs << (param.rc.qgSize == 8 ? 2 : 0) : 0;
+    m_header.qgSize = param.rc.qgSize;
+    m_header.cuTree = !!param.rc.cuTree;
+    m_header.bframes = param.bframes;
+    m_header.bBPyramid = param.bBPyramid;
+    m_header.keyframeMax = param.keyframeMax;
+    m_header.keyframeMin = param.keyframeMin;
+    m_header.bOpenGOP = param.bOpenGOP;
+}
+
+/* derive the position of the variable sized arrays of a record, the 8 byte
+ * ones first so that they stay aligned in a mapped file */
+void LookaheadFile::layout()
+{
+    m_plannedSatdOffset = sizeof(x265_lookahead_frame_record);
+    m_qpOffset = m_plannedSatdOffset + m_header.numPlanned * sizeof(int64_t);
+    m_plannedTypeOffset = m_qpOffset + m_header.numQpOffsets * sizeof(double);
+    m_intraCostOffset = m_plannedTypeOffset + m_header.numPlanned * sizeof(int32_t);
+}
+
+bool LookaheadFile::create(const x265_param& param, const char* filename)
+{
+    m_param = &param;
+    initHeader(param);
+    layout();
+    m_header.recordSize = (m_intraCostOffset + m_header.numLowresCUs * sizeof(int32_t) + 7) & ~7;
+
+    m_filename = X265_MALLOC(char, strlen(filename) + 1);
+    m_record = X265_MALLOC(uint8_t, m_header.recordSize);
+    if (!m_filename || !m_record)
+        return false;
+    strcpy(m_filename, filename);
+
+    char* temp = X265_MALLOC(char, strlen(filename) + 6);
+    if (!temp)
+        return false;
+    sprintf(temp, "%s.temp", filename);
+    m_fileOut = x265_fopen(temp, "wb");
+    X265_FREE(temp);
+    if (!m_fileOut)
+    {
+        x265_log_file(NULL, X265_LOG_ERROR, "Lookahead save: failed to open file %s.temp\n", filename);
+        return false;
+    }
+
+    /* the header is written again with the frame count once the file is complete */
+    return fwrite(&m_header, sizeof(m_header), 1, m_fileOut) == 1;
+}
+
+bool LookaheadFile::write(const Frame& frame)
+{
+    const Lowres& lowres = frame.m_lowres;
+    memset(m_record, 0, m_header.recordSize);
+
+    x265_lookahead_frame_record* rec = (x265_lookahead_frame_record*)m_record;
+    rec->poc = frame.m_poc;
+    rec->sliceType = lowres.sliceType;
+    rec->bKeyframe = lowres.bKeyframe;
+    rec->bScenecut = lowres.bScenecut;
+    rec->intraSatd = lowres.costEst[0][0];
+
+    int64_t* plannedSatd = (int64_t*)(m_record + m_plannedSatdOffset);
+    int32_t* plannedType = (int32_t*)(m_record + m_plannedTypeOffset);
+    for (uint32_t i = 0; i < m_header.numPlanned; i++)
+    {
+        plannedSatd[i] = lowres.plannedSatd[i];
+        plannedType[i] = lowres.plannedType[i];
+    }
+    memcpy(m_record + m_intraCostOffset, lowres.intraCost, m_header.numLowresCUs * sizeof(int32_t));
+    if (m_header.numQpOffsets)
+        memcpy(m_record + m_qpOffset, lowres.qpCuTreeOffset, m_header.numQpOffsets * sizeof(double));
+
+    /* pictures leave the lookahead in decode order, records are in POC order */
+    if (fseeko(m_fileOut, (int64_t)m_header.headerSize + (int64_t)frame.m_poc * m_header.recordSize, SEEK_SET) ||
+        fwrite(m_record, m_header.recordSize, 1, m_fileOut) != 1)
+    {
+        x265_log(m_param, X265_LOG_ERROR, "Lookahead save: failed to write the record of frame %d\n", frame.m_poc);
+        return false;
+    }
+    m_header.numFrames = X265_MAX(m_header.numFrames, (uint32_t)frame.m_poc + 1);
+    return true;
+}
+
+#define LOOKAHEAD_FILE_VALIDATE(fileValue, value, name) \
+    if ((fileValue) != (uint32_t)(value)) \
+    { \
+        x265_log(m_param, X265_LOG_ERROR, "Lookahead load: incompatible option <%s>, file %u encode %u\n", name, (fileValue), (uint32_t)(value)); \
+        return false; \
+    }
+
+bool LookaheadFile::open(const x265_param& param, const char* filename)
+{
+    m_param = &param;
+
+#ifdef _WIN32
+    FILE* fileIn = x265_fopen(filename, "rb");
+    if (fileIn)
+    {
+        fseeko(fileIn, 0, SEEK_END);
+        int64_t size = ftello(fileIn);
+        fseeko(fileIn, 0, SEEK_SET);
+        m_data = size > 0 ? X265_MALLOC(uint8_t, (size_t)size) : NULL;
+        if (m_data && fread(m_data, (size_t)size, 1, fileIn) == 1)
+            m_dataSize = (size_t)size;
+        fclose(fileIn);
+    }
+#else
+    int fd = ::open(filename, O_RDONLY);
+    if (fd >= 0)
+    {
+        struct stat st;
+        if (!fstat(fd, &st) && st.st_size > 0)
+        {
+            void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (data != MAP_FAILED)
+            {
+                m_data = (uint8_t*)data;
+                m_dataSize = (size_t)st.st_size;
+                m_bMapped = true;
+            }
+        }
+        ::close(fd);
+    }
+#endif
+    if (!m_dataSize)
+    {
+        x265_log_file(NULL, X265_LOG_ERROR, "Lookahead load: failed to read file %s\n", filename);
+        return false;
+    }
+
+    /* version 1 records held the offsets in 8.8 fixed point at another place */
+    memcpy(&m_header, m_data, X265_MIN(m_dataSize, sizeof(m_header)));
+    layout();
+    if (m_dataSize < sizeof(m_header) || m_header.magic != X265_LOOKAHEAD_FILE_MAGIC ||
+        m_header.version < 2 || m_header.version > X265_LOOKAHEAD_FILE_VERSION ||
+        m_header.headerSize < sizeof(m_header) || (m_header.recordSize & 7) ||
+        m_header.recordSize < m_intraCostOffset + m_header.numLowresCUs * sizeof(int32_t) ||
+        m_dataSize < m_header.headerSize + (uint64_t)m_header.numFrames * m_header.recordSize)
+    {
+        x265_log_file(NULL, X265_LOG_ERROR, "Lookahead load: %s is not a complete lookahead analysis file\n", filename);
+        return false;
+    }
+
+    /* compare with the header this encode would have written */
+    x265_lookahead_file_header fileHeader = m_header;
+    initHeader(param);
+    x265_lookahead_file_header encode = m_header;
+    m_header = fileHeader;
+
+    LOOKAHEAD_FILE_VALIDATE(m_header.sourceWidth, encode.sourceWidth, "input-res");
+    LOOKAHEAD_FILE_VALIDATE(m_header.sourceHeight, encode.sourceHeight, "input-res");
+    LOOKAHEAD_FILE_VALIDATE(m_header.numLowresCUs, encode.numLowresCUs, "input-res");
+    LOOKAHEAD_FILE_VALIDATE(m_header.bframes, encode.bframes, "bframes");
+    LOOKAHEAD_FILE_VALIDATE(m_header.bBPyramid, encode.bBPyramid, "b-pyramid");
+    LOOKAHEAD_FILE_VALIDATE(m_header.keyframeMax, encode.keyframeMax, "keyint");
+    LOOKAHEAD_FILE_VALIDATE(m_header.keyframeMin, encode.keyframeMin, "min-keyint");
+    LOOKAHEAD_FILE_VALIDATE(m_header.bOpenGOP, encode.bOpenGOP, "open-gop");
+    if (param.rc.cuTree && encode.numQpOffsets)
+    {
+        LOOKAHEAD_FILE_VALIDATE(m_header.cuTree, 1, "cutree");
+        LOOKAHEAD_FILE_VALIDATE(m_header.numQpOffsets, encode.numQpOffsets, "qg-size");
+    }
+
+    m_numPlanned = X265_MIN(m_header.numPlanned, encode.numPlanned);
+    if (encode.numPlanned && !m_header.numPlanned)
+        x265_log(m_param, X265_LOG_WARNING, "Lookahead load: file has no VBV plan, VBV lookahead disabled\n");
+
+    return true;
+}
+
+const x265_lookahead_frame_record* LookaheadFile::record(int poc) const
+{
+    if (poc < 0 || (uint32_t)poc >= m_header.numFrames)
+        return NULL;
+
+    const x265_lookahead_frame_record* rec = (const x265_lookahead_frame_record*)(m_data + m_header.headerSize + (size_t)poc * m_header.recordSize);
+    return rec->poc == poc ? rec : NULL;
+}
+
+int LookaheadFile::loadInput(Frame& frame) const
+{
+    const x265_lookahead_frame_record* rec = record(frame.m_poc);
+    if (!rec)
+    {
+        x265_log(m_param, X265_LOG_ERROR, "Lookahead load: no record of frame %d\n", frame.m_poc);
+        return -1;
+    }
+
+    Lowres& lowres = frame.m_lowres;
+    lowres.bScenecut = !!rec->bScenecut;
+
+    /* as with the cuTree stats of a second pass, the offsets of referenced
+     * pictures replace their AQ, which the lookahead then skips */
+    if (m_param->rc.cuTree && lowres.qpCuTreeOffset && rec->sliceType != X265_TYPE_B)
+    {
+        int ncu = m_header.numQpOffsets;
+        memcpy(lowres.qpCuTreeOffset, (const uint8_t*)rec + m_qpOffset, ncu * sizeof(double));
+        for (int i = 0; i < ncu; i++)
+            lowres.invQscaleFactor[i] = x265_exp2fix8(lowres.qpCuTreeOffset[i]);
+    }
+    return rec->sliceType;
+}
+
+void LookaheadFile::loadDecided(Frame& frame) const
+{
+    const x265_lookahead_frame_record* rec = record(frame.m_poc);
+    if (!rec || !m_numPlanned)
+        return;
+
+    const int64_t* plannedSatd = (const int64_t*)((const uint8_t*)rec + m_plannedSatdOffset);
+    const int32_t* plannedType = (const int32_t*)((const uint8_t*)rec + m_plannedTypeOffset);
+    for (int i = 0; i < m_numPlanned; i++)
+    {
+        frame.m_lowres.plannedSatd[i] = plannedSatd[i];
+        frame.m_lowres.plannedType[i] = plannedType[i];
+    }
+    if (m_numPlanned < X265_LOOKAHEAD_MAX + 1)
+        frame.m_lowres.plannedType[m_numPlanned] = X265_TYPE_AUTO;
+}
+
+void LookaheadFile::close()
+{
+    if (m_fileOut)
+    {
+        bool bError = fseeko(m_fileOut, 0, SEEK_SET) || fwrite(&m_header, sizeof(m_header), 1, m_fileOut) != 1;
+        fclose(m_fileOut);
+        m_fileOut = NULL;
+
+        char* temp = X265_MALLOC(char, strlen(m_filename) + 6);
+        if (temp)
+        {
+            sprintf(temp, "%s.temp", m_filename);
+            x265_unlink(m_filename);
+            bError |= !!x265_rename(temp, m_filename);
+            X265_FREE(temp);
+        }
+        if (bError || !temp)
+            x265_log_file(m_param, X265_LOG_ERROR, "failed to write lookahead analysis file \"%s\"\n", m_filename);
+    }
+    if (m_data)
+    {
+#ifndef _WIN32
+        if (m_bMapped)
+            munmap(m_data, m_dataSize);
+        else
+#endif
+            X265_FREE(m_data);
+        m_data = NULL;
+        m_dataSize = 0;
+    }
+    X265_FREE(m_filename);
+    X265_FREE(m_record);
+    m_filename = NULL;
+    m_record = NULL;
+}
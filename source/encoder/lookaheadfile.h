@@ -0,0 +1,90 @@
+/*****************************************************************************
+ * Copyright (C) 2013-2020 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+
+#ifndef X265_LOOKAHEADFILE_H
+#define X265_LOOKAHEADFILE_H
+
+#include "common.h"
+#include "x265.h"
+
+namespace X265_NS {
+// private x265 namespace
+
+class Frame;
+
+/* Reads and writes lookahead analysis files, see x265_lookahead_file_header.
+ * A written file is created as <name>.temp and renamed once it is complete.
+ * A read file is mapped into memory, records are used in place */
+class LookaheadFile
+{
+public:
+
+    LookaheadFile();
+    ~LookaheadFile()           { close(); }
+
+    /* starts a file for the pictures of this encode */
+    bool create(const x265_param& param, const char* filename);
+
+    /* maps a file and checks it was written for compatible settings */
+    bool open(const x265_param& param, const char* filename);
+
+    /* completes a created file, or releases an opened one */
+    void close();
+
+    /* writes the record of a picture leaving the lookahead */
+    bool write(const Frame& frame);
+
+    /* record of a POC, NULL if the file has none */
+    const x265_lookahead_frame_record* record(int poc) const;
+
+    /* applies the slice type, scenecut flag and cuTree offsets of a picture
+     * before it enters the lookahead. Returns the slice type to force, or
+     * -1 when the file has no record of the picture */
+    int loadInput(Frame& frame) const;
+
+    /* applies the VBV plan of a picture leaving the lookahead; the lowres
+     * init of the lookahead resets it */
+    void loadDecided(Frame& frame) const;
+
+protected:
+
+    const x265_param* m_param;
+    char*      m_filename;
+    FILE*      m_fileOut;
+    uint8_t*   m_record;        // record under construction
+
+    uint8_t*   m_data;          // mapped or read file
+    size_t     m_dataSize;
+    bool       m_bMapped;
+
+    x265_lookahead_file_header m_header;
+    uint32_t   m_plannedSatdOffset;
+    uint32_t   m_qpOffset;
+    uint32_t   m_plannedTypeOffset;
+    uint32_t   m_intraCostOffset;
+    int        m_numPlanned;    // VBV plan entries used by this encode
+
+    void initHeader(const x265_param& param);
+    void layout();
+};
+}
+
+#endif // ifndef X265_LOOKAHEADFILE_H
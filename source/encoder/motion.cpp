@@ -111,6 +111,8 @@ MotionEstimate::MotionEstimate()
     blockOffset = 0;
     bChromaSATD = false;
     chromaSatd = NULL;
+    subpelBuf = NULL;
+    numStartPoints = 0;
     for (int i = 0; i < INTEGRAL_PLANE_NUM; i++)
         integral[i] = NULL;
 }
@@ -118,6 +120,7 @@ MotionEstimate::MotionEstimate()
 void MotionEstimate::init(int csp)
 {
     fencPUYuv.create(FENC_STRIDE, csp);
+    subpelBuf = X265_MALLOC(pixel, SUBPEL_BATCH * MAX_CU_SIZE * MAX_CU_SIZE);
 }
 
 void MotionEstimate::initScales(void)
@@ -161,6 +164,7 @@ int MotionEstimate::hpelIterationCount(int subme)
 MotionEstimate::~MotionEstimate()
 {
     fencPUYuv.destroy();
+    X265_FREE(subpelBuf);
 }
 
 /* Called by lookahead, luma only, no use of PicYuv */
@@ -173,6 +177,9 @@ void MotionEstimate::setSourcePU(pixel *fencY, intptr_t stride, intptr_t offset,
     satd = primitives.pu[partEnum].satd;
     sad_x3 = primitives.pu[partEnum].sad_x3;
     sad_x4 = primitives.pu[partEnum].sad_x4;
+    sad_xn = primitives.pu[partEnum].sad_xn;
+    satd_xn = primitives.pu[partEnum].satd_xn;
+    numStartPoints = 0;
 
 
     blockwidth = pwidth;
@@ -200,6 +207,9 @@ void MotionEstimate::setSourcePU(pixel *fencY, intptr_t stride, intptr_t offset,
     satd = primitives.pu[partEnum].satd;
     sad_x3 = primitives.pu[partEnum].sad_x3;
     sad_x4 = primitives.pu[partEnum].sad_x4;
+    sad_xn = primitives.pu[partEnum].sad_xn;
+    satd_xn = primitives.pu[partEnum].satd_xn;
+    numStartPoints = 0;
 
 
     blockwidth = pwidth;
@@ -225,6 +235,9 @@ void MotionEstimate::setSourcePU(const Yuv& srcFencYuv, int _ctuAddr, int cuPart
     satd = primitives.pu[partEnum].satd;
     sad_x3 = primitives.pu[partEnum].sad_x3;
     sad_x4 = primitives.pu[partEnum].sad_x4;
+    sad_xn = primitives.pu[partEnum].sad_xn;
+    satd_xn = primitives.pu[partEnum].satd_xn;
+    numStartPoints = 0;
 
     chromaSatd = primitives.chroma[fencPUYuv.m_csp].pu[partEnum].satd;
 
@@ -698,30 +711,12 @@ void MotionEstimate::refineMV(ReferencePlanes* ref,
     // const SubpelWorkload& wl = workload[this->subpelRefine];
     const SubpelWorkload& wl = workload[5];
 
-    pixelcmp_t hpelcomp;
-
     if (wl.hpel_satd)
-    {
         bcost = subpelCompare(ref, bmv, satd) + mvcost(bmv);
-        hpelcomp = satd;
-    }
-    else
-        hpelcomp = sad;
 
     for (int iter = 0; iter < wl.hpel_iters; iter++)
     {
-        int bdir = 0;
-        for (int i = 1; i <= wl.hpel_dirs; i++)
-        {
-            MV qmv = bmv + square1[i] * 2;            
-
-            // check mv range for slice bound
-            if ((qmv.y < qmvmin.y) | (qmv.y > qmvmax.y))
-                continue;
-
-            int cost = subpelCompare(ref, qmv, hpelcomp) + mvcost(qmv);
-            COPY2_IF_LT(bcost, cost, bdir, i);
-        }
+        int bdir = subpelRefineStep(ref, bmv, 2, wl.hpel_dirs, wl.hpel_satd, qmvmin, qmvmax, bcost);
 
         if (bdir)
             bmv += square1[bdir] * 2;            
@@ -735,18 +730,7 @@ void MotionEstimate::refineMV(ReferencePlanes* ref,
 
     for (int iter = 0; iter < wl.qpel_iters; iter++)
     {
-        int bdir = 0;
-        for (int i = 1; i <= wl.qpel_dirs; i++)
-        {
-            MV qmv = bmv + square1[i];
-            
-            // check mv range for slice bound
-            if ((qmv.y < qmvmin.y) | (qmv.y > qmvmax.y))
-                continue;
-
-            int cost = subpelCompare(ref, qmv, satd) + mvcost(qmv);
-            COPY2_IF_LT(bcost, cost, bdir, i);
-        }
+        int bdir = subpelRefineStep(ref, bmv, 1, wl.qpel_dirs, true, qmvmin, qmvmax, bcost);
 
         if (bdir)
             bmv += square1[bdir];
@@ -794,32 +778,30 @@ int MotionEstimate::motionEstimate(ReferencePlanes *ref,
      * (mode + MVD bits). */
 
     // measure SAD cost at clipped QPEL MVP
-    MV pmv = qmvp.clipped(qmvmin, qmvmax);
-    if (m_vertRestriction)
-    {
-        if (pmv.y > mvmax.y << 2)
-        {
-            pmv.y = (mvmax.y << 2);
-        }
-    }
+    MV pmv = clipMVP(qmvp, mvmin, mvmax, m_vertRestriction);
     MV bestpre = pmv;
     int bprecost;
 
+    /* the full pel SADs may have been measured with other references */
+    MV bmv = pmv.roundToFPel();
+    const StartPoint* sp = srcReferencePlane ? NULL : findStartPoint(ref, bmv);
+
     if (ref->isLowres)
         bprecost = ref->lowresQPelCost(fenc, blockOffset, pmv, sad, hme);
+    else if (sp && !pmv.isSubpel())
+        bprecost = sp->sad + (bChromaSATD ? chromaSubpelCompare(ref, pmv) : 0);
     else
         bprecost = subpelCompare(ref, pmv, sad);
 
     /* re-measure full pel rounded MVP with SAD as search start point */
-    MV bmv = pmv.roundToFPel();
     int bcost = bprecost;
     if (pmv.isSubpel())
-        bcost = sad(fenc, FENC_STRIDE, fref + bmv.x + bmv.y * stride, stride) + mvcost(bmv << 2);
+        bcost = (sp ? sp->sad : sad(fenc, FENC_STRIDE, fref + bmv.x + bmv.y * stride, stride)) + mvcost(bmv << 2);
 
     // measure SAD cost at MV(0) if MVP is not zero
     if (pmv.notZero())
     {
-        int cost = sad(fenc, FENC_STRIDE, fref, stride) + mvcost(MV(0, 0));
+        int cost = (sp ? sp->zeroSad : sad(fenc, FENC_STRIDE, fref, stride)) + mvcost(MV(0, 0));
         if (cost < bcost)
         {
             bcost = cost;
@@ -830,16 +812,50 @@ int MotionEstimate::motionEstimate(ReferencePlanes *ref,
 
     X265_CHECK(!(ref->isLowres && numCandidates), "lowres motion candidates not allowed\n")
     // measure SAD cost at each QPEL motion vector candidate
-    for (int i = 0; i < numCandidates; i++)
+    if (sad_xn && subpelBuf)
     {
-        MV m = mvc[i].clipped(qmvmin, qmvmax);
-        if (m.notZero() & (m != pmv ? 1 : 0) & (m != bestpre ? 1 : 0)) // check already measured
+        /* batches of distinct candidates, measuring a candidate again can
+         * not change the best one since its cost would not be lower */
+        MV cand[SUBPEL_BATCH];
+        int count = 0;
+        for (int i = 0; i < numCandidates; i++)
         {
-            int cost = subpelCompare(ref, m, sad) + mvcost(m);
-            if (cost < bprecost)
+            MV m = mvc[i].clipped(qmvmin, qmvmax);
+            bool bMeasured = !m.notZero() || m == pmv;
+            for (int j = 0; j < count; j++)
+                bMeasured |= m == cand[j];
+            if (!bMeasured)
+                cand[count++] = m;
+
+            if (count == SUBPEL_BATCH || (count && i == numCandidates - 1))
             {
-                bprecost = cost;
-                bestpre = m;
+                subpelCompareN(ref, cand, count, sad_xn, costs);
+                for (int j = 0; j < count; j++)
+                {
+                    int cost = costs[j] + mvcost(cand[j]);
+                    if (cost < bprecost)
+                    {
+                        bprecost = cost;
+                        bestpre = cand[j];
+                    }
+                }
+                count = 0;
+            }
+        }
+    }
+    else
+    {
+        for (int i = 0; i < numCandidates; i++)
+        {
+            MV m = mvc[i].clipped(qmvmin, qmvmax);
+            if (m.notZero() & (m != pmv ? 1 : 0) & (m != bestpre ? 1 : 0)) // check already measured
+            {
+                int cost = subpelCompare(ref, m, sad) + mvcost(m);
+                if (cost < bprecost)
+                {
+                    bprecost = cost;
+                    bestpre = m;
+                }
             }
         }
     }
@@ -976,6 +992,70 @@ me_hex2:
         break;
     }
 
+    case X265_EPZS_SEARCH:
+    {
+        /* predictive zonal search. Besides the spatial predictors the
+         * candidates measured above hold the co-located motion of the
+         * reference and the global motion. Thresholds are SAD of a 16x16
+         * block; when the predictors agree their best match is trusted
+         * sooner */
+        bool bAgree = numCandidates < 2 || predictorDifference(mvc, numCandidates) < 16 * (numCandidates - 1);
+        int thresh1 = (bAgree ? 512 : 256) << (X265_DEPTH - 8);
+        int thresh2 = (bAgree ? 1536 : 768) << (X265_DEPTH - 8);
+
+        /* the best predictor at full pel */
+        MV start = bmv;
+        MV fpre = bestpre.roundToFPel();
+        if (bprecost < bcost && fpre != bmv)
+            COST_MV(fpre.x, fpre.y);
+        if (SAD_THRESH(thresh1))
+            break;
+
+        /* a small diamond around the mvp (or zero) and the best predictor,
+         * then follow the best match with small diamonds */
+        DIA1_ITER(start.x, start.y);
+        if (fpre != start)
+            DIA1_ITER(fpre.x, fpre.y);
+
+        for (int i = merange; i && bmv != omv && bmv.checkRange(mvmin, mvmax); i--)
+            DIA1_ITER(bmv.x, bmv.y);
+
+        /* the predictors missed, widen the search with the hexagon grid of
+         * umh around the best match, one batched comparison per ring */
+        if (!SAD_THRESH(thresh2) && bmv.checkRange(mvmin, mvmax))
+        {
+            omv = bmv;
+            for (int16_t i = 1; i <= merange >> 2; i++)
+            {
+                MV cand[16];
+                const pixel* pix[16];
+                int count = 0;
+                for (int j = 0; j < 16; j++)
+                {
+                    cand[count] = omv + (hex4[j] * i);
+                    pix[count] = fref + cand[count].x + cand[count].y * stride;
+                    count += cand[count].checkRange(mvmin, mvmax);
+                }
+
+                if (sad_xn)
+                    sad_xn(fenc, pix, count, stride, costs);
+                else
+                {
+                    for (int j = 0; j < count; j++)
+                        costs[j] = sad(fenc, FENC_STRIDE, pix[j], stride);
+                }
+                for (int j = 0; j < count; j++)
+                {
+                    costs[j] += mvcost(cand[j] << 2);
+                    COPY2_IF_LT(bcost, costs[j], bmv, cand[j]);
+                }
+            }
+            if (bmv.checkRange(mvmin, mvmax))
+                goto me_hex2;
+        }
+        break;
+    }
+
     case X265_UMH_SEARCH:
     {
         int ucost1, ucost2;
@@ -1536,30 +1616,12 @@ me_hex2:
     }
     else
     {
-        pixelcmp_t hpelcomp;
-
         if (wl.hpel_satd)
-        {
             bcost = subpelCompare(ref, bmv, satd) + mvcost(bmv);
-            hpelcomp = satd;
-        }
-        else
-            hpelcomp = sad;
 
         for (int iter = 0; iter < wl.hpel_iters; iter++)
         {
-            int bdir = 0;
-            for (int i = 1; i <= wl.hpel_dirs; i++)
-            {
-                MV qmv = bmv + square1[i] * 2;
-
-                // check mv range for slice bound
-                if ((qmv.y < qmvmin.y) | (qmv.y > qmvmax.y))
-                    continue;
-
-                int cost = subpelCompare(ref, qmv, hpelcomp) + mvcost(qmv);
-                COPY2_IF_LT(bcost, cost, bdir, i);
-            }
+            int bdir = subpelRefineStep(ref, bmv, 2, wl.hpel_dirs, wl.hpel_satd, qmvmin, qmvmax, bcost);
 
             if (bdir)
                 bmv += square1[bdir] * 2;
@@ -1573,18 +1635,7 @@ me_hex2:
 
         for (int iter = 0; iter < wl.qpel_iters; iter++)
         {
-            int bdir = 0;
-            for (int i = 1; i <= wl.qpel_dirs; i++)
-            {
-                MV qmv = bmv + square1[i];
-
-                // check mv range for slice bound
-                if ((qmv.y < qmvmin.y) | (qmv.y > qmvmax.y))
-                    continue;
-
-                int cost = subpelCompare(ref, qmv, satd) + mvcost(qmv);
-                COPY2_IF_LT(bcost, cost, bdir, i);
-            }
+            int bdir = subpelRefineStep(ref, bmv, 1, wl.qpel_dirs, true, qmvmin, qmvmax, bcost);
 
             if (bdir)
                 bmv += square1[bdir];
@@ -1632,66 +1683,233 @@ int MotionEstimate::subpelCompare(ReferencePlanes *ref, const MV& qmv, pixelcmp_
     }
 
     if (bChromaSATD)
+        cost += chromaSubpelCompare(ref, qmv);
+
+    return cost;
+}
+
+/* chroma residual cost of a qpel MV, used when bChromaSATD is enabled */
+int MotionEstimate::chromaSubpelCompare(ReferencePlanes *ref, const MV& qmv)
+{
+    ALIGN_VAR_32(pixel, subpelbuf[MAX_CU_SIZE * MAX_CU_SIZE]);
+
+    int csp    = fencPUYuv.m_csp;
+    int hshift = fencPUYuv.m_hChromaShift;
+    int vshift = fencPUYuv.m_vChromaShift;
+    int mvx = qmv.x << (1 - hshift);
+    int mvy = qmv.y << (1 - vshift);
+    intptr_t fencStrideC = fencPUYuv.m_csize;
+
+    intptr_t refStrideC = ref->reconPic->m_strideC;
+    intptr_t refOffset = (mvx >> 3) + (mvy >> 3) * refStrideC;
+
+    const pixel* refCb = ref->getCbAddr(ctuAddr, absPartIdx) + refOffset;
+    const pixel* refCr = ref->getCrAddr(ctuAddr, absPartIdx) + refOffset;
+
+    X265_CHECK((hshift == 0) || (hshift == 1), "hshift must be 0 or 1\n");
+    X265_CHECK((vshift == 0) || (vshift == 1), "vshift must be 0 or 1\n");
+
+    int xFrac = mvx & 7;
+    int yFrac = mvy & 7;
+    int cost;
+
+    if (!(yFrac | xFrac))
     {
-        int csp    = fencPUYuv.m_csp;
-        int hshift = fencPUYuv.m_hChromaShift;
-        int vshift = fencPUYuv.m_vChromaShift;
-        int mvx = qmv.x << (1 - hshift);
-        int mvy = qmv.y << (1 - vshift);
-        intptr_t fencStrideC = fencPUYuv.m_csize;
+        cost = chromaSatd(fencPUYuv.m_buf[1], fencStrideC, refCb, refStrideC);
+        cost += chromaSatd(fencPUYuv.m_buf[2], fencStrideC, refCr, refStrideC);
+    }
+    else
+    {
+        int blockwidthC = blockwidth >> hshift;
 
-        intptr_t refStrideC = ref->reconPic->m_strideC;
-        intptr_t refOffset = (mvx >> 3) + (mvy >> 3) * refStrideC;
+        if (!yFrac)
+        {
+            primitives.chroma[csp].pu[partEnum].filter_hpp(refCb, refStrideC, subpelbuf, blockwidthC, xFrac);
+            cost = chromaSatd(fencPUYuv.m_buf[1], fencStrideC, subpelbuf, blockwidthC);
 
-        const pixel* refCb = ref->getCbAddr(ctuAddr, absPartIdx) + refOffset;
-        const pixel* refCr = ref->getCrAddr(ctuAddr, absPartIdx) + refOffset;
+            primitives.chroma[csp].pu[partEnum].filter_hpp(refCr, refStrideC, subpelbuf, blockwidthC, xFrac);
+            cost += chromaSatd(fencPUYuv.m_buf[2], fencStrideC, subpelbuf, blockwidthC);
+        }
+        else if (!xFrac)
+        {
+            primitives.chroma[csp].pu[partEnum].filter_vpp(refCb, refStrideC, subpelbuf, blockwidthC, yFrac);
+            cost = chromaSatd(fencPUYuv.m_buf[1], fencStrideC, subpelbuf, blockwidthC);
 
-        X265_CHECK((hshift == 0) || (hshift == 1), "hshift must be 0 or 1\n");
-        X265_CHECK((vshift == 0) || (vshift == 1), "vshift must be 0 or 1\n");
+            primitives.chroma[csp].pu[partEnum].filter_vpp(refCr, refStrideC, subpelbuf, blockwidthC, yFrac);
+            cost += chromaSatd(fencPUYuv.m_buf[2], fencStrideC, subpelbuf, blockwidthC);
+        }
+        else
+        {
+            ALIGN_VAR_32(int16_t, immed[MAX_CU_SIZE * (MAX_CU_SIZE + NTAPS_LUMA - 1)]);
+            const int halfFilterSize = (NTAPS_CHROMA >> 1);
 
-        xFrac = mvx & 7;
-        yFrac = mvy & 7;
+            primitives.chroma[csp].pu[partEnum].filter_hps(refCb, refStrideC, immed, blockwidthC, xFrac, 1);
+            primitives.chroma[csp].pu[partEnum].filter_vsp(immed + (halfFilterSize - 1) * blockwidthC, blockwidthC, subpelbuf, blockwidthC, yFrac);
+            cost = chromaSatd(fencPUYuv.m_buf[1], fencStrideC, subpelbuf, blockwidthC);
 
-        if (!(yFrac | xFrac))
+            primitives.chroma[csp].pu[partEnum].filter_hps(refCr, refStrideC, immed, blockwidthC, xFrac, 1);
+            primitives.chroma[csp].pu[partEnum].filter_vsp(immed + (halfFilterSize - 1) * blockwidthC, blockwidthC, subpelbuf, blockwidthC, yFrac);
+            cost += chromaSatd(fencPUYuv.m_buf[2], fencStrideC, subpelbuf, blockwidthC);
+        }
+    }
+
+    return cost;
+}
+
+/* the QPEL MVP motionEstimate() starts from, clipped to the search range */
+MV MotionEstimate::clipMVP(const MV& qmvp, const MV& mvmin, const MV& mvmax, bool bVertRestriction)
+{
+    MV pmv = qmvp.clipped(mvmin.toQPel(), mvmax.toQPel());
+    if (bVertRestriction)
+    {
+        if (pmv.y > mvmax.y << 2)
         {
-            cost += chromaSatd(fencPUYuv.m_buf[1], fencStrideC, refCb, refStrideC);
-            cost += chromaSatd(fencPUYuv.m_buf[2], fencStrideC, refCr, refStrideC);
+            pmv.y = (mvmax.y << 2);
         }
+    }
+    return pmv;
+}
+
+/* Measure the full pel start points of the coming motionEstimate() calls of
+ * the PU, the rounded MVP and MV(0) of each reference, by one batched SAD
+ * which keeps fenc loaded for all of them. qmvp are the clipped QPEL MVPs.
+ * motionEstimate() uses a start point when it is called with the same
+ * reference and rounded MVP, until the next call or setSourcePU() */
+void MotionEstimate::measureStartPoints(ReferencePlanes* const* refs, const MV* qmvp, int count)
+{
+    X265_CHECK(count <= MAX_NUM_REF, "too many start points\n");
+    numStartPoints = 0;
+    if (!sad_xn || !count)
+        return;
+
+    const pixel* cand[2 * MAX_NUM_REF];
+    int32_t costs[2 * MAX_NUM_REF];
+    intptr_t stride = refs[0]->lumaStride;
+    int numCand = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        /* the batch is compared at one stride */
+        if (refs[i]->isLowres || refs[i]->lumaStride != stride)
+            return;
+
+        intptr_t offset = ctuAddr >= 0 ? refs[i]->reconPic->getLumaAddr(ctuAddr, absPartIdx) - refs[i]->reconPic->getLumaAddr(0) : blockOffset;
+        const pixel* fref = refs[i]->fpelPlane[0] + offset;
+        MV fmv = qmvp[i].roundToFPel();
+
+        cand[numCand++] = fref + fmv.x + fmv.y * stride;
+        if (fmv.notZero())
+            cand[numCand++] = fref;
+    }
+
+    sad_xn(fencPUYuv.m_buf[0], cand, numCand, stride, costs);
+
+    for (int i = 0, c = 0; i < count; i++)
+    {
+        StartPoint& point = startPoint[i];
+        point.ref = refs[i];
+        point.fpelMv = qmvp[i].roundToFPel();
+        point.sad = costs[c++];
+        point.zeroSad = point.fpelMv.notZero() ? costs[c++] : point.sad;
+    }
+    numStartPoints = count;
+}
+
+const MotionEstimate::StartPoint* MotionEstimate::findStartPoint(const ReferencePlanes* ref, const MV& fpelMv) const
+{
+    for (int i = 0; i < numStartPoints; i++)
+    {
+        if (startPoint[i].ref == ref && startPoint[i].fpelMv == fpelMv)
+            return &startPoint[i];
+    }
+
+    return NULL;
+}
+
+/* luma (and chroma if enabled) costs of several qpel MVs, all of the luma
+ * blocks are measured by one call of the batched comparison */
+void MotionEstimate::subpelCompareN(ReferencePlanes *ref, const MV* qmv, int count, pixelcmp_xn_t cmp, int32_t* costs)
+{
+    X265_CHECK(count <= SUBPEL_BATCH, "too many subpel candidates\n");
+    intptr_t refStride = ref->lumaStride;
+    const pixel* cand[SUBPEL_BATCH];
+
+    for (int i = 0; i < count; i++)
+    {
+        const pixel* fref = ref->fpelPlane[0] + blockOffset + (qmv[i].x >> 2) + (qmv[i].y >> 2) * refStride;
+        int xFrac = qmv[i].x & 0x3;
+        int yFrac = qmv[i].y & 0x3;
+        pixel* buf = subpelBuf + i * MAX_CU_SIZE * MAX_CU_SIZE;
+
+        /* full pel candidates are copied, the batch is compared at one stride */
+        if (!(yFrac | xFrac))
+            primitives.pu[partEnum].copy_pp(buf, blockwidth, fref, refStride);
+        else if (!yFrac)
+            primitives.pu[partEnum].luma_hpp(fref, refStride, buf, blockwidth, xFrac);
+        else if (!xFrac)
+            primitives.pu[partEnum].luma_vpp(fref, refStride, buf, blockwidth, yFrac);
         else
+            primitives.pu[partEnum].luma_hvpp(fref, refStride, buf, blockwidth, xFrac, yFrac);
+        cand[i] = buf;
+    }
+
+    cmp(fencPUYuv.m_buf[0], cand, count, blockwidth, costs);
+
+    if (bChromaSATD)
+    {
+        for (int i = 0; i < count; i++)
+            costs[i] += chromaSubpelCompare(ref, qmv[i]);
+    }
+}
+
+/* measure the qpel MVs around bmv in the first numDirs directions of square1
+ * at the given scale (2 for HPEL, 1 for QPEL), skipping those outside of the
+ * vertical MV range. Returns the best direction, or 0 if none improved bcost */
+int MotionEstimate::subpelRefineStep(ReferencePlanes* ref, const MV& bmv, int scale, int numDirs, bool bSatd, const MV& qmvmin, const MV& qmvmax, int& bcost)
+{
+    pixelcmp_xn_t cmpN = bSatd ? satd_xn : sad_xn;
+    int bdir = 0;
+
+    if (cmpN && subpelBuf)
+    {
+        MV qmv[SUBPEL_BATCH];
+        int dir[SUBPEL_BATCH];
+        int32_t costs[SUBPEL_BATCH];
+        int count = 0;
+
+        for (int i = 1; i <= numDirs; i++)
         {
-            int blockwidthC = blockwidth >> hshift;
+            qmv[count] = bmv + square1[i] * scale;
+            dir[count] = i;
 
-            if (!yFrac)
-            {
-                primitives.chroma[csp].pu[partEnum].filter_hpp(refCb, refStrideC, subpelbuf, blockwidthC, xFrac);
-                cost += chromaSatd(fencPUYuv.m_buf[1], fencStrideC, subpelbuf, blockwidthC);
+            // check mv range for slice bound
+            count += (qmv[count].y >= qmvmin.y) & (qmv[count].y <= qmvmax.y);
+        }
 
-                primitives.chroma[csp].pu[partEnum].filter_hpp(refCr, refStrideC, subpelbuf, blockwidthC, xFrac);
-                cost += chromaSatd(fencPUYuv.m_buf[2], fencStrideC, subpelbuf, blockwidthC);
-            }
-            else if (!xFrac)
-            {
-                primitives.chroma[csp].pu[partEnum].filter_vpp(refCb, refStrideC, subpelbuf, blockwidthC, yFrac);
-                cost += chromaSatd(fencPUYuv.m_buf[1], fencStrideC, subpelbuf, blockwidthC);
+        if (count)
+            subpelCompareN(ref, qmv, count, cmpN, costs);
+        for (int i = 0; i < count; i++)
+        {
+            int cost = costs[i] + mvcost(qmv[i]);
+            COPY2_IF_LT(bcost, cost, bdir, dir[i]);
+        }
+    }
+    else
+    {
+        pixelcmp_t cmp = bSatd ? satd : sad;
 
-                primitives.chroma[csp].pu[partEnum].filter_vpp(refCr, refStrideC, subpelbuf, blockwidthC, yFrac);
-                cost += chromaSatd(fencPUYuv.m_buf[2], fencStrideC, subpelbuf, blockwidthC);
-            }
-            else
-            {
-                ALIGN_VAR_32(int16_t, immed[MAX_CU_SIZE * (MAX_CU_SIZE + NTAPS_LUMA - 1)]);
-                const int halfFilterSize = (NTAPS_CHROMA >> 1);
+        for (int i = 1; i <= numDirs; i++)
+        {
+            MV qmv = bmv + square1[i] * scale;
 
-                primitives.chroma[csp].pu[partEnum].filter_hps(refCb, refStrideC, immed, blockwidthC, xFrac, 1);
-                primitives.chroma[csp].pu[partEnum].filter_vsp(immed + (halfFilterSize - 1) * blockwidthC, blockwidthC, subpelbuf, blockwidthC, yFrac);
-                cost += chromaSatd(fencPUYuv.m_buf[1], fencStrideC, subpelbuf, blockwidthC);
+            // check mv range for slice bound
+            if ((qmv.y < qmvmin.y) | (qmv.y > qmvmax.y))
+                continue;
 
-                primitives.chroma[csp].pu[partEnum].filter_hps(refCr, refStrideC, immed, blockwidthC, xFrac, 1);
-                primitives.chroma[csp].pu[partEnum].filter_vsp(immed + (halfFilterSize - 1) * blockwidthC, blockwidthC, subpelbuf, blockwidthC, yFrac);
-                cost += chromaSatd(fencPUYuv.m_buf[2], fencStrideC, subpelbuf, blockwidthC);
-            }
+            int cost = subpelCompare(ref, qmv, cmp) + mvcost(qmv);
+            COPY2_IF_LT(bcost, cost, bdir, i);
         }
     }
 
-    return cost;
+    return bdir;
 }
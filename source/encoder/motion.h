@@ -54,10 +54,29 @@ protected:
     pixelcmp_t sad;
     pixelcmp_x3_t sad_x3;
     pixelcmp_x4_t sad_x4;
+    pixelcmp_xn_t sad_xn;
     pixelcmp_ads_t ads;
     pixelcmp_t satd;
+    pixelcmp_xn_t satd_xn;
     pixelcmp_t chromaSatd;
 
+    /* subpel candidates measured by one batched comparison */
+    enum { SUBPEL_BATCH = 8 };
+    pixel* subpelBuf;
+
+    /* full pel SADs motionEstimate() starts from, measured ahead for several
+     * references of the PU by measureStartPoints() */
+    struct StartPoint
+    {
+        const ReferencePlanes* ref;
+        MV  fpelMv;   // rounded clipped MVP
+        int sad;      // SAD at fpelMv
+        int zeroSad;  // SAD at MV(0)
+    };
+
+    StartPoint startPoint[MAX_NUM_REF];
+    int numStartPoints;
+
     MotionEstimate& operator =(const MotionEstimate&);
 
 public:
@@ -84,6 +103,9 @@ public:
     /* buf*() and motionEstimate() methods all use cached fenc pixels and thus
      * require setSourcePU() to be called prior. */
 
+    static MV clipMVP(const MV& qmvp, const MV& mvmin, const MV& mvmax, bool bVertRestriction);
+    void measureStartPoints(ReferencePlanes* const* refs, const MV* qmvp, int count);
+
     inline int bufSAD(const pixel* fref, intptr_t stride)  { return sad(fencPUYuv.m_buf[0], FENC_STRIDE, fref, stride); }
 
     inline int bufSATD(const pixel* fref, intptr_t stride) { return satd(fencPUYuv.m_buf[0], FENC_STRIDE, fref, stride); }
@@ -98,9 +120,14 @@ public:
     int motionEstimate(ReferencePlanes* ref, const MV & mvmin, const MV & mvmax, const MV & qmvp, int numCandidates, const MV * mvc, int merange, MV & outQMv, uint32_t maxSlices, bool m_vertRestriction, pixel *srcReferencePlane = 0);
 
     int subpelCompare(ReferencePlanes* ref, const MV &qmv, pixelcmp_t);
+    void subpelCompareN(ReferencePlanes* ref, const MV* qmv, int count, pixelcmp_xn_t, int32_t* costs);
 
 protected:
 
+    int chromaSubpelCompare(ReferencePlanes* ref, const MV& qmv);
+    const StartPoint* findStartPoint(const ReferencePlanes* ref, const MV& fpelMv) const;
+    int subpelRefineStep(ReferencePlanes* ref, const MV& bmv, int scale, int numDirs, bool bSatd, const MV& qmvmin, const MV& qmvmax, int& bcost);
+
     inline void StarPatternSearch(ReferencePlanes *ref,
                                   const MV &       mvmin,
                                   const MV &       mvmax,
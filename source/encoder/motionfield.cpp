@@ -0,0 +1,269 @@
+/*****************************************************************************
+ * Copyright (C) 2013-2020 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+
+#include "common.h"
+#include "motionfield.h"
+
+using namespace X265_NS;
+
+MotionFieldCache::MotionFieldCache()
+{
+    m_fields = NULL;
+    m_maxFields = 0;
+    m_freeList = -1;
+    m_bytes = 0;
+    for (int i = 0; i < NUM_BUCKETS; i++)
+        m_bucket[i] = -1;
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+bool MotionFieldCache::create(int maxFields)
+{
+    CHECKED_MALLOC_ZERO(m_fields, Field, maxFields);
+    m_maxFields = maxFields;
+    for (int i = 0; i < maxFields; i++)
+        m_fields[i].next = i + 1 < maxFields ? i + 1 : -1;
+    m_freeList = 0;
+    return true;
+
+fail:
+    return false;
+}
+
+void MotionFieldCache::destroy()
+{
+    for (int i = 0; i < m_maxFields; i++)
+    {
+        X265_FREE(m_fields[i].mvs);
+        X265_FREE(m_fields[i].costs);
+    }
+    X265_FREE(m_fields);
+    m_fields = NULL;
+    m_maxFields = 0;
+    m_freeList = -1;
+    m_bytes = 0;
+    for (int i = 0; i < NUM_BUCKETS; i++)
+        m_bucket[i] = -1;
+}
+
+int MotionFieldCache::find(int poc, int refPoc, int level) const
+{
+    for (int i = m_bucket[hash(poc, refPoc, level)]; i >= 0; i = m_fields[i].next)
+    {
+        const Field& f = m_fields[i];
+        if (f.poc == poc && f.refPoc == refPoc && f.grid.level == level)
+            return i;
+    }
+
+    return -1;
+}
+
+/* moves a field from its hash chain to the free list, keeping its buffers */
+void MotionFieldCache::unlink(int index)
+{
+    Field& f = m_fields[index];
+    int* link = &m_bucket[hash(f.poc, f.refPoc, f.grid.level)];
+    while (*link != index)
+        link = &m_fields[*link].next;
+    *link = f.next;
+
+    f.next = m_freeList;
+    m_freeList = index;
+}
+
+void MotionFieldCache::publish(int poc, int refPoc, const Grid& grid, const MV* mvs, const int32_t* costs)
+{
+    if (!m_fields || !grid.width || !grid.height)
+        return;
+
+    ScopedLock lock(m_lock);
+
+    int index = find(poc, refPoc, grid.level);
+    if (index >= 0)
+        unlink(index);
+
+    if (m_freeList < 0)
+    {
+        /* full; the oldest picture has the field least likely to be used */
+        int oldest = -1;
+        for (int i = 0; i < m_maxFields; i++)
+            if (oldest < 0 || m_fields[i].poc < m_fields[oldest].poc)
+                oldest = i;
+        unlink(oldest);
+    }
+
+    index = m_freeList;
+    Field& f = m_fields[index];
+    m_freeList = f.next;
+
+    size_t count = (size_t)grid.width * grid.height;
+    if (count > f.capacity)
+    {
+        m_bytes -= f.capacity * (sizeof(MV) + sizeof(int32_t));
+        X265_FREE(f.mvs);
+        X265_FREE(f.costs);
+        f.mvs = X265_MALLOC(MV, count);
+        f.costs = X265_MALLOC(int32_t, count);
+        if (!f.mvs || !f.costs)
+        {
+            X265_FREE(f.mvs);
+            X265_FREE(f.costs);
+            f.mvs = NULL;
+            f.costs = NULL;
+            f.capacity = 0;
+            f.next = m_freeList;
+            m_freeList = index;
+            return;
+        }
+        f.capacity = count;
+        m_bytes += count * (sizeof(MV) + sizeof(int32_t));
+        m_stats.peakBytes = X265_MAX(m_stats.peakBytes, m_bytes);
+    }
+
+    f.poc = poc;
+    f.refPoc = refPoc;
+    f.grid = grid;
+    f.grid.stride = grid.width;
+    f.bCosts = costs != NULL;
+    for (uint32_t y = 0; y < grid.height; y++)
+    {
+        memcpy(f.mvs + y * grid.width, mvs + y * grid.stride, grid.width * sizeof(MV));
+        if (costs)
+            memcpy(f.costs + y * grid.width, costs + y * grid.stride, grid.width * sizeof(int32_t));
+    }
+
+    int bucket = hash(poc, refPoc, grid.level);
+    f.next = m_bucket[bucket];
+    m_bucket[bucket] = index;
+}
+
+MV MotionFieldCache::convert(MV mv, const Grid& from, const Grid& to)
+{
+    /* each level halves the resolution */
+    int shift = to.mvShift - from.mvShift + from.level - to.level;
+    if (shift >= 0)
+        return MV(mv.x * (1 << shift), mv.y * (1 << shift));
+
+    int round = 1 << (-shift - 1);
+    return MV((mv.x + round) >> -shift, (mv.y + round) >> -shift);
+}
+
+bool MotionFieldCache::resample(int poc, int refPoc, int level, const Grid& dst, MV* dstMvs, bool bRelease)
+{
+    if (!m_fields)
+        return false;
+
+    ScopedLock lock(m_lock);
+
+    int index = find(poc, refPoc, level);
+    if (index < 0)
+        return false;
+
+    const Field& f = m_fields[index];
+    const int srcBlock = f.grid.blockSize << f.grid.level;
+    const int dstBlock = dst.blockSize << dst.level;
+
+    for (uint32_t by = 0; by < dst.height; by++)
+    {
+        /* field blocks overlapping the full resolution area of the dst block */
+        uint32_t y0 = X265_MIN((by * dstBlock) / srcBlock, f.grid.height - 1);
+        uint32_t y1 = X265_MIN(((by + 1) * dstBlock - 1) / srcBlock, f.grid.height - 1);
+
+        for (uint32_t bx = 0; bx < dst.width; bx++)
+        {
+            uint32_t x0 = X265_MIN((bx * dstBlock) / srcBlock, f.grid.width - 1);
+            uint32_t x1 = X265_MIN(((bx + 1) * dstBlock - 1) / srcBlock, f.grid.width - 1);
+            uint32_t best = ((y0 + y1) >> 1) * f.grid.width + ((x0 + x1) >> 1);
+
+            if (f.bCosts)
+            {
+                int32_t bestCost = f.costs[best];
+                for (uint32_t y = y0; y <= y1; y++)
+                {
+                    for (uint32_t x = x0; x <= x1; x++)
+                    {
+                        uint32_t idx = y * f.grid.width + x;
+                        if (f.costs[idx] < bestCost)
+                        {
+                            bestCost = f.costs[idx];
+                            best = idx;
+                        }
+                    }
+                }
+            }
+
+            dstMvs[by * dst.stride + bx] = convert(f.mvs[best], f.grid, dst);
+        }
+    }
+
+    if (bRelease)
+        unlink(index);
+
+    return true;
+}
+
+void MotionFieldCache::evict(int poc)
+{
+    if (!m_fields)
+        return;
+
+    ScopedLock lock(m_lock);
+
+    for (int b = 0; b < NUM_BUCKETS; b++)
+    {
+        int i = m_bucket[b];
+        while (i >= 0)
+        {
+            int next = m_fields[i].next;
+            if (m_fields[i].poc == poc)
+                unlink(i);
+            i = next;
+        }
+    }
+}
+
+void MotionFieldCache::evict(int poc, int refPoc, int level)
+{
+    if (!m_fields)
+        return;
+
+    ScopedLock lock(m_lock);
+
+    int index = find(poc, refPoc, level);
+    if (index >= 0)
+        unlink(index);
+}
+
+void MotionFieldCache::addSearchStats(bool bSeeded, int layersSkipped, int layersSearched)
+{
+    ScopedLock lock(m_lock);
+
+    m_stats.seedLookups++;
+    m_stats.seedHits += bSeeded;
+    m_stats.layersSkipped += layersSkipped;
+    m_stats.layersSearched += layersSearched;
+}
+
+MotionFieldCache::Stats MotionFieldCache::getStats()
+{
+    ScopedLock lock(m_lock);
+    return m_stats;
+}
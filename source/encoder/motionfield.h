@@ -0,0 +1,119 @@
+/*****************************************************************************
+ * Copyright (C) 2013-2020 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+
+#ifndef X265_MOTIONFIELD_H
+#define X265_MOTIONFIELD_H
+
+#include "common.h"
+#include "threading.h"
+#include "mv.h"
+
+namespace X265_NS {
+// private x265 namespace
+
+/* Motion fields of frame pairs, published by the lookahead motion search and
+ * used to seed the search of the temporal filter. A field is keyed by
+ * (poc, refPoc, level), the level being the number of halvings from full
+ * resolution: 1 is the lowres plane and 2 the HME lowerRes plane. Fields
+ * are copied in when they are published, so they outlive the lowres vector
+ * tables and temporal filter reference lists they came from. The fields of
+ * a picture are evicted once it is encoded */
+class MotionFieldCache
+{
+public:
+
+    enum { LEVEL_LOWRES = 1, LEVEL_LOWERRES = 2 };
+
+    /* block layout and vector precision of a field */
+    struct Grid
+    {
+        uint32_t width;     // blocks per row
+        uint32_t height;    // block rows
+        uint32_t stride;    // vectors from one block row to the next
+        int      level;
+        int      blockSize; // in pels of the level
+        int      mvShift;   // fraction bits of the vectors, 2 for quarter pel
+    };
+
+    struct Stats
+    {
+        uint64_t seedLookups;     // temporal filter pairs which looked for a seed
+        uint64_t seedHits;
+        uint64_t layersSkipped;   // temporal filter search layers replaced by a seed
+        uint64_t layersSearched;
+        size_t   peakBytes;
+    };
+
+    MotionFieldCache();
+    ~MotionFieldCache()        { destroy(); }
+
+    bool create(int maxFields);
+    void destroy();
+
+    /* copies the field of a pair, costs may be NULL. Republishing a pair
+     * replaces its field */
+    void publish(int poc, int refPoc, const Grid& grid, const MV* mvs, const int32_t* costs);
+
+    /* writes the field of the pair at the given level into the blocks of dst,
+     * converted to its resolution and vector precision. A dst block covering
+     * several field blocks takes the vector of the lowest cost. bRelease
+     * evicts the field afterwards. Returns false if the field is not cached */
+    bool resample(int poc, int refPoc, int level, const Grid& dst, MV* dstMvs, bool bRelease);
+
+    void evict(int poc);
+    void evict(int poc, int refPoc, int level);
+
+    void addSearchStats(bool bSeeded, int layersSkipped, int layersSearched);
+    Stats getStats();
+
+protected:
+
+    struct Field
+    {
+        int      poc;
+        int      refPoc;
+        Grid     grid;      // stride is always width
+        MV*      mvs;
+        int32_t* costs;
+        bool     bCosts;    // false if the publisher had no costs
+        size_t   capacity;  // vectors mvs and costs can hold
+        int      next;      // next field of the hash chain or of the free list
+    };
+
+    enum { NUM_BUCKETS = 256 };
+
+    Lock     m_lock;
+    Field*   m_fields;
+    int      m_maxFields;
+    int      m_freeList;
+    int      m_bucket[NUM_BUCKETS];
+    size_t   m_bytes;
+    Stats    m_stats;
+
+    static int  hash(int poc, int refPoc, int level) { return (poc * 67 + refPoc * 7 + level) & (NUM_BUCKETS - 1); }
+    static MV   convert(MV mv, const Grid& from, const Grid& to);
+
+    int  find(int poc, int refPoc, int level) const;
+    void unlink(int index);
+};
+}
+
+#endif // ifndef X265_MOTIONFIELD_H
@@ -48,6 +48,10 @@ public:
     int         numInterpPlanes;
     uint32_t*   numSliceWeightedRows;
 
+    /* motion of the whole picture towards this reference, the median of the
+     * lookahead vectors, only estimated for --me epzs */
+    MV          globalMV;
+
 protected:
 
     MotionReference& operator =(const MotionReference&);
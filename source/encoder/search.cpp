@@ -33,6 +33,7 @@
 
 #include "analysis.h"  // TLD
 #include "framedata.h"
+#include "motionfield.h"
 
 using namespace X265_NS;
 
@@ -1990,14 +1991,9 @@ uint32_t Search::mergeEstimation(CUData& cu, const CUGeom& cuGeom, const Predict
 MV Search::getLowresMV(const CUData& cu, const PredictionUnit& pu, int list, int ref)
 {
     int diffPoc = abs(m_slice->m_poc - m_slice->m_refPOCList[list][ref]);
-    if (diffPoc > m_param->bframes + 1)
-        /* poc difference is out of range for lookahead */
-        return 0;
-
-    MV* mvs = m_frame->m_lowres.lowresMvs[list][diffPoc];
-    if (mvs[0].x == 0x7FFF)
-        /* this motion search was not estimated by lookahead */
-        return 0;
+    MV* mvs = diffPoc <= m_param->bframes + 1 ? m_frame->m_lowres.lowresMvs[list][diffPoc] : NULL;
+    if (!mvs)
+        return 0; /* poc difference is out of range for lookahead */
 
     uint32_t block_x = (cu.m_cuPelX + g_zscanToPelX[pu.puAbsPartIdx] + pu.width / 2) >> 4;
     uint32_t block_y = (cu.m_cuPelY + g_zscanToPelY[pu.puAbsPartIdx] + pu.height / 2) >> 4;
@@ -2009,6 +2005,27 @@ MV Search::getLowresMV(const CUData& cu, const PredictionUnit& pu, int list, int
     return mvs[idx] << 1; /* scale up lowres mv */
 }
 
+/* add the predictors of --me epzs to the motion candidates: the motion of
+ * the reference picture around the PU and the global motion towards it.
+ * Zero and the candidates already listed are skipped */
+int Search::getEpzsCandidates(const CUData& cu, const PredictionUnit& pu, int list, int ref, MV* mvc, int numMvc)
+{
+    MV cand[NUM_EPZS_CAND];
+    int numCand = cu.getRefPicMotion(cand, list, ref, pu.puAbsPartIdx, pu.width, pu.height);
+    cand[numCand++] = m_slice->m_mref[list][ref].globalMV;
+
+    for (int i = 0; i < numCand; i++)
+    {
+        bool bListed = !cand[i].notZero();
+        for (int j = 0; j < numMvc; j++)
+            bListed |= cand[i] == mvc[j];
+        if (!bListed)
+            mvc[numMvc++] = cand[i];
+    }
+
+    return numMvc;
+}
+
 /* Pick between the two AMVP candidates which is the best one to use as
  * MVP for the motion search, based on SAD cost */
 int Search::selectMVP(const CUData& cu, const PredictionUnit& pu, const MV amvp[AMVP_NUM_CANDS], int list, int ref)
@@ -2122,8 +2139,8 @@ void Search::singleMotionEstimation(Search& master, Mode& interMode, const Predi
 
     MotionData* bestME = interMode.bestME[part];
 
-    // 12 mv candidates including lowresMV
-    MV  mvc[(MD_ABOVE_LEFT + 1) * 2 + 2];
+    // 12 mv candidates including lowresMV, and the EPZS candidates
+    MV  mvc[(MD_ABOVE_LEFT + 1) * 2 + 2 + NUM_EPZS_CAND];
 #if (ENABLE_MULTIVIEW || ENABLE_SCC_EXT)
     int numMvc = interMode.cu.getPMV(interMode.interNeighbours, list, ref, interMode.amvpCand[list][ref], mvc, 0, pu.puAbsPartIdx);
 #else
@@ -2144,6 +2161,8 @@ void Search::singleMotionEstimation(Search& master, Mode& interMode, const Predi
         if (m_param->bEnableHME)
             mvp_lowres = lmv;
     }
+    if (m_param->searchMethod == X265_EPZS_SEARCH)
+        numMvc = getEpzsCandidates(interMode.cu, pu, list, ref, mvc, numMvc);
 
     m_vertRestriction = interMode.cu.m_slice->m_refPOCList[list][ref] == interMode.cu.m_slice->m_poc;
     setSearchRange(interMode.cu, mvp, m_param->searchRange, mvmin, mvmax);
@@ -2228,8 +2247,8 @@ void Search::predInterSearch(Mode& interMode, const CUGeom& cuGeom, bool bChroma
     CUData& cu = interMode.cu;
     Yuv* predYuv = &interMode.predYuv;
 
-    // 12 mv candidates including lowresMV
-    MV mvc[(MD_ABOVE_LEFT + 1) * 2 + 2];
+    // 12 mv candidates including lowresMV, and the EPZS candidates
+    MV mvc[(MD_ABOVE_LEFT + 1) * 2 + 2 + NUM_EPZS_CAND];
 
     const Slice *slice = m_slice;
     int numPart     = cu.getNumPartInter(0);
@@ -2452,6 +2471,14 @@ void Search::predInterSearch(Mode& interMode, const CUGeom& cuGeom, bool bChroma
                 if (!list && m_ibcEnabled)
                     numIdx--;
 #endif
+                /* every reference of the list is set up first, so that the
+                 * start points of all of their searches are measured by one
+                 * batched SAD of the PU */
+                RefSearch refSearch[MAX_NUM_REF];
+                ReferencePlanes* refPlanes[MAX_NUM_REF];
+                MV startMvs[MAX_NUM_REF];
+                int numSearches = 0;
+
                 for (int ref = 0; ref < numIdx; ref++)
                 {
                     ProfileCounter(interMode.cu, totalMotionReferences[cuGeom.depth]);
@@ -2462,29 +2489,54 @@ void Search::predInterSearch(Mode& interMode, const CUGeom& cuGeom, bool bChroma
                         continue;
                     }
 
-                    uint32_t bits = m_listSelBits[list] + MVP_IDX_BITS;
-                    bits += getTUBits(ref, numIdx);
+                    RefSearch& rs = refSearch[numSearches];
+                    rs.ref = ref;
+                    rs.bits = m_listSelBits[list] + MVP_IDX_BITS;
+                    rs.bits += getTUBits(ref, numIdx);
 
 #if (ENABLE_MULTIVIEW || ENABLE_SCC_EXT)
-                    int numMvc = cu.getPMV(interMode.interNeighbours, list, ref, interMode.amvpCand[list][ref], mvc, puIdx, pu.puAbsPartIdx);
+                    rs.numMvc = cu.getPMV(interMode.interNeighbours, list, ref, interMode.amvpCand[list][ref], rs.mvc, puIdx, pu.puAbsPartIdx);
 #else
-                    int numMvc = cu.getPMV(interMode.interNeighbours, list, ref, interMode.amvpCand[list][ref], mvc);
+                    rs.numMvc = cu.getPMV(interMode.interNeighbours, list, ref, interMode.amvpCand[list][ref], rs.mvc);
 #endif
 
                     const MV* amvp = interMode.amvpCand[list][ref];
-                    int mvpIdx = selectMVP(cu, pu, amvp, list, ref);
-                    MV mvmin, mvmax, outmv, mvp = amvp[mvpIdx], mvp_lowres;
-                    bool bLowresMVP = false;
+                    rs.mvpIdx = selectMVP(cu, pu, amvp, list, ref);
+                    rs.mvp = amvp[rs.mvpIdx];
+                    rs.mvp_lowres = MV();
 
                     if (!strlen(m_param->analysisSave) && !strlen(m_param->analysisLoad)) /* Prevents load/save outputs from diverging when lowresMV is not available */
                     {
                         MV lmv = getLowresMV(cu, pu, list, ref);
                         int layer = m_param->numViews > 1 ? m_frame->m_viewId : (m_param->numScalableLayers > 1) ? m_frame->m_sLayerId : 0;
                         if (lmv.notZero() && !layer)
-                            mvc[numMvc++] = lmv;
+                            rs.mvc[rs.numMvc++] = lmv;
                         if (m_param->bEnableHME)
-                            mvp_lowres = lmv;
+                            rs.mvp_lowres = lmv;
                     }
+                    if (m_param->searchMethod == X265_EPZS_SEARCH)
+                        rs.numMvc = getEpzsCandidates(cu, pu, list, ref, rs.mvc, rs.numMvc);
+                    m_vertRestriction = rs.bVertRestriction = cu.m_slice->m_refPOCList[list][ref] == cu.m_slice->m_poc;
+                    setSearchRange(cu, rs.mvp, m_param->searchRange, rs.mvmin, rs.mvmax);
+
+                    refPlanes[numSearches] = &slice->m_mref[list][ref];
+                    startMvs[numSearches] = MotionEstimate::clipMVP(rs.mvp, rs.mvmin, rs.mvmax, m_vertRestriction);
+                    numSearches++;
+                }
+
+                if (!m_param->bSourceReferenceEstimation)
+                    m_me.measureStartPoints(refPlanes, startMvs, numSearches);
+
+                for (int i = 0; i < numSearches; i++)
+                {
+                    RefSearch& rs = refSearch[i];
+                    int ref = rs.ref;
+                    uint32_t bits = rs.bits;
+                    const MV* amvp = interMode.amvpCand[list][ref];
+                    int mvpIdx = rs.mvpIdx;
+                    MV mvmin = rs.mvmin, mvmax = rs.mvmax, outmv, mvp = rs.mvp, mvp_lowres = rs.mvp_lowres;
+                    bool bLowresMVP = false;
+
                     if (m_param->searchMethod == X265_SEA)
                     {
                         int puX = puIdx & 1;
@@ -2492,16 +2544,15 @@ void Search::predInterSearch(Mode& interMode, const CUGeom& cuGeom, bool bChroma
                         for (int planes = 0; planes < INTEGRAL_PLANE_NUM; planes++)
                             m_me.integral[planes] = interMode.fencYuv->m_integral[list][ref][planes] + puX * pu.width + puY * pu.height * m_slice->m_refFrameList[list][ref]->m_reconPic[0]->m_stride;
                     }
-                    m_vertRestriction = cu.m_slice->m_refPOCList[list][ref] == cu.m_slice->m_poc;
-                    setSearchRange(cu, mvp, m_param->searchRange, mvmin, mvmax);
-                    int satdCost = m_me.motionEstimate(&slice->m_mref[list][ref], mvmin, mvmax, mvp, numMvc, mvc, m_param->searchRange, outmv, m_param->maxSlices, m_vertRestriction,
+                    m_vertRestriction = rs.bVertRestriction;
+                    int satdCost = m_me.motionEstimate(&slice->m_mref[list][ref], mvmin, mvmax, mvp, rs.numMvc, rs.mvc, m_param->searchRange, outmv, m_param->maxSlices, m_vertRestriction,
                       m_param->bSourceReferenceEstimation ? m_slice->m_refFrameList[list][ref]->m_fencPic->getLumaAddr(0) : 0);
 
                     if (m_param->bEnableHME && mvp_lowres.notZero() && mvp_lowres != mvp)
                     {
                         MV outmv_lowres;
                         setSearchRange(cu, mvp_lowres, m_param->searchRange, mvmin, mvmax);
-                        int lowresMvCost = m_me.motionEstimate(&slice->m_mref[list][ref], mvmin, mvmax, mvp_lowres, numMvc, mvc, m_param->searchRange, outmv_lowres, m_param->maxSlices, m_vertRestriction,
+                        int lowresMvCost = m_me.motionEstimate(&slice->m_mref[list][ref], mvmin, mvmax, mvp_lowres, rs.numMvc, rs.mvc, m_param->searchRange, outmv_lowres, m_param->maxSlices, m_vertRestriction,
                             m_param->bSourceReferenceEstimation ? m_slice->m_refFrameList[list][ref]->m_fencPic->getLumaAddr(0) : 0);
                         if (lowresMvCost < satdCost)
                         {
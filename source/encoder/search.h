@@ -50,6 +50,7 @@
 #endif
 
 #define NUM_SUBPART MAX_TS_SIZE * 4 // 4 sub partitions * 4 depth
+#define NUM_EPZS_CAND 4 // co-located, right and below motion of the reference and the global motion
 
 namespace X265_NS {
 // private namespace
@@ -340,6 +341,7 @@ public:
     void checkDQPForSplitPred(Mode& mode, const CUGeom& cuGeom);
 
     MV getLowresMV(const CUData& cu, const PredictionUnit& pu, int list, int ref);
+    int getEpzsCandidates(const CUData& cu, const PredictionUnit& pu, int list, int ref, MV* mvc, int numMvc);
 
 #if ENABLE_SCC_EXT
     void      predInterSearch(Mode& interMode, const CUGeom& cuGeom, bool bChromaMC, uint32_t masks[2], MV* iMVCandList = NULL);
@@ -451,6 +453,21 @@ protected:
         uint32_t bits;
     };
 
+    /* setup of the unidirectional search of one reference of a PU */
+    struct RefSearch
+    {
+        MV       mvc[(MD_ABOVE_LEFT + 1) * 2 + 2 + NUM_EPZS_CAND];
+        MV       mvp;
+        MV       mvp_lowres;
+        MV       mvmin;
+        MV       mvmax;
+        int      numMvc;
+        int      mvpIdx;
+        int      ref;
+        uint32_t bits;
+        bool     bVertRestriction;
+    };
+
     /* inter/ME helper functions */
     int       selectMVP(const CUData& cu, const PredictionUnit& pu, const MV amvp[AMVP_NUM_CANDS], int list, int ref);
     const MV& checkBestMVP(const MV amvpCand[2], const MV& mv, int& mvpIdx, uint32_t& outBits, uint32_t& outCost) const;
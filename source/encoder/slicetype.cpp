@@ -97,63 +97,12 @@ uint32_t acEnergyVarHist(uint64_t sum_ssd, int shift)
 
 bool computeEdge(pixel* edgePic, pixel* refPic, pixel* edgeTheta, intptr_t stride, int height, int width, bool bcalcTheta, pixel whitePixel)
 {
-    intptr_t rowOne = 0, rowTwo = 0, rowThree = 0, colOne = 0, colTwo = 0, colThree = 0;
-    intptr_t middle = 0, topLeft = 0, topRight = 0, bottomLeft = 0, bottomRight = 0;
-
-    const int startIndex = 1;
-
     if (!edgePic || !refPic || (!edgeTheta && bcalcTheta))
-    {
         return false;
-    }
-    else
-    {
-        float gradientH = 0, gradientV = 0, radians = 0, theta = 0;
-        float gradientMagnitude = 0;
-        pixel blackPixel = 0;
-
-        //Applying Sobel filter expect for border pixels
-        height = height - startIndex;
-        width = width - startIndex;
-        for (int rowNum = startIndex; rowNum < height; rowNum++)
-        {
-            rowTwo = rowNum * stride;
-            rowOne = rowTwo - stride;
-            rowThree = rowTwo + stride;
 
-            for (int colNum = startIndex; colNum < width; colNum++)
-            {
-
-                 /*  Horizontal and vertical gradients
-                     [ -3   0   3 ]        [-3   -10  -3 ]
-                 gH =[ -10  0   10]   gV = [ 0    0    0 ]
-                     [ -3   0   3 ]        [ 3    10   3 ] */
-
-                colTwo = colNum;
-                colOne = colTwo - startIndex;
-                colThree = colTwo + startIndex;
-                middle = rowTwo + colTwo;
-                topLeft = rowOne + colOne;
-                topRight = rowOne + colThree;
-                bottomLeft = rowThree + colOne;
-                bottomRight = rowThree + colThree;
-                gradientH = (float)(-3 * refPic[topLeft] + 3 * refPic[topRight] - 10 * refPic[rowTwo + colOne] + 10 * refPic[rowTwo + colThree] - 3 * refPic[bottomLeft] + 3 * refPic[bottomRight]);
-                gradientV = (float)(-3 * refPic[topLeft] - 10 * refPic[rowOne + colTwo] - 3 * refPic[topRight] + 3 * refPic[bottomLeft] + 10 * refPic[rowThree + colTwo] + 3 * refPic[bottomRight]);
-                gradientMagnitude = sqrtf(gradientH * gradientH + gradientV * gradientV);
-                if(bcalcTheta) 
-                {
-                    edgeTheta[middle] = 0;
-                    radians = atan2(gradientV, gradientH);
-                    theta = (float)((radians * 180) / PI);
-                    if (theta < 0)
-                       theta = 180 + theta;
-                    edgeTheta[middle] = (pixel)theta;
-                }
-                edgePic[middle] = (pixel)(gradientMagnitude >= EDGE_THRESHOLD ? whitePixel : blackPixel);
-            }
-        }
-        return true;
-    }
+    //Applying Sobel filter expect for border pixels
+    primitives.edgeSobel(edgePic, bcalcTheta ? edgeTheta : NULL, refPic, stride, width, height, whitePixel);
+    return true;
 }
 
 void edgeFilter(Frame *curFrame, x265_param* param)
@@ -175,68 +124,17 @@ void edgeFilter(Frame *curFrame, x265_param* param)
 
     for (int i = 0; i < height; i++)
     {
-        memcpy(edgePic, src, width * sizeof(pixel));
-        memcpy(refPic, src, width * sizeof(pixel));
-        src += stride;
-        edgePic += stride;
-        refPic += stride;
+        memcpy(edgePic + i * stride, src + i * stride, width * sizeof(pixel));
+        memcpy(refPic + i * stride, src + i * stride, width * sizeof(pixel));
     }
 
-    //Applying Gaussian filter on the picture
-    src = (pixel*)curFrame->m_fencPic->m_picOrg[0];
-    refPic = curFrame->m_gaussianPic + curFrame->m_fencPic->m_lumaMarginY * stride + curFrame->m_fencPic->m_lumaMarginX;
-    edgePic = curFrame->m_edgePic + curFrame->m_fencPic->m_lumaMarginY * stride + curFrame->m_fencPic->m_lumaMarginX;
-    pixel pixelValue = 0;
-
-    for (int rowNum = 0; rowNum < height; rowNum++)
-    {
-        for (int colNum = 0; colNum < width; colNum++)
-        {
-            if ((rowNum >= 2) && (colNum >= 2) && (rowNum < height - 2) && (colNum < width - 2)) //Ignoring the border pixels of the picture
-            {
-                /*  5x5 Gaussian filter
-                    [2   4   5   4   2]
-                 1  [4   9   12  9   4]
-                --- [5   12  15  12  5]
-                159 [4   9   12  9   4]
-                    [2   4   5   4   2]*/
-
-                const intptr_t rowOne = (rowNum - 2)*stride, colOne = colNum - 2;
-                const intptr_t rowTwo = (rowNum - 1)*stride, colTwo = colNum - 1;
-                const intptr_t rowThree = rowNum * stride, colThree = colNum;
-                const intptr_t rowFour = (rowNum + 1)*stride, colFour = colNum + 1;
-                const intptr_t rowFive = (rowNum + 2)*stride, colFive = colNum + 2;
-                const intptr_t index = (rowNum*stride) + colNum;
-
-                pixelValue = ((2 * src[rowOne + colOne] + 4 * src[rowOne + colTwo] + 5 * src[rowOne + colThree] + 4 * src[rowOne + colFour] + 2 * src[rowOne + colFive] +
-                    4 * src[rowTwo + colOne] + 9 * src[rowTwo + colTwo] + 12 * src[rowTwo + colThree] + 9 * src[rowTwo + colFour] + 4 * src[rowTwo + colFive] +
-                    5 * src[rowThree + colOne] + 12 * src[rowThree + colTwo] + 15 * src[rowThree + colThree] + 12 * src[rowThree + colFour] + 5 * src[rowThree + colFive] +
-                    4 * src[rowFour + colOne] + 9 * src[rowFour + colTwo] + 12 * src[rowFour + colThree] + 9 * src[rowFour + colFour] + 4 * src[rowFour + colFive] +
-                    2 * src[rowFive + colOne] + 4 * src[rowFive + colTwo] + 5 * src[rowFive + colThree] + 4 * src[rowFive + colFour] + 2 * src[rowFive + colFive]) / 159);
-                refPic[index] = pixelValue;
-            }
-        }
-    }
+    //Applying Gaussian filter on the picture, ignoring the border pixels
+    primitives.edgeGaussian(refPic, src, stride, width, height);
 
     if(!computeEdge(edgePic, refPic, edgeTheta, stride, height, width, true))
         x265_log(NULL, X265_LOG_ERROR, "Failed edge computation!");
 }
 
-//Find the angle of a block by averaging the pixel angles 
-inline void findAvgAngle(const pixel* block, intptr_t stride, uint32_t size, uint32_t &angle)
-{
-    int sum = 0;
-    for (uint32_t y = 0; y < size; y++)
-    {
-        for (uint32_t x = 0; x < size; x++)
-        {
-            sum += block[x];
-        }
-        block += stride;
-    }
-    angle = sum / (size*size);
-}
-
 uint32_t LookaheadTLD::edgeDensityCu(Frame* curFrame, uint32_t &avgAngle, uint32_t blockX, uint32_t blockY, uint32_t qgSize)
 {
     pixel *edgeImage = curFrame->m_edgePic + curFrame->m_fencPic->m_lumaMarginY * curFrame->m_fencPic->m_stride + curFrame->m_fencPic->m_lumaMarginX;
@@ -246,14 +144,15 @@ uint32_t LookaheadTLD::edgeDensityCu(Frame* curFrame, uint32_t &avgAngle, uint32
     int plane = 0; // Sobel filter is applied only on Y component
     uint32_t var;
 
+    /* the average angle of the block is the pixel sum in the low half of var */
     if (qgSize == 8)
     {
-        findAvgAngle(edgeTheta + blockOffsetLuma, srcStride, qgSize, avgAngle);
+        avgAngle = (uint32_t)primitives.cu[BLOCK_8x8].var(edgeTheta + blockOffsetLuma, srcStride) / 64;
         var = acEnergyVar(curFrame, primitives.cu[BLOCK_8x8].var(edgeImage + blockOffsetLuma, srcStride), 6, plane);
     }
     else
     {
-        findAvgAngle(edgeTheta + blockOffsetLuma, srcStride, 16, avgAngle);
+        avgAngle = (uint32_t)primitives.cu[BLOCK_16x16].var(edgeTheta + blockOffsetLuma, srcStride) / 256;
         var = acEnergyVar(curFrame, primitives.cu[BLOCK_16x16].var(edgeImage + blockOffsetLuma, srcStride), 8, plane);
     }
     x265_emms();
@@ -451,6 +350,10 @@ void LookaheadTLD::xPreanalyze(Frame* curFrame)
 
 void LookaheadTLD::calcAdaptiveQuantFrame(Frame *curFrame, x265_param* param)
 {
+    /* referenced pictures take the cuTree offsets of a first pass or of a
+     * lookahead file in place of their AQ */
+    bool bCuTreeRead = (param->rc.bStatRead || strlen(param->lookaheadLoad)) && param->rc.cuTree && IS_REFERENCED(curFrame);
+
     /* Actual adaptive quantization */
     int maxCol = curFrame->m_fencPic->m_picWidth;
     int maxRow = curFrame->m_fencPic->m_picHeight;
@@ -478,7 +381,7 @@ void LookaheadTLD::calcAdaptiveQuantFrame(Frame *curFrame, x265_param* param)
         curFrame->m_lowres.wp_sum[y] = 0;
     }
 
-    if (!(param->rc.bStatRead && param->rc.cuTree && IS_REFERENCED(curFrame)))
+    if (!bCuTreeRead)
     {
         /* Calculate Qp offset for each 16x16 or 8x8 block in the frame */
         if (param->rc.aqMode == X265_AQ_NONE || param->rc.aqStrength == 0)
@@ -702,7 +605,7 @@ void LookaheadTLD::calcAdaptiveQuantFrame(Frame *curFrame, x265_param* param)
 
     if (param->bEnableWeightedPred || param->bEnableWeightedBiPred)
     {
-        if (param->rc.bStatRead && param->rc.cuTree && IS_REFERENCED(curFrame))
+        if (bCuTreeRead)
         {
             for (int blockY = 0; blockY < maxRow; blockY += loopIncr)
                 for (int blockX = 0; blockX < maxCol; blockX += loopIncr)
@@ -725,7 +628,7 @@ void LookaheadTLD::calcAdaptiveQuantFrame(Frame *curFrame, x265_param* param)
         }
     }
 
-    if (param->bDynamicRefine || param->bEnableFades)
+    if (param->bDynamicRefine || param->bEnableFades || param->bSplitPredict)
     {
         uint64_t blockXY = 0, rowVariance = 0;
         curFrame->m_lowres.frameVariance = 0;
@@ -1018,10 +921,15 @@ Lookahead::Lookahead(x265_param *param, ThreadPool* pool)
     m_lastNonB = NULL;
     m_isSceneTransition = false;
     m_scratch  = NULL;
+    m_aqMotionScratch = NULL;
+    m_plans    = NULL;
+    m_cuTreeDelta = NULL;
+    m_cuTreeCost = NULL;
     m_tld      = NULL;
     m_filled   = false;
     m_outputSignalRequired = false;
     m_isActive = true;
+    m_bFailed = false;
     m_inputCount = 0;
     m_extendGopBoundary = false;
     m_8x8Height = ((m_param->sourceHeight / 2) + X265_LOWRES_CU_SIZE - 1) >> X265_LOWRES_CU_BITS;
@@ -1029,6 +937,11 @@ Lookahead::Lookahead(x265_param *param, ThreadPool* pool)
     m_4x4Height = ((m_param->sourceHeight / 4) + X265_LOWRES_CU_SIZE - 1) >> X265_LOWRES_CU_BITS;
     m_4x4Width = ((m_param->sourceWidth / 4) + X265_LOWRES_CU_SIZE - 1) >> X265_LOWRES_CU_BITS;
     m_cuCount = m_8x8Width * m_8x8Height;
+
+    /* batch jobs of small lowres pictures evaluate several estimates, so the
+     * per job cost stays well above the cost of handing it out */
+    m_batchGrain = m_param->lookaheadBatch ? m_param->lookaheadBatch :
+                   x265_clip3(1, (int)CostEstimateGroup::MAX_BATCH_GROUP, 8192 / X265_MAX(m_cuCount, 1));
     m_8x8Blocks = m_8x8Width > 2 && m_8x8Height > 2 ? (m_cuCount + 4 - 2 * (m_8x8Width + m_8x8Height)) : m_cuCount;
     m_isFadeIn = false;
     m_fadeCount = 0;
@@ -1041,6 +954,9 @@ Lookahead::Lookahead(x265_param *param, ThreadPool* pool)
 
     m_lastKeyframe = -m_param->keyframeMax;
     m_sliceTypeBusy = false;
+    m_propagateBusy = false;
+    m_planFirst = m_planQueued = m_planRecorded = 0;
+    m_pendingHeld = 0;
     m_fullQueueSize = X265_MAX(1, m_param->lookaheadDepth);
     m_bAdaptiveQuant = m_param->rc.aqMode ||
                        m_param->bEnableWeightedPred ||
@@ -1055,6 +971,10 @@ Lookahead::Lookahead(x265_param *param, ThreadPool* pool)
      * slicetypeDecide() */
     m_bBatchMotionSearch = m_pool && m_param->bFrameAdaptive == X265_B_ADAPT_TRELLIS;
 
+    /* slice types read from a first pass or a lookahead analysis file skip
+     * slicetypeAnalyse(), the cuTree and the VBV planning */
+    m_bTypesRead = m_param->rc.bStatRead || strlen(m_param->lookaheadLoad);
+
     /* It is also beneficial to pre-calculate all possible frame cost estimates
      * using worker threads bonded to the worker thread running
      * slicetypeDecide(). This creates bframes * bframes jobs which take less
@@ -1064,6 +984,30 @@ Lookahead::Lookahead(x265_param *param, ThreadPool* pool)
      * of work */
     m_bBatchFrameCosts = m_bBatchMotionSearch;
 
+    /* With a thread pool, the cuTree propagation and VBV planning of a
+     * mini-GOP run as a separate stage, overlapping the slicetypeDecide() of
+     * the next mini-GOP; its pictures are only handed out once their plan has
+     * run. Modes which alter the lowres data of the window while deciding
+     * (motion AQ, MCSTF, zone reconfiguration) or which look into the decided
+     * pictures from outside keep the serial order */
+    m_bPipelinedCuTree = m_pool && m_param->lookaheadDepth && !m_bTypesRead &&
+                         (m_param->rc.cuTree || m_param->rc.vbvBufferSize) &&
+                         !m_param->bAQMotion && !m_param->bEnableTemporalFilter &&
+                         !m_param->rc.zonefileCount && !m_param->bliveVBV2pass &&
+                         !m_param->bCTUInfo && !strlen(m_param->analysisLoad);
+
+    /* The incremental propagation relies on the propagate costs and QP offsets
+     * of the window surviving from one plan to the next */
+    m_bIncrementalCuTree = m_param->bIncrementalCuTree && m_param->rc.cuTree && m_param->lookaheadDepth &&
+                           !m_bTypesRead && !m_param->bAQMotion;
+    m_bShareMotionFields = m_param->bShareMotionFields && m_param->bEnableTemporalFilter;
+    m_cuTreeSerial = 0;
+    m_cuTreeMaxFrames = 0;
+    m_numCuTreeTracked = 0;
+#if DETAILED_CU_STATS
+    memset(&m_cuTreeWork, 0, sizeof(m_cuTreeWork));
+#endif
+
     if (m_param->lookaheadSlices && !m_pool)
     {
         x265_log(param, X265_LOG_WARNING, "No pools found; disabling lookahead-slices\n");
@@ -1076,18 +1020,20 @@ Lookahead::Lookahead(x265_param *param, ThreadPool* pool)
         m_param->lookaheadSlices = 0;
     }
 
+    int coopSlices = X265_MAX(m_param->lookaheadSlices, 1);
+    setCoopSlices(coopSlices);
     if (m_param->lookaheadSlices > 1)
-    {
-        m_numRowsPerSlice = m_8x8Height / m_param->lookaheadSlices;
-        m_numRowsPerSlice = X265_MAX(m_numRowsPerSlice, 10);            // at least 10 rows per slice
-        m_numRowsPerSlice = X265_MIN(m_numRowsPerSlice, m_8x8Height);   // but no more than the full picture
-        m_numCoopSlices = m_8x8Height / m_numRowsPerSlice;
         m_param->lookaheadSlices = m_numCoopSlices;                     // report actual final slice count
-    }
-    else
+
+    /* the adaptive lookahead starts out with the configured setting */
+    m_bAdaptiveLookahead = m_param->bAdaptiveLookahead && m_param->lookaheadDepth > 1 && !m_bTypesRead;
+    m_lookaheadDepth = X265_LOOKAHEAD_MAX;
+    m_trellisDepth = X265_BFRAME_MAX;
+    if (m_bAdaptiveLookahead)
     {
-        m_numRowsPerSlice = m_8x8Height;
-        m_numCoopSlices = 1;
+        m_throughput.init(*m_param, coopSlices);
+        m_lookaheadDepth = m_throughput.depth;
+        m_trellisDepth = m_throughput.trellis;
     }
     if (param->gopLookahead && (param->gopLookahead > (param->lookaheadDepth - param->bframes - 2)))
     {
@@ -1099,6 +1045,8 @@ Lookahead::Lookahead(x265_param *param, ThreadPool* pool)
     m_preLookaheadElapsedTime = 0;
     m_countSlicetypeDecide = 0;
     m_countPreLookahead = 0;
+    m_cuTreeElapsedTime = 0;
+    m_countCuTree = 0;
 #endif
 
     m_accHistDiffRunningAvgCb = X265_MALLOC(uint32_t*, NUMBER_OF_SEGMENTS_IN_WIDTH * sizeof(uint32_t*));
@@ -1168,6 +1116,22 @@ bool Lookahead::create()
     for (int i = 0; i < numTLD; i++)
         m_tld[i].init(m_8x8Width, m_8x8Height, m_8x8Blocks);
     m_scratch = X265_MALLOC(int, m_tld[0].widthInCU);
+    if (m_param->bAQMotion)
+    {
+        m_aqMotionScratch = X265_MALLOC(double, m_cuCount);
+        if (!m_aqMotionScratch)
+            return false;
+    }
+    m_plans = new LookaheadPlan[m_bPipelinedCuTree ? LOOKAHEAD_PLANS : 1];
+    if (m_bIncrementalCuTree)
+    {
+        m_cuTreeMaxFrames = X265_MIN(m_param->lookaheadDepth, X265_LOOKAHEAD_MAX) + 2;
+        m_cuTreeDelta = X265_MALLOC(int32_t, (size_t)m_cuTreeMaxFrames * m_cuCount);
+        m_cuTreeCost = X265_MALLOC(uint16_t, m_8x8Width + m_cuCount);
+        if (!m_cuTreeDelta || !m_cuTreeCost)
+            return false;
+        memset(m_cuTreeCost, 0, m_8x8Width * sizeof(uint16_t));
+    }
 
     if (m_param->bEnableTemporalFilter)
     {
@@ -1175,20 +1139,35 @@ bool Lookahead::create()
         m_origPicBuf = new OrigPicBuffer();
     }
 
-    return m_tld && m_scratch;
+    if (m_bShareMotionFields)
+    {
+        /* a picture publishes a lowres and an HME field per MCSTF reference,
+         * kept until MCSTF consumes them or the picture is encoded */
+        int numFrames = X265_MIN(m_param->lookaheadDepth, X265_LOOKAHEAD_MAX) + m_param->bframes + m_param->frameNumThreads + 4;
+        if (!m_mvFieldCache.create(numFrames * 2 * 2 * m_param->mcstfFrameRange))
+            return false;
+    }
+
+    return m_tld && m_scratch && m_plans;
 }
 
 void Lookahead::stopJobs()
 {
-    if (m_pool && !m_inputQueue.empty())
+    if (m_pool && (!m_inputQueue.empty() || m_bPipelinedCuTree))
     {
         m_inputLock.acquire();
         m_isActive = false;
-        bool wait = m_outputSignalRequired = m_sliceTypeBusy;
+        bool wait = m_outputSignalRequired = m_sliceTypeBusy || m_propagateBusy;
         m_inputLock.release();
 
-        if (wait)
+        while (wait)
+        {
             m_outputSignal.wait();
+
+            m_inputLock.acquire();
+            wait = m_outputSignalRequired = m_sliceTypeBusy || m_propagateBusy;
+            m_inputLock.release();
+        }
     }
     if (m_pool && m_param->lookaheadThreads > 0)
     {
@@ -1199,7 +1178,7 @@ void Lookahead::stopJobs()
 
 void Lookahead::destroy()
 {
-    // these two queues will be empty unless the encode was aborted
+    // these queues will be empty unless the encode was aborted
     while (!m_inputQueue.empty())
     {
         Frame* curFrame = m_inputQueue.popFront();
@@ -1207,6 +1186,13 @@ void Lookahead::destroy()
         delete curFrame;
     }
 
+    while (!m_pendingQueue.empty())
+    {
+        Frame* curFrame = m_pendingQueue.popFront();
+        curFrame->destroy();
+        delete curFrame;
+    }
+
     while (!m_outputQueue.empty())
     {
         Frame* curFrame = m_outputQueue.popFront();
@@ -1227,6 +1213,10 @@ void Lookahead::destroy()
     X265_FREE(m_accHistDiffRunningAvg[0]);
     X265_FREE(m_accHistDiffRunningAvg);
     X265_FREE(m_scratch);
+    X265_FREE(m_aqMotionScratch);
+    X265_FREE(m_cuTreeDelta);
+    X265_FREE(m_cuTreeCost);
+    delete [] m_plans;
     delete [] m_tld;
     if (m_param->lookaheadThreads > 0)
         delete [] m_pool;
@@ -1268,6 +1258,16 @@ void Lookahead::addPicture(Frame& curFrame, int sliceType)
 
 void Lookahead::addPicture(Frame& curFrame)
 {
+    Lowres& lowres = curFrame.m_lowres;
+    if (!m_tablePool.frameBytes)
+    {
+        int pairs = (lowres.bframes + 2) * (lowres.bframes + 2) - 1;
+        m_tablePool.frameBytes = lowres.fixedBytes;
+        m_tablePool.fullFrameBytes = pairs * lowres.costTableSize + 2 * (lowres.bframes + 1) * lowres.mvTableSize;
+    }
+    lowres.tablePool = &m_tablePool;
+    curFrame.m_mvFieldCache = m_bShareMotionFields ? &m_mvFieldCache : NULL;
+
     m_inputLock.acquire();
     m_inputQueue.pushBack(curFrame);
     m_inputLock.release();
@@ -1303,20 +1303,176 @@ void Lookahead::flush()
 void Lookahead::setLookaheadQueue()
 {
     m_filled = false;
-    m_fullQueueSize = X265_MAX(1, m_param->lookaheadDepth);
+    m_fullQueueSize = X265_MAX(1, lookaheadDepth());
+}
+
+void Lookahead::setCoopSlices(int slices)
+{
+    if (slices > 1)
+    {
+        m_numRowsPerSlice = m_8x8Height / slices;
+        m_numRowsPerSlice = X265_MAX(m_numRowsPerSlice, 10);            // at least 10 rows per slice
+        m_numRowsPerSlice = X265_MIN(m_numRowsPerSlice, m_8x8Height);   // but no more than the full picture
+        m_numCoopSlices = m_8x8Height / m_numRowsPerSlice;
+    }
+    else
+    {
+        m_numRowsPerSlice = m_8x8Height;
+        m_numCoopSlices = 1;
+    }
+}
+
+void LookaheadThroughput::init(const x265_param& param, int numCoopSlices)
+{
+    double fps = param.lookaheadTargetFps > 0 ? param.lookaheadTargetFps : (double)param.fpsNum / param.fpsDenom;
+    targetFrameTime = (int64_t)(1000000 / fps);
+    lastFrame = 0;
+    frameTime = (double)targetFrameTime;
+    idle = 0;
+    backlog = 0;
+    frameThreads = X265_MAX(param.frameNumThreads, 1);
+    frames = 0;
+    step = 0;
+
+    maxDepth = X265_MIN(param.lookaheadDepth, X265_LOOKAHEAD_MAX);
+    minDepth = param.lookaheadMinDepth ? param.lookaheadMinDepth : param.bframes + 2;
+    minDepth = x265_clip3(2, maxDepth, minDepth);
+    maxTrellis = param.bframes;
+    minTrellis = param.bFrameAdaptive == X265_B_ADAPT_TRELLIS ? X265_MIN(maxTrellis, 1) : maxTrellis;
+    maxSlices = numCoopSlices;
+
+    depth = maxDepth;
+    trellis = maxTrellis;
+    slices = maxSlices;
+
+    numChanges = numReducedFrames = numReports = 0;
+}
+
+/* returns true when the requested setting changed */
+bool LookaheadThroughput::update(int64_t now, int64_t idleTime)
+{
+    if (!lastFrame)
+    {
+        lastFrame = now;
+        return false;
+    }
+
+    double interval = (double)X265_MAX(now - lastFrame, 1);
+    lastFrame = now;
+    numReports++;
+    numReducedFrames += depth < maxDepth;
+
+    /* a frame encoder takes a new frame once every frameThreads frames */
+    double idleFraction = X265_MIN((double)idleTime / (interval * frameThreads), 1.0);
+    frameTime += (interval - frameTime) / ADAPT_INTERVAL;
+    idle += (idleFraction - idle) / ADAPT_INTERVAL;
+
+    if (++frames < ADAPT_INTERVAL)
+        return false;
+    frames = 0;
+
+    bool behind = frameTime > 1.02 * targetFrameTime || backlog > maxTrellis + 1;
+    bool ahead = frameTime < 0.9 * targetFrameTime && backlog <= 0;
+    bool waiting = idle > 0.1;
+
+    int newSlices = slices;
+    if (behind)
+    {
+        /* more slices shorten a lookahead the frame encoders wait on, fewer
+         * leave more workers to busy frame encoders */
+        step = X265_MIN(step + 1, (int)NUM_STEPS);
+        newSlices += waiting ? 1 : -1;
+    }
+    else if (ahead)
+    {
+        step = X265_MAX(step - 1, 0);
+        newSlices++;
+    }
+    else
+        return false;
+
+    newSlices = x265_clip3(1, maxSlices, newSlices);
+    int newDepth = maxDepth - ((maxDepth - minDepth) * step + NUM_STEPS / 2) / NUM_STEPS;
+    int newTrellis = maxTrellis - ((maxTrellis - minTrellis) * step + NUM_STEPS / 2) / NUM_STEPS;
+    if (newDepth == depth && newTrellis == trellis && newSlices == slices)
+        return false;
+
+    depth = newDepth;
+    trellis = newTrellis;
+    slices = newSlices;
+    numChanges++;
+    return true;
+}
+
+/* Called by API thread with the time the frame encoder about to start its
+ * next frame spent idle */
+void Lookahead::reportThroughput(int64_t idleTime)
+{
+    ScopedLock lock(m_inputLock);
+    LookaheadThroughput& tp = m_throughput;
+    if (tp.update(x265_mdate(), idleTime))
+        x265_log(m_param, X265_LOG_DEBUG, "adaptive lookahead: %.1f fps, %.0f%% idle, window %d trellis %d slices %d\n",
+                 1000000.0 / tp.frameTime, 100.0 * tp.idle, tp.depth, tp.trellis, tp.slices);
+}
+
+/* Called by slicetypeDecide() before it looks at the input queue, so the
+ * window, the trellis depth and the lookahead slices never change under a
+ * running decision */
+void Lookahead::adoptThroughput()
+{
+    ScopedLock lock(m_inputLock);
+    m_throughput.backlog = m_inputQueue.size() - (m_throughput.maxDepth + m_param->bframes + 2);
+    m_lookaheadDepth = m_throughput.depth;
+    m_trellisDepth = m_throughput.trellis;
+    setCoopSlices(m_throughput.slices);
+
+    /* unless flushing */
+    if (m_fullQueueSize > 1)
+        m_fullQueueSize = X265_MAX(1, lookaheadDepth());
 }
 
 void Lookahead::findJob(int /*workerThreadID*/)
 {
-    bool doDecide;
+    bool doDecide = false, doPropagate = false;
 
+    /* the propagate stage goes first, it holds back decided pictures. A new
+     * decision needs room in the plan ring for its plain and keyframe plans */
     m_inputLock.acquire();
-    if (m_inputQueue.size() >= m_fullQueueSize && !m_sliceTypeBusy && m_isActive)
+    if (m_planQueued && !m_propagateBusy && m_isActive)
+        doPropagate = m_propagateBusy = true;
+    else if (m_inputQueue.size() >= m_fullQueueSize && !m_sliceTypeBusy && m_isActive &&
+             m_planQueued + 2 <= LOOKAHEAD_PLANS)
         doDecide = m_sliceTypeBusy = true;
     else
-        doDecide = m_helpWanted = false;
+        m_helpWanted = false;
     m_inputLock.release();
 
+    if (doPropagate)
+    {
+        ProfileLookaheadTime(m_cuTreeElapsedTime, m_countCuTree);
+
+        LookaheadPlan& plan = m_plans[m_planFirst];
+        runPlan(plan);
+
+        m_outputLock.acquire();
+        m_inputLock.acquire();
+        for (int i = 0; i < plan.numOutput; i++)
+            m_outputQueue.pushBack(*m_pendingQueue.popFront());
+        m_pendingHeld -= plan.numOutput;
+        m_planFirst = (m_planFirst + 1) % LOOKAHEAD_PLANS;
+        m_planQueued--;
+        m_outputLock.release();
+
+        if (m_outputSignalRequired)
+        {
+            m_outputSignal.trigger();
+            m_outputSignalRequired = false;
+        }
+        m_propagateBusy = false;
+        m_inputLock.release();
+        return;
+    }
+
     if (!doDecide)
         return;
 
@@ -1325,6 +1481,9 @@ void Lookahead::findJob(int /*workerThreadID*/)
 
     slicetypeDecide();
 
+    if (m_bPipelinedCuTree)
+        queueDecided();
+
     m_inputLock.acquire();
     if (m_outputSignalRequired)
     {
@@ -1353,16 +1512,28 @@ Frame* Lookahead::getDecidedPicture()
         if (strlen(m_param->analysisLoad) && m_param->bDisableLookahead)
             return NULL;
 
-        findJob(-1); /* run slicetypeDecide() if necessary */
+        /* a decided picture may still be waiting on its cuTree plan, so with
+         * the pipelined propagate stage keep going until one comes out */
+        for (;;)
+        {
+            findJob(-1); /* run slicetypeDecide() or a cuTree plan if necessary */
 
-        m_inputLock.acquire();
-        bool wait = m_outputSignalRequired = m_sliceTypeBusy;
-        m_inputLock.release();
+            m_inputLock.acquire();
+            bool wait = m_outputSignalRequired = m_sliceTypeBusy || m_propagateBusy;
+            bool held = m_planQueued && m_isActive;
+            m_inputLock.release();
 
-        if (wait)
-            m_outputSignal.wait();
+            if (wait)
+                m_outputSignal.wait();
+
+            m_outputLock.acquire();
+            out = m_outputQueue.popFront();
+            m_outputLock.release();
+
+            if (out || !m_bPipelinedCuTree || !(wait || held))
+                break;
+        }
 
-        out = m_outputQueue.popFront();
         if (out)
             m_inputCount--;
         return out;
@@ -1371,6 +1542,33 @@ Frame* Lookahead::getDecidedPicture()
         return NULL;
 }
 
+/* Hand the pictures output by the last slicetypeDecide() to the newest queued
+ * plan, which releases them to the output queue once it has run, or straight
+ * to the output queue when there is no plan outstanding */
+void Lookahead::queueDecided()
+{
+    m_outputLock.acquire();
+    int decided = m_pendingQueue.size() - m_pendingHeld;
+
+    m_inputLock.acquire();
+    m_planQueued += m_planRecorded;
+    m_planRecorded = 0;
+    if (m_planQueued)
+    {
+        m_plans[(m_planFirst + m_planQueued - 1) % LOOKAHEAD_PLANS].numOutput += decided;
+        m_pendingHeld += decided;
+        tryWakeOne();
+    }
+    else
+    {
+        while (decided--)
+            m_outputQueue.pushBack(*m_pendingQueue.popFront());
+    }
+    m_inputLock.release();
+
+    m_outputLock.release();
+}
+
 /* Called by rate-control to calculate the estimated SATD cost for a given
  * picture.  It assumes dpb->prepareEncode() has already been called for the
  * picture and all the references are established */
@@ -1426,7 +1624,7 @@ void Lookahead::getEstimatedPictureCost(Frame *curFrame)
 
         if (curFrame->m_param->rc.cuTree && !curFrame->m_param->rc.bStatRead)
             /* update row satds based on cutree offsets */
-            curFrame->m_lowres.satdCost = frameCostRecalculate(frames, p0, p1, b);
+            curFrame->m_lowres.satdCost = frameCostRecalculate(frames, frames[b]->sliceType, p0, p1, b);
         else if (!strlen(curFrame->m_param->analysisLoad) || curFrame->m_param->scaleFactor || curFrame->m_param->bAnalysisType == HEVC_INFO)
         {
             if (curFrame->m_param->rc.aqMode)
@@ -1488,138 +1686,39 @@ void Lookahead::getEstimatedPictureCost(Frame *curFrame)
     }
 }
 
-uint32_t LookaheadTLD::calcVariance(pixel* inpSrc, intptr_t stride, intptr_t blockOffset, uint32_t plane)
-{
-    pixel* src = inpSrc + blockOffset;
-
-    uint32_t var;
-    if (!plane)
-        var = acEnergyVarHist(primitives.cu[BLOCK_8x8].var(src, stride), 6);
-    else
-        var = acEnergyVarHist(primitives.cu[BLOCK_4x4].var(src, stride), 4);
-
-    x265_emms();
-    return var;
-}
-
-/*
-** Compute Block and Picture Variance, Block Mean for all blocks in the picture
-*/
-void LookaheadTLD::computePictureStatistics(Frame *curFrame)
+/* average AC energy of the blocks of a plane, the mean over the rows of the
+ * average block variance of each row. The blocks are measured with the var
+ * primitive of the block size */
+static uint16_t planeAvgVariance(const pixel* src, intptr_t stride, int width, int height, int blockSize)
 {
-    int maxCol = curFrame->m_fencPic->m_picWidth;
-    int maxRow = curFrame->m_fencPic->m_picHeight;
-    intptr_t inpStride = curFrame->m_fencPic->m_stride;
-
-    // Variance
+    var_t var = primitives.cu[blockSize == 8 ? BLOCK_8x8 : BLOCK_4x4].var;
+    int shift = blockSize == 8 ? 6 : 4;
     uint64_t picTotVariance = 0;
-    uint32_t variance;
-
-    uint64_t blockXY = 0;
-    pixel* src = curFrame->m_fencPic->m_picOrg[0];
-
-    for (int blockY = 0; blockY < maxRow; blockY += 8)
-    {
-        uint64_t rowVariance = 0;
-        for (int blockX = 0; blockX < maxCol; blockX += 8)
-        {
-            intptr_t blockOffsetLuma = blockX + (blockY * inpStride);
-
-            variance = calcVariance(
-                src,
-                inpStride,
-                blockOffsetLuma, 0);
-
-            rowVariance += variance;
-            blockXY++;
-        }
-        picTotVariance += (uint16_t)(rowVariance / maxCol);
-    }
-
-    curFrame->m_lowres.picAvgVariance = (uint16_t)(picTotVariance / maxRow);
-
-    // Collect chroma variance
-    int hShift = curFrame->m_fencPic->m_hChromaShift;
-    int vShift = curFrame->m_fencPic->m_vChromaShift;
-
-    int maxColChroma = curFrame->m_fencPic->m_picWidth >> hShift;
-    int maxRowChroma = curFrame->m_fencPic->m_picHeight >> vShift;
-    intptr_t cStride = curFrame->m_fencPic->m_strideC;
-
-    pixel* srcCb = curFrame->m_fencPic->m_picOrg[1];
-
-    picTotVariance = 0;
-    for (int blockY = 0; blockY < maxRowChroma; blockY += 4)
-    {
-        uint64_t rowVariance = 0;
-        for (int blockX = 0; blockX < maxColChroma; blockX += 4)
-        {
-            intptr_t blockOffsetChroma = blockX + blockY * cStride;
-
-            variance = calcVariance(
-                srcCb,
-                cStride,
-                blockOffsetChroma, 1);
-
-            rowVariance += variance;
-            blockXY++;
-        }
-        picTotVariance += (uint16_t)(rowVariance / maxColChroma);
-    }
-
-    curFrame->m_lowres.picAvgVarianceCb = (uint16_t)(picTotVariance / maxRowChroma);
-
 
-    pixel* srcCr = curFrame->m_fencPic->m_picOrg[2];
-
-    picTotVariance = 0;
-    for (int blockY = 0; blockY < maxRowChroma; blockY += 4)
+    for (int blockY = 0; blockY < height; blockY += blockSize)
     {
         uint64_t rowVariance = 0;
-        for (int blockX = 0; blockX < maxColChroma; blockX += 4)
-        {
-            intptr_t blockOffsetChroma = blockX + blockY * cStride;
-
-            variance = calcVariance(
-                srcCr,
-                cStride,
-                blockOffsetChroma, 2);
-
-            rowVariance += variance;
-            blockXY++;
-        }
-        picTotVariance += (uint16_t)(rowVariance / maxColChroma);
+        for (int blockX = 0; blockX < width; blockX += blockSize)
+            rowVariance += acEnergyVarHist(var(src + blockX + blockY * stride, stride), shift);
+        picTotVariance += (uint16_t)(rowVariance / width);
     }
 
-    curFrame->m_lowres.picAvgVarianceCr = (uint16_t)(picTotVariance / maxRowChroma);
+    x265_emms();
+    return (uint16_t)(picTotVariance / height);
 }
 
 /*
-* Compute histogram of n-bins for the input
+** Compute Block and Picture Variance, Block Mean for all blocks in the picture
 */
-void LookaheadTLD::calculateHistogram(
-    pixel     *inputSrc,
-    uint32_t   inputWidth,
-    uint32_t   inputHeight,
-    intptr_t   stride,
-    uint8_t    dsFactor,
-    uint32_t  *histogram,
-    uint64_t  *sum)
-
+void LookaheadTLD::computePictureStatistics(Frame *curFrame)
 {
-    *sum = 0;
-
-    for (uint32_t verticalIdx = 0; verticalIdx < inputHeight; verticalIdx += dsFactor)
-    {
-        for (uint32_t horizontalIdx = 0; horizontalIdx < inputWidth; horizontalIdx += dsFactor)
-        {
-            ++(histogram[inputSrc[horizontalIdx]]);
-            *sum += inputSrc[horizontalIdx];
-        }
-        inputSrc += (stride << (dsFactor >> 1));
-    }
+    PicYuv* fencPic = curFrame->m_fencPic;
+    int widthChroma = fencPic->m_picWidth >> fencPic->m_hChromaShift;
+    int heightChroma = fencPic->m_picHeight >> fencPic->m_vChromaShift;
 
-    return;
+    curFrame->m_lowres.picAvgVariance = planeAvgVariance(fencPic->m_picOrg[0], fencPic->m_stride, fencPic->m_picWidth, fencPic->m_picHeight, 8);
+    curFrame->m_lowres.picAvgVarianceCb = planeAvgVariance(fencPic->m_picOrg[1], fencPic->m_strideC, widthChroma, heightChroma, 4);
+    curFrame->m_lowres.picAvgVarianceCr = planeAvgVariance(fencPic->m_picOrg[2], fencPic->m_strideC, widthChroma, heightChroma, 4);
 }
 
 /*
@@ -1654,7 +1753,7 @@ void LookaheadTLD::computeIntensityHistogramBinsChroma(
 
 
             // U Histogram
-            calculateHistogram(
+            primitives.intensityHistogram(
                 curFrame->m_fencPic->m_picOrg[1] + ((segmentInFrameWidthIndex * segmentWidth) >> 1) + (((segmentInFrameHeightIndex * segmentHeight) >> 1) * curFrame->m_fencPic->m_strideC),
                 (segmentWidth + segmentWidthOffset) >> 1,
                 (segmentHeight + segmentHeightOffset) >> 1,
@@ -1674,7 +1773,7 @@ void LookaheadTLD::computeIntensityHistogramBinsChroma(
             }
 
             // V Histogram
-            calculateHistogram(
+            primitives.intensityHistogram(
                 curFrame->m_fencPic->m_picOrg[2] + ((segmentInFrameWidthIndex * segmentWidth) >> 1) + (((segmentInFrameHeightIndex * segmentHeight) >> 1) * curFrame->m_fencPic->m_strideC),
                 (segmentWidth + segmentWidthOffset) >> 1,
                 (segmentHeight + segmentHeightOffset) >> 1,
@@ -1726,7 +1825,7 @@ void LookaheadTLD::computeIntensityHistogramBinsLuma(
                 curFrame->m_lowres.quarterSampleLowResHeight - (NUMBER_OF_SEGMENTS_IN_HEIGHT * segmentHeight) : 0;
 
             // Y Histogram
-            calculateHistogram(
+            primitives.intensityHistogram(
                 curFrame->m_lowres.quarterSampleLowResBuffer + (curFrame->m_lowres.quarterSampleLowResOriginX + segmentInFrameWidthIndex * segmentWidth) + ((curFrame->m_lowres.quarterSampleLowResOriginY + segmentInFrameHeightIndex * segmentHeight) * curFrame->m_lowres.quarterSampleLowResStrideY),
                 segmentWidth + segmentWidthOffset,
                 segmentHeight + segmentHeightOffset,
@@ -1848,13 +1947,61 @@ void Lookahead::compCostBref(Lowres **frames, int start, int end, int num)
     }
 }
 
+/* publishes the lowres and HME fields of the searches just made which MCSTF
+ * of the picture may use */
+void CostEstimateGroup::shareMotionFields(int p0, int p1, int b, bool bDoSearch[2])
+{
+    Lowres* fenc = m_frames[b];
+    MotionFieldCache& cache = m_lookahead.m_mvFieldCache;
+
+    for (int list = 0; list < 2; list++)
+    {
+        int dist = list ? p1 - b : b - p0;
+        if (!bDoSearch[list] || dist < 1 || dist > m_lookahead.m_param->mcstfFrameRange)
+            continue;
+
+        int refPoc = m_frames[list ? p1 : p0]->frameNum;
+        MotionFieldCache::Grid grid = { (uint32_t)m_lookahead.m_8x8Width, (uint32_t)m_lookahead.m_8x8Height, (uint32_t)m_lookahead.m_8x8Width,
+                                        MotionFieldCache::LEVEL_LOWRES, X265_LOWRES_CU_SIZE, 2 };
+        cache.publish(fenc->frameNum, refPoc, grid, fenc->lowresMvs[list][dist], fenc->lowresMvCosts[list][dist]);
+
+        if (fenc->bEnableHME)
+        {
+            MotionFieldCache::Grid hmeGrid = { (uint32_t)m_lookahead.m_4x4Width, (uint32_t)m_lookahead.m_4x4Height, (uint32_t)m_lookahead.m_4x4Width,
+                                               MotionFieldCache::LEVEL_LOWERRES, X265_LOWRES_CU_SIZE, 2 };
+            cache.publish(fenc->frameNum, refPoc, hmeGrid, fenc->lowerResMvs[list][dist], fenc->lowerResMvCosts[list][dist]);
+        }
+    }
+}
+
 void CostEstimateGroup::estimatelowresmotion(MotionEstimatorTLD& m_metld, Frame* curframe, int refId)
 {
     m_metld.m_bitDepth = curframe->m_param->internalBitDepth;
     TemporalFilterRefPicInfo* ref = &curframe->m_mcstfRefList[refId];
 
-    m_metld.motionEstimationLuma(m_metld, ref->mvs0, ref->mvsStride0, curframe->m_lowres.lowerResPlane[0], (int)(curframe->m_lowres.lumaStride / 2), (curframe->m_lowres.lines / 2), (curframe->m_lowres.width / 2), ref->lowerRes, 16, curframe->m_param->searchRangeForLayer2);
-    m_metld.motionEstimationLuma(m_metld, ref->mvs1, ref->mvsStride1, curframe->m_lowres.lowresPlane[0], (int)(curframe->m_lowres.lumaStride), (curframe->m_lowres.lines), (curframe->m_lowres.width), ref->lowres, 16, curframe->m_param->searchRangeForLayer1, ref->mvs0, ref->mvsStride0, 2);
+    /* with shared motion fields the coarse layers start from the vectors the
+     * lookahead found for this pair: a lowres field replaces the two coarse
+     * layers, an HME field the coarsest one */
+    int seedLayers = 0;
+    if (m_lookahead.m_bShareMotionFields)
+    {
+        MotionFieldCache& cache = m_lookahead.m_mvFieldCache;
+        MotionFieldCache::Grid layer1 = { (uint32_t)curframe->m_lowres.width / 16, (uint32_t)curframe->m_lowres.lines / 16, ref->mvsStride1,
+                                          MotionFieldCache::LEVEL_LOWRES, 16, 4 };
+        MotionFieldCache::Grid layer2 = { (uint32_t)curframe->m_lowres.width / 32, (uint32_t)curframe->m_lowres.lines / 32, ref->mvsStride0,
+                                          MotionFieldCache::LEVEL_LOWERRES, 16, 4 };
+        if (cache.resample(curframe->m_poc, ref->poc, MotionFieldCache::LEVEL_LOWRES, layer1, ref->mvs1, true))
+            seedLayers = 2;
+        else if (cache.resample(curframe->m_poc, ref->poc, MotionFieldCache::LEVEL_LOWERRES, layer2, ref->mvs0, true))
+            seedLayers = 1;
+        cache.evict(curframe->m_poc, ref->poc, MotionFieldCache::LEVEL_LOWERRES);
+        cache.addSearchStats(!!seedLayers, seedLayers, 4 - seedLayers);
+    }
+
+    if (seedLayers < 1)
+        m_metld.motionEstimationLuma(m_metld, ref->mvs0, ref->mvsStride0, curframe->m_lowres.lowerResPlane[0], (int)(curframe->m_lowres.lumaStride / 2), (curframe->m_lowres.lines / 2), (curframe->m_lowres.width / 2), ref->lowerRes, 16, curframe->m_param->searchRangeForLayer2);
+    if (seedLayers < 2)
+        m_metld.motionEstimationLuma(m_metld, ref->mvs1, ref->mvsStride1, curframe->m_lowres.lowresPlane[0], (int)(curframe->m_lowres.lumaStride), (curframe->m_lowres.lines), (curframe->m_lowres.width), ref->lowres, 16, curframe->m_param->searchRangeForLayer1, ref->mvs0, ref->mvsStride0, 2);
     m_metld.motionEstimationLuma(m_metld, ref->mvs2, ref->mvsStride2, curframe->m_fencPic->m_picOrg[0], (int)curframe->m_fencPic->m_stride, curframe->m_fencPic->m_picHeight, curframe->m_fencPic->m_picWidth, ref->picBuffer->m_picOrg[0], 16, curframe->m_param->searchRangeForLayer0, ref->mvs1, ref->mvsStride1, 2);
     m_metld.motionEstimationLumaDoubleRes(m_metld, ref->mvs, ref->mvsStride, curframe->m_fencPic, ref->picBuffer, 8, ref->mvs2, ref->mvsStride2, 1, ref->error);
 
@@ -1952,11 +2099,14 @@ bool Lookahead::generatemcstf(Frame * frameEnc, PicList refPic, int poclast)
 void Lookahead::slicetypeDecide()
 {
     PreLookaheadGroup pre(*this);
+    PicList& decided = m_bPipelinedCuTree ? m_pendingQueue : m_outputQueue;
     Lowres* frames[X265_LOOKAHEAD_MAX + X265_BFRAME_MAX + 4];
     Frame*  list[X265_BFRAME_MAX + 4];
     memset(frames, 0, sizeof(frames));
     memset(list, 0, sizeof(list));
-    int maxSearch = X265_MIN(m_param->lookaheadDepth, X265_LOOKAHEAD_MAX);
+    if (m_bAdaptiveLookahead)
+        adoptThroughput();
+    int maxSearch = X265_MIN(lookaheadDepth(), X265_LOOKAHEAD_MAX);
     maxSearch = X265_MAX(1, maxSearch);
 
     {
@@ -1980,6 +2130,9 @@ void Lookahead::slicetypeDecide()
         {
             if (!curFrame) break;
             list[j] = curFrame;
+            curFrame->m_decideDepth = maxSearch;
+            curFrame->m_decideTrellis = trellisDepth();
+            curFrame->m_decideSlices = m_numCoopSlices;
             curFrame = curFrame->m_next;
         }
 
@@ -2061,7 +2214,7 @@ void Lookahead::slicetypeDecide()
          m_param->rc.cuTree || m_param->scenecutThreshold || m_param->bHistBasedSceneCut ||
          (m_param->lookaheadDepth && m_param->rc.vbvBufferSize)))
     {
-        if (!m_param->rc.bStatRead)
+        if (!m_bTypesRead)
             slicetypeAnalyse(frames, false);
         bool bIsVbv = m_param->rc.vbvBufferSize > 0 && m_param->rc.vbvMaxBitrate > 0;
         if ((strlen(m_param->analysisLoad) && m_param->scaleFactor && bIsVbv) || m_param->bliveVBV2pass)
@@ -2073,7 +2226,9 @@ void Lookahead::slicetypeDecide()
                 if (!fenc)
                     break;
             }
-            vbvLookahead(frames, numFrames, false);
+            LookaheadPlan& plan = beginPlan(frames, numFrames, false);
+            planVbv(plan);
+            endPlan(plan);
         }
     }
 
@@ -2320,7 +2475,7 @@ void Lookahead::slicetypeDecide()
                     list[newbFrames]->m_gopOffset = 0;
                     list[newbFrames]->m_gopId = gopId;
                     list[newbFrames]->m_tempLayer = x265_gop_ra[gopId][0].layer;
-                    m_outputQueue.pushBack(*list[newbFrames]);
+                    decided.pushBack(*list[newbFrames]);
 
                     /* add B frames to output queue */
                     int i = 1, j = 1;
@@ -2336,7 +2491,7 @@ void Lookahead::slicetypeDecide()
                         list[offset]->m_tempLayer = x265_gop_ra[gopId][j++].layer;
 
                         list[offset]->m_reorderedPts = pts[idx++];
-                        m_outputQueue.pushBack(*list[offset]);
+                        decided.pushBack(*list[offset]);
                         i++;
                     }
 
@@ -2403,7 +2558,7 @@ void Lookahead::slicetypeDecide()
                 list[newbFrames]->m_gopOffset = 0;
                 list[newbFrames]->m_gopId = -1;
                 list[newbFrames]->m_tempLayer = 0;
-                m_outputQueue.pushBack(*list[newbFrames]);
+                decided.pushBack(*list[newbFrames]);
                 if (brefs)
                 {
                     for (int i = listReset; i < newbFrames; i++)
@@ -2414,7 +2569,7 @@ void Lookahead::slicetypeDecide()
                             list[i]->m_gopOffset = 0;
                             list[i]->m_gopId = -1;
                             list[i]->m_tempLayer = 0;
-                            m_outputQueue.pushBack(*list[i]);
+                            decided.pushBack(*list[i]);
                         }
                     }
                 }
@@ -2429,7 +2584,7 @@ void Lookahead::slicetypeDecide()
                         list[i]->m_gopOffset = 0;
                         list[i]->m_gopId = -1;
                         list[i]->m_tempLayer = 1;
-                        m_outputQueue.pushBack(*list[i]);
+                        decided.pushBack(*list[i]);
                     }
                 }
             }
@@ -2491,7 +2646,7 @@ void Lookahead::slicetypeDecide()
             list[bframes]->m_gopOffset = 0;
             list[bframes]->m_gopId = m_gopId;
             list[bframes]->m_tempLayer = x265_gop_ra[m_gopId][0].layer;
-            m_outputQueue.pushBack(*list[bframes]);
+            decided.pushBack(*list[bframes]);
 
             int i = 1, j = 1;
             while (i <= bframes)
@@ -2507,7 +2662,7 @@ void Lookahead::slicetypeDecide()
 
                 /* add B frames to output queue */
                 list[offset]->m_reorderedPts = pts[idx++];
-                m_outputQueue.pushBack(*list[offset]);
+                decided.pushBack(*list[offset]);
                 i++;
             }
         }
@@ -2527,7 +2682,7 @@ void Lookahead::slicetypeDecide()
             m_inputLock.release();
 
             frames[j + 1] = NULL;
-            if (!m_param->rc.bStatRead)
+            if (!m_bTypesRead)
                 slicetypeAnalyse(frames, true);
             bool bIsVbv = m_param->rc.vbvBufferSize > 0 && m_param->rc.vbvMaxBitrate > 0;
             if ((strlen(m_param->analysisLoad) && m_param->scaleFactor && bIsVbv) || m_param->bliveVBV2pass)
@@ -2539,7 +2694,9 @@ void Lookahead::slicetypeDecide()
                     if (!fenc)
                         break;
                 }
-                vbvLookahead(frames, numFrames, true);
+                LookaheadPlan& plan = beginPlan(frames, numFrames, true);
+                planVbv(plan);
+                endPlan(plan);
             }
         }
 
@@ -2630,7 +2787,7 @@ void Lookahead::slicetypeDecide()
         /* add non-B to output queue */
         int idx = 0;
         list[bframes]->m_reorderedPts = pts[idx++];
-        m_outputQueue.pushBack(*list[bframes]);
+        decided.pushBack(*list[bframes]);
 
         /* Add B-ref frame next to P frame in output queue, the B-ref encode before non B-ref frame */
         if (brefs)
@@ -2640,7 +2797,7 @@ void Lookahead::slicetypeDecide()
                 if (list[i]->m_lowres.sliceType == X265_TYPE_BREF)
                 {
                     list[i]->m_reorderedPts = pts[idx++];
-                    m_outputQueue.pushBack(*list[i]);
+                    decided.pushBack(*list[i]);
                 }
             }
         }
@@ -2652,7 +2809,7 @@ void Lookahead::slicetypeDecide()
             if (list[i]->m_lowres.sliceType != X265_TYPE_BREF)
             {
                 list[i]->m_reorderedPts = pts[idx++];
-                m_outputQueue.pushBack(*list[i]);
+                decided.pushBack(*list[i]);
             }
         }
 
@@ -2672,7 +2829,7 @@ void Lookahead::slicetypeDecide()
             m_inputLock.release();
 
             frames[j + 1] = NULL;
-            if (!m_param->rc.bStatRead)
+            if (!m_bTypesRead)
                 slicetypeAnalyse(frames, true);
             bool bIsVbv = m_param->rc.vbvBufferSize > 0 && m_param->rc.vbvMaxBitrate > 0;
             if ((strlen(m_param->analysisLoad) && m_param->scaleFactor && bIsVbv) || m_param->bliveVBV2pass)
@@ -2684,7 +2841,9 @@ void Lookahead::slicetypeDecide()
                     if (!fenc)
                         break;
                 }
-                vbvLookahead(frames, numFrames, true);
+                LookaheadPlan& plan = beginPlan(frames, numFrames, true);
+                planVbv(plan);
+                endPlan(plan);
             }
         }
 
@@ -2692,10 +2851,13 @@ void Lookahead::slicetypeDecide()
     }
 }
 
-void Lookahead::vbvLookahead(Lowres **frames, int numFrames, int keyframe)
+/* Run twice per plan: first with bEstimate by the decide stage, only making
+ * the cost estimates, then by runPlan() to fill in the planned costs; types
+ * holds the frame types as they were when the plan was made */
+void Lookahead::vbvLookahead(Lowres **frames, const int *types, int numFrames, int keyframe, bool bEstimate)
 {
     int prevNonB = 0, curNonB = 1, idx = 0;
-    while (curNonB < numFrames && IS_X265_TYPE_B(frames[curNonB]->sliceType))
+    while (curNonB < numFrames && IS_X265_TYPE_B(types[curNonB]))
         curNonB++;
     int nextNonB = keyframe ? prevNonB : curNonB;
     int nextB = prevNonB + 1;
@@ -2708,17 +2870,21 @@ void Lookahead::vbvLookahead(Lowres **frames, int numFrames, int keyframe)
         /* P/I cost: This shouldn't include the cost of nextNonB */
         if (nextNonB != curNonB)
         {
-            int p0 = IS_X265_TYPE_I(frames[curNonB]->sliceType) ? curNonB : prevNonB;
-            frames[nextNonB]->plannedSatd[idx] = vbvFrameCost(frames, p0, curNonB, curNonB);
-            frames[nextNonB]->plannedType[idx] = frames[curNonB]->sliceType;
-
-            /* Save the nextNonB Cost in each B frame of the current miniGop */
-            if (curNonB > miniGopEnd)
+            int p0 = IS_X265_TYPE_I(types[curNonB]) ? curNonB : prevNonB;
+            int64_t satdCost = vbvFrameCost(frames, types, p0, curNonB, curNonB, bEstimate);
+            if (!bEstimate)
             {
-                for (int j = nextB; j < miniGopEnd; j++)
+                frames[nextNonB]->plannedSatd[idx] = satdCost;
+                frames[nextNonB]->plannedType[idx] = types[curNonB];
+
+                /* Save the nextNonB Cost in each B frame of the current miniGop */
+                if (curNonB > miniGopEnd)
                 {
-                    frames[j]->plannedSatd[frames[j]->indB] = frames[nextNonB]->plannedSatd[idx];
-                    frames[j]->plannedType[frames[j]->indB++] = frames[nextNonB]->plannedType[idx];
+                    for (int j = nextB; j < miniGopEnd; j++)
+                    {
+                        frames[j]->plannedSatd[frames[j]->indB] = frames[nextNonB]->plannedSatd[idx];
+                        frames[j]->plannedType[frames[j]->indB++] = frames[nextNonB]->plannedType[idx];
+                    }
                 }
             }
             idx++;
@@ -2736,16 +2902,18 @@ void Lookahead::vbvLookahead(Lowres **frames, int numFrames, int keyframe)
             {
                 if (i == nextBRef)
                 {
-                    satdCost = vbvFrameCost(frames, prevNonB, curNonB, nextBRef);
+                    satdCost = vbvFrameCost(frames, types, prevNonB, curNonB, nextBRef, bEstimate);
                     type = X265_TYPE_BREF;
                 }
                 else if (i < nextBRef)
-                    satdCost = vbvFrameCost(frames, prevNonB, nextBRef, i);
+                    satdCost = vbvFrameCost(frames, types, prevNonB, nextBRef, i, bEstimate);
                 else
-                    satdCost = vbvFrameCost(frames, nextBRef, curNonB, i);
+                    satdCost = vbvFrameCost(frames, types, nextBRef, curNonB, i, bEstimate);
             }
             else
-                satdCost = vbvFrameCost(frames, prevNonB, curNonB, i);
+                satdCost = vbvFrameCost(frames, types, prevNonB, curNonB, i, bEstimate);
+            if (bEstimate)
+                continue;
             frames[nextNonB]->plannedSatd[idx] = satdCost;
             frames[nextNonB]->plannedType[idx] = type;
             /* Save the nextB Cost in each B frame of the current miniGop */
@@ -2762,22 +2930,29 @@ void Lookahead::vbvLookahead(Lowres **frames, int numFrames, int keyframe)
         }
         prevNonB = curNonB;
         curNonB++;
-        while (curNonB <= numFrames && IS_X265_TYPE_B(frames[curNonB]->sliceType))
+        while (curNonB <= numFrames && IS_X265_TYPE_B(types[curNonB]))
             curNonB++;
     }
 
-    frames[nextNonB]->plannedType[idx] = X265_TYPE_AUTO;
+    if (!bEstimate)
+        frames[nextNonB]->plannedType[idx] = X265_TYPE_AUTO;
 }
 
-int64_t Lookahead::vbvFrameCost(Lowres **frames, int p0, int p1, int b)
+int64_t Lookahead::vbvFrameCost(Lowres **frames, const int *types, int p0, int p1, int b, bool bEstimate)
 {
-    CostEstimateGroup estGroup(*this, frames);
-    int64_t cost = estGroup.singleCost(p0, p1, b);
+    if (bEstimate)
+    {
+        CostEstimateGroup estGroup(*this, frames);
+        return estGroup.singleCost(p0, p1, b);
+    }
+
+    /* the estimate pass has already made this one */
+    int64_t cost = frames[b]->costEst[b - p0][p1 - b];
 
     if (m_param->rc.aqMode || m_param->bAQMotion)
     {
         if (m_param->rc.cuTree)
-            return frameCostRecalculate(frames, p0, p1, b);
+            return frameCostRecalculate(frames, types[b], p0, p1, b);
         else
             return frames[b]->costEstAq[b - p0][p1 - b];
     }
@@ -2788,7 +2963,7 @@ int64_t Lookahead::vbvFrameCost(Lowres **frames, int p0, int p1, int b)
 void Lookahead::slicetypeAnalyse(Lowres **frames, bool bKeyframe)
 {
     int numFrames, origNumFrames, keyintLimit, framecnt;
-    int maxSearch = X265_MIN(m_param->lookaheadDepth, X265_LOOKAHEAD_MAX);
+    int maxSearch = X265_MIN(lookaheadDepth(), X265_LOOKAHEAD_MAX);
     int cuCount = m_8x8Blocks;
     int resetStart;
     bool bIsVbvLookahead = m_param->rc.vbvBufferSize && m_param->lookaheadDepth;
@@ -2804,7 +2979,11 @@ void Lookahead::slicetypeAnalyse(Lowres **frames, bool bKeyframe)
     if (!framecnt)
     {
         if (m_param->rc.cuTree)
-            cuTree(frames, 0, bKeyframe);
+        {
+            LookaheadPlan& plan = beginPlan(frames, 0, bKeyframe);
+            cuTree(frames, 0, bKeyframe, plan);
+            endPlan(plan);
+        }
         return;
     }
     frames[framecnt + 1] = NULL;
@@ -2854,21 +3033,22 @@ void Lookahead::slicetypeAnalyse(Lowres **frames, bool bKeyframe)
     {
         /* pre-calculate all motion searches, using many worker threads */
         CostEstimateGroup estGroup(*this, frames);
+        int trellis = trellisDepth();
         for (int b = 2; b < numFrames; b++)
         {
-            for (int i = 1; i <= m_param->bframes + 1; i++)
+            for (int i = 1; i <= trellis + 1; i++)
             {
                 int p0 = b - i;
                 if (p0 < 0)
                     continue;
 
                 /* Skip search if already done */
-                if (frames[b]->lowresMvs[0][i][0].x != 0x7FFF)
+                if (frames[b]->lowresMvs[0][i])
                     continue;
 
                 /* perform search to p1 at same distance, if possible */
                 int p1 = b + i;
-                if (p1 >= numFrames || frames[b]->lowresMvs[1][i][0].x != 0x7FFF)
+                if (p1 >= numFrames || frames[b]->lowresMvs[1][i])
                     p1 = b;
 
                 estGroup.add(p0, p1, b);
@@ -2883,26 +3063,26 @@ void Lookahead::slicetypeAnalyse(Lowres **frames, bool bKeyframe)
             /* pre-calculate all frame cost estimates, using many worker threads */
             for (int b = 2; b < numFrames; b++)
             {
-                for (int i = 1; i <= m_param->bframes + 1; i++)
+                for (int i = 1; i <= trellis + 1; i++)
                 {
                     if (b < i)
                         continue;
 
                     /* only measure frame cost in this pass if motion searches
                      * are already done */
-                    if (frames[b]->lowresMvs[0][i][0].x == 0x7FFF)
+                    if (!frames[b]->lowresMvs[0][i])
                         continue;
 
                     int p0 = b - i;
 
-                    for (int j = 0; j <= m_param->bframes; j++)
+                    for (int j = 0; j <= trellis; j++)
                     {
                         int p1 = b + j;
                         if (p1 >= numFrames)
                             break;
 
                         /* ensure P1 search is done */
-                        if (j && frames[b]->lowresMvs[1][j][0].x == 0x7FFF)
+                        if (j && !frames[b]->lowresMvs[1][j])
                             continue;
 
                         /* ensure frame cost is not done */
@@ -2963,11 +3143,15 @@ void Lookahead::slicetypeAnalyse(Lowres **frames, bool bKeyframe)
             if (numFrames > 1)
             {
                 char best_paths[X265_BFRAME_MAX + 1][X265_LOOKAHEAD_MAX + 1] = { "", "P" };
+                int64_t best_costs[X265_BFRAME_MAX + 1] = { 0 };
                 int best_path_index = numFrames % (X265_BFRAME_MAX + 1);
 
+                if (m_bBatchMotionSearch && !m_param->bEnableTemporalFilter)
+                    batchPathCosts(frames, numFrames);
+
                 /* Perform the frame type analysis. */
-                for (int j = 2; j <= numFrames; j++)
-                    slicetypePath(frames, j, best_paths);
+                for (int j = 1; j <= numFrames; j++)
+                    slicetypePath(frames, j, best_paths, best_costs);
 
                 numBFrames = (int)strspn(best_paths[best_path_index], "B");
 
@@ -3072,11 +3256,12 @@ void Lookahead::slicetypeAnalyse(Lowres **frames, bool bKeyframe)
 
         resetStart = bKeyframe ? 1 : 2;
     }
-    if (m_param->bAQMotion)
+    if (m_param->bAQMotion && !m_bFailed)
         aqMotion(frames, bKeyframe);
 
+    LookaheadPlan& plan = beginPlan(frames, numFrames, bKeyframe);
     if (m_param->rc.cuTree)
-        cuTree(frames, X265_MIN(numFrames, m_param->keyframeMax), bKeyframe);
+        cuTree(frames, X265_MIN(numFrames, m_param->keyframeMax), bKeyframe, plan);
 
     if (m_param->gopLookahead && (keyFrameLimit >= 0) && (keyFrameLimit <= m_param->bframes + 1) && !m_extendGopBoundary)
         keyintLimit = keyFrameLimit;
@@ -3089,7 +3274,8 @@ void Lookahead::slicetypeAnalyse(Lowres **frames, bool bKeyframe)
         }
 
     if (bIsVbvLookahead)
-        vbvLookahead(frames, numFrames, bKeyframe);
+        planVbv(plan);
+    endPlan(plan);
     int maxp1 = X265_MIN(m_param->bframes + 1, origNumFrames);
 
     /* Restore frame types for all frames that haven't actually been decided yet. */
@@ -3400,98 +3586,146 @@ bool Lookahead::histBasedScenecut(Lowres **frames, int p0, int p1, int numFrames
     return frames[p1]->bScenecut;
 }
 
-void Lookahead::slicetypePath(Lowres **frames, int length, char(*best_paths)[X265_LOOKAHEAD_MAX + 1])
+/* Every path of the trellis is the best path of a shorter length followed by
+ * one more mini-GOP, so the cost of a path is the memoized cost of that best
+ * path plus the cost of the mini-GOP. Candidates whose prefix alone does not
+ * beat the best path so far are skipped, and the mini-GOP is only measured
+ * for as long as the sum can still beat it */
+void Lookahead::slicetypePath(Lowres **frames, int length, char(*best_paths)[X265_LOOKAHEAD_MAX + 1], int64_t *best_costs)
 {
-    char paths[2][X265_LOOKAHEAD_MAX + 1];
-    int num_paths = X265_MIN(m_param->bframes + 1, length);
+    CostEstimateGroup estGroup(*this, frames);
+    int num_paths = X265_MIN(trellisDepth() + 1, length);
     int64_t best_cost = 1LL << 62;
-    int idx = 0;
+    int best_len = 0;
 
     /* Iterate over all currently possible paths */
     for (int path = 0; path < num_paths; path++)
     {
-        /* Add suffixes to the current path */
         int len = length - (path + 1);
-        memcpy(paths[idx], best_paths[len % (X265_BFRAME_MAX + 1)], len);
-        memset(paths[idx] + len, 'B', path);
-        strcpy(paths[idx] + len + path, "P");
+        int64_t cost = best_costs[len % (X265_BFRAME_MAX + 1)];
+        if (cost >= best_cost)
+            continue;
 
         /* Calculate the actual cost of the current path */
-        int64_t cost = slicetypePathCost(frames, paths[idx], best_cost);
+        cost = slicetypePathCost(estGroup, len, length, cost, best_cost);
         if (cost < best_cost)
         {
             best_cost = cost;
-            idx ^= 1;
+            best_len = len;
         }
     }
 
-    /* Store the best path. */
-    memcpy(best_paths[length % (X265_BFRAME_MAX + 1)], paths[idx ^ 1], length);
+    /* Store the best path, its prefix may share the slot when the mini-GOP
+     * is X265_BFRAME_MAX + 1 frames long */
+    char* dst = best_paths[length % (X265_BFRAME_MAX + 1)];
+    const char* src = best_paths[best_len % (X265_BFRAME_MAX + 1)];
+    if (dst != src)
+        memcpy(dst, src, best_len);
+    memset(dst + best_len, 'B', length - best_len - 1);
+    strcpy(dst + length - 1, "P");
+    best_costs[length % (X265_BFRAME_MAX + 1)] = best_cost;
 }
 
-// Find slicetype of the frame with poc # in lookahead buffer
-int Lookahead::findSliceType(int poc)
+/* Measure the frame costs every candidate path of the trellis may need in a
+ * single batch, before the paths are searched. Estimates whose motion
+ * searches are not done yet are left to the paths, as two of them would race
+ * on the same search */
+void Lookahead::batchPathCosts(Lowres **frames, int numFrames)
 {
-    int out_slicetype = X265_TYPE_AUTO;
-    if (m_filled)
+    CostEstimateGroup estGroup(*this, frames);
+    int trellis = trellisDepth();
+
+    for (int b = 1; b <= numFrames; b++)
     {
-        m_outputLock.acquire();
-        Frame* out = m_outputQueue.first();
-        while (out != NULL) {
-            if (poc == out->m_poc)
+        bool needed[X265_BFRAME_MAX + 2][X265_BFRAME_MAX + 2];
+        memset(needed, 0, sizeof(needed));
+
+        /* the mini-GOPs from cur_p to next_p which contain b */
+        for (int next_p = b; next_p <= X265_MIN(b + trellis, numFrames); next_p++)
+        {
+            for (int cur_p = X265_MAX(next_p - trellis - 1, 0); cur_p < b; cur_p++)
             {
-                out_slicetype = out->m_lowres.sliceType;
-                break;
+                int p0 = cur_p, p1 = next_p;
+                if (b < next_p && m_param->bBPyramid && next_p - cur_p > 2)
+                {
+                    int middle = cur_p + (next_p - cur_p) / 2;
+                    if (b < middle)
+                        p1 = middle;
+                    else if (b > middle)
+                        p0 = middle;
+                }
+                needed[b - p0][p1 - b] = true;
+            }
+        }
+
+        for (int i = 1; i <= trellis + 1; i++)
+        {
+            for (int j = 0; j <= trellis; j++)
+            {
+                if (!needed[i][j] || frames[b]->costEst[i][j] >= 0)
+                    continue;
+
+                /* ensure both motion searches are done */
+                if (!frames[b]->lowresMvs[0][i] || (j && !frames[b]->lowresMvs[1][j]))
+                    continue;
+
+                estGroup.add(b - i, b + j, b);
             }
-            out = out->m_next;
         }
-        m_outputLock.release();
     }
-    return out_slicetype;
+
+    estGroup.finishBatch();
 }
 
-int64_t Lookahead::slicetypePathCost(Lowres **frames, char *path, int64_t threshold)
+// Find slicetype of the frame with poc # in lookahead buffer
+int Lookahead::findSliceType(int poc)
 {
-    int64_t cost = 0;
-    int loc = 1;
-    int cur_p = 0;
-
-    CostEstimateGroup estGroup(*this, frames);
-
-    path--; /* Since the 1st path element is really the second frame */
-    while (path[loc])
+    int out_slicetype = X265_TYPE_AUTO;
+    if (m_filled)
     {
-        int next_p = loc;
-        /* Find the location of the next P-frame. */
-        while (path[next_p] != 'P')
-            next_p++;
+        m_outputLock.acquire();
+        Frame* out = m_outputQueue.first();
+        while (out != NULL) {
+            if (poc == out->m_poc)
+            {
+                out_slicetype = out->m_lowres.sliceType;
+                break;
+            }
+            out = out->m_next;
+        }
+        m_outputLock.release();
+    }
+    return out_slicetype;
+}
 
-        /* Add the cost of the P-frame found above */
-        cost += estGroup.singleCost(cur_p, next_p, next_p);
+/* Adds the cost of the mini-GOP from cur_p to next_p to the cost of the path
+ * leading up to cur_p, stopping once the sum is no better than threshold */
+int64_t Lookahead::slicetypePathCost(CostEstimateGroup& estGroup, int cur_p, int next_p, int64_t cost, int64_t threshold)
+{
+    int loc = cur_p + 1;
 
-        /* Early terminate if the cost we have found is larger than the best path cost so far */
-        if (cost > threshold)
-            break;
+    /* Add the cost of the P-frame */
+    cost += estGroup.singleCost(cur_p, next_p, next_p);
 
-        if (m_param->bBPyramid && next_p - cur_p > 2)
-        {
-            int middle = cur_p + (next_p - cur_p) / 2;
-            cost += estGroup.singleCost(cur_p, next_p, middle);
+    /* Early terminate if the cost we have found is larger than the best path cost so far */
+    if (cost > threshold)
+        return cost;
 
-            for (int next_b = loc; next_b < middle && cost < threshold; next_b++)
-                cost += estGroup.singleCost(cur_p, middle, next_b);
+    if (m_param->bBPyramid && next_p - cur_p > 2)
+    {
+        int middle = cur_p + (next_p - cur_p) / 2;
+        cost += estGroup.singleCost(cur_p, next_p, middle);
 
-            for (int next_b = middle + 1; next_b < next_p && cost < threshold; next_b++)
-                cost += estGroup.singleCost(middle, next_p, next_b);
-        }
-        else
-        {
-            for (int next_b = loc; next_b < next_p && cost < threshold; next_b++)
-                cost += estGroup.singleCost(cur_p, next_p, next_b);
-        }
+        for (int next_b = loc; next_b < middle && cost < threshold; next_b++)
+            cost += estGroup.singleCost(cur_p, middle, next_b);
 
-        loc = next_p + 1;
-        cur_p = next_p;
+        for (int next_b = middle + 1; next_b < next_p && cost < threshold; next_b++)
+            cost += estGroup.singleCost(middle, next_p, next_b);
+    }
+    else
+    {
+        for (int next_b = loc; next_b < next_p && cost < threshold; next_b++)
+            cost += estGroup.singleCost(cur_p, next_p, next_b);
     }
 
     return cost;
@@ -3553,7 +3787,7 @@ void Lookahead::calcMotionAdaptiveQuantFrame(Lowres **frames, int p0, int p1, in
             if (lists_used == 3)
                 displacement = displacement / 2;
             qp_adj = pow(displacement, 0.1);
-            frames[b]->qpAqMotionOffset[cuIndex] = qp_adj;
+            m_aqMotionScratch[cuIndex] = qp_adj;
             avg_adj += qp_adj;
             avg_adj_pow2 += qp_adj * qp_adj;
         }
@@ -3568,7 +3802,7 @@ void Lookahead::calcMotionAdaptiveQuantFrame(Lowres **frames, int p0, int p1, in
             int cuIndex = blocky * strideInCU;
             for (uint16_t blockx = 0; blockx < m_8x8Width; blockx++, cuIndex++)
             {
-                qp_adj = frames[b]->qpAqMotionOffset[cuIndex];
+                qp_adj = m_aqMotionScratch[cuIndex];
                 qp_adj = (qp_adj - avg_adj) / sd;
                 if (qp_adj > 1)
                 {
@@ -3581,16 +3815,14 @@ void Lookahead::calcMotionAdaptiveQuantFrame(Lowres **frames, int p0, int p1, in
     }
 }
 
-void Lookahead::cuTree(Lowres **frames, int numframes, bool bIntra)
+/* Makes the cost estimates of the propagation and records its steps in plan,
+ * runPlan() carries them out */
+void Lookahead::cuTree(Lowres **frames, int numframes, bool bIntra, LookaheadPlan& plan)
 {
     int idx = !bIntra;
     int lastnonb, curnonb = 1;
     int bframes = 0;
 
-    x265_emms();
-
-    double averageDuration = (double)m_param->fpsDenom / m_param->fpsNum;
-
     int i = numframes;
 
     while (i > 0 && frames[i]->sliceType == X265_TYPE_B)
@@ -3605,21 +3837,18 @@ void Lookahead::cuTree(Lowres **frames, int numframes, bool bIntra)
     {
         if (bIntra)
         {
-            memset(frames[0]->propagateCost, 0, m_cuCount * sizeof(uint16_t));
-            if (m_param->rc.qgSize == 8)
-                memcpy(frames[0]->qpCuTreeOffset, frames[0]->qpAqOffset, m_cuCount * 4 * sizeof(double));
-            else
-                memcpy(frames[0]->qpCuTreeOffset, frames[0]->qpAqOffset, m_cuCount * sizeof(double));
+            plan.add(LookaheadPlan::CLEAR, 0);
+            plan.add(LookaheadPlan::COPY_AQ, 0);
             return;
         }
-        std::swap(frames[lastnonb]->propagateCost, frames[0]->propagateCost);
-        memset(frames[0]->propagateCost, 0, m_cuCount * sizeof(uint16_t));
+        plan.add(LookaheadPlan::SWAP, lastnonb, 0);
+        plan.add(LookaheadPlan::CLEAR, 0);
     }
     else
     {
         if (lastnonb < idx)
             return;
-        memset(frames[lastnonb]->propagateCost, 0, m_cuCount * sizeof(uint16_t));
+        plan.add(LookaheadPlan::CLEAR, lastnonb);
     }
 
     CostEstimateGroup estGroup(*this, frames);
@@ -3635,13 +3864,13 @@ void Lookahead::cuTree(Lowres **frames, int numframes, bool bIntra)
 
         estGroup.singleCost(curnonb, lastnonb, lastnonb);
 
-        memset(frames[curnonb]->propagateCost, 0, m_cuCount * sizeof(uint16_t));
+        plan.add(LookaheadPlan::CLEAR, curnonb);
         bframes = lastnonb - curnonb - 1;
         if (m_param->bBPyramid && bframes > 1)
         {
             int middle = (bframes + 1) / 2 + curnonb;
             estGroup.singleCost(curnonb, lastnonb, middle);
-            memset(frames[middle]->propagateCost, 0, m_cuCount * sizeof(uint16_t));
+            plan.add(LookaheadPlan::CLEAR, middle);
             while (i > curnonb)
             {
                 int p0 = i > middle ? middle : curnonb;
@@ -3649,36 +3878,145 @@ void Lookahead::cuTree(Lowres **frames, int numframes, bool bIntra)
                 if (i != middle)
                 {
                     estGroup.singleCost(p0, p1, i);
-                    estimateCUPropagate(frames, averageDuration, p0, p1, i, 0);
+                    plan.add(LookaheadPlan::PROPAGATE, i, p0, p1, 0);
                 }
                 i--;
             }
 
-            estimateCUPropagate(frames, averageDuration, curnonb, lastnonb, middle, 1);
+            plan.add(LookaheadPlan::PROPAGATE, middle, curnonb, lastnonb, 1);
         }
         else
         {
             while (i > curnonb)
             {
                 estGroup.singleCost(curnonb, lastnonb, i);
-                estimateCUPropagate(frames, averageDuration, curnonb, lastnonb, i, 0);
+                plan.add(LookaheadPlan::PROPAGATE, i, curnonb, lastnonb, 0);
                 i--;
             }
         }
-        estimateCUPropagate(frames, averageDuration, curnonb, lastnonb, lastnonb, 1);
+        plan.add(LookaheadPlan::PROPAGATE, lastnonb, curnonb, lastnonb, 1);
         lastnonb = curnonb;
     }
 
     if (!m_param->lookaheadDepth)
     {
         estGroup.singleCost(0, lastnonb, lastnonb);
-        estimateCUPropagate(frames, averageDuration, 0, lastnonb, lastnonb, 1);
-        std::swap(frames[lastnonb]->propagateCost, frames[0]->propagateCost);
+        plan.add(LookaheadPlan::PROPAGATE, lastnonb, 0, lastnonb, 1);
+        plan.add(LookaheadPlan::SWAP, lastnonb, 0);
     }
 
-    cuTreeFinish(frames[lastnonb], averageDuration, lastnonb);
+    plan.add(LookaheadPlan::FINISH, lastnonb, lastnonb);
     if (m_param->bBPyramid && bframes > 1 && !m_param->rc.vbvBufferSize)
-        cuTreeFinish(frames[lastnonb + (bframes + 1) / 2], averageDuration, 0);
+        plan.add(LookaheadPlan::FINISH, lastnonb + (bframes + 1) / 2, 0);
+}
+
+LookaheadPlan& Lookahead::beginPlan(Lowres **frames, int numFrames, bool bKeyframe)
+{
+    LookaheadPlan* plan = m_plans;
+    if (m_bPipelinedCuTree)
+    {
+        m_inputLock.acquire();
+        X265_CHECK(m_planQueued + m_planRecorded < LOOKAHEAD_PLANS, "lookahead plan ring overflow\n");
+        plan = &m_plans[(m_planFirst + m_planQueued + m_planRecorded) % LOOKAHEAD_PLANS];
+        m_inputLock.release();
+    }
+
+    memcpy(plan->frames, frames, (numFrames + 1) * sizeof(Lowres*));
+    plan->numFrames = numFrames;
+    plan->numOps = 0;
+    plan->numOutput = 0;
+    plan->bKeyframe = bKeyframe;
+    plan->bVbv = false;
+    return *plan;
+}
+
+void Lookahead::planVbv(LookaheadPlan& plan)
+{
+    if (m_bFailed)
+        return;
+
+    for (int i = 0; i <= plan.numFrames; i++)
+        plan.vbvTypes[i] = plan.frames[i]->sliceType;
+    plan.bVbv = true;
+
+    vbvLookahead(plan.frames, plan.vbvTypes, plan.numFrames, plan.bKeyframe, true);
+}
+
+void Lookahead::endPlan(LookaheadPlan& plan)
+{
+    if (!plan.numOps && !plan.bVbv)
+        return;
+
+    if (m_bPipelinedCuTree)
+        m_planRecorded++; /* queued by queueDecided() */
+    else
+        runPlan(plan);
+}
+
+void Lookahead::runPlan(LookaheadPlan& plan)
+{
+    /* the estimates the plan reads may have no tables */
+    if (m_bFailed)
+        return;
+
+    x265_emms();
+
+#if DETAILED_CU_STATS
+    int64_t start = x265_mdate();
+#endif
+    double averageDuration = (double)m_param->fpsDenom / m_param->fpsNum;
+
+    if (m_bIncrementalCuTree && plan.numOps)
+    {
+        cuTreeIncremental(plan, averageDuration);
+#if CHECKED_BUILD
+        verifyCuTreeIncremental(plan, averageDuration);
+#endif
+    }
+    else
+        cuTreeSteps(plan, averageDuration);
+
+#if DETAILED_CU_STATS
+    m_cuTreeWork.elapsed += x265_mdate() - start;
+#endif
+
+    if (plan.bVbv)
+        vbvLookahead(plan.frames, plan.vbvTypes, plan.numFrames, plan.bKeyframe, false);
+}
+
+void Lookahead::cuTreeSteps(LookaheadPlan& plan, double averageDuration)
+{
+    Lowres** frames = plan.frames;
+
+    for (int i = 0; i < plan.numOps; i++)
+    {
+        const LookaheadPlan::Op& op = plan.ops[i];
+        switch (op.type)
+        {
+        case LookaheadPlan::CLEAR:
+            memset(frames[op.b]->propagateCost, 0, m_cuCount * sizeof(uint16_t));
+            break;
+
+        case LookaheadPlan::SWAP:
+            std::swap(frames[op.b]->propagateCost, frames[op.p0]->propagateCost);
+            break;
+
+        case LookaheadPlan::COPY_AQ:
+            if (m_param->rc.qgSize == 8)
+                memcpy(frames[op.b]->qpCuTreeOffset, frames[op.b]->qpAqOffset, m_cuCount * 4 * sizeof(double));
+            else
+                memcpy(frames[op.b]->qpCuTreeOffset, frames[op.b]->qpAqOffset, m_cuCount * sizeof(double));
+            break;
+
+        case LookaheadPlan::PROPAGATE:
+            estimateCUPropagate(frames, averageDuration, op.p0, op.p1, op.b, op.referenced);
+            break;
+
+        case LookaheadPlan::FINISH:
+            cuTreeFinish(frames[op.b], averageDuration, op.p0);
+            break;
+        }
+    }
 }
 
 void Lookahead::estimateCUPropagate(Lowres **frames, double averageDuration, int p0, int p1, int b, int referenced)
@@ -3700,6 +4038,11 @@ void Lookahead::estimateCUPropagate(Lowres **frames, double averageDuration, int
     if (!referenced)
         memset(frames[b]->propagateCost, 0, m_8x8Width * sizeof(uint16_t));
 
+#if DETAILED_CU_STATS
+    m_cuTreeWork.steps++;
+    m_cuTreeWork.blocks += m_cuCount;
+#endif
+
     int32_t strideInCU = m_8x8Width;
     for (uint16_t blocky = 0; blocky < m_8x8Height; blocky++)
     {
@@ -3722,6 +4065,9 @@ void Lookahead::estimateCUPropagate(Lowres **frames, double averageDuration, int
             /* Don't propagate for an intra block. */
             if (propagate_amount > 0)
             {
+#if DETAILED_CU_STATS
+                m_cuTreeWork.propagated++;
+#endif
                 /* Access width-2 bitfield. */
                 int32_t lists_used = frames[b]->lowresCosts[b - p0][p1 - b][cuIndex] >> LOWRES_COST_SHIFT;
                 /* Follow the MVs to the previous frame(s). */
@@ -3789,6 +4135,372 @@ void Lookahead::estimateCUPropagate(Lowres **frames, double averageDuration, int
         cuTreeFinish(frames[b], averageDuration, b == p1 ? b - p0 : 0);
 }
 
+/* Changes of a block's propagate cost smaller than 1 / (1 << CUTREE_DELTA_SHIFT)
+ * of its own intra propagate amount are not carried on by the incremental
+ * cuTree */
+#define CUTREE_DELTA_SHIFT 6
+
+enum { CUTREE_DIRTY = 1, CUTREE_FRESH = 2, CUTREE_CHANGED = 4 };
+
+int32_t* Lookahead::cuTreeDelta(int idx)
+{
+    int32_t* delta = m_cuTreeDelta + (size_t)idx * m_cuCount;
+    if (!(m_cuTreeState[idx] & CUTREE_DIRTY))
+    {
+        memset(delta, 0, m_cuCount * sizeof(int32_t));
+        m_cuTreeState[idx] |= CUTREE_DIRTY;
+    }
+    return delta;
+}
+
+/* The propagate cost of each frame of the window is kept as the sum of the
+ * last propagation step applied from every frame which references it. A plan
+ * first takes back the steps which are no longer made, then walks its steps
+ * back to front: new or changed steps add their full propagate amounts, the
+ * unchanged steps of referenced frames only pass on the change of their own
+ * propagate cost. Frames entering the window start from zero */
+void Lookahead::cuTreeIncremental(LookaheadPlan& plan, double averageDuration)
+{
+    Lowres** frames = plan.frames;
+    int numFrames = plan.numFrames;
+    uint32_t serial = ++m_cuTreeSerial;
+    double fpsFactor = CLIP_DURATION((double)m_param->fpsDenom / m_param->fpsNum) / CLIP_DURATION(averageDuration);
+    int firstNum = frames[0]->frameNum;
+    int lastNum = frames[numFrames]->frameNum;
+
+    X265_CHECK(numFrames < m_cuTreeMaxFrames, "incremental cuTree window too large\n");
+
+    int8_t  stepRef[X265_LOOKAHEAD_MAX + 2];
+    int16_t stepRefs[X265_LOOKAHEAD_MAX + 2][2];
+    for (int i = 0; i <= numFrames; i++)
+    {
+        frames[i]->cuTreeSerial = serial;
+        frames[i]->cuTreeIndex = i;
+        m_cuTreeState[i] = 0;
+        stepRef[i] = 0;
+    }
+    for (int i = 0; i < plan.numOps; i++)
+    {
+        const LookaheadPlan::Op& op = plan.ops[i];
+        if (op.type == LookaheadPlan::PROPAGATE)
+        {
+            stepRef[op.b] = op.referenced ? 2 : 1;
+            stepRefs[op.b][0] = op.p0;
+            stepRefs[op.b][1] = op.p1;
+        }
+    }
+
+    /* The window end only moves back when the keyframe placement changed;
+     * start over rather than chase the steps of frames beyond the end */
+    bool bReset = false;
+    for (int i = 0; i < m_numCuTreeTracked; i++)
+        bReset |= m_cuTreeTrackedNum[i] > lastNum;
+    if (bReset)
+    {
+        for (int i = 0; i < m_numCuTreeTracked; i++)
+        {
+            if (m_cuTreeTrackedNum[i] > lastNum)
+            {
+                m_cuTreeTracked[i]->cuTreeStep = 0;
+                m_cuTreeTracked[i]->bCuTreeTracked = false;
+            }
+        }
+        for (int i = 0; i <= numFrames; i++)
+        {
+            frames[i]->cuTreeStep = 0;
+            frames[i]->bCuTreeTracked = false;
+        }
+    }
+
+    /* the keyframe of a keyframe window is always rebuilt from its own window */
+    for (int i = 0; i <= numFrames; i++)
+    {
+        if (!frames[i]->bCuTreeTracked || (plan.bKeyframe && !i))
+        {
+            memset(frames[i]->propagateCost, 0, m_cuCount * sizeof(uint16_t));
+            frames[i]->bCuTreeTracked = true;
+            frames[i]->cuTreeFinishDist = -1;
+            m_cuTreeState[i] |= CUTREE_FRESH;
+        }
+    }
+
+    for (int i = 0; i <= numFrames; i++)
+    {
+        Lowres* frame = frames[i];
+        bool bSame = stepRef[i] && frame->cuTreeStep == stepRef[i];
+        for (int list = 0; list < 2 && bSame; list++)
+        {
+            Lowres* ref = frames[stepRefs[i][list]];
+            bSame = frame->cuTreeRefs[list] == ref && frame->cuTreeRefNum[list] == ref->frameNum &&
+                    !(m_cuTreeState[stepRefs[i][list]] & CUTREE_FRESH);
+        }
+        if (bSame)
+            continue;
+
+        m_cuTreeState[i] |= CUTREE_CHANGED;
+        if (!frame->cuTreeStep)
+            continue;
+
+        /* take back the old step from the references still in the window;
+         * those which left it are never looked at again */
+        Lowres* refs[2] = { NULL, NULL };
+        int refIdx[2] = { -1, -1 };
+        int listDist[2] = { frame->frameNum - frame->cuTreeRefNum[0], frame->cuTreeRefNum[1] - frame->frameNum };
+        for (int list = 0; list < 2; list++)
+        {
+            int idx = frame->cuTreeRefNum[list] - firstNum;
+            if (idx >= 0 && idx <= numFrames && frames[idx] == frame->cuTreeRefs[list] && !(m_cuTreeState[idx] & CUTREE_FRESH))
+            {
+                refs[list] = frames[idx];
+                refIdx[list] = idx;
+            }
+        }
+        if (refs[0] || refs[1])
+        {
+            const uint16_t* propagateIn = m_cuTreeCost;
+            if (frame->cuTreeStep == 2)
+            {
+                uint16_t* priorCost = m_cuTreeCost + m_8x8Width;
+                const int32_t* delta = (m_cuTreeState[i] & CUTREE_DIRTY) ? cuTreeDelta(i) : NULL;
+                for (int cu = 0; cu < m_cuCount; cu++)
+                    priorCost[cu] = (uint16_t)x265_clip3(0, (1 << 16) - 1, frame->propagateCost[cu] - (delta ? delta[cu] : 0));
+                propagateIn = priorCost;
+            }
+            addCUPropagate(frame, refs, refIdx, listDist, propagateIn, NULL, frame->cuTreeStep == 2, -1, fpsFactor);
+        }
+        frame->cuTreeStep = 0;
+    }
+
+    bool bVbvFinish = !!m_param->rc.vbvBufferSize;
+    for (int i = 0; i < plan.numOps; i++)
+    {
+        const LookaheadPlan::Op& op = plan.ops[i];
+        if (op.type == LookaheadPlan::FINISH)
+        {
+            cuTreeFinish(frames[op.b], averageDuration, op.p0);
+            frames[op.b]->cuTreeFinishDist = op.p0;
+            continue;
+        }
+        if (op.type != LookaheadPlan::PROPAGATE)
+            continue;
+
+        Lowres* frame = frames[op.b];
+        Lowres* refs[2] = { frames[op.p0], frames[op.p1] };
+        int listDist[2] = { op.b - op.p0, op.p1 - op.b };
+        int state = m_cuTreeState[op.b];
+
+        if (state & (CUTREE_CHANGED | CUTREE_DIRTY))
+        {
+            int refIdx[2] = { op.p0, op.p1 };
+            if (state & CUTREE_CHANGED)
+            {
+                addCUPropagate(frame, refs, refIdx, listDist, op.referenced ? frame->propagateCost : m_cuTreeCost,
+                               NULL, op.referenced, 1, fpsFactor);
+                frame->cuTreeStep = op.referenced ? 2 : 1;
+                for (int list = 0; list < 2; list++)
+                {
+                    frame->cuTreeRefs[list] = refs[list];
+                    frame->cuTreeRefNum[list] = refs[list]->frameNum;
+                }
+            }
+            else if (op.referenced)
+                addCUPropagate(frame, refs, refIdx, listDist, NULL, cuTreeDelta(op.b), 1, 1, fpsFactor);
+        }
+
+        if (bVbvFinish && op.referenced)
+        {
+            int ref0Distance = op.b == op.p1 ? op.b - op.p0 : 0;
+            if (state || frame->cuTreeFinishDist != ref0Distance)
+            {
+                cuTreeFinish(frame, averageDuration, ref0Distance);
+                frame->cuTreeFinishDist = ref0Distance;
+            }
+        }
+    }
+
+    m_numCuTreeTracked = 0;
+    for (int i = 0; i <= numFrames; i++)
+    {
+        if (frames[i]->cuTreeStep)
+        {
+            m_cuTreeTracked[m_numCuTreeTracked] = frames[i];
+            m_cuTreeTrackedNum[m_numCuTreeTracked++] = frames[i]->frameNum;
+        }
+    }
+}
+
+/* Adds sign times the propagate amounts of frame to its references, and to
+ * the deltas of the references at window positions refIdx. The amounts follow from the
+ * propagate costs propagateIn (one reused zero row for unreferenced frames),
+ * or only from the propagate cost changes deltaIn when that is given */
+void Lookahead::addCUPropagate(Lowres *frame, Lowres* const refs[2], const int refIdx[2], const int listDist[2],
+                               const uint16_t *propagateIn, const int32_t *deltaIn, int referenced, int sign, double fpsFactor)
+{
+    int32_t distScaleFactor = ((listDist[0] << 8) + ((listDist[0] + listDist[1]) >> 1)) / (listDist[0] + listDist[1]);
+    int32_t bipredWeight = m_param->bEnableWeightedBiPred ? 64 - (distScaleFactor >> 2) : 32;
+    int32_t bipredWeights[2] = { bipredWeight, 64 - bipredWeight };
+    const uint16_t* lowresCosts = frame->lowresCosts[listDist[0]][listDist[1]];
+    const int* invQscales = m_param->rc.qgSize == 8 ? frame->invQscaleFactor8x8 : frame->invQscaleFactor;
+
+#if DETAILED_CU_STATS
+    m_cuTreeWork.steps++;
+    m_cuTreeWork.blocks += m_cuCount;
+#endif
+
+    int32_t strideInCU = m_8x8Width;
+    for (uint16_t blocky = 0; blocky < m_8x8Height; blocky++)
+    {
+        int cuIndex = blocky * strideInCU;
+        if (deltaIn)
+        {
+            for (uint16_t blockx = 0; blockx < m_8x8Width; blockx++)
+            {
+                int i = cuIndex + blockx;
+                int32_t delta = deltaIn[i];
+                int32_t intraCost = frame->intraCost[i];
+                int32_t interCost = X265_MIN(intraCost, lowresCosts[i] & LOWRES_COST_MASK);
+                double intraAmount = (double)intraCost * invQscales[i] * fpsFactor / 256;
+                if (!intraCost || (double)abs(delta) * (1 << CUTREE_DELTA_SHIFT) < intraAmount)
+                    m_scratch[blockx] = 0;
+                else
+                    m_scratch[blockx] = (int32_t)((double)delta * (intraCost - interCost) / intraCost + (delta > 0 ? 0.5 : -0.5));
+            }
+        }
+        else
+        {
+            primitives.propagateCost(m_scratch, propagateIn, frame->intraCost + cuIndex, lowresCosts + cuIndex,
+                                     invQscales + cuIndex, &fpsFactor, m_8x8Width);
+            if (referenced)
+                propagateIn += m_8x8Width;
+        }
+
+        for (uint16_t blockx = 0; blockx < m_8x8Width; blockx++, cuIndex++)
+        {
+            int32_t propagate_amount = m_scratch[blockx];
+            if (!propagate_amount)
+                continue;
+#if DETAILED_CU_STATS
+            m_cuTreeWork.propagated++;
+#endif
+
+            /* keep the rounding of removed steps identical to their addition */
+            int amountSign = sign;
+            if (propagate_amount < 0)
+            {
+                propagate_amount = -propagate_amount;
+                amountSign = -amountSign;
+            }
+
+            int32_t lists_used = lowresCosts[cuIndex] >> LOWRES_COST_SHIFT;
+            for (uint16_t list = 0; list < 2; list++)
+            {
+                if (!((lists_used >> list) & 1) || !refs[list])
+                    continue;
+
+#define CLIP_ADD_DELTA(idx, x) \
+    { \
+        int32_t amount = amountSign * (x); \
+        refCosts[idx] = (uint16_t)x265_clip3(0, (1 << 16) - 1, refCosts[idx] + amount); \
+        if (amount && refIdx[list] >= 0) \
+            cuTreeDelta(refIdx[list])[idx] += amount; \
+    }
+                uint16_t* refCosts = refs[list]->propagateCost;
+                int32_t listamount = propagate_amount;
+                if (lists_used == 3)
+                    listamount = (listamount * bipredWeights[list] + 32) >> 6;
+
+                MV *mvs = frame->lowresMvs[list][listDist[list]];
+                if (!mvs[cuIndex].word)
+                {
+                    CLIP_ADD_DELTA(cuIndex, listamount);
+                    continue;
+                }
+
+                int32_t x = mvs[cuIndex].x;
+                int32_t y = mvs[cuIndex].y;
+                int32_t cux = (x >> 5) + blockx;
+                int32_t cuy = (y >> 5) + blocky;
+                int32_t idx0 = cux + cuy * strideInCU;
+                x &= 31;
+                y &= 31;
+                int32_t idx0weight = (32 - y) * (32 - x);
+                int32_t idx1weight = (32 - y) * x;
+                int32_t idx2weight = y * (32 - x);
+                int32_t idx3weight = y * x;
+
+                if (cux < m_8x8Width && cuy < m_8x8Height && cux >= 0 && cuy >= 0)
+                    CLIP_ADD_DELTA(idx0, (listamount * idx0weight + 512) >> 10);
+                if (cux + 1 < m_8x8Width && cuy < m_8x8Height && cux + 1 >= 0 && cuy >= 0)
+                    CLIP_ADD_DELTA(idx0 + 1, (listamount * idx1weight + 512) >> 10);
+                if (cux < m_8x8Width && cuy + 1 < m_8x8Height && cux >= 0 && cuy + 1 >= 0)
+                    CLIP_ADD_DELTA(idx0 + strideInCU, (listamount * idx2weight + 512) >> 10);
+                if (cux + 1 < m_8x8Width && cuy + 1 < m_8x8Height && cux + 1 >= 0 && cuy + 1 >= 0)
+                    CLIP_ADD_DELTA(idx0 + strideInCU + 1, (listamount * idx3weight + 512) >> 10);
+#undef CLIP_ADD_DELTA
+            }
+        }
+    }
+}
+
+#if CHECKED_BUILD
+/* The mean QP offset difference allowed between the incremental and the full
+ * propagation for a frame finished by a plan */
+#define CUTREE_INCREMENTAL_TOLERANCE 0.25
+
+/* Checked builds repeat every incremental plan as a full propagation, compare
+ * the QP offsets of the frames it finished, then put the incremental state back */
+void Lookahead::verifyCuTreeIncremental(LookaheadPlan& plan, double averageDuration)
+{
+    Lowres** frames = plan.frames;
+    int numFrames = plan.numFrames;
+    int qpCount = m_param->rc.qgSize == 8 ? m_cuCount * 4 : m_cuCount;
+
+    uint16_t* costs = X265_MALLOC(uint16_t, (size_t)(numFrames + 1) * m_cuCount);
+    double* offsets = X265_MALLOC(double, (size_t)(numFrames + 1) * qpCount);
+    if (costs && offsets)
+    {
+        for (int i = 0; i <= numFrames; i++)
+        {
+            memcpy(costs + (size_t)i * m_cuCount, frames[i]->propagateCost, m_cuCount * sizeof(uint16_t));
+            memcpy(offsets + (size_t)i * qpCount, frames[i]->qpCuTreeOffset, qpCount * sizeof(double));
+        }
+
+#if DETAILED_CU_STATS
+        /* the full propagation is not counted as work of the plan */
+        CuTreeWork work = m_cuTreeWork;
+        cuTreeSteps(plan, averageDuration);
+        m_cuTreeWork = work;
+#else
+        cuTreeSteps(plan, averageDuration);
+#endif
+
+        for (int i = 0; i < plan.numOps; i++)
+        {
+            const LookaheadPlan::Op& op = plan.ops[i];
+            if (op.type != LookaheadPlan::FINISH &&
+                !(op.type == LookaheadPlan::PROPAGATE && op.referenced && m_param->rc.vbvBufferSize))
+                continue;
+
+            const double* incremental = offsets + (size_t)op.b * qpCount;
+            double sum = 0;
+            for (int j = 0; j < qpCount; j++)
+                sum += fabs(frames[op.b]->qpCuTreeOffset[j] - incremental[j]);
+            X265_CHECK(sum <= CUTREE_INCREMENTAL_TOLERANCE * qpCount,
+                       "incremental cuTree QP offsets of frame %d are %.3f off the full propagation\n",
+                       frames[op.b]->frameNum, sum / qpCount);
+        }
+
+        for (int i = 0; i <= numFrames; i++)
+        {
+            memcpy(frames[i]->propagateCost, costs + (size_t)i * m_cuCount, m_cuCount * sizeof(uint16_t));
+            memcpy(frames[i]->qpCuTreeOffset, offsets + (size_t)i * qpCount, qpCount * sizeof(double));
+        }
+    }
+    X265_FREE(costs);
+    X265_FREE(offsets);
+}
+#endif
+
 void Lookahead::computeCUTreeQpOffset(Lowres *frame, double averageDuration, int ref0Distance)
 {
     int fpsFactor = (int)(CLIP_DURATION(averageDuration) / CLIP_DURATION((double)m_param->fpsDenom / m_param->fpsNum) * 256);
@@ -3981,9 +4693,9 @@ void Lookahead::cuTreeFinish(Lowres *frame, double averageDuration, int ref0Dist
 
 /* If MB-tree changes the quantizers, we need to recalculate the frame cost without
  * re-running lookahead. */
-int64_t Lookahead::frameCostRecalculate(Lowres** frames, int p0, int p1, int b)
+int64_t Lookahead::frameCostRecalculate(Lowres** frames, int type, int p0, int p1, int b)
 {
-    if (frames[b]->sliceType == X265_TYPE_B)
+    if (type == X265_TYPE_B)
         return frames[b]->costEstAq[b - p0][p1 - b];
 
     int64_t score = 0;
@@ -4072,22 +4784,55 @@ void CostEstimateGroup::add(int p0, int p1, int b)
     X265_CHECK(m_batchMode || !m_jobTotal, "single CostEstimateGroup instance cannot mix batch modes\n");
     m_batchMode = true;
 
-    Estimate& e = m_estimates[m_jobTotal++];
+    Estimate& e = m_estimates[m_numEstimates++];
     e.p0 = p0;
     e.p1 = p1;
     e.b = b;
 
-    if (m_jobTotal == MAX_BATCH_SIZE)
+    if (m_numEstimates == MAX_BATCH_SIZE)
         finishBatch();
 }
 
+bool CostEstimateGroup::isMcstfSearch(const Estimate& e)
+{
+    if (!m_lookahead.m_param->bEnableTemporalFilter)
+        return false;
+
+    Frame* curFrame = m_lookahead.m_inputQueue.getPOC(e.b);
+    return curFrame && (curFrame->m_lowres.sliceType == X265_TYPE_IDR || curFrame->m_lowres.sliceType == X265_TYPE_I || curFrame->m_lowres.sliceType == X265_TYPE_P);
+}
+
 void CostEstimateGroup::finishBatch()
 {
+    /* group consecutive estimates of the same picture, keeping enough groups
+     * for every worker to have one */
+    int workers = m_lookahead.m_pool ? m_lookahead.m_pool->m_numWorkers + 1 : 1;
+    int grain = X265_MIN(m_lookahead.m_batchGrain, X265_MAX(1, m_numEstimates / workers));
+
+    m_jobTotal = 0;
+    for (int i = 0; i < m_numEstimates; i++)
+    {
+        bool bMcstf = isMcstfSearch(m_estimates[i]);
+        if (m_jobTotal)
+        {
+            Group& last = m_groups[m_jobTotal - 1];
+            if (!bMcstf && !last.bMcstf && last.count < grain && m_estimates[last.first].b == m_estimates[i].b)
+            {
+                last.count++;
+                continue;
+            }
+        }
+        Group& g = m_groups[m_jobTotal++];
+        g.first = i;
+        g.count = 1;
+        g.bMcstf = bMcstf;
+    }
+
     if (m_lookahead.m_pool)
         tryBondPeers(*m_lookahead.m_pool, m_jobTotal);
     processTasks(-1);
     waitForExit();
-    m_jobTotal = m_jobAcquired = 0;
+    m_jobTotal = m_jobAcquired = m_numEstimates = 0;
 }
 
 void CostEstimateGroup::processTasks(int workerThreadID)
@@ -4110,15 +4855,43 @@ void CostEstimateGroup::processTasks(int workerThreadID)
             ProfileLookaheadTime(tld.batchElapsedTime, tld.countBatches);
             ProfileScopeEvent(estCostSingle);
 
-            Estimate& e = m_estimates[i];
-            Frame* curFrame = m_lookahead.m_inputQueue.getPOC(e.b);
-
-            if (m_lookahead.m_param->bEnableTemporalFilter && curFrame && (curFrame->m_lowres.sliceType == X265_TYPE_IDR || curFrame->m_lowres.sliceType == X265_TYPE_I || curFrame->m_lowres.sliceType == X265_TYPE_P))
+            Group& g = m_groups[i];
+            if (g.bMcstf)
             {
-                estimatelowresmotion(m_metld, curFrame, e.p0);
+                Estimate& e = m_estimates[g.first];
+                estimatelowresmotion(m_metld, m_lookahead.m_inputQueue.getPOC(e.b), e.p0);
             }
             else
-                estimateFrameCost(tld, e.p0, e.p1, e.b, false);
+            {
+                Estimate* est[MAX_BATCH_GROUP];
+                int count = 0;
+                for (int k = g.first; k < g.first + g.count; k++)
+                {
+                    Estimate& e = m_estimates[k];
+                    Lowres* fenc = m_frames[e.b];
+                    if (fenc->costEst[e.b - e.p0][e.p1 - e.b] >= 0 && fenc->rowSatds[e.b - e.p0][e.p1 - e.b] && fenc->rowSatds[e.b - e.p0][e.p1 - e.b][0] != -1)
+                        continue;
+                    if (!prepareEstimate(tld, e))
+                        break; /* the lookahead has failed */
+
+                    /* a weighted reference lives in the worker's wbuffer
+                     * until the next estimate is prepared */
+                    if (fenc->weightedRef[e.b - e.p0].isWeighted)
+                    {
+                        Estimate* weighted = &e;
+                        estimateBlocks(tld, &weighted, 1);
+                        finishEstimate(e);
+                    }
+                    else
+                        est[count++] = &e;
+                }
+                if (count)
+                {
+                    estimateBlocks(tld, est, count);
+                    for (int k = 0; k < count; k++)
+                        finishEstimate(*est[k]);
+                }
+            }
         }
         else
         {
@@ -4131,7 +4904,7 @@ void CostEstimateGroup::processTasks(int workerThreadID)
             bool lastRow;
             if (m_lookahead.m_param->bEnableHME)
             {
-                int numRowsPerSlice = m_lookahead.m_4x4Height / m_lookahead.m_param->lookaheadSlices;
+                int numRowsPerSlice = m_lookahead.m_4x4Height / m_lookahead.m_numCoopSlices;
                 numRowsPerSlice = X265_MIN(X265_MAX(numRowsPerSlice, 5), m_lookahead.m_4x4Height);
                 firstY = numRowsPerSlice * i;
                 lastY = (i == m_jobTotal - 1) ? m_lookahead.m_4x4Height - 1 : numRowsPerSlice * (i + 1) - 1;
@@ -4163,35 +4936,118 @@ void CostEstimateGroup::processTasks(int workerThreadID)
     m_lock.release();
 }
 
-int64_t CostEstimateGroup::estimateFrameCost(LookaheadTLD& tld, int p0, int p1, int b, bool bIntraPenalty)
+/* Takes the tables of an estimate whose cost is not known yet and decides
+ * which of its motion searches it performs. Returns false and fails the
+ * lookahead when the tables are not available */
+bool CostEstimateGroup::prepareEstimate(LookaheadTLD& tld, Estimate& e)
 {
-    Lowres*     fenc  = m_frames[b];
-    x265_param* param = m_lookahead.m_param;
-    int64_t     score = 0;
+    Lowres* fenc = m_frames[e.b];
+    int p0 = e.p0, p1 = e.p1, b = e.b;
 
-    if (fenc->costEst[b - p0][p1 - b] >= 0 && fenc->rowSatds[b - p0][p1 - b][0] != -1)
-        score = fenc->costEst[b - p0][p1 - b];
-    else
+    e.bDoSearch[0] = !fenc->lowresMvs[0][b - p0];
+    e.bDoSearch[1] = p1 > b && !fenc->lowresMvs[1][p1 - b];
+
+#if CHECKED_BUILD
+    X265_CHECK(!(p0 < b && !e.bDoSearch[0] && fenc->lowresMvs[0][b - p0][0].x == 0x7FFE), "motion search batch duplication L0\n");
+    X265_CHECK(!(p1 > b && !e.bDoSearch[1] && fenc->lowresMvs[1][p1 - b][0].x == 0x7FFE), "motion search batch duplication L1\n");
+#endif
+
+    /* the tables of this pair and of the searches it makes are taken
+     * from the table pool the first time they are needed */
+    if ((e.bDoSearch[0] && !fenc->allocMvTable(0, b - p0)) ||
+        (e.bDoSearch[1] && !fenc->allocMvTable(1, p1 - b)) ||
+        (!fenc->rowSatds[b - p0][p1 - b] && !fenc->allocCostTable(b - p0, p1 - b)))
     {
-        bool bDoSearch[2];
-        bDoSearch[0] = fenc->lowresMvs[0][b - p0][0].x == 0x7FFF;
-        bDoSearch[1] = p1 > b && fenc->lowresMvs[1][p1 - b][0].x == 0x7FFF;
+        if (!m_lookahead.m_bFailed)
+            x265_log(m_lookahead.m_param, X265_LOG_ERROR, "lookahead: no tables for the cost of frame %d (p0 %d, p1 %d)\n",
+                     fenc->frameNum, m_frames[p0]->frameNum, m_frames[p1]->frameNum);
+        m_lookahead.m_bFailed = true;
+        return false;
+    }
 
 #if CHECKED_BUILD
-        X265_CHECK(!(p0 < b && fenc->lowresMvs[0][b - p0][0].x == 0x7FFE), "motion search batch duplication L0\n");
-        X265_CHECK(!(p1 > b && fenc->lowresMvs[1][p1 - b][0].x == 0x7FFE), "motion search batch duplication L1\n");
-        if (bDoSearch[0]) fenc->lowresMvs[0][b - p0][0].x = 0x7FFE;
-        if (bDoSearch[1]) fenc->lowresMvs[1][p1 - b][0].x = 0x7FFE;
+    if (e.bDoSearch[0]) fenc->lowresMvs[0][b - p0][0].x = 0x7FFE;
+    if (e.bDoSearch[1]) fenc->lowresMvs[1][p1 - b][0].x = 0x7FFE;
 #endif
 
-        fenc->weightedRef[b - p0].isWeighted = false;
-        if (param->bEnableWeightedPred && bDoSearch[0])
-            tld.weightsAnalyse(*m_frames[b], *m_frames[p0]);
+    fenc->weightedRef[b - p0].isWeighted = false;
+    if (m_lookahead.m_param->bEnableWeightedPred && e.bDoSearch[0])
+        tld.weightsAnalyse(*m_frames[b], *m_frames[p0]);
+
+    fenc->costEst[b - p0][p1 - b] = 0;
+    fenc->costEstAq[b - p0][p1 - b] = 0;
+    return true;
+}
 
-        fenc->costEst[b - p0][p1 - b] = 0;
-        fenc->costEstAq[b - p0][p1 - b] = 0;
+/* Evaluates every lowres block of the estimates, which all belong to the same
+ * picture. The blocks are walked in the reverse raster order each estimate's
+ * vector prediction depends on, and each block is evaluated for all estimates
+ * in turn, so the estimates give the same results as if run one at a time */
+void CostEstimateGroup::estimateBlocks(LookaheadTLD& tld, Estimate** est, int count)
+{
+    Lowres* fenc = m_frames[est[0]->b];
+    bool lastRow;
 
-        if (!m_batchMode && m_lookahead.m_numCoopSlices > 1 && ((p1 > b) || bDoSearch[0] || bDoSearch[1]))
+    /* Calculate MVs for 1/16th resolution*/
+    if (m_lookahead.m_param->bEnableHME)
+    {
+        lastRow = true;
+        for (int cuY = m_lookahead.m_4x4Height - 1; cuY >= 0; cuY--)
+        {
+            for (int cuX = m_lookahead.m_4x4Width - 1; cuX >= 0; cuX--)
+                for (int k = 0; k < count; k++)
+                    estimateCUCost(tld, cuX, cuY, est[k]->p0, est[k]->p1, est[k]->b, est[k]->bDoSearch, lastRow, -1, 1);
+            lastRow = false;
+        }
+    }
+    lastRow = true;
+    for (int cuY = m_lookahead.m_8x8Height - 1; cuY >= 0; cuY--)
+    {
+        for (int k = 0; k < count; k++)
+            fenc->rowSatds[est[k]->b - est[k]->p0][est[k]->p1 - est[k]->b][cuY] = 0;
+
+        for (int cuX = m_lookahead.m_8x8Width - 1; cuX >= 0; cuX--)
+            for (int k = 0; k < count; k++)
+                estimateCUCost(tld, cuX, cuY, est[k]->p0, est[k]->p1, est[k]->b, est[k]->bDoSearch, lastRow, -1, 0);
+
+        lastRow = false;
+    }
+}
+
+int64_t CostEstimateGroup::finishEstimate(Estimate& e)
+{
+    Lowres* fenc = m_frames[e.b];
+    int p0 = e.p0, p1 = e.p1, b = e.b;
+
+    if (m_lookahead.m_bShareMotionFields)
+        shareMotionFields(p0, p1, b, e.bDoSearch);
+
+    int64_t score = fenc->costEst[b - p0][p1 - b];
+
+    if (b != p1)
+        score = score * 100 / (130 + m_lookahead.m_param->bFrameBias);
+
+    fenc->costEst[b - p0][p1 - b] = score;
+    return score;
+}
+
+int64_t CostEstimateGroup::estimateFrameCost(LookaheadTLD& tld, int p0, int p1, int b, bool bIntraPenalty)
+{
+    Lowres*     fenc  = m_frames[b];
+    int64_t     score = 0;
+
+    if (fenc->costEst[b - p0][p1 - b] >= 0 && fenc->rowSatds[b - p0][p1 - b] && fenc->rowSatds[b - p0][p1 - b][0] != -1)
+        score = fenc->costEst[b - p0][p1 - b];
+    else
+    {
+        Estimate e;
+        e.p0 = p0;
+        e.p1 = p1;
+        e.b = b;
+        if (!prepareEstimate(tld, e))
+            return 0; /* the lookahead has failed, no decision is made from this */
+
+        if (!m_batchMode && m_lookahead.m_numCoopSlices > 1 && ((p1 > b) || e.bDoSearch[0] || e.bDoSearch[1]))
         {
             /* Use cooperative mode if a thread pool is available and the cost estimate is
              * going to need motion searches or bidir measurements */
@@ -4203,8 +5059,8 @@ int64_t CostEstimateGroup::estimateFrameCost(LookaheadTLD& tld, int p0, int p1,
             m_coop.p0 = p0;
             m_coop.p1 = p1;
             m_coop.b = b;
-            m_coop.bDoSearch[0] = bDoSearch[0];
-            m_coop.bDoSearch[1] = bDoSearch[1];
+            m_coop.bDoSearch[0] = e.bDoSearch[0];
+            m_coop.bDoSearch[1] = e.bDoSearch[1];
             m_jobTotal = m_lookahead.m_numCoopSlices;
             m_jobAcquired = 0;
             m_lock.release();
@@ -4225,36 +5081,11 @@ int64_t CostEstimateGroup::estimateFrameCost(LookaheadTLD& tld, int p0, int p1,
         }
         else
         {
-            /* Calculate MVs for 1/16th resolution*/
-            bool lastRow;
-            if (param->bEnableHME)
-            {
-                lastRow = true;
-                for (int cuY = m_lookahead.m_4x4Height - 1; cuY >= 0; cuY--)
-                {
-                    for (int cuX = m_lookahead.m_4x4Width - 1; cuX >= 0; cuX--)
-                        estimateCUCost(tld, cuX, cuY, p0, p1, b, bDoSearch, lastRow, -1, 1);
-                    lastRow = false;
-                }
-            }
-            lastRow = true;
-            for (int cuY = m_lookahead.m_8x8Height - 1; cuY >= 0; cuY--)
-            {
-                fenc->rowSatds[b - p0][p1 - b][cuY] = 0;
-
-                for (int cuX = m_lookahead.m_8x8Width - 1; cuX >= 0; cuX--)
-                    estimateCUCost(tld, cuX, cuY, p0, p1, b, bDoSearch, lastRow, -1, 0);
-
-                lastRow = false;
-            }
+            Estimate* est = &e;
+            estimateBlocks(tld, &est, 1);
         }
 
-        score = fenc->costEst[b - p0][p1 - b];
-
-        if (b != p1)
-            score = score * 100 / (130 + param->bFrameBias);
-
-        fenc->costEst[b - p0][p1 - b] = score;
+        score = finishEstimate(e);
     }
 
     if (bIntraPenalty)
@@ -4329,7 +5160,7 @@ void CostEstimateGroup::estimateCUCost(LookaheadTLD& tld, int cuX, int cuY, int
             if (cuX < widthInCU - 1)
                 MVC(fencMV[widthInCU + 1]);
         }
-        if (fenc->lowerResMvs[0][0] && !hme && fenc->lowerResMvCosts[i][listDist[i]][cuXY_4x4] > 0)
+        if (fenc->bEnableHME && !hme && fenc->lowerResMvCosts[i][listDist[i]][cuXY_4x4] > 0)
         {
             MVC((fenc->lowerResMvs[i][listDist[i]][cuXY_4x4]) * 2);
         }
@@ -31,6 +31,7 @@
 #include "piclist.h"
 #include "threadpool.h"
 #include "temporalfilter.h"
+#include "motionfield.h"
 
 namespace X265_NS {
 // private namespace
@@ -38,6 +39,7 @@ namespace X265_NS {
 struct Lowres;
 class Frame;
 class Lookahead;
+class CostEstimateGroup;
 
 #define LOWRES_COST_MASK  ((1 << 14) - 1)
 #define LOWRES_COST_SHIFT 14
@@ -63,13 +65,6 @@ class Lookahead;
 
 #define NUM64x64INPIC(w,h)                  ((w*h)>> (MAX_LOG2_CU_SIZE<<1))
 
-#if HIGH_BIT_DEPTH
-#define EDGE_THRESHOLD 1023.0
-#else
-#define EDGE_THRESHOLD 255.0
-#endif
-#define PI 3.14159265
-
 /* Thread local data for lookahead tasks */
 struct LookaheadTLD
 {
@@ -120,18 +115,8 @@ struct LookaheadTLD
         uint64_t *sumAverageIntensityCb,
         uint64_t *sumAverageIntensityCr);
 
-    void calculateHistogram(
-        pixel    *inputSrc,
-        uint32_t  inputWidth,
-        uint32_t  inputHeight,
-        intptr_t  stride,
-        uint8_t   dsFactor,
-        uint32_t *histogram,
-        uint64_t *sum);
-
     void computePictureStatistics(Frame *curFrame);
 
-    uint32_t calcVariance(pixel* src, intptr_t stride, intptr_t blockOffset, uint32_t plane);
 
     void calcAdaptiveQuantFrame(Frame *curFrame, x265_param* param);
     void calcFrameSegment(Frame *curFrame);
@@ -149,12 +134,102 @@ protected:
     bool     allocWeightedRef(Lowres& fenc);
 };
 
+/* cuTree propagation and VBV planning for one slicetypeAnalyse() window. The
+ * decide stage makes every cost estimate the plan needs and records the
+ * propagation steps along with the provisional frame types; runPlan() then
+ * does the work, possibly on another worker while slicetypeDecide() moves on
+ * to the next mini-GOP */
+struct LookaheadPlan
+{
+    enum { CLEAR, SWAP, COPY_AQ, PROPAGATE, FINISH };
+
+    struct Op
+    {
+        int8_t  type;
+        int8_t  referenced;
+        int16_t b;
+        int16_t p0;            // FINISH: ref0Distance, SWAP: other frame
+        int16_t p1;
+    };
+
+    Lowres* frames[X265_LOOKAHEAD_MAX + 2];
+    int     vbvTypes[X265_LOOKAHEAD_MAX + 2];
+    Op      ops[2 * X265_LOOKAHEAD_MAX + 8];
+    int     numOps;
+    int     numFrames;
+    bool    bKeyframe;
+    bool    bVbv;
+    int     numOutput;         // decided pictures held back until this plan has run
+
+    void add(int type, int b, int p0 = 0, int p1 = 0, int referenced = 0)
+    {
+        Op& op = ops[numOps++];
+        op.type = (int8_t)type;
+        op.referenced = (int8_t)referenced;
+        op.b = (int16_t)b;
+        op.p0 = (int16_t)p0;
+        op.p1 = (int16_t)p1;
+    }
+};
+
+#define LOOKAHEAD_PLANS 4
+
+#if DETAILED_CU_STATS
+/* work done by the cuTree propagation, for the CuTreeBench */
+struct CuTreeWork
+{
+    uint64_t steps;       // propagation steps applied, including steps taken back
+    uint64_t blocks;      // lowres blocks walked by the steps
+    uint64_t propagated;  // blocks which passed a non-zero amount to their references
+    int64_t  elapsed;     // microseconds spent running plans
+};
+#endif
+
+/* Throughput controller of --adaptive-lookahead. The API thread reports the
+ * wall-clock interval and the frame encoder idle time of every frame it hands
+ * to a frame encoder, the lookahead reports the occupancy of its input queue
+ * when a decision starts. Every ADAPT_INTERVAL frames the controller steps the
+ * lookahead window and the trellis depth down while the encoder is behind the
+ * target frame rate and back up while it has headroom. The lookahead slices go
+ * up while the frame encoders wait on the lookahead and down while they are
+ * busy. slicetypeDecide() adopts the requested setting at its next run */
+struct LookaheadThroughput
+{
+    enum { ADAPT_INTERVAL = 8, NUM_STEPS = 8 };
+
+    int64_t  targetFrameTime;  // microseconds per frame at the target frame rate
+    int64_t  lastFrame;        // x265_mdate() of the previous report
+    double   frameTime;        // running average of the frame interval
+    double   idle;             // running average of the frame encoder idle fraction
+    int      backlog;          // undecided input pictures beyond a full lookahead
+    int      frameThreads;
+    int      frames;           // reports since the last step
+    int      step;             // 0 is the configured setting, NUM_STEPS the cheapest
+
+    int      minDepth, maxDepth;
+    int      minTrellis, maxTrellis;
+    int      maxSlices;
+
+    /* the requested setting */
+    int      depth;
+    int      trellis;
+    int      slices;
+
+    uint32_t numChanges;
+    uint32_t numReducedFrames; // reports made while the window was below maxDepth
+    uint32_t numReports;
+
+    void     init(const x265_param& param, int numCoopSlices);
+    bool     update(int64_t now, int64_t idleTime);
+};
+
 class Lookahead : public JobProvider
 {
 public:
 
     PicList       m_inputQueue;      // input pictures in order received
     PicList       m_outputQueue;     // pictures to be encoded, in encode order
+    PicList       m_pendingQueue;    // decided pictures waiting on their cuTree plan
     Lock          m_inputLock;
     Lock          m_outputLock;
     Event         m_outputSignal;
@@ -162,6 +237,33 @@ public:
     x265_param*   m_param;
     Lowres*       m_lastNonB;
     int*          m_scratch;         // temp buffer for cutree propagate
+    double*       m_aqMotionScratch; // motion displacements of a frame, for --aq-motion
+    LowresTablePool m_tablePool;     // on demand cost and vector tables of the lowres pictures
+    MotionFieldCache m_mvFieldCache; // lookahead motion fields seeding MCSTF, --share-motion-fields
+    LookaheadThroughput m_throughput; // --adaptive-lookahead controller, guarded by m_inputLock
+#if DETAILED_CU_STATS
+    CuTreeWork    m_cuTreeWork;      // updated by the plan being run
+#endif
+
+    /* cuTree/VBV plans; a ring of LOOKAHEAD_PLANS when the propagate stage is
+     * pipelined, otherwise a single plan run at the end of slicetypeAnalyse() */
+    LookaheadPlan* m_plans;
+    int           m_planFirst;       // oldest queued plan
+    int           m_planQueued;      // plans handed to the propagate stage
+    int           m_planRecorded;    // plans made by the running slicetypeDecide()
+    int           m_pendingHeld;     // pictures of m_pendingQueue owned by queued plans
+
+    /* incremental cuTree; the signed propagate cost changes of each window
+     * position in the running plan and the frames whose last propagation
+     * step is still recorded in the propagate costs of others */
+    int32_t*      m_cuTreeDelta;
+    uint16_t*     m_cuTreeCost;      // one zero row, then the prior propagate costs of a frame
+    uint8_t       m_cuTreeState[X265_LOOKAHEAD_MAX + 2];
+    uint32_t      m_cuTreeSerial;
+    int           m_cuTreeMaxFrames;
+    int           m_numCuTreeTracked;
+    Lowres*       m_cuTreeTracked[X265_LOOKAHEAD_MAX + 2];
+    int           m_cuTreeTrackedNum[X265_LOOKAHEAD_MAX + 2];
 
     /* pre-lookahead */
     int           m_fullQueueSize;
@@ -172,6 +274,9 @@ public:
     int           m_cuCount;
     int           m_numCoopSlices;
     int           m_numRowsPerSlice;
+    int           m_batchGrain;      // estimates of one picture per batch job, --lookahead-batch
+    int           m_lookaheadDepth;  // window and trellis depth in use, --adaptive-lookahead
+    int           m_trellisDepth;    // lowers them below rc-lookahead and bframes
     int           m_inputCount;
     double        m_cuTreeStrength;
 
@@ -180,7 +285,14 @@ public:
     int           m_4x4Height;
 
     bool          m_isActive;
+    bool          m_bFailed;          // a cost estimate could not take its tables, the encode is aborted
+    bool          m_bTypesRead;       // slice types come from pass 1 stats or a lookahead file
     bool          m_sliceTypeBusy;
+    bool          m_propagateBusy;
+    bool          m_bPipelinedCuTree;
+    bool          m_bIncrementalCuTree;
+    bool          m_bShareMotionFields;
+    bool          m_bAdaptiveLookahead;
     bool          m_bAdaptiveQuant;
     bool          m_outputSignalRequired;
     bool          m_bBatchMotionSearch;
@@ -212,6 +324,8 @@ public:
     int64_t       m_preLookaheadElapsedTime;
     uint64_t      m_countSlicetypeDecide;
     uint64_t      m_countPreLookahead;
+    int64_t       m_cuTreeElapsedTime;
+    uint64_t      m_countCuTree;
     void          getWorkerStats(int64_t& batchElapsedTime, uint64_t& batchCount, int64_t& coopSliceElapsedTime, uint64_t& coopSliceCount);
 #endif
 
@@ -224,6 +338,7 @@ public:
     void    checkLookaheadQueue(int &frameCnt);
     void    flush();
     Frame*  getDecidedPicture();
+    void    reportThroughput(int64_t idleTime);
 
     void    getEstimatedPictureCost(Frame *pic);
     void    setLookaheadQueue();
@@ -236,6 +351,10 @@ protected:
 
     void    findJob(int workerThreadID);
     void    slicetypeDecide();
+    void    adoptThroughput();
+    void    setCoopSlices(int slices);
+    int     lookaheadDepth() const { return X265_MIN(m_param->lookaheadDepth, m_lookaheadDepth); }
+    int     trellisDepth() const   { return X265_MIN(m_param->bframes, m_trellisDepth); }
     void    slicetypeAnalyse(Lowres **frames, bool bKeyframe);
 
     /* called by slicetypeAnalyse() to make slice decisions */
@@ -245,21 +364,40 @@ protected:
     bool    histBasedScenecut(Lowres **frames, int p0, int p1, int numFrames);
     bool    detectHistBasedSceneChange(Lowres **frames, int p0, int p1, int p2);
 
-    void    slicetypePath(Lowres **frames, int length, char(*best_paths)[X265_LOOKAHEAD_MAX + 1]);
-    int64_t slicetypePathCost(Lowres **frames, char *path, int64_t threshold);
-    int64_t vbvFrameCost(Lowres **frames, int p0, int p1, int b);
-    void    vbvLookahead(Lowres **frames, int numFrames, int keyframes);
+    void    slicetypePath(Lowres **frames, int length, char(*best_paths)[X265_LOOKAHEAD_MAX + 1], int64_t *best_costs);
+    int64_t slicetypePathCost(CostEstimateGroup& estGroup, int cur_p, int next_p, int64_t cost, int64_t threshold);
+    void    batchPathCosts(Lowres **frames, int numFrames);
+    int64_t vbvFrameCost(Lowres **frames, const int *types, int p0, int p1, int b, bool bEstimate);
+    void    vbvLookahead(Lowres **frames, const int *types, int numFrames, int keyframes, bool bEstimate);
     void    aqMotion(Lowres **frames, bool bintra);
     void    calcMotionAdaptiveQuantFrame(Lowres **frames, int p0, int p1, int b);
     /* called by slicetypeAnalyse() to effect cuTree adjustments to adaptive
      * quant offsets */
-    void    cuTree(Lowres **frames, int numframes, bool bintra);
+    void    cuTree(Lowres **frames, int numframes, bool bintra, LookaheadPlan& plan);
     void    estimateCUPropagate(Lowres **frames, double average_duration, int p0, int p1, int b, int referenced);
     void    cuTreeFinish(Lowres *frame, double averageDuration, int ref0Distance);
     void    computeCUTreeQpOffset(Lowres *frame, double averageDuration, int ref0Distance);
 
+    /* called by runPlan() to carry out the cuTree steps of a plan incrementally */
+    void    cuTreeIncremental(LookaheadPlan& plan, double averageDuration);
+    void    addCUPropagate(Lowres *frame, Lowres* const refs[2], const int refIdx[2], const int listDist[2],
+                           const uint16_t *propagateIn, const int32_t *deltaIn, int referenced, int sign, double fpsFactor);
+    int32_t* cuTreeDelta(int idx);
+#if CHECKED_BUILD
+    void    verifyCuTreeIncremental(LookaheadPlan& plan, double averageDuration);
+#endif
+
     /* called by getEstimatedPictureCost() to finalize cuTree costs */
-    int64_t frameCostRecalculate(Lowres **frames, int p0, int p1, int b);
+    int64_t frameCostRecalculate(Lowres **frames, int type, int p0, int p1, int b);
+
+    /* the staged cuTree/VBV planning: a plan is begun and filled in by the
+     * decide stage and run either immediately or by the propagate stage */
+    LookaheadPlan& beginPlan(Lowres **frames, int numFrames, bool bKeyframe);
+    void    planVbv(LookaheadPlan& plan);
+    void    endPlan(LookaheadPlan& plan);
+    void    runPlan(LookaheadPlan& plan);
+    void    cuTreeSteps(LookaheadPlan& plan, double averageDuration);
+    void    queueDecided();
     /*Compute index for positioning B-Ref frames*/
     void     placeBref(Frame** frames, int start, int end, int num, int *brefs);
     void     compCostBref(Lowres **frame, int start, int end, int num);
@@ -289,7 +427,7 @@ public:
     Lowres**   m_frames;
     bool       m_batchMode;
 
-    CostEstimateGroup(Lookahead& l, Lowres** f) : m_lookahead(l), m_frames(f), m_batchMode(false) {}
+    CostEstimateGroup(Lookahead& l, Lowres** f) : m_lookahead(l), m_frames(f), m_batchMode(false), m_numEstimates(0) {}
 
     /* Cooperative cost estimate using multiple slices of downscaled frame */
     struct Coop
@@ -308,13 +446,26 @@ public:
 
     int64_t singleCost(int p0, int p1, int b, bool intraPenalty = false);
 
-    /* Batch cost estimates, using one worker thread per estimateFrameCost() call */
+    /* Batch cost estimates. Consecutive estimates of the same picture are
+     * grouped into one job of up to m_batchGrain estimates, which walks the
+     * lowres blocks once and evaluates every estimate of the group on a block
+     * while its source pixels are cached */
     enum { MAX_BATCH_SIZE = 512 };
+    enum { MAX_BATCH_GROUP = 8 };
     struct Estimate
     {
         int  p0, b, p1;
+        bool bDoSearch[2];
     } m_estimates[MAX_BATCH_SIZE];
 
+    struct Group
+    {
+        int  first, count;
+        bool bMcstf;      // MCSTF motion search, always alone in its group
+    } m_groups[MAX_BATCH_SIZE];
+
+    int  m_numEstimates;
+
     void add(int p0, int p1, int b);
     void finishBatch();
 
@@ -325,9 +476,14 @@ protected:
     void    processTasks(int workerThreadID);
 
     int64_t estimateFrameCost(LookaheadTLD& tld, int p0, int p1, int b, bool intraPenalty);
+    bool    prepareEstimate(LookaheadTLD& tld, Estimate& e);
+    void    estimateBlocks(LookaheadTLD& tld, Estimate** est, int count);
+    int64_t finishEstimate(Estimate& e);
+    bool    isMcstfSearch(const Estimate& e);
     void    estimateCUCost(LookaheadTLD& tld, int cux, int cuy, int p0, int p1, int b, bool bDoSearch[2], bool lastRow, int slice, bool hme);
 
     void    estimatelowresmotion(MotionEstimatorTLD& m_metld, Frame* curframe, int refId);
+    void    shareMotionFields(int p0, int p1, int b, bool bDoSearch[2]);
 
     CostEstimateGroup& operator=(const CostEstimateGroup&);
 };
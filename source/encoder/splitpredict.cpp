@@ -0,0 +1,110 @@
+/*****************************************************************************
+ * Copyright (C) 2013-2020 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+
+#include "common.h"
+#include "splitpredict.h"
+
+#include <math.h>
+
+using namespace X265_NS;
+
+namespace {
+/* decisions of a CU size the model must have seen before it predicts */
+const uint32_t SPLIT_MIN_SAMPLES = 64;
+
+/* decisions of a CU size kept by the model, beyond this the counts are
+ * halved so the model follows changes of content */
+const uint32_t SPLIT_MAX_SAMPLES = 16384;
+}
+
+void SplitStats::add(int size, const uint8_t* features, bool bSplit)
+{
+    count[size][bSplit]++;
+    for (int f = 0; f < NUM_FEATURES; f++)
+        bins[size][f][features[f]][bSplit]++;
+}
+
+void SplitStats::add(const SplitStats& other)
+{
+    for (int s = 0; s < NUM_SIZES; s++)
+    {
+        for (int c = 0; c < 2; c++)
+            count[s][c] += other.count[s][c];
+        for (int f = 0; f < NUM_FEATURES; f++)
+            for (int b = 0; b < NUM_BINS; b++)
+                for (int c = 0; c < 2; c++)
+                    bins[s][f][b][c] += other.bins[s][f][b][c];
+        for (int p = 0; p < 2; p++)
+            for (int c = 0; c < 2; c++)
+                checked[s][p][c] += other.checked[s][p][c];
+    }
+}
+
+void SplitModel::update(const SplitStats& frame)
+{
+    stats.add(frame);
+
+    for (int s = 0; s < SplitStats::NUM_SIZES; s++)
+    {
+        if (stats.count[s][0] + stats.count[s][1] <= SPLIT_MAX_SAMPLES)
+            continue;
+
+        for (int c = 0; c < 2; c++)
+            stats.count[s][c] >>= 1;
+        for (int f = 0; f < SplitStats::NUM_FEATURES; f++)
+            for (int b = 0; b < SplitStats::NUM_BINS; b++)
+                for (int c = 0; c < 2; c++)
+                    stats.bins[s][f][b][c] >>= 1;
+        for (int p = 0; p < 2; p++)
+            for (int c = 0; c < 2; c++)
+                stats.checked[s][p][c] >>= 1;
+    }
+}
+
+int SplitModel::predict(int size, const uint8_t* features, double threshold) const
+{
+    uint32_t notSplit = stats.count[size][0];
+    uint32_t split = stats.count[size][1];
+    if (notSplit + split < SPLIT_MIN_SAMPLES)
+        return -1;
+
+    /* log odds of the prior and of each feature, with Laplace smoothing */
+    double logOdds = log((split + 1.0) / (notSplit + 1.0));
+    for (int f = 0; f < SplitStats::NUM_FEATURES; f++)
+    {
+        const uint32_t* bin = stats.bins[size][f][features[f]];
+        logOdds += log((bin[1] + 1.0) / (split + SplitStats::NUM_BINS)) -
+                   log((bin[0] + 1.0) / (notSplit + SplitStats::NUM_BINS));
+    }
+
+    double probability = 1.0 / (1.0 + exp(-logOdds));
+    if (probability >= threshold)
+        return 1;
+    if (1 - probability >= threshold)
+        return 0;
+    return -1;
+}
+
+bool SplitModel::trusted(int size, int prediction, double threshold) const
+{
+    const uint32_t* checked = stats.checked[size][prediction];
+    return (checked[1] + 1.0) / (checked[0] + checked[1] + 2.0) >= threshold;
+}
@@ -0,0 +1,82 @@
+/*****************************************************************************
+ * Copyright (C) 2013-2020 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+
+#ifndef X265_SPLITPREDICT_H
+#define X265_SPLITPREDICT_H
+
+#include "common.h"
+
+namespace X265_NS {
+// private x265 namespace
+
+/* Split decisions of analysed CUs, counted per CU size (16, 32 and 64) and
+ * per quantized feature, and how often the confident predictions made in
+ * training CTUs were right. Each CTU row of a frame keeps its own counts */
+struct SplitStats
+{
+    enum
+    {
+        NUM_SIZES = 3,
+        NUM_BINS = 10,
+
+        FEATURE_INTRA_COST = 0, // lowres intra cost of the CU area
+        FEATURE_QP_OFFSET,      // cuTree or AQ QP offset
+        FEATURE_NEIGHBOURS,     // left and above CTU depths against the CU depth
+        FEATURE_VARIANCE,       // AC energy of the CU area
+        FEATURE_MOTION,         // lowres L0 vector length
+        FEATURE_BEST_MODE,      // skip or cost of the best mode at the CU depth
+        NUM_FEATURES
+    };
+
+    uint32_t count[NUM_SIZES][2];
+    uint32_t bins[NUM_SIZES][NUM_FEATURES][NUM_BINS][2];
+    uint32_t checked[NUM_SIZES][2][2]; // [predicted split][prediction right]
+
+    void reset() { memset(this, 0, sizeof(*this)); }
+
+    void add(int size, const uint8_t* features, bool bSplit);
+    void check(int size, bool bPredictedSplit, bool bSplit) { checked[size][bPredictedSplit][bPredictedSplit == bSplit]++; }
+    void add(const SplitStats& other);
+};
+
+/* Naive Bayes split classifier of one slice type, trained online with the
+ * split decisions of previously encoded frames */
+struct SplitModel
+{
+    SplitStats stats;
+
+    void reset() { stats.reset(); }
+
+    /* adds the decisions of an encoded frame, older decisions fade out */
+    void update(const SplitStats& frame);
+
+    /* 1 if a CU of this size and these features is split with at least the
+     * given probability, 0 if it is not split with that probability, else -1 */
+    int predict(int size, const uint8_t* features, double threshold) const;
+
+    /* whether the checked predictions of this size and side were right as
+     * often as the threshold asks; Naive Bayes is overconfident when its
+     * features are correlated, so only trusted predictions are acted on */
+    bool trusted(int size, int prediction, double threshold) const;
+};
+}
+
+#endif // ifndef X265_SPLITPREDICT_H
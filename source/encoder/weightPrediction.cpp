@@ -325,7 +325,7 @@ void weightAnalyse(Slice& slice, Frame& frame, x265_param& param)
                 mvs = fenc.lowresMvs[list][diffPoc];
 
                 /* test whether this motion search was performed by lookahead */
-                if (mvs[0].x != 0x7FFF)
+                if (mvs)
                 {
                     /* reference chroma planes must be extended prior to being
                      * used as motion compensation sources */
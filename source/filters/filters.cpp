@@ -29,6 +29,9 @@
 
 using namespace X265_NS;
 
+/* row and plane alignment of the frames passed between pipelined filters */
+#define FILTER_ALIGN 64
+
 bool Filter::parseFilterString(char* paramString, vector<Filter *>* filters)
 {
     // --vf func1:param1/func2:param2
@@ -72,3 +75,295 @@ bool Filter::parseFilterString(char* paramString, vector<Filter *>* filters)
     }
     return false;
 }
+
+bool FilterPipeline::isSupported(vector<Filter*>& filters)
+{
+    for (auto &&f : filters)
+        if (!f->isFrameParallel())
+            return false;
+    return !filters.empty();
+}
+
+FilterPipeline::FilterPipeline(vector<Filter*>& filters, int threads, const x265_api* api, x265_encoder* encoder)
+    : m_filters(filters)
+{
+    m_api = api;
+    m_encoder = encoder;
+    m_numWorkers = (uint32_t)x265_clip3(1, (int)MAX_THREADS, threads);
+    /* one frame waiting to be popped and one being pushed besides those the
+     * workers are filtering */
+    m_depth = m_numWorkers + 2;
+    m_workers = NULL;
+    m_jobs = NULL;
+    m_bInit = false;
+    m_bStopped = false;
+    m_popped = 0;
+    m_submitted = 0;
+    m_nextJob = 0;
+    m_stopJob = INT_MAX;
+}
+
+FilterPipeline::~FilterPipeline()
+{
+    stopWorkers();
+    for (uint32_t i = 0; m_workers && i < m_numWorkers; i++)
+        X265_FREE(m_workers[i].m_tmp);
+    delete [] m_workers;
+    for (uint32_t i = 0; m_jobs && i < m_depth; i++)
+    {
+        X265_FREE(m_jobs[i].srcBuf);
+        for (size_t k = 0; k < m_filters.size(); k++)
+            X265_FREE(m_jobs[i].stageBuf[k]);
+        delete [] m_jobs[i].stage;
+        delete [] m_jobs[i].stageBuf;
+    }
+    delete [] m_jobs;
+}
+
+/* Lay out the planes of pic contiguously from buf, with every row aligned
+ * for SIMD filters. Returns the size of the frame */
+size_t FilterPipeline::layoutPlanes(x265_picture& pic, char* buf)
+{
+    int pixelbytes = pic.bitDepth > 8 ? 2 : 1;
+    size_t size = 0;
+    for (int i = 0; i < x265_cli_csps[pic.colorSpace].planes; i++)
+    {
+        pic.stride[i] = (((pic.width >> x265_cli_csps[pic.colorSpace].width[i]) * pixelbytes) + FILTER_ALIGN - 1) & ~(FILTER_ALIGN - 1);
+        pic.planes[i] = buf ? buf + size : NULL;
+        size += (size_t)pic.stride[i] * (pic.height >> x265_cli_csps[pic.colorSpace].height[i]);
+    }
+    pic.framesize = size;
+    return size;
+}
+
+bool FilterPipeline::init(const x265_picture& pic)
+{
+    m_bInit = true;
+
+    size_t numFilters = m_filters.size();
+    vector<x265_picture> format(numFilters);
+    const x265_picture* in = &pic;
+    size_t tmpSize = 1;
+    for (size_t k = 0; k < numFilters; k++)
+    {
+        format[k] = *in;
+        if (!m_filters[k]->initFormat(*in, format[k]))
+            return false;
+        tmpSize = X265_MAX(tmpSize, m_filters[k]->tmpSize());
+        in = &format[k];
+    }
+
+    if (m_encoder)
+    {
+        /* the last filter may write in place only if the encoder's pictures
+         * have the output format and the plane alignment the filter needs */
+        const x265_picture& out = format[numFilters - 1];
+        intptr_t align = m_filters[numFilters - 1]->alignment();
+        x265_picture* probe = m_api->encoder_get_input_buffer(m_encoder);
+        bool match = probe && probe->width == out.width && probe->height == out.height &&
+                     probe->colorSpace == out.colorSpace && probe->bitDepth == out.bitDepth;
+        for (int i = 0; match && i < x265_cli_csps[out.colorSpace].planes; i++)
+            match = !((intptr_t)probe->planes[i] % align) && !(probe->stride[i] % align);
+        if (probe)
+            m_api->encoder_release_input_buffer(m_encoder, probe);
+        if (!match)
+            m_encoder = NULL;
+    }
+
+    m_jobs = new Job[m_depth];
+    for (uint32_t i = 0; i < m_depth; i++)
+    {
+        Job& job = m_jobs[i];
+        job.srcBuf = NULL;
+        job.srcAlloc = 0;
+        job.encPic = NULL;
+        job.bOk = false;
+        job.stage = new x265_picture[numFilters];
+        job.stageBuf = new char*[numFilters];
+        for (size_t k = 0; k < numFilters; k++)
+        {
+            job.stage[k] = format[k];
+            job.stageBuf[k] = NULL;
+        }
+    }
+    for (uint32_t i = 0; i < m_depth; i++)
+    {
+        Job& job = m_jobs[i];
+        for (size_t k = 0; k < numFilters; k++)
+        {
+            if (k + 1 == numFilters && m_encoder)
+                continue;
+            job.stageBuf[k] = X265_MALLOC(char, layoutPlanes(job.stage[k], NULL));
+            if (!job.stageBuf[k])
+            {
+                x265_log(NULL, X265_LOG_ERROR, "filter pipeline: buffer allocation failure\n");
+                return false;
+            }
+            layoutPlanes(job.stage[k], job.stageBuf[k]);
+        }
+    }
+
+    m_workers = new Worker[m_numWorkers];
+    for (uint32_t i = 0; i < m_numWorkers; i++)
+    {
+        m_workers[i].m_pipeline = this;
+        m_workers[i].m_id = i;
+        m_workers[i].m_tmp = X265_MALLOC(char, tmpSize);
+    }
+    for (uint32_t i = 0; i < m_numWorkers; i++)
+    {
+        if (!m_workers[i].m_tmp || !m_workers[i].start())
+        {
+            x265_log(NULL, X265_LOG_ERROR, "filter pipeline: unable to start worker threads\n");
+            m_numWorkers = i;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool FilterPipeline::push(const x265_picture& pic)
+{
+    if (!m_bInit && !init(pic))
+        return false;
+    if (!m_workers || m_bStopped)
+        return false;
+
+    /* the source planes belong to the input reader, which reuses them long
+     * before a worker may get to this frame */
+    Job& job = m_jobs[m_submitted % m_depth];
+    job.src = pic;
+    size_t size = layoutPlanes(job.src, NULL);
+    if (size > job.srcAlloc)
+    {
+        X265_FREE(job.srcBuf);
+        job.srcBuf = X265_MALLOC(char, size);
+        job.srcAlloc = job.srcBuf ? size : 0;
+        if (!job.srcBuf)
+            return false;
+    }
+    layoutPlanes(job.src, job.srcBuf);
+
+    int pixelbytes = pic.bitDepth > 8 ? 2 : 1;
+    for (int i = 0; i < x265_cli_csps[pic.colorSpace].planes; i++)
+    {
+        size_t rowBytes = (size_t)(pic.width >> x265_cli_csps[pic.colorSpace].width[i]) * pixelbytes;
+        int rows = pic.height >> x265_cli_csps[pic.colorSpace].height[i];
+        const char* src = (const char*)pic.planes[i];
+        char* dst = (char*)job.src.planes[i];
+        for (int y = 0; y < rows; y++, src += pic.stride[i], dst += job.src.stride[i])
+            memcpy(dst, src, rowBytes);
+    }
+
+    if (m_encoder)
+    {
+        job.encPic = m_api->encoder_get_input_buffer(m_encoder);
+        if (!job.encPic)
+            return false;
+        x265_picture& out = job.stage[m_filters.size() - 1];
+        memcpy(out.planes, job.encPic->planes, sizeof(out.planes));
+        memcpy(out.stride, job.encPic->stride, sizeof(out.stride));
+    }
+
+    m_submitted++;
+    m_jobsReady.incr();
+    return true;
+}
+
+bool FilterPipeline::pop(x265_picture& pic)
+{
+    if (isEmpty())
+        return false;
+
+    int seq = m_popped++;
+    Job& job = m_jobs[seq % m_depth];
+    int done = job.done.get();
+    while (done != seq + 1)
+        done = job.done.waitForChange(done);
+
+    if (!job.bOk)
+    {
+        if (job.encPic)
+            m_api->encoder_release_input_buffer(m_encoder, job.encPic);
+        job.encPic = NULL;
+        return false;
+    }
+
+    const x265_picture& out = job.stage[m_filters.size() - 1];
+    pic = job.src;
+    pic.width = out.width;
+    pic.height = out.height;
+    pic.bitDepth = out.bitDepth;
+    pic.colorSpace = out.colorSpace;
+    pic.framesize = out.framesize;
+    memcpy(pic.planes, out.planes, sizeof(pic.planes));
+    memcpy(pic.stride, out.stride, sizeof(pic.stride));
+    job.encPic = NULL;  // now owned by the caller
+    return true;
+}
+
+int FilterPipeline::claimJob()
+{
+    int ready = m_jobsReady.get();
+    for (;;)
+    {
+        {
+            ScopedLock lock(m_claimLock);
+            if (m_nextJob < ready)
+            {
+                int seq = m_nextJob++;
+                return seq < m_stopJob ? seq : -1;
+            }
+        }
+        ready = m_jobsReady.waitForChange(ready);
+    }
+}
+
+void FilterPipeline::stopWorkers()
+{
+    if (m_bStopped || !m_workers)
+        return;
+
+    /* every worker claims one of these past the last real job and exits */
+    {
+        ScopedLock lock(m_claimLock);
+        m_stopJob = m_submitted;
+    }
+    for (uint32_t i = 0; i < m_numWorkers; i++)
+        m_jobsReady.incr();
+    for (uint32_t i = 0; i < m_numWorkers; i++)
+        m_workers[i].stop();
+    m_bStopped = true;
+}
+
+void FilterPipeline::releaseEncoderBuffers()
+{
+    stopWorkers();
+    for (; m_popped < m_submitted; m_popped++)
+    {
+        Job& job = m_jobs[m_popped % m_depth];
+        if (job.encPic)
+            m_api->encoder_release_input_buffer(m_encoder, job.encPic);
+        job.encPic = NULL;
+    }
+}
+
+void FilterPipeline::Worker::threadMain()
+{
+    THREAD_NAME("Filter", m_id);
+
+    FilterPipeline& p = *m_pipeline;
+    for (int seq = p.claimJob(); seq >= 0; seq = p.claimJob())
+    {
+        Job& job = p.m_jobs[seq % p.m_depth];
+        const x265_picture* in = &job.src;
+        job.bOk = true;
+        for (size_t k = 0; k < p.m_filters.size() && job.bOk; k++)
+        {
+            job.bOk = p.m_filters[k]->filterFrame(*in, job.stage[k], m_tmp);
+            in = &job.stage[k];
+        }
+        job.done.set(seq + 1);
+    }
+}
@@ -26,6 +26,7 @@
  
 #include "x265.h"
 #include "common.h"
+#include "threading.h"
 #include "cstring"
 #include "cstdio"
 #include <vector>
@@ -43,6 +44,100 @@ public:
     virtual bool isFail() const = 0;
     virtual void release() = 0;
     virtual void processFrame(x265_picture&) = 0;
+
+    /* Frame parallel interface used by FilterPipeline. initFormat() is called
+     * once with the first input picture and fills in the width, height,
+     * bitDepth and colorSpace of the output. filterFrame() may then run on
+     * several threads at once, each with its own tmp buffer of tmpSize()
+     * bytes, and writes into the planes the caller set up in dst */
+    virtual bool isFrameParallel() const { return false; }
+    virtual bool initFormat(const x265_picture&, x265_picture&) { return false; }
+    virtual size_t tmpSize() const { return 0; }
+    virtual int alignment() const { return 1; } // of dst planes and strides
+    virtual bool filterFrame(const x265_picture&, x265_picture&, void*) { return false; }
+};
+
+/* Runs a chain of frame parallel filters on several frames in flight across
+ * worker threads. Frames are pushed and popped in display order by a single
+ * caller; when an encoder is given and its input buffers match the output
+ * format, the last filter writes straight into encoder owned pictures, see
+ * x265_encoder_get_input_buffer() */
+class FilterPipeline
+{
+public:
+
+    enum { MAX_THREADS = 64 };
+
+    /* threads is clamped to 1..MAX_THREADS */
+    FilterPipeline(vector<Filter*>& filters, int threads, const x265_api* api, x265_encoder* encoder);
+    ~FilterPipeline();
+
+    static bool isSupported(vector<Filter*>& filters);
+
+    bool isFull() const          { return (uint32_t)(m_submitted - m_popped) >= m_depth; }
+    bool isEmpty() const         { return m_submitted == m_popped; }
+
+    /* true once the first push found the encoder's buffers usable */
+    bool usesEncoderBuffers() const { return m_bInit && m_encoder; }
+
+    /* queue a copy of pic for filtering, the pipeline must not be full */
+    bool push(const x265_picture& pic);
+
+    /* wait for the oldest frame and return it in pic. Returns false when
+     * nothing is queued or filtering failed. When usesEncoderBuffers(), the
+     * planes are those of an encoder input picture that now belongs to the
+     * caller; otherwise they are pipeline buffers valid until the next push */
+    bool pop(x265_picture& pic);
+
+    /* stop the workers and give back the encoder pictures of frames not yet
+     * popped */
+    void releaseEncoderBuffers();
+
+protected:
+
+    class Worker : public Thread
+    {
+    public:
+        FilterPipeline* m_pipeline;
+        int             m_id;
+        void*           m_tmp;
+
+        void threadMain();
+    };
+
+    struct Job
+    {
+        x265_picture      src;
+        char*             srcBuf;
+        size_t            srcAlloc;
+        x265_picture*     stage;      // output of each filter
+        char**            stageBuf;
+        x265_picture*     encPic;     // output of the last filter when writing to the encoder
+        bool              bOk;
+        ThreadSafeInteger done;       // sequence number + 1 once filtered
+    };
+
+    vector<Filter*>   m_filters;
+    const x265_api*   m_api;
+    x265_encoder*     m_encoder;
+    Worker*           m_workers;
+    uint32_t          m_numWorkers;
+    Job*              m_jobs;
+    uint32_t          m_depth;
+    bool              m_bInit;
+    bool              m_bStopped;
+    int               m_popped;
+    int               m_submitted;    // written only by the caller, published through m_jobsReady
+    int               m_nextJob;      // next job to be claimed by a worker
+    int               m_stopJob;      // jobs from here on tell the workers to exit, guarded by m_claimLock
+    Lock              m_claimLock;
+    ThreadSafeInteger m_jobsReady;
+
+    bool init(const x265_picture& pic);
+    int  claimJob();
+    void stopWorkers();
+
+    static size_t layoutPlanes(x265_picture& pic, char* buf);
 };
 }
 
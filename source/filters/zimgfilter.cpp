@@ -65,8 +65,10 @@ ZimgFilter::ZimgFilter(char* paramString)
     param1 = param2 = NAN;
     bFail = false;
     graph = NULL;
+    planes_all = NULL;
     planes[0] = NULL;
     temp = NULL;
+    tempSize = 0;
 
     char* begin = paramString;
     char* end = paramString + strlen(paramString);
@@ -234,6 +236,52 @@ void ZimgFilter::setParam(x265_param* xParam)
     graph_params.filter_param_b = param2;
 }
 
+/* Build the zimg graph for the format of the first picture */
+bool ZimgFilter::buildGraph(const x265_picture& picture)
+{
+    char fail_str[1024];
+    int OutputDepth = X265_DEPTH;
+    src_format.depth = picture.bitDepth;
+    dst_format.depth = OutputDepth;
+    src_format.pixel_type = picture.bitDepth > 8 ? ZIMG_PIXEL_WORD : ZIMG_PIXEL_BYTE;
+    dst_format.pixel_type = OutputDepth > 8 ? ZIMG_PIXEL_WORD : ZIMG_PIXEL_BYTE;
+
+    switch (picture.colorSpace)
+    {
+    case X265_CSP_BGR:
+    case X265_CSP_BGRA:
+    case X265_CSP_RGB:
+        src_format.color_family = dst_format.color_family = ZIMG_COLOR_RGB;
+        break;
+    case X265_CSP_I400:
+        src_format.color_family = dst_format.color_family = ZIMG_COLOR_GREY;
+        break;
+    default:
+        src_format.color_family = dst_format.color_family = ZIMG_COLOR_YUV;
+        break;
+    }
+    src_format.pixel_range =
+    dst_format.pixel_range = xp->vui.bEnableVideoFullRangeFlag ? ZIMG_RANGE_FULL : ZIMG_RANGE_LIMITED;
+
+    graph = zimg_filter_graph_build(&src_format, &dst_format, &graph_params);
+    if (!graph)
+    {
+        zimg_get_last_error(fail_str, sizeof(fail_str));
+        general_log(NULL, "zimg", X265_LOG_ERROR, "Init: %s\n", fail_str);
+        bFail = true;
+        return false;
+    }
+    // Size of the temp buffer
+    if (zimg_filter_graph_get_tmp_size(graph, &tempSize))
+    {
+        zimg_get_last_error(fail_str, sizeof(fail_str));
+        general_log(NULL, "zimg", X265_LOG_ERROR, "Init: %s\n", fail_str);
+        bFail = true;
+        return false;
+    }
+    return true;
+}
+
 void ZimgFilter::processFrame(x265_picture& picture)
 {
     if (byPass) return;
@@ -244,29 +292,10 @@ void ZimgFilter::processFrame(x265_picture& picture)
     int OutputDepth = X265_DEPTH;
     if (!graph) // Init
     {
-        int pixelSize = OutputDepth > 8 ? 2 : 1;
-        src_format.depth = picture.bitDepth;
-        dst_format.depth = OutputDepth;
-        src_format.pixel_type = picture.bitDepth > 8 ? ZIMG_PIXEL_WORD : ZIMG_PIXEL_BYTE;
-        dst_format.pixel_type = OutputDepth > 8 ? ZIMG_PIXEL_WORD : ZIMG_PIXEL_BYTE;
-
-        switch (picture.colorSpace)
-        {
-        case X265_CSP_BGR:
-        case X265_CSP_BGRA:
-        case X265_CSP_RGB:
-            src_format.color_family = dst_format.color_family = ZIMG_COLOR_RGB;
-            break;
-        case X265_CSP_I400:
-            src_format.color_family = dst_format.color_family = ZIMG_COLOR_GREY;
-            break;
-        default:
-            src_format.color_family = dst_format.color_family = ZIMG_COLOR_YUV;
-            break;
-        }
-        src_format.pixel_range =
-        dst_format.pixel_range = xp->vui.bEnableVideoFullRangeFlag ? ZIMG_RANGE_FULL : ZIMG_RANGE_LIMITED;
+        if (!buildGraph(picture))
+            return;
 
+        int pixelSize = OutputDepth > 8 ? 2 : 1;
         framesize = 0;
         auto stride_all = round_up_64(rWidth * pixelSize);
         planes_all = x265_malloc(rHeight * stride_all * x265_cli_csps[csp].planes);
@@ -282,25 +311,8 @@ void ZimgFilter::processFrame(x265_picture& picture)
             framesize += h * stride[i];
         }
 
-        graph = zimg_filter_graph_build(&src_format, &dst_format, &graph_params);
-        if (!graph)
-        {
-            zimg_get_last_error(fail_str, sizeof(fail_str));
-            general_log(NULL, "zimg", X265_LOG_ERROR, "Init: %s\n", fail_str);
-            bFail = true;
-            return;
-        }
         // Create temp buffer
-        size_t tmp_size;
-        err = zimg_filter_graph_get_tmp_size(graph, &tmp_size);
-        if (err)
-        {
-            zimg_get_last_error(fail_str, sizeof(fail_str));
-            general_log(NULL, "zimg", X265_LOG_ERROR, "Init: %s\n", fail_str);
-            bFail = true;
-            return;
-        }
-        temp = x265_malloc(tmp_size);
+        temp = x265_malloc(tempSize);
         if (!temp)
         {
             general_log(NULL, "zimg", X265_LOG_ERROR, "Init: error allocating memory for temp buffer\n");
@@ -339,6 +351,67 @@ void ZimgFilter::processFrame(x265_picture& picture)
     picture.framesize = framesize;
 }
 
+bool ZimgFilter::initFormat(const x265_picture& in, x265_picture& out)
+{
+    if (bFail)
+        return false;
+    out.colorSpace = in.colorSpace;
+    if (byPass)
+    {
+        out.width = in.width;
+        out.height = in.height;
+        out.bitDepth = in.bitDepth;
+        return true;
+    }
+    if (!graph && !buildGraph(in))
+        return false;
+    out.width = rWidth;
+    out.height = rHeight;
+    out.bitDepth = X265_DEPTH;
+    return true;
+}
+
+bool ZimgFilter::filterFrame(const x265_picture& in, x265_picture& out, void* tmp)
+{
+    if (byPass)
+    {
+        int pixelbytes = in.bitDepth > 8 ? 2 : 1;
+        for (int i = 0; i < x265_cli_csps[in.colorSpace].planes; i++)
+        {
+            size_t rowBytes = (size_t)(in.width >> x265_cli_csps[in.colorSpace].width[i]) * pixelbytes;
+            int rows = in.height >> x265_cli_csps[in.colorSpace].height[i];
+            const char* src = (const char*)in.planes[i];
+            char* dst = (char*)out.planes[i];
+            for (int y = 0; y < rows; y++, src += in.stride[i], dst += out.stride[i])
+                memcpy(dst, src, rowBytes);
+        }
+        return true;
+    }
+
+    zimg_image_buffer_const src_buf = { ZIMG_API_VERSION };
+    zimg_image_buffer dst_buf = { ZIMG_API_VERSION };
+
+    for (int i = 0; i < x265_cli_csps[csp].planes; i++)
+    {
+        src_buf.plane[i].data = in.planes[i];
+        src_buf.plane[i].stride = in.stride[i];
+        src_buf.plane[i].mask = ZIMG_BUFFER_MAX;
+        dst_buf.plane[i].data = out.planes[i];
+        dst_buf.plane[i].stride = out.stride[i];
+        dst_buf.plane[i].mask = ZIMG_BUFFER_MAX;
+    }
+
+    if (zimg_filter_graph_process(graph, &src_buf, &dst_buf, tmp, 0, 0, 0, 0))
+    {
+        char fail_str[1024];
+        zimg_get_last_error(fail_str, sizeof(fail_str));
+        general_log(NULL, "zimg", X265_LOG_ERROR, "Resize: %s\n", fail_str);
+        bFail = true;
+        return false;
+    }
+    return true;
+}
+
 void ZimgFilter::release()
 {
     if (temp)
@@ -30,6 +30,9 @@
 #include <cmath>
 #include <cstring>
 
+/* zimg requires image and temp buffers aligned for its widest SIMD */
+#define ZIMG_BUFFER_ALIGN 64
+
 namespace X265_NS {
 
 class ZimgFilter : public Filter
@@ -61,7 +64,9 @@ protected:
     void* planes_all;
     void* planes[3];
     void* temp;
+    size_t tempSize;
     int framesize;
+    bool buildGraph(const x265_picture&);
 public:
     ZimgFilter(char*);
     ~ZimgFilter() {}
@@ -69,6 +74,14 @@ public:
     bool isFail() const { return bFail; }
     void release();
     void processFrame(x265_picture&);
+
+    /* the graph is read-only once built, so frames may be processed
+     * concurrently as long as each thread brings its own temp buffer */
+    bool isFrameParallel() const { return true; }
+    bool initFormat(const x265_picture&, x265_picture&);
+    size_t tmpSize() const { return tempSize; }
+    int alignment() const { return ZIMG_BUFFER_ALIGN; }
+    bool filterFrame(const x265_picture&, x265_picture&, void*);
 };
 }
 //class Resize
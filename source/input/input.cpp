@@ -73,3 +73,44 @@ InputFile* InputFile::open(InputFileInfo& info, bool bForceY4m, bool alpha, int
 #endif
     return new YUVInput(info, alpha, format);
 }
+
+/* A picture from x265_encoder_get_input_buffer() can be filled in place only if
+ * the file's samples need no conversion to the encoder's internal format */
+bool InputFile::matchesEncoderBuffer(const x265_picture& pic, int width, int height, int csp, int depth)
+{
+    return pic.width == width && pic.height == height && pic.colorSpace == csp && pic.bitDepth == depth;
+}
+
+/* Read one planar frame from the file straight into the strided planes of pic */
+bool InputFile::readPlanes(FILE* ifs, x265_picture& pic)
+{
+    int pixelbytes = pic.bitDepth > 8 ? 2 : 1;
+    for (int i = 0; i < x265_cli_csps[pic.colorSpace].planes; i++)
+    {
+        size_t rowBytes = (size_t)(pic.width >> x265_cli_csps[pic.colorSpace].width[i]) * pixelbytes;
+        int rows = pic.height >> x265_cli_csps[pic.colorSpace].height[i];
+        char* row = (char*)pic.planes[i];
+        for (int y = 0; y < rows; y++, row += pic.stride[i])
+        {
+            if (fread(row, rowBytes, 1, ifs) != 1)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+/* Copy decoded planes into the strided planes of pic */
+void InputFile::copyPlanes(x265_picture& pic, const uint8_t* const* planes, const int* stride)
+{
+    int pixelbytes = pic.bitDepth > 8 ? 2 : 1;
+    for (int i = 0; i < x265_cli_csps[pic.colorSpace].planes; i++)
+    {
+        size_t rowBytes = (size_t)(pic.width >> x265_cli_csps[pic.colorSpace].width[i]) * pixelbytes;
+        int rows = pic.height >> x265_cli_csps[pic.colorSpace].height[i];
+        const uint8_t* src = planes[i];
+        char* dst = (char*)pic.planes[i];
+        for (int y = 0; y < rows; y++, src += stride[i], dst += pic.stride[i])
+            memcpy(dst, src, rowBytes);
+    }
+}
@@ -36,6 +36,20 @@
 namespace X265_NS {
 // private x265 namespace
 
+/* how raw frame data is read from yuv and y4m files (--input-io) */
+enum InputIOMode
+{
+    INPUT_IO_FREAD,
+    INPUT_IO_MMAP,
+    INPUT_IO_DIRECT
+};
+
+static const char * const input_io_names[] = { "fread", "mmap", "direct", 0 };
+
+/* frames the yuv and y4m readers may read ahead of the encoder (--read-ahead) */
+#define DEFAULT_READ_AHEAD 3
+#define MAX_READ_AHEAD     64
+
 struct InputFileInfo
 {
     /* possibly user-supplied, possibly read from file header */
@@ -54,6 +68,8 @@ struct InputFileInfo
     /* user supplied */
     int skipFrames;
     int encodeToFrame;
+    int ioMode;
+    int readAhead;
     const char *filename;
 
     /* reader specific options  */
@@ -66,6 +82,12 @@ protected:
 
     virtual ~InputFile()  {}
 
+    static bool matchesEncoderBuffer(const x265_picture& pic, int width, int height, int csp, int depth);
+
+    static bool readPlanes(FILE* ifs, x265_picture& pic);
+
+    static void copyPlanes(x265_picture& pic, const uint8_t* const* planes, const int* stride);
+
 public:
 
     InputFile()           {}
@@ -87,6 +109,15 @@ public:
     virtual int getWidth() const = 0;
 
     virtual int getHeight() const = 0;
+
+    /* Fill source pictures owned by the encoder, see x265_encoder_get_input_buffer(),
+     * instead of the reader's own frame buffers. Must be called before startReader().
+     * Returns false if this input cannot supply the encoder's sample layout */
+    virtual bool useEncoderBuffers(const x265_api*, x265_encoder*) { return false; }
+
+    /* Stop reading ahead and give back the encoder pictures not yet returned
+     * by readPicture(). Must be called before the encoder is closed */
+    virtual void releaseEncoderBuffers() {}
 };
 }
 
@@ -0,0 +1,194 @@
+/*****************************************************************************
+ * Copyright (C) 2013-2020 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+
+#include "inputio.h"
+
+#if !_WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/* O_DIRECT requires file offset, length and buffer to be aligned to the logical
+ * block size of the device; a page covers every common device */
+#define DIRECT_IO_ALIGN 4096
+
+using namespace X265_NS;
+
+InputIO::InputIO()
+{
+    ioMode = INPUT_IO_FREAD;
+    fileSize = 0;
+    map = NULL;
+    fd = -1;
+    bounce = NULL;
+    bounceSize = 0;
+}
+
+int InputIO::open(FILE* ifs, const char* filename, int requested, const char* readerName)
+{
+    ioMode = INPUT_IO_FREAD;
+    if (requested == INPUT_IO_FREAD || !ifs)
+        return ioMode;
+
+#if _WIN32
+    general_log(NULL, readerName, X265_LOG_WARNING, "--input-io %s is not supported on this platform, using fread\n", input_io_names[requested]);
+    (void)filename;
+#else
+    struct stat st;
+    if (ifs == stdin || fstat(fileno(ifs), &st) || !S_ISREG(st.st_mode) || st.st_size <= 0)
+    {
+        general_log(NULL, readerName, X265_LOG_WARNING, "--input-io %s needs a regular file, using fread\n", input_io_names[requested]);
+        return ioMode;
+    }
+    fileSize = st.st_size;
+
+    if (requested == INPUT_IO_MMAP)
+    {
+        /* a private writable mapping, so pictures handed out directly from the
+         * map may still be processed in place (dithering, filters) */
+        void* addr = (int64_t)(size_t)fileSize == fileSize ?
+                     mmap(NULL, (size_t)fileSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(ifs), 0) : MAP_FAILED;
+        if (addr == MAP_FAILED)
+        {
+            general_log(NULL, readerName, X265_LOG_WARNING, "unable to map input file, using fread\n");
+            return ioMode;
+        }
+        map = (uint8_t*)addr;
+        madvise(map, (size_t)fileSize, MADV_SEQUENTIAL);
+        ioMode = INPUT_IO_MMAP;
+    }
+    else if (requested == INPUT_IO_DIRECT)
+    {
+#ifdef O_DIRECT
+        fd = ::open(filename, O_RDONLY | O_DIRECT);
+#endif
+        if (fd < 0)
+        {
+            general_log(NULL, readerName, X265_LOG_WARNING, "unable to open input file for direct I/O, using fread\n");
+            return ioMode;
+        }
+        ioMode = INPUT_IO_DIRECT;
+    }
+#endif // if _WIN32
+
+    return ioMode;
+}
+
+void InputIO::close()
+{
+#if !_WIN32
+    if (map)
+        munmap(map, (size_t)fileSize);
+    if (fd >= 0)
+        ::close(fd);
+    free(bounce);
+#endif
+    map = NULL;
+    fd = -1;
+    bounce = NULL;
+    bounceSize = 0;
+    ioMode = INPUT_IO_FREAD;
+}
+
+const uint8_t* InputIO::frameData(int64_t offset, size_t size)
+{
+    if (offset < 0 || offset + (int64_t)size > fileSize)
+        return NULL;
+
+    if (map)
+        return map + offset;
+
+#if !_WIN32
+    if (fd >= 0)
+    {
+        int64_t start = offset & ~(int64_t)(DIRECT_IO_ALIGN - 1);
+        size_t head = (size_t)(offset - start);
+        size_t span = (head + size + DIRECT_IO_ALIGN - 1) & ~(size_t)(DIRECT_IO_ALIGN - 1);
+        if (span > bounceSize)
+        {
+            free(bounce);
+            bounceSize = 0;
+            if (posix_memalign((void**)&bounce, DIRECT_IO_ALIGN, span))
+            {
+                bounce = NULL;
+                return NULL;
+            }
+            bounceSize = span;
+        }
+
+        /* a short read is only expected at the end of the file */
+        size_t done = 0;
+        while (done < head + size)
+        {
+            ssize_t ret = pread(fd, bounce + done, span - done, start + done);
+            if (ret <= 0)
+                return NULL;
+            done += (size_t)ret;
+        }
+        return bounce + head;
+    }
+#endif
+
+    return NULL;
+}
+
+bool InputIO::readPlanes(int64_t offset, x265_picture& pic)
+{
+    int pixelbytes = pic.bitDepth > 8 ? 2 : 1;
+    size_t frameBytes = 0;
+    for (int i = 0; i < x265_cli_csps[pic.colorSpace].planes; i++)
+        frameBytes += (size_t)(pic.width >> x265_cli_csps[pic.colorSpace].width[i]) * pixelbytes *
+                      (pic.height >> x265_cli_csps[pic.colorSpace].height[i]);
+
+    const uint8_t* src = frameData(offset, frameBytes);
+    if (!src)
+        return false;
+
+    for (int i = 0; i < x265_cli_csps[pic.colorSpace].planes; i++)
+    {
+        size_t rowBytes = (size_t)(pic.width >> x265_cli_csps[pic.colorSpace].width[i]) * pixelbytes;
+        int rows = pic.height >> x265_cli_csps[pic.colorSpace].height[i];
+        char* dst = (char*)pic.planes[i];
+        for (int y = 0; y < rows; y++, src += rowBytes, dst += pic.stride[i])
+            memcpy(dst, src, rowBytes);
+    }
+
+    return true;
+}
+
+void InputIO::prefetch(int64_t offset, size_t size)
+{
+#if !_WIN32
+    /* direct reads are already issued ahead by the reader thread */
+    if (!map || offset < 0 || offset >= fileSize)
+        return;
+
+    int64_t page = sysconf(_SC_PAGESIZE);
+    int64_t start = offset - offset % page;
+    size = (size_t)X265_MIN((int64_t)size + (offset - start), fileSize - start);
+    madvise(map + start, size, MADV_WILLNEED);
+#else
+    (void)offset;
+    (void)size;
+#endif
+}
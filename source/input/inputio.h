@@ -0,0 +1,75 @@
+/*****************************************************************************
+ * Copyright (C) 2013-2020 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+
+#ifndef X265_INPUTIO_H
+#define X265_INPUTIO_H
+
+#include "input.h"
+
+namespace X265_NS {
+// private x265 namespace
+
+/* Random access to the frame data of a raw (yuv or y4m) input file, either
+ * through a private memory map of the whole file or through O_DIRECT reads
+ * which bypass the page cache. The stdio FILE handle of the reader is still
+ * used for headers and for INPUT_IO_FREAD */
+class InputIO
+{
+public:
+
+    InputIO();
+
+    ~InputIO()                 { close(); }
+
+    /* prepare access to the open file ifs in the requested mode; falls back
+     * to INPUT_IO_FREAD (with a warning) when the mode cannot be used for
+     * this file, for instance stdin. Returns the mode in use */
+    int open(FILE* ifs, const char* filename, int ioMode, const char* readerName);
+
+    void close();
+
+    int  mode() const          { return ioMode; }
+
+    int64_t size() const       { return fileSize; }
+
+    /* returns a pointer to size bytes of the file at offset, valid until the
+     * next call; with a memory map the data stays valid until close() */
+    const uint8_t* frameData(int64_t offset, size_t size);
+
+    /* copy a planar frame at offset into the strided planes of pic */
+    bool readPlanes(int64_t offset, x265_picture& pic);
+
+    /* the frame at [offset, offset + size) will be read soon */
+    void prefetch(int64_t offset, size_t size);
+
+protected:
+
+    int      ioMode;
+    int64_t  fileSize;
+
+    uint8_t* map;          // INPUT_IO_MMAP
+    int      fd;           // INPUT_IO_DIRECT
+    uint8_t* bounce;       // aligned buffer for O_DIRECT reads
+    size_t   bounceSize;
+};
+}
+
+#endif // ifndef X265_INPUTIO_H
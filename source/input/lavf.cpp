@@ -57,10 +57,27 @@ static int handle_jpeg(int csp, int *fullrange)
     }
 }
 
+/* decode straight into a source picture of the encoder, see useEncoderBuffers() */
+bool LavfInput::fill_encoder_buffer(x265_picture& pic, uint8_t** planes, int* stride) {
+    x265_picture* encoderPic = api->encoder_get_input_buffer(encoder);
+    if (!encoderPic)
+        return false;
+
+    copyPlanes(*encoderPic, planes, stride);
+    pic.width = _info.width;
+    pic.height = _info.height;
+    memcpy(pic.stride, encoderPic->stride, sizeof(pic.stride));
+    memcpy(pic.planes, encoderPic->planes, sizeof(pic.planes));
+    return true;
+}
+
 void LavfInput::fill_buffer(x265_picture& pic, uint8_t** planes, int* stride) {
     auto height = _info.height;
     auto height_uv = _info.height >> height_uv_ss;
 
+    if (encoder && fill_encoder_buffer(pic, planes, stride))
+        return;
+
     pic.width = _info.width;
     pic.height = _info.height;
 
@@ -103,6 +120,8 @@ bool LavfInput::readPicture(x265_picture& p_pic, InputFileInfo* info)
          * if so, retrieve the pts and image data before freeing it. */
         memcpy(p_pic.stride, h->first_pic->stride, sizeof(p_pic.stride));
         memcpy(p_pic.planes, h->first_pic->planes, sizeof(p_pic.planes));
+        if (encoder)
+            fill_encoder_buffer(p_pic, reinterpret_cast<uint8_t**>(h->first_pic->planes), h->first_pic->stride);
         p_pic.pts = h->first_pic->pts;
         p_pic.colorSpace = h->first_pic->colorSpace;
         p_pic.bitDepth = h->first_pic->bitDepth;
@@ -366,6 +385,25 @@ void LavfInput::openfile(InputFileInfo& info)
                 (int)duration / 60 / 60, (int)duration / 60 % 60, (int)duration - (int)duration / 60 * 60);
 }
 
+bool LavfInput::useEncoderBuffers(const x265_api* encApi, x265_encoder* enc)
+{
+    if (b_fail)
+        return false;
+
+    /* probe one buffer for the encoder's layout of the planes */
+    x265_picture* pic = encApi->encoder_get_input_buffer(enc);
+    if (!pic)
+        return false;
+    bool match = matchesEncoderBuffer(*pic, _info.width, _info.height, _info.csp, _info.depth);
+    encApi->encoder_release_input_buffer(enc, pic);
+    if (!match)
+        return false;
+
+    api = encApi;
+    encoder = enc;
+    return true;
+}
+
 void LavfInput::release()
 {
     // Deprecated since ffmpeg ~3.1
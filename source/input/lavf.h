@@ -41,8 +41,11 @@ protected:
     lavf_hnd_t handle;
     lavf_hnd_t* h;
     InputFileInfo _info;
+    const x265_api* api {nullptr};
+    x265_encoder* encoder {nullptr};
     void openfile(InputFileInfo& info);
     void fill_buffer(x265_picture& p_pic, uint8_t** planes, int* stride);
+    bool fill_encoder_buffer(x265_picture& p_pic, uint8_t** planes, int* stride);
 public:
     LavfInput(InputFileInfo& info)
     {
@@ -64,6 +67,7 @@ public:
     void startReader() {}
     bool readPicture(x265_picture&);
     bool readPicture(x265_picture&, InputFileInfo*);
+    bool useEncoderBuffers(const x265_api*, x265_encoder*);
     const char *getName() const
     {
         return "lavf";
@@ -283,6 +283,25 @@ void VPYInput::startReader()
         vsapi->getFrameAsync(n, node, frameDoneCallback, &vpyCallbackData);
 }
 
+bool VPYInput::useEncoderBuffers(const x265_api* encApi, x265_encoder* enc)
+{
+    if (vpyFailed)
+        return false;
+
+    /* probe one buffer for the encoder's layout of the planes */
+    x265_picture* pic = encApi->encoder_get_input_buffer(enc);
+    if (!pic)
+        return false;
+    bool match = matchesEncoderBuffer(*pic, _info.width, _info.height, _info.csp, _info.depth);
+    encApi->encoder_release_input_buffer(enc, pic);
+    if (!match)
+        return false;
+
+    api = encApi;
+    encoder = enc;
+    return true;
+}
+
 void VPYInput::release()
 {
     vpyCallbackData.isRunning = false;
@@ -334,23 +353,43 @@ bool VPYInput::readPicture(x265_picture& pic)
     pic.colorSpace = _info.csp;
     pic.bitDepth = _info.depth;
 
-    if (frame_size == 0 || frame_buffer == nullptr) {
+    /* copy straight into a source picture of the encoder, see useEncoderBuffers() */
+    x265_picture* encoderPic = encoder ? api->encoder_get_input_buffer(encoder) : nullptr;
+    if (encoderPic)
+    {
+        const uint8_t* planes[3];
+        int stride[3];
         for (int i = 0; i < x265_cli_csps[_info.csp].planes; i++)
-            frame_size += vsapi->getFrameHeight(currentFrame, i) * vsapi->getStride(currentFrame, i);
-        frame_buffer = reinterpret_cast<uint8_t*>(x265_malloc(frame_size));
+        {
+            planes[i] = vsapi->getReadPtr(currentFrame, i);
+            stride[i] = vsapi->getStride(currentFrame, i);
+        }
+        copyPlanes(*encoderPic, planes, stride);
+
+        memcpy(pic.stride, encoderPic->stride, sizeof(pic.stride));
+        memcpy(pic.planes, encoderPic->planes, sizeof(pic.planes));
+        pic.framesize = frame_size;
     }
+    else
+    {
+        if (frame_size == 0 || frame_buffer == nullptr) {
+            for (int i = 0; i < x265_cli_csps[_info.csp].planes; i++)
+                frame_size += vsapi->getFrameHeight(currentFrame, i) * vsapi->getStride(currentFrame, i);
+            frame_buffer = reinterpret_cast<uint8_t*>(x265_malloc(frame_size));
+        }
 
-    pic.framesize = frame_size;
+        pic.framesize = frame_size;
 
-    uint8_t* ptr = frame_buffer;
-    for(int i = 0; i < x265_cli_csps[_info.csp].planes; i++)
-    {
-        pic.stride[i] = vsapi->getStride(currentFrame, i);
-        pic.planes[i] = ptr;
-        auto len = vsapi->getFrameHeight(currentFrame, i) * pic.stride[i];
+        uint8_t* ptr = frame_buffer;
+        for(int i = 0; i < x265_cli_csps[_info.csp].planes; i++)
+        {
+            pic.stride[i] = vsapi->getStride(currentFrame, i);
+            pic.planes[i] = ptr;
+            auto len = vsapi->getFrameHeight(currentFrame, i) * pic.stride[i];
 
-        memcpy(pic.planes[i], const_cast<unsigned char*>(vsapi->getReadPtr(currentFrame, i)), len);
-        ptr += len;
+            memcpy(pic.planes[i], const_cast<unsigned char*>(vsapi->getReadPtr(currentFrame, i)), len);
+            ptr += len;
+        }
     }
 
     vsapi->freeFrame(currentFrame);
@@ -122,6 +122,10 @@ protected:
 
     VSFDCallbackData vpyCallbackData;
 
+    const x265_api* api {nullptr};
+
+    x265_encoder* encoder {nullptr};
+
     void load_vs();
 
     #if _WIN32
@@ -158,6 +162,8 @@ public:
 
     bool readPicture(x265_picture&);
 
+    bool useEncoderBuffers(const x265_api*, x265_encoder*);
+
     const char* getName() const { return "vpy"; }
 
     int getWidth() const { return _info.width; }
@@ -43,8 +43,17 @@ static const char header[] = {'F','R','A','M','E'};
 static const char magic_xlength[] = {'L','E','N','G','T','H','='};
 Y4MInput::Y4MInput(InputFileInfo& info, bool alpha, int format)
 {
-    for (int i = 0; i < QUEUE_SIZE; i++)
+    for (int i = 0; i < MAX_READ_AHEAD + 2; i++)
+    {
         buf[i] = NULL;
+        encPic[i] = NULL;
+    }
+    api = NULL;
+    encoder = NULL;
+    readAhead = info.readAhead > 0 ? X265_MIN(info.readAhead, MAX_READ_AHEAD) : DEFAULT_READ_AHEAD;
+    queueSize = readAhead + 2;
+    nextFrame = 0;
+    endFrame = INT_MAX;
 
     threadActive = false;
     colorSpace = info.csp;
@@ -81,7 +90,15 @@ Y4MInput::Y4MInput(InputFileInfo& info, bool alpha, int format)
         }
 
         threadActive = true;
-        for (int q = 0; q < QUEUE_SIZE; q++)
+        /* only the mmap and direct readers and --seek need the frame index */
+        int64_t dataStart = ifs != stdin && (info.ioMode != INPUT_IO_FREAD || info.skipFrames) ? ftello(ifs) : -1;
+        if (dataStart >= 0 && !indexFrames(dataStart) && info.ioMode != INPUT_IO_FREAD)
+            x265_log(NULL, X265_LOG_WARNING, "y4m: unable to index frames, using fread\n");
+        else
+            io.open(ifs, info.filename, info.ioMode, "y4m");
+
+        /* mapped frames are handed out in place */
+        for (int q = 0; q < queueSize && io.mode() != INPUT_IO_MMAP; q++)
         {
             buf[q] = X265_MALLOC(char, framesize);
             if (!buf[q])
@@ -110,9 +127,11 @@ Y4MInput::Y4MInput(InputFileInfo& info, bool alpha, int format)
     info.depth = depth;
     info.frameCount = frameCount;
     size_t estFrameSize = framesize + sizeof(header) + 1; /* assume basic FRAME\n headers */
-    /* try to estimate frame count, if this is not stdin */
-    if (ifs != stdin)
+    if (!frameOffset.empty())
+        info.frameCount = (int)frameOffset.size();
+    else if (ifs != stdin)
     {
+        /* try to estimate frame count */
         int64_t cur = ftello(ifs);
         if (cur >= 0)
         {
@@ -123,9 +142,20 @@ Y4MInput::Y4MInput(InputFileInfo& info, bool alpha, int format)
                 info.frameCount = (int)((size - cur) / estFrameSize);
         }
     }
-    if (info.skipFrames)
+    nextFrame = info.skipFrames;
+    if (info.encodeToFrame > 0)
+        endFrame = info.skipFrames + info.encodeToFrame;
+    if (!frameOffset.empty())
+        endFrame = X265_MIN(endFrame, (int)frameOffset.size());
+    if (info.skipFrames && io.mode() == INPUT_IO_FREAD)
     {
-        if (ifs != stdin)
+        if (!frameOffset.empty())
+        {
+            /* seek to the FRAME header of the first frame to read */
+            int n = X265_MIN(info.skipFrames, (int)frameOffset.size());
+            fseeko(ifs, frameOffset[n - 1] + (int64_t)framesize, SEEK_SET);
+        }
+        else if (ifs != stdin)
             fseeko(ifs, (int64_t)estFrameSize * info.skipFrames, SEEK_CUR);
         else
             for (int i = 0; i < info.skipFrames; i++)
@@ -137,8 +167,9 @@ Y4MInput::~Y4MInput()
 {
     if (ifs && ifs != stdin)
         fclose(ifs);
-    for (int i = 0; i < QUEUE_SIZE; i++)
+    for (int i = 0; i < MAX_READ_AHEAD + 2 && io.mode() != INPUT_IO_MMAP; i++)
         X265_FREE(buf[i]);
+    io.close();
 }
 
 void Y4MInput::release()
@@ -316,6 +347,37 @@ bool Y4MInput::parseHeader()
     return true;
 }
 
+/* Record the data offset of every complete frame of a seekable file, which
+ * gives the exact frame count and lets --seek and the mmap and direct readers
+ * address frames without parsing the stream. Leaves the file at dataStart */
+bool Y4MInput::indexFrames(int64_t dataStart)
+{
+    if (fseeko(ifs, 0, SEEK_END))
+        return false;
+    int64_t size = ftello(ifs);
+    int64_t pos = dataStart;
+    char hbuf[sizeof(header) + 1];
+
+    while (pos + (int64_t)(sizeof(hbuf) + framesize) <= size)
+    {
+        if (fseeko(ifs, pos, SEEK_SET) || fread(hbuf, sizeof(hbuf), 1, ifs) != 1 || memcmp(hbuf, header, sizeof(header)))
+            break;
+        /* frame parameters run up to the line feed */
+        int c = hbuf[sizeof(header)];
+        while (c != '\n')
+            if ((c = fgetc(ifs)) == EOF)
+                break;
+        pos = ftello(ifs);
+        if (c == EOF || pos + (int64_t)framesize > size)
+            break;
+        frameOffset.push_back(pos);
+        pos += framesize;
+    }
+
+    fseeko(ifs, dataStart, SEEK_SET);
+    return !frameOffset.empty();
+}
+
 void Y4MInput::startReader()
 {
 #if ENABLE_THREADING
@@ -339,38 +401,73 @@ void Y4MInput::threadMain()
 }
 bool Y4MInput::populateFrameQueue()
 {
-    if (!ifs || ferror(ifs))
+    if (!ifs || ferror(ifs) || nextFrame >= endFrame)
         return false;
-    /* strip off the FRAME\n header */
-    char hbuf[sizeof(header) + 1];
-    if (fread(hbuf, sizeof(hbuf), 1, ifs) != 1 || memcmp(hbuf, header, sizeof(header)))
+    int64_t offset = io.mode() != INPUT_IO_FREAD ? frameOffset[nextFrame] : -1;
+    if (offset < 0)
     {
-        if (!feof(ifs))
-            x265_log(NULL, X265_LOG_ERROR, "y4m: frame header missing\n");
-        return false;
+        /* strip off the FRAME\n header */
+        char hbuf[sizeof(header) + 1];
+        if (fread(hbuf, sizeof(hbuf), 1, ifs) != 1 || memcmp(hbuf, header, sizeof(header)))
+        {
+            if (!feof(ifs))
+                x265_log(NULL, X265_LOG_ERROR, "y4m: frame header missing\n");
+            return false;
+        }
+        /* consume bytes up to line feed */
+        int c = hbuf[sizeof(header)];
+        while (c != '\n')
+            if ((c = fgetc(ifs)) == EOF)
+                break;
     }
-    /* consume bytes up to line feed */
-    int c = hbuf[sizeof(header)];
-    while (c != '\n')
-        if ((c = fgetc(ifs)) == EOF)
-            break;
     /* wait for room in the ring buffer */
     int written = writeCount.get();
     int read = readCount.get();
-    while (written - read > QUEUE_SIZE - 2)
+    while (written - read > queueSize - 2)
     {
         read = readCount.waitForChange(read);
         if (!threadActive)
             return false;
     }
     ProfileScopeEvent(frameRead);
-    if (fread(buf[written % QUEUE_SIZE], framesize, 1, ifs) == 1)
+    int slot = written % queueSize;
+    bool ok;
+    if (encoder)
     {
-        writeCount.incr();
-        return true;
+        x265_picture* pic = api->encoder_get_input_buffer(encoder);
+        if (!pic)
+            return false;
+        ok = offset < 0 ? readPlanes(ifs, *pic) : io.readPlanes(offset, *pic);
+        if (!ok)
+        {
+            api->encoder_release_input_buffer(encoder, pic);
+            return false;
+        }
+        encPic[slot] = pic;
+    }
+    else if (io.mode() == INPUT_IO_MMAP)
+    {
+        /* hand out the frame in place, paged in ahead of the encoder */
+        buf[slot] = (char*)io.frameData(offset, framesize);
+        io.prefetch(offset, framesize);
+        ok = !!buf[slot];
+    }
+    else if (io.mode() == INPUT_IO_DIRECT)
+    {
+        const uint8_t* src = io.frameData(offset, framesize);
+        if (src)
+            memcpy(buf[slot], src, framesize);
+        ok = !!src;
     }
     else
-        return false;
+        ok = fread(buf[slot], framesize, 1, ifs) == 1;
+
+    if (ok)
+    {
+        nextFrame++;
+        writeCount.incr();
+    }
+    return ok;
 }
 
 bool Y4MInput::readPicture(x265_picture& pic)
@@ -390,7 +487,21 @@ bool Y4MInput::readPicture(x265_picture& pic)
 
 #endif // if ENABLE_THREADING
 
-    if (read < written)
+    if (read < written && encoder)
+    {
+        x265_picture* encoderPic = encPic[read % queueSize];
+        encPic[read % queueSize] = NULL;
+        pic.colorSpace = encoderPic->colorSpace;
+        pic.bitDepth = encoderPic->bitDepth;
+        pic.framesize = framesize;
+        pic.height = encoderPic->height;
+        pic.width = encoderPic->width;
+        memcpy(pic.stride, encoderPic->stride, sizeof(pic.stride));
+        memcpy(pic.planes, encoderPic->planes, sizeof(pic.planes));
+        readCount.incr();
+        return true;
+    }
+    else if (read < written)
     {
         int pixelbytes = depth > 8 ? 2 : 1;
         pic.bitDepth = depth;
@@ -401,7 +512,7 @@ bool Y4MInput::readPicture(x265_picture& pic)
         pic.stride[0] = width * pixelbytes * (pic.format == 1 ? 2 : 1);
         pic.stride[1] = pic.stride[0] >> x265_cli_csps[colorSpace].width[1];
         pic.stride[2] = pic.stride[0] >> x265_cli_csps[colorSpace].width[2];
-        pic.planes[0] = buf[read % QUEUE_SIZE];
+        pic.planes[0] = buf[read % queueSize];
         pic.planes[1] = (char*)pic.planes[0] + pic.stride[0] * (height * (pic.format == 2 ? 2 : 1));
         pic.planes[2] = (char*)pic.planes[1] + pic.stride[1] * ((height * (pic.format == 2 ? 2 : 1)) >> x265_cli_csps[colorSpace].height[1]);
 #if ENABLE_ALPHA
@@ -434,3 +545,42 @@ int Y4MInput::readNumber(T &out)
 
     return c;
 }
+
+bool Y4MInput::useEncoderBuffers(const x265_api* encApi, x265_encoder* enc)
+{
+    if (!threadActive || alphaAvailable)
+        return false;
+
+    /* probe one buffer for the encoder's layout of the planes */
+    x265_picture* pic = encApi->encoder_get_input_buffer(enc);
+    if (!pic)
+        return false;
+    bool match = matchesEncoderBuffer(*pic, width, height, colorSpace, depth);
+    encApi->encoder_release_input_buffer(enc, pic);
+    if (!match)
+        return false;
+
+    api = encApi;
+    encoder = enc;
+    for (int i = 0; i < MAX_READ_AHEAD + 2 && io.mode() != INPUT_IO_MMAP; i++)
+        X265_FREE_ZERO(buf[i]);
+    return true;
+}
+
+void Y4MInput::releaseEncoderBuffers()
+{
+    if (!encoder)
+        return;
+
+    threadActive = false;
+    readCount.poke();
+    stop();
+
+    for (int i = 0; i < queueSize; i++)
+    {
+        if (encPic[i])
+            api->encoder_release_input_buffer(encoder, encPic[i]);
+        encPic[i] = NULL;
+    }
+    readCount.set(writeCount.get());
+}
@@ -25,10 +25,10 @@
 #define X265_Y4M_H
 
 #include "input.h"
+#include "inputio.h"
 #include "threading.h"
 #include <fstream>
-
-#define QUEUE_SIZE 5
+#include <vector>
 
 namespace X265_NS {
 // x265 private namespace
@@ -64,9 +64,27 @@ protected:
     ThreadSafeInteger readCount;
 
     ThreadSafeInteger writeCount;
-    char* buf[QUEUE_SIZE];
+
+    /* ring of frames read ahead of the encoder, readAhead + 2 entries. With
+     * INPUT_IO_MMAP the entries point into the file mapping */
+    int queueSize;
+    int readAhead;
+    char* buf[MAX_READ_AHEAD + 2];
     FILE *ifs;
+
+    /* frame data offsets of a seekable file, indexed when it is opened */
+    InputIO io;
+    std::vector<int64_t> frameOffset;
+    int nextFrame;
+    int endFrame;
+
+    /* encoder owned pictures queued in place of buf, see useEncoderBuffers() */
+    const x265_api* api;
+    x265_encoder* encoder;
+    x265_picture* encPic[MAX_READ_AHEAD + 2];
+
     bool parseHeader();
+    bool indexFrames(int64_t dataStart);
     void threadMain();
 
     bool populateFrameQueue();
@@ -77,10 +95,12 @@ public:
 
     virtual ~Y4MInput();
     void release();
-    bool isEof() const            { return ifs && feof(ifs); }
+    bool isEof() const            { return nextFrame >= endFrame || (ifs && feof(ifs)); }
     bool isFail()                 { return !(ifs && !ferror(ifs) && threadActive); }
     void startReader();
     bool readPicture(x265_picture&);
+    bool useEncoderBuffers(const x265_api*, x265_encoder*);
+    void releaseEncoderBuffers();
 
     const char *getName() const   { return "y4m"; }
 
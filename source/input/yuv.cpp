@@ -42,8 +42,17 @@ using namespace std;
 
 YUVInput::YUVInput(InputFileInfo& info, bool alpha, int format)
 {
-    for (int i = 0; i < QUEUE_SIZE; i++)
+    for (int i = 0; i < MAX_READ_AHEAD + 2; i++)
+    {
         buf[i] = NULL;
+        encPic[i] = NULL;
+    }
+    api = NULL;
+    encoder = NULL;
+    readAhead = info.readAhead > 0 ? X265_MIN(info.readAhead, MAX_READ_AHEAD) : DEFAULT_READ_AHEAD;
+    queueSize = readAhead + 2;
+    nextFrame = 0;
+    endFrame = INT_MAX;
 
     depth = info.depth;
     width = info.width;
@@ -86,7 +95,10 @@ YUVInput::YUVInput(InputFileInfo& info, bool alpha, int format)
         return;
     }
 
-    for (uint32_t i = 0; i < QUEUE_SIZE; i++)
+    io.open(ifs, info.filename, info.ioMode, "yuv");
+
+    /* mapped frames are handed out in place */
+    for (int i = 0; i < queueSize && io.mode() != INPUT_IO_MMAP; i++)
     {
         buf[i] = X265_MALLOC(char, framesize);
         if (buf[i] == NULL)
@@ -111,7 +123,12 @@ YUVInput::YUVInput(InputFileInfo& info, bool alpha, int format)
                 info.frameCount = (int)((size - cur) / framesize);
         }
     }
-    if (info.skipFrames)
+    nextFrame = info.skipFrames;
+    if (info.encodeToFrame > 0)
+        endFrame = info.skipFrames + info.encodeToFrame;
+    if (io.mode() != INPUT_IO_FREAD)
+        endFrame = X265_MIN(endFrame, (int)(io.size() / framesize));
+    else if (info.skipFrames)
     {
         if (ifs != stdin)
             fseeko(ifs, (int64_t)framesize * info.skipFrames, SEEK_CUR);
@@ -125,8 +142,9 @@ YUVInput::~YUVInput()
 {
     if (ifs && ifs != stdin)
         fclose(ifs);
-    for (int i = 0; i < QUEUE_SIZE; i++)
+    for (int i = 0; i < MAX_READ_AHEAD + 2 && io.mode() != INPUT_IO_MMAP; i++)
         X265_FREE(buf[i]);
+    io.close();
 }
 
 void YUVInput::release()
@@ -159,12 +177,13 @@ void YUVInput::threadMain()
 }
 bool YUVInput::populateFrameQueue()
 {
-    if (!ifs || ferror(ifs))
+    if (!ifs || ferror(ifs) || nextFrame >= endFrame)
         return false;
+    int64_t offset = (int64_t)framesize * nextFrame;
     /* wait for room in the ring buffer */
     int written = writeCount.get();
     int read = readCount.get();
-    while (written - read > QUEUE_SIZE - 2)
+    while (written - read > queueSize - 2)
     {
         read = readCount.waitForChange(read);
         if (!threadActive)
@@ -172,13 +191,44 @@ bool YUVInput::populateFrameQueue()
             return false;
     }
     ProfileScopeEvent(frameRead);
-    if (fread(buf[written % QUEUE_SIZE], framesize, 1, ifs) == 1)
+    int slot = written % queueSize;
+    bool ok;
+    if (encoder)
     {
-        writeCount.incr();
-        return true;
+        x265_picture* pic = api->encoder_get_input_buffer(encoder);
+        if (!pic)
+            return false;
+        ok = io.mode() == INPUT_IO_FREAD ? readPlanes(ifs, *pic) : io.readPlanes(offset, *pic);
+        if (!ok)
+        {
+            api->encoder_release_input_buffer(encoder, pic);
+            return false;
+        }
+        encPic[slot] = pic;
+    }
+    else if (io.mode() == INPUT_IO_MMAP)
+    {
+        /* hand out the frame in place, paged in ahead of the encoder */
+        buf[slot] = (char*)io.frameData(offset, framesize);
+        io.prefetch(offset, framesize);
+        ok = !!buf[slot];
+    }
+    else if (io.mode() == INPUT_IO_DIRECT)
+    {
+        const uint8_t* src = io.frameData(offset, framesize);
+        if (src)
+            memcpy(buf[slot], src, framesize);
+        ok = !!src;
     }
     else
-        return false;
+        ok = fread(buf[slot], framesize, 1, ifs) == 1;
+
+    if (ok)
+    {
+        nextFrame++;
+        writeCount.incr();
+    }
+    return ok;
 }
 
 bool YUVInput::readPicture(x265_picture& pic)
@@ -198,7 +248,21 @@ bool YUVInput::readPicture(x265_picture& pic)
 
 #endif // if ENABLE_THREADING
 
-    if (read < written)
+    if (read < written && encoder)
+    {
+        x265_picture* encoderPic = encPic[read % queueSize];
+        encPic[read % queueSize] = NULL;
+        pic.colorSpace = encoderPic->colorSpace;
+        pic.bitDepth = encoderPic->bitDepth;
+        pic.framesize = framesize;
+        pic.height = encoderPic->height;
+        pic.width = encoderPic->width;
+        memcpy(pic.stride, encoderPic->stride, sizeof(pic.stride));
+        memcpy(pic.planes, encoderPic->planes, sizeof(pic.planes));
+        readCount.incr();
+        return true;
+    }
+    else if (read < written)
     {
         uint32_t pixelbytes = depth > 8 ? 2 : 1;
         pic.colorSpace = colorSpace;
@@ -209,7 +273,7 @@ bool YUVInput::readPicture(x265_picture& pic)
         pic.stride[0] = width * pixelbytes * (pic.format == 1 ? 2 : 1);
         pic.stride[1] = pic.stride[0] >> x265_cli_csps[colorSpace].width[1];
         pic.stride[2] = pic.stride[0] >> x265_cli_csps[colorSpace].width[2];
-        pic.planes[0] = buf[read % QUEUE_SIZE];
+        pic.planes[0] = buf[read % queueSize];
         pic.planes[1] = (char*)pic.planes[0] + pic.stride[0] * (height * (pic.format == 2 ? 2 : 1));
         pic.planes[2] = (char*)pic.planes[1] + pic.stride[1] * ((height * (pic.format == 2 ? 2 : 1)) >> x265_cli_csps[colorSpace].height[1]);
 #if ENABLE_ALPHA
@@ -225,3 +289,42 @@ bool YUVInput::readPicture(x265_picture& pic)
     else
         return false;
 }
+
+bool YUVInput::useEncoderBuffers(const x265_api* encApi, x265_encoder* enc)
+{
+    if (!threadActive || alphaAvailable)
+        return false;
+
+    /* probe one buffer for the encoder's layout of the planes */
+    x265_picture* pic = encApi->encoder_get_input_buffer(enc);
+    if (!pic)
+        return false;
+    bool match = matchesEncoderBuffer(*pic, width, height, colorSpace, depth);
+    encApi->encoder_release_input_buffer(enc, pic);
+    if (!match)
+        return false;
+
+    api = encApi;
+    encoder = enc;
+    for (int i = 0; i < MAX_READ_AHEAD + 2 && io.mode() != INPUT_IO_MMAP; i++)
+        X265_FREE_ZERO(buf[i]);
+    return true;
+}
+
+void YUVInput::releaseEncoderBuffers()
+{
+    if (!encoder)
+        return;
+
+    threadActive = false;
+    readCount.poke();
+    stop();
+
+    for (int i = 0; i < queueSize; i++)
+    {
+        if (encPic[i])
+            api->encoder_release_input_buffer(encoder, encPic[i]);
+        encPic[i] = NULL;
+    }
+    readCount.set(writeCount.get());
+}
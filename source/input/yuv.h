@@ -25,11 +25,10 @@
 #define X265_YUV_H
 
 #include "input.h"
+#include "inputio.h"
 #include "threading.h"
 #include <fstream>
 
-#define QUEUE_SIZE 5
-
 namespace X265_NS {
 // private x265 namespace
 
@@ -54,8 +53,24 @@ protected:
     ThreadSafeInteger readCount;
 
     ThreadSafeInteger writeCount;
-    char* buf[QUEUE_SIZE];
+
+    /* ring of frames read ahead of the encoder, readAhead + 2 entries. With
+     * INPUT_IO_MMAP the entries point into the file mapping */
+    int queueSize;
+    int readAhead;
+    char* buf[MAX_READ_AHEAD + 2];
     FILE *ifs;
+
+    /* frame n starts at n * framesize */
+    InputIO io;
+    int nextFrame;
+    int endFrame;
+
+    /* encoder owned pictures queued in place of buf, see useEncoderBuffers() */
+    const x265_api* api;
+    x265_encoder* encoder;
+    x265_picture* encPic[MAX_READ_AHEAD + 2];
+
     int guessFrameCount();
     void threadMain();
 
@@ -67,11 +82,13 @@ public:
 
     virtual ~YUVInput();
     void release();
-    bool isEof() const                            { return ifs && feof(ifs); }
+    bool isEof() const                            { return nextFrame >= endFrame || (ifs && feof(ifs)); }
     bool isFail()                                 { return !(ifs && !ferror(ifs) && threadActive); }
     void startReader();
 
     bool readPicture(x265_picture&);
+    bool useEncoderBuffers(const x265_api*, x265_encoder*);
+    void releaseEncoderBuffers();
 
     const char *getName() const                   { return "yuv"; }
 
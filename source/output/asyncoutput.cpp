@@ -0,0 +1,172 @@
+/*****************************************************************************
+ * Copyright (C) 2013-2020 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+
+#include "asyncoutput.h"
+
+using namespace X265_NS;
+
+AsyncOutput::AsyncOutput(OutputFile* output, int depth)
+{
+    out = output;
+    queueSize = depth;
+    b_fail = false;
+    threadActive = false;
+    queue = X265_MALLOC(Packet, queueSize);
+    if (queue)
+    {
+        memset(queue, 0, sizeof(Packet) * queueSize);
+        threadActive = start();
+    }
+    if (!threadActive)
+        general_log(NULL, getName(), X265_LOG_WARNING, "unable to start output thread, writing synchronously\n");
+}
+
+AsyncOutput::~AsyncOutput()
+{
+    for (int i = 0; queue && i < queueSize; i++)
+    {
+        X265_FREE(queue[i].nal);
+        X265_FREE(queue[i].payload);
+    }
+    X265_FREE(queue);
+}
+
+void AsyncOutput::release()
+{
+    stopWriter();
+    out->release();
+    delete this;
+}
+
+void AsyncOutput::threadMain()
+{
+    THREAD_NAME("Output", 0);
+
+    int read = readCount.get();
+    for (;;)
+    {
+        int written = writeCount.get();
+        while (read == written)
+            written = writeCount.waitForChange(written);
+
+        /* drain everything queued, releasing each slot as soon as it is written */
+        for (; read < written; read++)
+        {
+            Packet& p = queue[read % queueSize];
+            if (p.bEnd)
+            {
+                readCount.incr();
+                return;
+            }
+            if (out->writeFrame(p.nal, p.nalCount, p.pic) < 0)
+                b_fail = true;
+            readCount.incr();
+        }
+    }
+}
+
+AsyncOutput::Packet& AsyncOutput::waitForSlot()
+{
+    int written = writeCount.get();
+    int read = readCount.get();
+    while (written - read >= queueSize)
+        read = readCount.waitForChange(read);
+    return queue[written % queueSize];
+}
+
+/* wait until the writer thread has written every queued frame */
+void AsyncOutput::flush()
+{
+    int written = writeCount.get();
+    int read = readCount.get();
+    while (read < written)
+        read = readCount.waitForChange(read);
+}
+
+void AsyncOutput::stopWriter()
+{
+    if (!threadActive)
+        return;
+
+    waitForSlot().bEnd = true;
+    writeCount.incr();
+    stop();
+    threadActive = false;
+}
+
+int AsyncOutput::writeHeaders(const x265_nal* nal, uint32_t nalcount)
+{
+    flush();
+    return out->writeHeaders(nal, nalcount);
+}
+
+int AsyncOutput::writeFrame(const x265_nal* nal, uint32_t nalcount, x265_picture& pic)
+{
+    if (!threadActive)
+        return out->writeFrame(nal, nalcount, pic);
+
+    uint32_t bytes = 0;
+    for (uint32_t i = 0; i < nalcount; i++)
+        bytes += nal[i].sizeBytes;
+
+    Packet& p = waitForSlot();
+    if (nalcount > p.nalAlloc)
+    {
+        X265_FREE(p.nal);
+        p.nal = X265_MALLOC(x265_nal, nalcount);
+        p.nalAlloc = p.nal ? nalcount : 0;
+    }
+    if (bytes > p.payloadAlloc)
+    {
+        X265_FREE(p.payload);
+        p.payload = X265_MALLOC(uint8_t, bytes);
+        p.payloadAlloc = p.payload ? bytes : 0;
+    }
+    if (!p.nal || !p.payload)
+    {
+        /* keep the stream in order and write this frame directly */
+        flush();
+        return out->writeFrame(nal, nalcount, pic);
+    }
+
+    uint8_t* dst = p.payload;
+    for (uint32_t i = 0; i < nalcount; i++)
+    {
+        p.nal[i] = nal[i];
+        p.nal[i].payload = dst;
+        memcpy(dst, nal[i].payload, nal[i].sizeBytes);
+        dst += nal[i].sizeBytes;
+    }
+    p.nalCount = nalcount;
+    p.pic = pic;
+    p.bEnd = false;
+    writeCount.incr();
+
+    return (int)bytes;
+}
+
+void AsyncOutput::closeFile(int64_t largest_pts, int64_t second_largest_pts)
+{
+    stopWriter();
+    if (b_fail)
+        general_log(NULL, getName(), X265_LOG_ERROR, "writing one or more frames failed\n");
+    out->closeFile(largest_pts, second_largest_pts);
+}
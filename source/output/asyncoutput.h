@@ -0,0 +1,95 @@
+/*****************************************************************************
+ * Copyright (C) 2013-2020 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+
+#ifndef X265_ASYNC_OUTPUT_H
+#define X265_ASYNC_OUTPUT_H
+
+#include "output.h"
+#include "threading.h"
+
+namespace X265_NS {
+// private x265 namespace
+
+/* Wraps another OutputFile and moves its frame writes to a writer thread, so
+ * a slow disk or muxer only stalls the encode loop once the bounded queue of
+ * compressed frames is full. The NAL payloads are copied, since the encoder
+ * reuses its NAL buffers on the next call to x265_encoder_encode() */
+class AsyncOutput : public OutputFile, public Thread
+{
+protected:
+
+    struct Packet
+    {
+        x265_picture pic;       // only the timing and slice type fields are used by muxers
+        x265_nal*    nal;
+        uint32_t     nalCount;
+        uint32_t     nalAlloc;
+        uint8_t*     payload;
+        uint32_t     payloadAlloc;
+        bool         bEnd;      // queued by closeFile(), stops the writer
+    };
+
+    OutputFile*       out;
+    Packet*           queue;
+    int               queueSize;
+    bool              threadActive;
+    bool              b_fail;
+
+    ThreadSafeInteger readCount;
+    ThreadSafeInteger writeCount;
+
+    virtual ~AsyncOutput();
+
+    void threadMain();
+
+    Packet& waitForSlot();
+
+    void flush();
+
+    void stopWriter();
+
+public:
+
+    AsyncOutput(OutputFile* output, int depth);
+
+    bool isFail() const                     { return b_fail || out->isFail(); }
+
+    bool needPTS() const                    { return out->needPTS(); }
+
+    void release();
+
+    const char* getName() const             { return out->getName(); }
+
+    void setParam(x265_param* param)        { out->setParam(param); }
+
+    void setPS(x265_encoder* encoder)       { out->setPS(encoder); }
+
+    void preallocate(int64_t bytes)         { out->preallocate(bytes); }
+
+    int writeHeaders(const x265_nal* nal, uint32_t nalcount);
+
+    int writeFrame(const x265_nal* nal, uint32_t nalcount, x265_picture& pic);
+
+    void closeFile(int64_t largest_pts, int64_t second_largest_pts);
+};
+}
+
+#endif // ifndef X265_ASYNC_OUTPUT_H
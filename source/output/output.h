@@ -78,6 +78,10 @@ public:
 
     virtual void setPS(x265_encoder*) { }
 
+    /* Reserve disk space for the expected size of the stream, to avoid
+     * fragmentation and allocation stalls during the encode */
+    virtual void preallocate(int64_t) { }
+
     virtual int writeHeaders(const x265_nal* nal, uint32_t nalcount) = 0;
 
     virtual int writeFrame(const x265_nal* nal, uint32_t nalcount, x265_picture& pic) = 0;
@@ -28,8 +28,14 @@
 #if defined(_MSC_VER)
 #pragma warning(disable: 4996) // POSIX setmode and fileno deprecated
 #endif
+#else
+#include <fcntl.h>
 #endif
 
+/* frames are small next to the write granularity of most storage, so let
+ * stdio coalesce them into large writes */
+#define RAW_WRITE_BUFFER (1 << 20)
+
 using namespace X265_NS;
 using namespace std;
 RAWOutput::RAWOutput(const char* fname, InputFileInfo&)
@@ -41,11 +47,25 @@ RAWOutput::RAWOutput(const char* fname, InputFileInfo&)
 #if _WIN32
         setmode(fileno(stdout), O_BINARY);
 #endif
+        setvbuf(ofs, NULL, _IOFBF, RAW_WRITE_BUFFER);
         return;
     }
     ofs = x265_fopen(fname, "wb");
     if (!ofs || ferror(ofs))
         b_fail = true;
+    else
+        setvbuf(ofs, NULL, _IOFBF, RAW_WRITE_BUFFER);
+}
+
+void RAWOutput::preallocate(int64_t bytes)
+{
+#if defined(__linux__) && defined(FALLOC_FL_KEEP_SIZE)
+    /* the file size is left alone, so nothing needs trimming at close */
+    if (ofs != stdout && fallocate(fileno(ofs), FALLOC_FL_KEEP_SIZE, 0, bytes))
+        general_log(NULL, getName(), X265_LOG_WARNING, "unable to preallocate output file\n");
+#else
+    (void)bytes;
+#endif
 }
 
 void RAWOutput::setParam(x265_param* param)
@@ -53,6 +53,8 @@ public:
 
     void setParam(x265_param* param);
 
+    void preallocate(int64_t bytes);
+
     int writeHeaders(const x265_nal* nal, uint32_t nalcount);
 
     int writeFrame(const x265_nal* nal, uint32_t nalcount, x265_picture&);
@@ -0,0 +1,179 @@
+/*****************************************************************************
+ * Copyright (C) 2013-2020 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+
+/* cuTree propagation work benchmark. Runs the lookahead alone
+ * (--lookahead-only) on a synthetic 640x360 clip for a range of rc-lookahead
+ * depths, with the full and the incremental (--cutree-incremental)
+ * propagation, and reports per decided frame the propagation steps applied,
+ * the lowres blocks they walked, the blocks which passed a propagate amount
+ * on and the time spent running cuTree plans:
+ *
+ *   CuTreeBench [frames] [preset]
+ *
+ * The full propagation grows linearly with rc-lookahead; the incremental
+ * one should stay roughly flat. The lookahead counts this work only in
+ * builds with DETAILED_CU_STATS */
+
+#include "common.h"
+#include "encoder.h"
+#include "slicetype.h"
+
+using namespace X265_NS;
+
+#if DETAILED_CU_STATS
+namespace {
+
+enum { WIDTH = 640, HEIGHT = 360, RING = 64 };
+
+/* a textured pattern panning and scrolling at different speeds, so that the
+ * lowres blocks have motion and inter costs well below their intra costs */
+void fillFrame(x265_picture& pic, int frame)
+{
+    pixel* luma = (pixel*)pic.planes[0];
+    for (int y = 0; y < HEIGHT; y++)
+        for (int x = 0; x < WIDTH; x++)
+        {
+            int u = x + frame * 2, v = y + frame;
+            luma[y * WIDTH + x] = (pixel)(((u ^ v) & 0x3f) + ((u * v) >> 9) + 64);
+        }
+
+    for (int c = 1; c < 3; c++)
+    {
+        pixel* chroma = (pixel*)pic.planes[c];
+        for (int y = 0; y < HEIGHT / 2; y++)
+            for (int x = 0; x < WIDTH / 2; x++)
+                chroma[y * (WIDTH / 2) + x] = (pixel)(128 + ((x + y + frame * c) & 0x1f));
+    }
+}
+
+bool propagateClip(x265_picture* pic, int lookahead, bool bIncremental, int frames, const char* preset, CuTreeWork& work)
+{
+    x265_param* param = x265_param_alloc();
+    x265_param_default_preset(param, preset, NULL);
+    param->sourceWidth = WIDTH;
+    param->sourceHeight = HEIGHT;
+    param->fpsNum = 30;
+    param->fpsDenom = 1;
+    param->internalCsp = X265_CSP_I420;
+    param->logLevel = X265_LOG_ERROR;
+    param->bEnablePsnr = param->bEnableSsim = 0;
+    param->bLookaheadOnly = 1;
+    param->rc.cuTree = 1;
+    param->lookaheadDepth = lookahead;
+    param->bIncrementalCuTree = bIncremental;
+    /* keep every window at full depth */
+    param->keyframeMax = frames + 1;
+    param->scenecutThreshold = 0;
+    param->bHistBasedSceneCut = 0;
+
+    x265_encoder* encoder = x265_encoder_open(param);
+    if (!encoder)
+    {
+        x265_param_free(param);
+        return false;
+    }
+
+    x265_nal* nal;
+    uint32_t nalCount;
+    for (int i = 0; i < frames; i++)
+    {
+        pic[i % RING].pts = i;
+        x265_encoder_encode(encoder, &nal, &nalCount, &pic[i % RING], NULL);
+    }
+    while (x265_encoder_encode(encoder, &nal, &nalCount, NULL, NULL) > 0)
+        ;
+
+    work = static_cast<Encoder*>(encoder)->m_lookahead->m_cuTreeWork;
+
+    x265_encoder_close(encoder);
+    x265_param_free(param);
+    return true;
+}
+
+}
+
+#endif // if DETAILED_CU_STATS
+
+int main(int argc, char *argv[])
+{
+#if !DETAILED_CU_STATS
+    (void)argc;
+    (void)argv;
+    printf("CuTreeBench needs a build with DETAILED_CU_STATS enabled\n");
+    return 1;
+#else
+    static const int depths[] = { 20, 40, 80, 120, 250 };
+
+    int frames = argc > 1 ? atoi(argv[1]) : 500;
+    const char* preset = argc > 2 ? argv[2] : "fast";
+
+    if (frames < 1)
+    {
+        printf("usage: CuTreeBench [frames] [preset]\n");
+        return 1;
+    }
+
+    /* the pictures are generated once, the clip loops over a ring of them */
+    x265_param* param = x265_param_alloc();
+    x265_param_default(param);
+    param->internalCsp = X265_CSP_I420;
+    size_t picSize = (size_t)WIDTH * HEIGHT * 3 / 2;
+    pixel* buf = X265_MALLOC(pixel, picSize * RING);
+    if (!buf)
+    {
+        x265_param_free(param);
+        return 1;
+    }
+    x265_picture pic[RING];
+    for (int i = 0; i < RING; i++)
+    {
+        x265_picture_init(param, &pic[i]);
+        pic[i].planes[0] = buf + picSize * i;
+        pic[i].planes[1] = (pixel*)pic[i].planes[0] + WIDTH * HEIGHT;
+        pic[i].planes[2] = (pixel*)pic[i].planes[1] + WIDTH * HEIGHT / 4;
+        pic[i].stride[0] = WIDTH * sizeof(pixel);
+        pic[i].stride[1] = pic[i].stride[2] = WIDTH / 2 * sizeof(pixel);
+        fillFrame(pic[i], i);
+    }
+    x265_param_free(param);
+
+    printf("cuTree propagation per decided frame, %d frames %dx%d, preset %s\n", frames, WIDTH, HEIGHT, preset);
+    printf("rc-lookahead  mode         steps    blocks walked  blocks propagated     us\n");
+    for (size_t d = 0; d < sizeof(depths) / sizeof(depths[0]); d++)
+    {
+        for (int incremental = 0; incremental < 2; incremental++)
+        {
+            CuTreeWork work;
+            if (!propagateClip(pic, depths[d], !!incremental, frames, preset, work))
+            {
+                printf("%12d  %-11s  unable to open encoder\n", depths[d], incremental ? "incremental" : "full");
+                continue;
+            }
+            printf("%12d  %-11s  %5.1f  %15.0f  %17.0f  %5.0f\n", depths[d], incremental ? "incremental" : "full",
+                   (double)work.steps / frames, (double)work.blocks / frames,
+                   (double)work.propagated / frames, (double)work.elapsed / frames);
+        }
+    }
+
+    X265_FREE(buf);
+    return 0;
+#endif
+}
@@ -0,0 +1,165 @@
+/*****************************************************************************
+ * Copyright (C) 2013-2020 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+
+/* Lookahead throughput benchmark. Runs the lookahead alone (--lookahead-only)
+ * on synthetic 720p, 1080p and 4K clips and reports the pictures analysed per
+ * second for each --lookahead-batch grain:
+ *
+ *   LookaheadBench [frames] [preset] [threads]
+ *
+ * Every size runs the explicit grains 1, 2, 4 and 8, which shows what the
+ * grouping of estimates gains, and then grain 0, labelled with the grain the
+ * lookahead picks for that lowres picture size, which shows whether the pick
+ * is the right one */
+
+#include "common.h"
+
+using namespace X265_NS;
+
+namespace {
+
+/* fill a moving pattern with some texture so every frame has real motion */
+void fillFrame(x265_picture& pic, int width, int height, int frame)
+{
+    pixel* luma = (pixel*)pic.planes[0];
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+            luma[y * width + x] = (pixel)(((x + frame * 3) ^ (y + frame)) + ((x * y) >> 7));
+
+    for (int c = 1; c < 3; c++)
+    {
+        pixel* chroma = (pixel*)pic.planes[c];
+        for (int y = 0; y < height / 2; y++)
+            for (int x = 0; x < width / 2; x++)
+                chroma[y * (width / 2) + x] = (pixel)((x + y + frame * c) >> 1);
+    }
+}
+
+double analyseClip(int width, int height, int grain, int frames, const char* preset, int threads)
+{
+    x265_param* param = x265_param_alloc();
+    x265_param_default_preset(param, preset, NULL);
+    param->sourceWidth = width;
+    param->sourceHeight = height;
+    param->fpsNum = 30;
+    param->fpsDenom = 1;
+    param->internalCsp = X265_CSP_I420;
+    param->logLevel = X265_LOG_ERROR;
+    param->bEnablePsnr = param->bEnableSsim = 0;
+    param->bLookaheadOnly = 1;
+    param->lookaheadBatch = grain;
+    if (threads)
+        snprintf(param->numaPools, X265_MAX_STRING_SIZE, "%d", threads);
+
+    x265_encoder* encoder = x265_encoder_open(param);
+    if (!encoder)
+    {
+        x265_param_free(param);
+        return 0;
+    }
+
+    /* the pictures are generated before the clock starts, the clip loops
+     * over a ring of them */
+    enum { RING = 16 };
+    x265_picture pic[RING];
+    size_t picSize = (size_t)width * height * 3 / 2;
+    pixel* buf = X265_MALLOC(pixel, picSize * RING);
+    if (!buf)
+    {
+        x265_encoder_close(encoder);
+        x265_param_free(param);
+        return 0;
+    }
+    for (int i = 0; i < RING; i++)
+    {
+        x265_picture_init(param, &pic[i]);
+        pic[i].planes[0] = buf + picSize * i;
+        pic[i].planes[1] = (pixel*)pic[i].planes[0] + width * height;
+        pic[i].planes[2] = (pixel*)pic[i].planes[1] + width * height / 4;
+        pic[i].stride[0] = width * sizeof(pixel);
+        pic[i].stride[1] = pic[i].stride[2] = width / 2 * sizeof(pixel);
+        fillFrame(pic[i], width, height, i);
+    }
+
+    x265_nal* nal;
+    uint32_t nalCount;
+    int64_t start = x265_mdate();
+    for (int i = 0; i < frames; i++)
+    {
+        pic[i % RING].pts = i;
+        x265_encoder_encode(encoder, &nal, &nalCount, &pic[i % RING], NULL);
+    }
+    while (x265_encoder_encode(encoder, &nal, &nalCount, NULL, NULL) > 0)
+        ;
+    int64_t elapsed = x265_mdate() - start;
+
+    X265_FREE(buf);
+    x265_encoder_close(encoder);
+    x265_param_free(param);
+
+    return elapsed ? (double)frames * 1000000 / elapsed : 0;
+}
+
+/* the grain the lookahead picks for --lookahead-batch 0, see Lookahead() */
+int autoGrain(int width, int height)
+{
+    int cuCount = (((width / 2) + X265_LOWRES_CU_SIZE - 1) >> X265_LOWRES_CU_BITS) *
+                  (((height / 2) + X265_LOWRES_CU_SIZE - 1) >> X265_LOWRES_CU_BITS);
+    return x265_clip3(1, 8, 8192 / X265_MAX(cuCount, 1));
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct { const char* name; int width, height; } sizes[] =
+    {
+        { "720p",  1280,  720 },
+        { "1080p", 1920, 1080 },
+        { "4K",    3840, 2160 },
+    };
+    static const int grains[] = { 1, 2, 4, 8, 0 };
+
+    int frames = argc > 1 ? atoi(argv[1]) : 120;
+    const char* preset = argc > 2 ? argv[2] : "medium";
+    int threads = argc > 3 ? atoi(argv[3]) : 0;
+
+    if (frames < 1 || threads < 0)
+    {
+        printf("usage: LookaheadBench [frames] [preset] [threads]\n");
+        return 1;
+    }
+
+    printf("Lookahead throughput, %d frames, preset %s\n", frames, preset);
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        for (size_t g = 0; g < sizeof(grains) / sizeof(grains[0]); g++)
+        {
+            double fps = analyseClip(sizes[s].width, sizes[s].height, grains[g], frames, preset, threads);
+            if (grains[g])
+                printf("%-5s  grain %d         %8.2f fps\n", sizes[s].name, grains[g], fps);
+            else
+                printf("%-5s  grain auto (%d)  %8.2f fps\n", sizes[s].name, autoGrain(sizes[s].width, sizes[s].height), fps);
+        }
+    }
+
+    return 0;
+}
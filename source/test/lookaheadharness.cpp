@@ -0,0 +1,176 @@
+/*****************************************************************************
+ * Copyright (C) 2024 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+
+#include "common.h"
+#include "lookaheadharness.h"
+
+using namespace X265_NS;
+
+LookaheadHarness::LookaheadHarness()
+{
+    /* [0] --- Random values
+     * [1] --- Minimum and maximum, strongest gradients
+     * [2] --- Small steps, gradients close to the edge threshold */
+    for (int i = 0; i < BUFFSIZE; i++)
+    {
+        pixel_test_buff[0][i] = rand() % (PIXEL_MAX + 1);
+        pixel_test_buff[1][i] = (rand() & 1) ? PIXEL_MAX : PIXEL_MIN;
+        pixel_test_buff[2][i] = (pixel)((PIXEL_MAX >> 1) + (((i % STRIDE) / 8) & 1) * (PIXEL_MAX >> 3) + rand() % 3);
+    }
+}
+
+bool LookaheadHarness::check_edge_gaussian(edge_gaussian_t ref, edge_gaussian_t opt)
+{
+    for (int i = 0; i < ITERS; i++)
+    {
+        int index = i % TEST_CASES;
+        int width = 5 + rand() % (MAX_WIDTH - 4);
+        int height = 5 + rand() % (MAX_HEIGHT - 4);
+
+        memset(pixel_out_c, 0xCD, sizeof(pixel_out_c));
+        memset(pixel_out_vec, 0xCD, sizeof(pixel_out_vec));
+
+        ref(pixel_out_c, pixel_test_buff[index], STRIDE, width, height);
+        checked(opt, pixel_out_vec, pixel_test_buff[index], (intptr_t)STRIDE, width, height);
+
+        if (memcmp(pixel_out_c, pixel_out_vec, sizeof(pixel_out_c)))
+            return false;
+
+        reportfail();
+    }
+
+    return true;
+}
+
+bool LookaheadHarness::check_edge_sobel(edge_sobel_t ref, edge_sobel_t opt)
+{
+    for (int i = 0; i < ITERS; i++)
+    {
+        int index = i % TEST_CASES;
+        int width = 3 + rand() % (MAX_WIDTH - 2);
+        int height = 3 + rand() % (MAX_HEIGHT - 2);
+        pixel white = (rand() & 1) ? PIXEL_MAX : 1;
+        bool bTheta = !!(i & 1);
+
+        memset(pixel_out_c, 0xCD, sizeof(pixel_out_c));
+        memset(pixel_out_vec, 0xCD, sizeof(pixel_out_vec));
+        memset(theta_out_c, 0xCD, sizeof(theta_out_c));
+        memset(theta_out_vec, 0xCD, sizeof(theta_out_vec));
+
+        ref(pixel_out_c, bTheta ? theta_out_c : NULL, pixel_test_buff[index], STRIDE, width, height, white);
+        checked(opt, pixel_out_vec, bTheta ? theta_out_vec : NULL, pixel_test_buff[index], (intptr_t)STRIDE, width, height, white);
+
+        if (memcmp(pixel_out_c, pixel_out_vec, sizeof(pixel_out_c)) ||
+            memcmp(theta_out_c, theta_out_vec, sizeof(theta_out_c)))
+            return false;
+
+        reportfail();
+    }
+
+    return true;
+}
+
+bool LookaheadHarness::check_intensity_histogram(intensity_histogram_t ref, intensity_histogram_t opt)
+{
+    for (int i = 0; i < ITERS; i++)
+    {
+        int index = i % TEST_CASES;
+        int width = 1 + rand() % MAX_WIDTH;
+        int height = 1 + rand() % MAX_HEIGHT;
+        int dsFactor = (i & 1) ? 4 : 1;
+        uint32_t hist_c[256], hist_vec[256];
+        uint64_t sum_c = 0, sum_vec = 0;
+
+        /* the primitive accumulates into the histogram */
+        for (int j = 0; j < 256; j++)
+            hist_c[j] = hist_vec[j] = j;
+
+        ref(pixel_test_buff[index], STRIDE, width, height, dsFactor, hist_c, &sum_c);
+        checked(opt, pixel_test_buff[index], (intptr_t)STRIDE, width, height, dsFactor, hist_vec, &sum_vec);
+
+        if (sum_c != sum_vec || memcmp(hist_c, hist_vec, sizeof(hist_c)))
+            return false;
+
+        reportfail();
+    }
+
+    return true;
+}
+
+bool LookaheadHarness::testCorrectness(const EncoderPrimitives& ref, const EncoderPrimitives& opt)
+{
+    if (opt.edgeGaussian)
+    {
+        if (!check_edge_gaussian(ref.edgeGaussian, opt.edgeGaussian))
+        {
+            printf("edgeGaussian failed\n");
+            return false;
+        }
+    }
+
+    if (opt.edgeSobel)
+    {
+        if (!check_edge_sobel(ref.edgeSobel, opt.edgeSobel))
+        {
+            printf("edgeSobel failed\n");
+            return false;
+        }
+    }
+
+    if (opt.intensityHistogram)
+    {
+        if (!check_intensity_histogram(ref.intensityHistogram, opt.intensityHistogram))
+        {
+            printf("intensityHistogram failed\n");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+#define HEADER0(str) printf("%22s", str);
+
+void LookaheadHarness::measureSpeed(const EncoderPrimitives& ref, const EncoderPrimitives& opt)
+{
+    uint32_t hist[256];
+    uint64_t sum;
+
+    if (opt.edgeGaussian)
+    {
+        HEADER0("edgeGaussian");
+        REPORT_SPEEDUP(opt.edgeGaussian, ref.edgeGaussian, pixel_out_vec, pixel_test_buff[0], STRIDE, MAX_WIDTH, MAX_HEIGHT);
+    }
+
+    if (opt.edgeSobel)
+    {
+        HEADER0("edgeSobel");
+        REPORT_SPEEDUP(opt.edgeSobel, ref.edgeSobel, pixel_out_vec, theta_out_vec, pixel_test_buff[0], STRIDE, MAX_WIDTH, MAX_HEIGHT, PIXEL_MAX);
+    }
+
+    if (opt.intensityHistogram)
+    {
+        HEADER0("intensityHistogram");
+        REPORT_SPEEDUP(opt.intensityHistogram, ref.intensityHistogram, pixel_test_buff[0], STRIDE, MAX_WIDTH, MAX_HEIGHT, 1, hist, &sum);
+        HEADER0("intensityHistogram[ds=4]");
+        REPORT_SPEEDUP(opt.intensityHistogram, ref.intensityHistogram, pixel_test_buff[0], STRIDE, MAX_WIDTH, MAX_HEIGHT, 4, hist, &sum);
+    }
+}
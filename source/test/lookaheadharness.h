@@ -0,0 +1,60 @@
+/*****************************************************************************
+ * Copyright (C) 2024 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+
+#ifndef _LOOKAHEADHARNESS_H_1
+#define _LOOKAHEADHARNESS_H_1 1
+
+#include "testharness.h"
+#include "primitives.h"
+
+class LookaheadHarness : public TestHarness
+{
+protected:
+
+    enum { TEST_CASES = 3 };
+    enum { ITERS = 100 };
+    enum { STRIDE = 160 };
+    enum { MAX_WIDTH = 128 };
+    enum { MAX_HEIGHT = 64 };
+    enum { BUFFSIZE = STRIDE * MAX_HEIGHT };
+
+    pixel pixel_test_buff[TEST_CASES][BUFFSIZE];
+    pixel pixel_out_c[BUFFSIZE];
+    pixel pixel_out_vec[BUFFSIZE];
+    pixel theta_out_c[BUFFSIZE];
+    pixel theta_out_vec[BUFFSIZE];
+
+    bool check_edge_gaussian(edge_gaussian_t ref, edge_gaussian_t opt);
+    bool check_edge_sobel(edge_sobel_t ref, edge_sobel_t opt);
+    bool check_intensity_histogram(intensity_histogram_t ref, intensity_histogram_t opt);
+
+public:
+
+    LookaheadHarness();
+
+    const char *getName() const { return "lookahead"; }
+
+    bool testCorrectness(const EncoderPrimitives& ref, const EncoderPrimitives& opt);
+
+    void measureSpeed(const EncoderPrimitives& ref, const EncoderPrimitives& opt);
+};
+
+#endif // ifndef _LOOKAHEADHARNESS_H_1
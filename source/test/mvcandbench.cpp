@@ -0,0 +1,284 @@
+/*****************************************************************************
+ * Copyright (C) 2013-2020 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+
+/* Motion candidate derivation benchmark. Builds a 1080p B picture and its
+ * collocated picture with random motion fields, then derives the merge and
+ * AMVP candidates of every PU an rd 5 analysis with --rect and --amp
+ * evaluates in a CTU, with and without the per-CTU motion candidate cache:
+ *
+ *   MvCandBench [ctus] [refs]
+ *
+ * Both passes must produce the same candidates */
+
+#include "common.h"
+#include "cudata.h"
+#include "frame.h"
+#include "framedata.h"
+#include "slice.h"
+#include "predict.h"
+
+using namespace X265_NS;
+
+namespace {
+
+enum { WIDTH = 1920, HEIGHT = 1088, CTU_SIZE = 64 };
+
+struct Picture
+{
+    Frame         frame;
+    FrameData     encData;
+    Slice         slice;
+    CUDataMemPool pool;
+    CUData*       ctus;
+};
+
+uint32_t s_seed = 1;
+
+uint32_t rnd()
+{
+    s_seed = s_seed * 1103515245 + 12345;
+    return s_seed >> 8;
+}
+
+/* one prediction per 8x8 block, one block in ten is intra */
+void fillMotion(CUData& ctu, int refs)
+{
+    for (uint32_t i = 0; i < ctu.m_numPartitions; i += 4)
+    {
+        bool bIntra = !(rnd() % 10);
+        uint8_t interDir = bIntra ? 0 : (uint8_t)(1 + rnd() % 3);
+        MV mv[2];
+        int8_t refIdx[2];
+        for (int list = 0; list < 2; list++)
+        {
+            bool bUsed = !!(interDir & (1 << list));
+            refIdx[list] = bUsed ? (int8_t)(rnd() % refs) : (int8_t)REF_NOT_VALID;
+            mv[list] = bUsed ? MV((int32_t)(rnd() % 129) - 64, (int32_t)(rnd() % 65) - 32) : MV(0, 0);
+        }
+        for (uint32_t j = i; j < i + 4; j++)
+        {
+            ctu.m_predMode[j] = bIntra ? MODE_INTRA : MODE_INTER;
+            ctu.m_interDir[j] = interDir;
+            for (int list = 0; list < 2; list++)
+            {
+                ctu.m_refIdx[list][j] = refIdx[list];
+                ctu.m_mv[list][j] = mv[list];
+            }
+        }
+    }
+}
+
+bool createPicture(Picture& pic, const x265_param& param, const SPS& sps, const PPS& pps, int refs)
+{
+    pic.slice.m_param = &param;
+    pic.slice.m_sps = &sps;
+    pic.slice.m_pps = &pps;
+    pic.encData.m_param = &param;
+    pic.encData.m_slice = &pic.slice;
+    pic.frame.m_encData = &pic.encData;
+
+    if (!pic.pool.create(0, param.internalCsp, sps.numCUsInFrame, param))
+        return false;
+    pic.ctus = new CUData[sps.numCUsInFrame];
+    pic.encData.m_picCTU = pic.ctus;
+    for (uint32_t i = 0; i < sps.numCUsInFrame; i++)
+    {
+        pic.ctus[i].initialize(pic.pool, 0, param, i);
+        pic.ctus[i].initCTU(pic.frame, i, 32, !(i / sps.numCuInWidth), 0, 0);
+        fillMotion(pic.ctus[i], refs);
+    }
+    return true;
+}
+
+void destroyPicture(Picture& pic)
+{
+    delete [] pic.ctus;
+    pic.pool.destroy();
+}
+
+/* candidates of every PU of every CU and partition of one CTU, folded in a
+ * checksum */
+uint64_t deriveCTU(CUData& ctu, CUData* modeCU, const CUGeom* geoms, int refs)
+{
+    static const PartSize sizes[] = { SIZE_2Nx2N, SIZE_2NxN, SIZE_Nx2N, SIZE_2NxnU, SIZE_2NxnD, SIZE_nLx2N, SIZE_nRx2N };
+    uint64_t sum = 0;
+
+    for (int g = 0; g < CUGeom::MAX_GEOMS; g++)
+    {
+        const CUGeom& geom = geoms[g];
+        CUData& cu = modeCU[geom.depth];
+        cu.initSubCU(ctu, geom, 32);
+        cu.setPredModeSubParts(MODE_INTER);
+
+        int numSizes = geom.log2CUSize > 3 ? 7 : 3;
+        for (int s = 0; s < numSizes; s++)
+        {
+            cu.setPartSizeSubParts(sizes[s]);
+
+            for (int puIdx = 0; puIdx < (int)cu.getNumPartInter(0); puIdx++)
+            {
+                PredictionUnit pu(cu, geom, puIdx);
+
+                MVField candMvField[MRG_MAX_NUM_CANDS][2];
+                uint8_t candDir[MRG_MAX_NUM_CANDS];
+                uint32_t numMergeCand = cu.getInterMergeCandidates(pu.puAbsPartIdx, puIdx, candMvField, candDir);
+                for (uint32_t i = 0; i < numMergeCand; i++)
+                    sum = sum * 31 + candDir[i] + candMvField[i][0].mv.word + (candMvField[i][1].mv.word << 3);
+
+                InterNeighbourMV neighbours[6];
+                cu.getNeighbourMV(puIdx, pu.puAbsPartIdx, neighbours);
+                for (int list = 0; list < 2; list++)
+                {
+                    for (int ref = 0; ref < refs; ref++)
+                    {
+                        MV amvpCand[AMVP_NUM_CANDS], mvc[(MD_ABOVE_LEFT + 1) * 2 + 2];
+#if (ENABLE_MULTIVIEW || ENABLE_SCC_EXT)
+                        int numMvc = cu.getPMV(neighbours, list, ref, amvpCand, mvc, puIdx, pu.puAbsPartIdx);
+#else
+                        int numMvc = cu.getPMV(neighbours, list, ref, amvpCand, mvc);
+#endif
+                        sum = sum * 31 + numMvc + amvpCand[0].word + (amvpCand[1].word << 3);
+                    }
+                }
+            }
+        }
+    }
+
+    return sum;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    int ctus = argc > 1 ? atoi(argv[1]) : 2000;
+    int refs = argc > 2 ? atoi(argv[2]) : 3;
+    if (ctus <= 0 || refs <= 0 || refs > MAX_NUM_REF)
+    {
+        printf("usage: MvCandBench [ctus] [refs]\n");
+        return 1;
+    }
+
+    x265_param param;
+    x265_param_default(&param);
+    param.maxCUSize = CTU_SIZE;
+    param.maxLog2CUSize = 6;
+    param.unitSizeDepth = param.maxLog2CUSize - LOG2_UNIT_SIZE;
+    param.num4x4Partitions = 1U << (param.unitSizeDepth << 1);
+    param.maxCUDepth = 3;
+    param.minCUSize = 8;
+    param.internalCsp = X265_CSP_I420;
+
+    SPS sps;
+    sps.picWidthInLumaSamples = WIDTH;
+    sps.picHeightInLumaSamples = HEIGHT;
+    sps.numCuInWidth = WIDTH / CTU_SIZE;
+    sps.numCuInHeight = HEIGHT / CTU_SIZE;
+    sps.numCUsInFrame = sps.numCuInWidth * sps.numCuInHeight;
+    sps.numPartitions = param.num4x4Partitions;
+    sps.numPartInCUSize = 1 << param.unitSizeDepth;
+    sps.bTemporalMVPEnabled = true;
+
+    PPS pps;
+    memset(&pps, 0, sizeof(pps));
+
+    /* the collocated picture is the first L1 reference of a hierarchical B */
+    Picture col, cur;
+    col.slice.m_sliceType = B_SLICE;
+    col.slice.m_poc = 16;
+    cur.slice.m_sliceType = B_SLICE;
+    cur.slice.m_poc = 12;
+    for (int ref = 0; ref < refs; ref++)
+    {
+        col.slice.m_refPOCList[0][ref] = 8 - 8 * ref;
+        col.slice.m_refPOCList[1][ref] = 32 + 16 * ref;
+        cur.slice.m_refPOCList[0][ref] = 8 - 4 * ref;
+        cur.slice.m_refPOCList[1][ref] = 16 + 4 * ref;
+        cur.slice.m_refFrameList[0][ref] = &col.frame;
+        cur.slice.m_refFrameList[1][ref] = &col.frame;
+    }
+    cur.slice.m_numRefIdx[0] = cur.slice.m_numRefIdx[1] = refs;
+    cur.slice.m_maxNumMergeCand = 3;
+    cur.slice.m_colRefIdx = 0;
+    cur.slice.m_colFromL0Flag = false;
+    cur.slice.m_bCheckLDC = false;
+    cur.slice.m_bTemporalMvp = true;
+
+    if (!createPicture(col, param, sps, pps, refs) || !createPicture(cur, param, sps, pps, refs))
+    {
+        printf("allocation failure\n");
+        return 1;
+    }
+
+    CUGeom geoms[CUGeom::MAX_GEOMS];
+    CUData::calcCTUGeoms(CTU_SIZE, CTU_SIZE, CTU_SIZE, 8, geoms);
+
+    CUDataMemPool modePool[NUM_CU_DEPTH];
+    CUData modeCU[NUM_CU_DEPTH];
+    for (uint32_t depth = 0; depth <= param.maxCUDepth; depth++)
+    {
+        if (!modePool[depth].create(depth, param.internalCsp, 1, param))
+        {
+            printf("allocation failure\n");
+            return 1;
+        }
+        modeCU[depth].initialize(modePool[depth], depth, param, 0);
+    }
+
+    printf("%d CTUs of %dx%d, %d references per list\n", ctus, CTU_SIZE, CTU_SIZE, refs);
+
+    MVCandCache cache;
+    uint64_t sum[2] = { 0, 0 };
+    int64_t best[2] = { 0, 0 };
+    for (int pass = 0; pass < 6; pass++)
+    {
+        int bCache = pass & 1;
+        uint64_t passSum = 0;
+        int64_t start = x265_mdate();
+        for (int i = 0; i < ctus; i++)
+        {
+            CUData& ctu = cur.ctus[i % sps.numCUsInFrame];
+            if (bCache)
+                cache.reset(ctu.m_cuAddr);
+            ctu.m_mvCandCache = bCache ? &cache : NULL;
+            passSum += deriveCTU(ctu, modeCU, geoms, refs);
+        }
+        int64_t elapsed = x265_mdate() - start;
+        if (!best[bCache] || elapsed < best[bCache])
+            best[bCache] = elapsed;
+        sum[bCache] = passSum;
+    }
+
+    printf("no cache : %8.2f us per CTU\n", (double)best[0] / ctus);
+    printf("ctu cache: %8.2f us per CTU (x%.2f)\n", (double)best[1] / ctus, (double)best[0] / best[1]);
+
+    for (uint32_t depth = 0; depth <= param.maxCUDepth; depth++)
+        modePool[depth].destroy();
+    destroyPicture(cur);
+    destroyPicture(col);
+
+    if (sum[0] != sum[1])
+    {
+        printf("candidate mismatch\n");
+        return 1;
+    }
+    return 0;
+}
@@ -201,6 +201,33 @@ bool PixelHarness::check_pixelcmp_x4(pixelcmp_x4_t ref, pixelcmp_x4_t opt)
     return true;
 }
 
+bool PixelHarness::check_pixelcmp_xn(pixelcmp_xn_t ref, pixelcmp_xn_t opt)
+{
+    ALIGN_VAR_16(int, cres[16]);
+    ALIGN_VAR_16(int, vres[16]);
+    const pixel* fref[16];
+    int j = 0;
+    intptr_t stride = FENC_STRIDE - 5;
+    for (int i = 0; i < ITERS; i++)
+    {
+        int index1 = rand() % TEST_CASES;
+        int count = 1 + rand() % 16;
+        for (int k = 0; k < count; k++)
+            fref[k] = pixel_test_buff[rand() % TEST_CASES] + j + k;
+
+        checked(opt, pixel_test_buff[index1], fref, count, stride, &vres[0]);
+        ref(pixel_test_buff[index1], fref, count, stride, &cres[0]);
+
+        if (memcmp(vres, cres, count * sizeof(int)))
+            return false;
+
+        reportfail();
+        j += INCR;
+    }
+
+    return true;
+}
+
 bool PixelHarness::check_calresidual(calcresidual_t ref, calcresidual_t opt)
 {
     ALIGN_VAR_16(int16_t, ref_dest[64 * 64]);
@@ -2377,6 +2404,24 @@ bool PixelHarness::testPU(int part, const EncoderPrimitives& ref, const EncoderP
             return false;
         }
     }
+
+    if (opt.pu[part].sad_xn)
+    {
+        if (!check_pixelcmp_xn(ref.pu[part].sad_xn, opt.pu[part].sad_xn))
+        {
+            printf("sad_xn[%s]: failed!\n", lumaPartStr[part]);
+            return false;
+        }
+    }
+
+    if (opt.pu[part].satd_xn)
+    {
+        if (!check_pixelcmp_xn(ref.pu[part].satd_xn, opt.pu[part].satd_xn))
+        {
+            printf("satd_xn[%s]: failed!\n", lumaPartStr[part]);
+            return false;
+        }
+    }
     if (opt.pu[part].pixelavg_pp[NONALIGNED])
     {
         if (!check_pixelavg_pp(ref.pu[part].pixelavg_pp[NONALIGNED], opt.pu[part].pixelavg_pp[NONALIGNED]))
@@ -3238,6 +3283,20 @@ void PixelHarness::measurePartition(int part, const EncoderPrimitives& ref, cons
         REPORT_SPEEDUP(opt.pu[part].sad_x4, ref.pu[part].sad_x4, pbuf1, fref, fref + 1, fref - 1, fref - INCR, FENC_STRIDE + 5, &cres[0]);
     }
 
+    if (opt.pu[part].sad_xn)
+    {
+        const pixel* frefs[8] = { fref, fref + 1, fref - 1, fref - INCR, fref + INCR, fref + 2, fref - 2, fref + INCR + 1 };
+        HEADER("sad_xn[%s]", lumaPartStr[part]);
+        REPORT_SPEEDUP(opt.pu[part].sad_xn, ref.pu[part].sad_xn, pbuf1, frefs, 8, FENC_STRIDE + 5, &cres[0]);
+    }
+
+    if (opt.pu[part].satd_xn)
+    {
+        const pixel* frefs[8] = { fref, fref + 1, fref - 1, fref - INCR, fref + INCR, fref + 2, fref - 2, fref + INCR + 1 };
+        HEADER("satd_xn[%s]", lumaPartStr[part]);
+        REPORT_SPEEDUP(opt.pu[part].satd_xn, ref.pu[part].satd_xn, pbuf1, frefs, 8, FENC_STRIDE + 5, &cres[0]);
+    }
+
     if (opt.pu[part].copy_pp)
     {
         HEADER("copy_pp[%s]", lumaPartStr[part]);
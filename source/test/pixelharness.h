@@ -74,6 +74,7 @@ protected:
     bool check_pixel_sse_ss(pixel_sse_ss_t ref, pixel_sse_ss_t opt);
     bool check_pixelcmp_x3(pixelcmp_x3_t ref, pixelcmp_x3_t opt);
     bool check_pixelcmp_x4(pixelcmp_x4_t ref, pixelcmp_x4_t opt);
+    bool check_pixelcmp_xn(pixelcmp_xn_t ref, pixelcmp_xn_t opt);
     bool check_copy_pp(copy_pp_t ref, copy_pp_t opt);
     bool check_copy_sp(copy_sp_t ref, copy_sp_t opt);
     bool check_copy_ps(copy_ps_t ref, copy_ps_t opt);
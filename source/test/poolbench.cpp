@@ -0,0 +1,338 @@
+/*****************************************************************************
+ * Copyright (C) 2013-2020 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+
+/* Thread pool scheduler micro-benchmark. Compares the sleep bitmap scheduler
+ * with the work-stealing scheduler:
+ *
+ *   wake   - latency from tryWakeOne() on an idle pool until a worker runs findJob()
+ *   steal  - latency when the preferred worker is busy and a peer must steal the job
+ *   fanout - throughput of many tiny jobs which recruit further workers as they run
+ *   idle   - CPU time spent by the pool per wake-up for a low-rate trickle of work
+ *
+ * "PoolBench scaling [frames] [preset]" instead encodes a synthetic 1080p clip
+ * with a single thread pool of 32, 64, 128 and 192 threads in each scheduler
+ * mode and reports fps and fps per pool thread */
+
+#include "common.h"
+#include "threading.h"
+#include "threadpool.h"
+
+#include <time.h>
+
+using namespace X265_NS;
+
+namespace {
+
+class BenchProvider : public JobProvider
+{
+public:
+
+    volatile int64_t   m_wakeTime;
+    int64_t            m_latencySum;
+    ThreadSafeInteger  m_served;
+
+    volatile int32_t   m_jobsLeft;
+    volatile int32_t   m_jobsDone;
+    bool               m_fanout;
+
+    BenchProvider() : m_wakeTime(0), m_latencySum(0), m_jobsLeft(0), m_jobsDone(0), m_fanout(false) {}
+
+    void findJob(int /*workerThreadId*/)
+    {
+        if (m_fanout)
+        {
+            if (ATOMIC_DEC(&m_jobsLeft) >= 0)
+            {
+                m_helpWanted = true;
+                tryWakeOne(); /* recruit another worker while work remains */
+                volatile int spin = 0;
+                for (int i = 0; i < 200; i++)
+                    spin += i;
+                ATOMIC_INC(&m_jobsDone);
+            }
+            else
+                m_helpWanted = false;
+            return;
+        }
+
+        if (m_wakeTime)
+        {
+            m_latencySum += x265_mdate() - m_wakeTime;
+            m_wakeTime = 0;
+            m_served.incr();
+        }
+        m_helpWanted = false;
+    }
+};
+
+/* keeps one worker busy until released, so wakes must go to another worker */
+class BlockerProvider : public JobProvider
+{
+public:
+
+    volatile int32_t m_release;
+    volatile int32_t m_running;
+
+    BlockerProvider() : m_release(0), m_running(0) {}
+
+    void findJob(int /*workerThreadId*/)
+    {
+        if (!m_helpWanted)
+            return;
+        m_helpWanted = false;
+        ATOMIC_INC(&m_running);
+        while (!m_release)
+            GIVE_UP_TIME();
+        ATOMIC_DEC(&m_running);
+    }
+};
+
+double cpuSeconds()
+{
+    return (double)clock() / CLOCKS_PER_SEC;
+}
+
+void sleepMicroseconds(int us)
+{
+#if _WIN32
+    Sleep(us / 1000);
+#else
+    usleep(us);
+#endif
+}
+
+void runMode(int poolMode, int numThreads, int iterations)
+{
+    ThreadPool pool;
+    BenchProvider bench;
+    BlockerProvider blocker;
+
+    uint64_t nodeMask = ((uint64_t)1 << X265_MIN(ThreadPool::getNumaNodeCount(), 63)) - 1;
+    if (!pool.create(numThreads, 2, nodeMask, poolMode == X265_POOL_STEAL))
+    {
+        printf("unable to create thread pool\n");
+        return;
+    }
+    bench.m_pool = blocker.m_pool = &pool;
+    bench.m_jpId = pool.m_numProviders++;
+    pool.m_jpTable[bench.m_jpId] = &bench;
+    blocker.m_jpId = pool.m_numProviders++;
+    pool.m_jpTable[blocker.m_jpId] = &blocker;
+    if (!pool.start())
+    {
+        printf("unable to start thread pool\n");
+        return;
+    }
+    sleepMicroseconds(20000);
+
+    printf("%-7s threads %3d ", x265_pool_mode_names[poolMode], numThreads);
+
+    /* wake latency, pool fully idle */
+    for (int i = 0; i < iterations; i++)
+    {
+        int served = bench.m_served.get();
+        bench.m_wakeTime = x265_mdate();
+        bench.tryWakeOne();
+        while (bench.m_served.get() == served)
+            bench.m_served.waitForChange(served);
+        sleepMicroseconds(200);
+    }
+    printf(" wake %7.2fus", (double)bench.m_latencySum / iterations);
+
+    /* steal latency, the preferred worker is kept busy by the blocker */
+    if (numThreads > 1)
+    {
+        blocker.m_release = 0;
+        blocker.m_helpWanted = true;
+        blocker.tryWakeOne();
+        while (!blocker.m_running)
+            GIVE_UP_TIME();
+        bench.m_latencySum = 0;
+        for (int i = 0; i < iterations; i++)
+        {
+            int served = bench.m_served.get();
+            bench.m_wakeTime = x265_mdate();
+            bench.tryWakeOne(blocker.m_lastWorkerId);
+            while (bench.m_served.get() == served)
+                bench.m_served.waitForChange(served);
+            sleepMicroseconds(200);
+        }
+        blocker.m_release = 1;
+        while (blocker.m_running)
+            GIVE_UP_TIME();
+        printf("  steal %7.2fus", (double)bench.m_latencySum / iterations);
+    }
+
+    /* fan-out throughput */
+    int jobs = iterations * 200;
+    bench.m_fanout = true;
+    bench.m_jobsDone = 0;
+    bench.m_jobsLeft = jobs;
+    int64_t start = x265_mdate();
+    bench.m_helpWanted = true;
+    bench.tryWakeOne();
+    while (bench.m_jobsDone < jobs)
+        GIVE_UP_TIME();
+    int64_t elapsed = x265_mdate() - start;
+    bench.m_fanout = false;
+    printf("  fanout %8.0f jobs/ms", elapsed ? (double)jobs * 1000 / elapsed : 0.0);
+
+    /* idle cost: a trickle of single wakes, CPU time charged per wake */
+    sleepMicroseconds(20000);
+    double cpuStart = cpuSeconds();
+    for (int i = 0; i < iterations; i++)
+    {
+        int served = bench.m_served.get();
+        bench.m_wakeTime = x265_mdate();
+        bench.tryWakeOne();
+        while (bench.m_served.get() == served)
+            bench.m_served.waitForChange(served);
+        sleepMicroseconds(1000);
+    }
+    double cpuUsed = cpuSeconds() - cpuStart;
+    printf("  idle %7.2fus cpu/wake\n", cpuUsed * 1e6 / iterations);
+
+    pool.stopWorkers();
+}
+
+/* fill a moving pattern with some texture so every frame has real motion */
+void fillFrame(x265_picture& pic, int width, int height, int frame)
+{
+    pixel* luma = (pixel*)pic.planes[0];
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+            luma[y * width + x] = (pixel)(((x + frame * 3) ^ (y + frame)) + ((x * y) >> 7));
+
+    for (int c = 1; c < 3; c++)
+    {
+        pixel* chroma = (pixel*)pic.planes[c];
+        for (int y = 0; y < height / 2; y++)
+            for (int x = 0; x < width / 2; x++)
+                chroma[y * (width / 2) + x] = (pixel)((x + y + frame * c) >> 1);
+    }
+}
+
+double encodeClip(int poolMode, int numThreads, int frames, const char* preset)
+{
+    const int width = 1920, height = 1080;
+
+    x265_param* param = x265_param_alloc();
+    x265_param_default_preset(param, preset, NULL);
+    param->sourceWidth = width;
+    param->sourceHeight = height;
+    param->fpsNum = 30;
+    param->fpsDenom = 1;
+    param->internalCsp = X265_CSP_I420;
+    param->logLevel = X265_LOG_WARNING;
+    param->bEnablePsnr = param->bEnableSsim = 0;
+    param->poolMode = poolMode;
+    snprintf(param->numaPools, X265_MAX_STRING_SIZE, "%d", numThreads);
+
+    x265_encoder* encoder = x265_encoder_open(param);
+    if (!encoder)
+    {
+        x265_param_free(param);
+        return 0;
+    }
+
+    x265_picture pic;
+    x265_picture_init(param, &pic);
+    pixel* buf = X265_MALLOC(pixel, width * height * 3 / 2);
+    if (!buf)
+    {
+        x265_encoder_close(encoder);
+        x265_param_free(param);
+        return 0;
+    }
+    pic.planes[0] = buf;
+    pic.planes[1] = buf + width * height;
+    pic.planes[2] = buf + width * height * 5 / 4;
+    pic.stride[0] = width * sizeof(pixel);
+    pic.stride[1] = pic.stride[2] = width / 2 * sizeof(pixel);
+
+    x265_nal* nal;
+    uint32_t nalCount;
+    int64_t start = x265_mdate();
+    for (int i = 0; i < frames; i++)
+    {
+        fillFrame(pic, width, height, i);
+        pic.pts = i;
+        x265_encoder_encode(encoder, &nal, &nalCount, &pic, NULL);
+    }
+    while (x265_encoder_encode(encoder, &nal, &nalCount, NULL, NULL) > 0)
+        ;
+    int64_t elapsed = x265_mdate() - start;
+
+    X265_FREE(buf);
+    x265_encoder_close(encoder);
+    x265_param_free(param);
+
+    return elapsed ? (double)frames * 1000000 / elapsed : 0;
+}
+
+void runScaling(int frames, const char* preset)
+{
+    static const int threadCounts[] = { 32, 64, 128, 192 };
+
+    printf("1080p scaling, %d frames, preset %s, %d hardware threads\n", frames, preset, ThreadPool::getCpuCount());
+    for (int mode = X265_POOL_BITMAP; mode <= X265_POOL_STEAL; mode++)
+    {
+        for (size_t i = 0; i < sizeof(threadCounts) / sizeof(threadCounts[0]); i++)
+        {
+            double fps = encodeClip(mode, threadCounts[i], frames, preset);
+            printf("%-7s threads %3d  %7.2f fps  %7.4f fps/thread\n", x265_pool_mode_names[mode],
+                   threadCounts[i], fps, fps / threadCounts[i]);
+        }
+    }
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1 && !strcmp(argv[1], "scaling"))
+    {
+        runScaling(argc > 2 ? atoi(argv[2]) : 120, argc > 3 ? argv[3] : "medium");
+        return 0;
+    }
+
+    int maxThreads = argc > 1 ? atoi(argv[1]) : ThreadPool::getCpuCount();
+    int iterations = argc > 2 ? atoi(argv[2]) : 1000;
+
+    if (maxThreads < 1 || iterations < 1)
+    {
+        printf("usage: PoolBench [threads] [iterations]\n"
+               "       PoolBench scaling [frames] [preset]\n");
+        return 1;
+    }
+
+    printf("Thread pool scheduler benchmark, %d iterations\n", iterations);
+    for (int threads = 2; ; threads *= 2)
+    {
+        threads = X265_MIN3(threads, maxThreads, (int)MAX_POOL_THREADS);
+        runMode(X265_POOL_BITMAP, threads, iterations);
+        runMode(X265_POOL_STEAL, threads, iterations);
+        if (threads >= X265_MIN(maxThreads, (int)MAX_POOL_THREADS))
+            break;
+    }
+
+    return 0;
+}
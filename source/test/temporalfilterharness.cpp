@@ -0,0 +1,173 @@
+/*****************************************************************************
+ * Copyright (C) 2013-2020 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+
+#include "common.h"
+#include "temporalfilter.h"
+#include "temporalfilterharness.h"
+
+using namespace X265_NS;
+
+TemporalFilterHarness::TemporalFilterHarness()
+{
+    /* [0] --- Random values
+     * [1] --- Minimum and maximum, clipped interpolation
+     * [2] --- Small steps around mid grey, weighted averages close to halves */
+    for (int i = 0; i < BUFFSIZE; i++)
+    {
+        pixel_test_buff[0][i] = rand() % (PIXEL_MAX + 1);
+        pixel_test_buff[1][i] = (rand() & 1) ? PIXEL_MAX : PIXEL_MIN;
+        pixel_test_buff[2][i] = (pixel)((PIXEL_MAX >> 1) + rand() % 3);
+    }
+
+    /* [0] --- Gaussian weights like the encoder's
+     * [1] --- Random weights
+     * [2] --- Unit weights, which make halves with unit reference weights */
+    for (int k = 0; k < 4; k++)
+    {
+        double sigmaSq = (1 + k) * 300.0;
+        for (int d = 0; d <= PIXEL_MAX; d++)
+        {
+            double diff = d * (1024.0 / (PIXEL_MAX + 1));
+            weight_lut[0][k * (PIXEL_MAX + 1) + d] = exp(-diff * diff / (2 * sigmaSq));
+            weight_lut[1][k * (PIXEL_MAX + 1) + d] = (rand() % 1000) / 1000.0;
+            weight_lut[2][k * (PIXEL_MAX + 1) + d] = 1.0;
+        }
+    }
+}
+
+bool TemporalFilterHarness::check_interp(temporal_filter_interp_t ref, temporal_filter_interp_t opt)
+{
+    /* rows -2 to height + 2 and columns -2 to width + 2 are read */
+    const int offset = 2 * STRIDE + 8;
+
+    for (int i = 0; i < ITERS; i++)
+    {
+        int index = i % TEST_CASES;
+        int width = (rand() & 1) ? 8 : 4;
+        int height = (rand() & 1) ? 8 : 4;
+        int x = rand() % (STRIDE - 8 - 16);
+        int y = rand() % (BUFFSIZE / STRIDE - 2 - 8 - 3);
+        const int* xFilter = s_interpolationFilter[rand() & 15];
+        const int* yFilter = s_interpolationFilter[rand() & 15];
+
+        memset(pixel_out_c, 0xCD, sizeof(pixel_out_c));
+        memset(pixel_out_vec, 0xCD, sizeof(pixel_out_vec));
+
+        ref(pixel_out_c, STRIDE, pixel_test_buff[index] + offset + y * STRIDE + x, STRIDE, width, height, xFilter, yFilter);
+        checked(opt, pixel_out_vec, (intptr_t)STRIDE, pixel_test_buff[index] + offset + y * STRIDE + x, (intptr_t)STRIDE, width, height, xFilter, yFilter);
+
+        if (memcmp(pixel_out_c, pixel_out_vec, sizeof(pixel_out_c)))
+            return false;
+
+        reportfail();
+    }
+
+    return true;
+}
+
+bool TemporalFilterHarness::check_blend(temporal_filter_blend_t ref, temporal_filter_blend_t opt)
+{
+    for (int i = 0; i < ITERS; i++)
+    {
+        int index = i % TEST_CASES;
+        int numRefs = 1 + rand() % MAX_REFS;
+        int width = 1 + rand() % 8;
+        int height = 1 + rand() % 8;
+        int dst = rand() % (BUFFSIZE - 8 * STRIDE);
+
+        const pixel* refs[MAX_REFS];
+        const double* luts[MAX_REFS];
+        double refWeight[MAX_REFS];
+        for (int r = 0; r < numRefs; r++)
+        {
+            refs[r] = pixel_test_buff[(index + r) % TEST_CASES] + rand() % (BUFFSIZE - 8 * STRIDE);
+            luts[r] = weight_lut[index] + (rand() & 3) * (PIXEL_MAX + 1);
+            refWeight[r] = index == 2 ? 1.0 : (1 + rand() % 2000) / 1000.0;
+        }
+
+        memcpy(pixel_out_c, pixel_test_buff[index], sizeof(pixel_out_c));
+        memcpy(pixel_out_vec, pixel_test_buff[index], sizeof(pixel_out_vec));
+
+        ref(pixel_out_c + dst, STRIDE, refs, STRIDE, numRefs, refWeight, luts, width, height);
+        checked(opt, pixel_out_vec + dst, (intptr_t)STRIDE, refs, (intptr_t)STRIDE, numRefs, (const double*)refWeight, (const double* const*)luts, width, height);
+
+        if (memcmp(pixel_out_c, pixel_out_vec, sizeof(pixel_out_c)))
+            return false;
+
+        reportfail();
+    }
+
+    return true;
+}
+
+bool TemporalFilterHarness::testCorrectness(const EncoderPrimitives& ref, const EncoderPrimitives& opt)
+{
+    if (opt.temporalFilterInterp)
+    {
+        if (!check_interp(ref.temporalFilterInterp, opt.temporalFilterInterp))
+        {
+            printf("temporalFilterInterp failed\n");
+            return false;
+        }
+    }
+
+    if (opt.temporalFilterBlend)
+    {
+        if (!check_blend(ref.temporalFilterBlend, opt.temporalFilterBlend))
+        {
+            printf("temporalFilterBlend failed\n");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+#define HEADER0(str) printf("%22s", str);
+
+void TemporalFilterHarness::measureSpeed(const EncoderPrimitives& ref, const EncoderPrimitives& opt)
+{
+    const int offset = 2 * STRIDE + 8;
+
+    if (opt.temporalFilterInterp)
+    {
+        HEADER0("temporalFilterInterp[8x8]");
+        REPORT_SPEEDUP(opt.temporalFilterInterp, ref.temporalFilterInterp, pixel_out_vec, STRIDE, pixel_test_buff[0] + offset, STRIDE, 8, 8, s_interpolationFilter[5], s_interpolationFilter[11]);
+        HEADER0("temporalFilterInterp[4x4]");
+        REPORT_SPEEDUP(opt.temporalFilterInterp, ref.temporalFilterInterp, pixel_out_vec, STRIDE, pixel_test_buff[0] + offset, STRIDE, 4, 4, s_interpolationFilter[5], s_interpolationFilter[11]);
+    }
+
+    if (opt.temporalFilterBlend)
+    {
+        const pixel* refs[MAX_REFS];
+        const double* luts[MAX_REFS];
+        double refWeight[MAX_REFS];
+        for (int r = 0; r < MAX_REFS; r++)
+        {
+            refs[r] = pixel_test_buff[0] + (r + 1) * 8 * STRIDE;
+            luts[r] = weight_lut[0] + r * (PIXEL_MAX + 1);
+            refWeight[r] = 0.4 / (r + 1);
+        }
+
+        HEADER0("temporalFilterBlend[8x8]");
+        REPORT_SPEEDUP(opt.temporalFilterBlend, ref.temporalFilterBlend, pixel_out_vec, STRIDE, refs, STRIDE, MAX_REFS, refWeight, luts, 8, 8);
+    }
+}
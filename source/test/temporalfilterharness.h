@@ -0,0 +1,58 @@
+/*****************************************************************************
+ * Copyright (C) 2013-2020 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+
+#ifndef _TEMPORALFILTERHARNESS_H_1
+#define _TEMPORALFILTERHARNESS_H_1 1
+
+#include "testharness.h"
+#include "primitives.h"
+
+class TemporalFilterHarness : public TestHarness
+{
+protected:
+
+    enum { TEST_CASES = 3 };
+    enum { ITERS = 200 };
+    enum { STRIDE = 64 };
+    enum { MAX_REFS = 4 };
+    enum { BUFFSIZE = STRIDE * 32 };
+    enum { LUT_SIZE = 4 * (PIXEL_MAX + 1) };
+
+    pixel  pixel_test_buff[TEST_CASES][BUFFSIZE];
+    pixel  pixel_out_c[BUFFSIZE];
+    pixel  pixel_out_vec[BUFFSIZE];
+    double weight_lut[TEST_CASES][LUT_SIZE];
+
+    bool check_interp(temporal_filter_interp_t ref, temporal_filter_interp_t opt);
+    bool check_blend(temporal_filter_blend_t ref, temporal_filter_blend_t opt);
+
+public:
+
+    TemporalFilterHarness();
+
+    const char *getName() const { return "temporalfilter"; }
+
+    bool testCorrectness(const EncoderPrimitives& ref, const EncoderPrimitives& opt);
+
+    void measureSpeed(const EncoderPrimitives& ref, const EncoderPrimitives& opt);
+};
+
+#endif // ifndef _TEMPORALFILTERHARNESS_H_1
@@ -31,6 +31,8 @@
 #include "mbdstharness.h"
 #include "ipfilterharness.h"
 #include "intrapredharness.h"
+#include "lookaheadharness.h"
+#include "temporalfilterharness.h"
 #include "param.h"
 #include "cpu.h"
 
@@ -95,6 +97,8 @@ PixelHarness  HPixel;
 MBDstHarness  HMBDist;
 IPFilterHarness HIPFilter;
 IntraPredHarness HIPred;
+LookaheadHarness HLookahead;
+TemporalFilterHarness HTemporalFilter;
 
 int main(int argc, char *argv[])
 {
@@ -165,7 +169,9 @@ int main(int argc, char *argv[])
         &HPixel,
         &HMBDist,
         &HIPFilter,
-        &HIPred
+        &HIPred,
+        &HLookahead,
+        &HTemporalFilter
     };
 
     EncoderPrimitives cprim;
@@ -116,6 +116,53 @@ typedef struct x265_lookahead_data
     int64_t   reorderedPts;
 } x265_lookahead_data;
 
+/* Lookahead analysis file, written by param.lookaheadSave and read by
+ * param.lookaheadLoad. A header is followed by one fixed size record per
+ * picture in POC order, so the file may be mapped and indexed directly. All
+ * fields are in host byte order. Readers must use headerSize and recordSize
+ * to locate records; later versions only append fields */
+#define X265_LOOKAHEAD_FILE_MAGIC   0x4b4c3532 /* "25LK" */
+#define X265_LOOKAHEAD_FILE_VERSION 2
+
+typedef struct x265_lookahead_file_header
+{
+    uint32_t  magic;
+    uint32_t  version;
+    uint32_t  headerSize;     /* bytes before the first record */
+    uint32_t  recordSize;     /* bytes from one record to the next, a multiple of 8 */
+    uint32_t  numFrames;
+    uint32_t  sourceWidth;
+    uint32_t  sourceHeight;
+    uint32_t  fpsNum;
+    uint32_t  fpsDenom;
+    uint32_t  numPlanned;     /* plannedSatd and plannedType entries per record */
+    uint32_t  numLowresCUs;   /* intraCost entries per record, 8x8 lowres CUs */
+    uint32_t  numQpOffsets;   /* qpCuTreeOffset entries per record */
+    uint32_t  qgSize;
+    uint32_t  cuTree;         /* qpCuTreeOffset holds cuTree rather than AQ offsets */
+    uint32_t  bframes;
+    uint32_t  bBPyramid;
+    uint32_t  keyframeMax;
+    uint32_t  keyframeMin;
+    uint32_t  bOpenGOP;
+    uint32_t  reserved[5];
+} x265_lookahead_file_header;
+
+/* Fixed part of a picture record. It is followed by int64_t
+ * plannedSatd[numPlanned], double qpCuTreeOffset[numQpOffsets], int32_t
+ * plannedType[numPlanned] and int32_t intraCost[numLowresCUs], then padded
+ * to recordSize. The offsets are kept at full precision so a loading encode
+ * uses exactly the offsets of the encode that wrote them */
+typedef struct x265_lookahead_frame_record
+{
+    int32_t   poc;
+    int32_t   sliceType;      /* X265_TYPE_* */
+    int32_t   bKeyframe;
+    int32_t   bScenecut;
+    int64_t   intraSatd;      /* lowres intra cost of the picture */
+    int64_t   reserved;
+} x265_lookahead_frame_record;
+
 typedef struct x265_analysis_validate
 {
     int     maxNumReferences;
@@ -318,6 +365,14 @@ typedef struct x265_frame_stats
     int64_t          currTrBitrate;
     double           currTrCRF;
     int              currTrQP;
+    double           refStallTime;       /* sum over CTU rows of time spent waiting on reference rows */
+    double           wppStallTime;       /* sum over CTU rows of time spent waiting on the row above */
+    double           maxRowRefStallTime;
+    double           maxRowWppStallTime;
+    int              lookaheadDepth;     /* lookahead window, trellis depth and cooperative slices */
+    int              lookaheadTrellis;   /* the frame was decided with (adaptive-lookahead) */
+    int              lookaheadSlices;
+    int              bLookaheadAdapted;  /* the setting differs from that of the previous frame */
 } x265_frame_stats;
 
 typedef struct x265_ctu_info_t
@@ -511,7 +566,8 @@ typedef enum
     X265_UMH_SEARCH,
     X265_STAR_SEARCH,
     X265_SEA,
-    X265_FULL_SEARCH
+    X265_FULL_SEARCH,
+    X265_EPZS_SEARCH
 } X265_ME_METHODS;
 
 /* CPU flags */
@@ -632,6 +688,10 @@ typedef enum
 #define X265_ANALYSIS_SAVE 1
 #define X265_ANALYSIS_LOAD 2
 
+/* Thread pool scheduler modes */
+#define X265_POOL_BITMAP   0
+#define X265_POOL_STEAL    1
+
 #define FORWARD                 1
 #define BACKWARD                2
 #define BI_DIRECTIONAL          3
@@ -741,7 +801,7 @@ typedef struct x265_stats
 } x265_stats;
 
 /* String values accepted by x265_param_parse() (and CLI) for various parameters */
-static const char * const x265_motion_est_names[] = { "dia", "hex", "umh", "star", "sea", "full", 0 };
+static const char * const x265_motion_est_names[] = { "dia", "hex", "umh", "star", "sea", "full", "epzs", 0 };
 static const char * const x265_source_csp_names[] = { "i400", "i420", "i422", "i444", "nv12", "nv16", 0 };
 static const char * const x265_video_format_names[] = { "component", "pal", "ntsc", "secam", "mac", "unknown", 0 };
 static const char * const x265_fullrange_names[] = { "limited", "full", 0 };
@@ -755,6 +815,7 @@ static const char * const x265_sar_names[] = { "unknown", "1:1", "12:11", "10:11
                                                "32:11", "80:33", "18:11", "15:11", "64:33", "160:99", "4:3", "3:2", "2:1", 0 };
 static const char * const x265_interlace_names[] = { "prog", "tff", "bff", 0 };
 static const char * const x265_analysis_names[] = { "off", "save", "load", 0 };
+static const char * const x265_pool_mode_names[] = { "bitmap", "steal", 0 };
 
 struct x265_zone;
 struct x265_param;
@@ -1145,7 +1206,7 @@ typedef struct x265_param
      * implicitly disabled.
      *
      * Multiple thread pools will be allocated for any NUMA node with more than
-     * 64 logical CPU cores. But any given thread pool will always use at most
+     * 256 logical CPU cores. But any given thread pool will always use at most
      * one NUMA node.
      *
      * Frame encoders are distributed between the available thread pools, and
@@ -1519,13 +1580,17 @@ typedef struct x265_param
     /* Limit modes analyzed for each CU using cost metrics from the 4 sub-CUs */
     uint32_t limitModes;
 
-    /* ME search method (DIA, HEX, UMH, STAR, SEA, FULL). The search patterns
-     * (methods) are sorted in increasing complexity, with diamond being the
-     * simplest and fastest and full being the slowest.  DIA, HEX, UMH and SEA were
+    /* ME search method (DIA, HEX, UMH, STAR, SEA, FULL, EPZS). The methods up
+     * to FULL are sorted in increasing complexity, with diamond being the
+     * simplest and fastest and full being the slowest; EPZS was appended
+     * after FULL and is not part of this ordering.  DIA, HEX, UMH and SEA were
      * adapted from x264 directly. STAR is an adaption of the HEVC reference
-     * encoder's three step search, while full is a naive exhaustive search. The
-     * default is the star search, it has a good balance of performance and
-     * compression efficiency */
+     * encoder's three step search, while full is a naive exhaustive search. EPZS
+     * is a predictive zonal search which adds the co-located motion of the
+     * reference picture, the lookahead vector and the global motion to the
+     * predictors and refines the best of them, widening to the multi-hexagon grid
+     * of umh only when the match stays poor. The default is the star search, it
+     * has a good balance of performance and compression efficiency */
     int       searchMethod;
 
     /* A value between 0 and X265_MAX_SUBPEL_LEVEL which adjusts the amount of
@@ -2364,6 +2429,81 @@ typedef struct x265_param
     /*Frame level RateControl Configuration*/
     int     bConfigRCFrame;
     int    isAbrLadderEnable;
+
+    /* Scheduler used by the worker thread pools. X265_POOL_BITMAP (default)
+     * keeps idle workers in a sleep bitmap and has idle workers scan every
+     * job provider for work. X265_POOL_STEAL gives each worker its own deque
+     * of job providers wanting help, idle workers steal from their peers, and
+     * wavefront rows are preferably handed back to the worker which last
+     * encoded them. Pools may hold up to 256 threads in either mode */
+    int     poolMode;
+
+    /* Update the cuTree propagation of the lookahead window incrementally:
+     * frames whose propagation step is unchanged since the previous mini-GOP
+     * only pass on the change in their propagate cost, and changes too small
+     * to move the QP offsets are not carried further. The QP offsets stay
+     * close to, but are not bit-exact with, a full propagation. Requires
+     * rc-lookahead > 0; not used with aq-motion or 2-pass reads. Default 0 */
+    int     bIncrementalCuTree;
+
+    /* Share the motion fields of frame pairs between the motion searches of
+     * the lookahead and MCSTF. MCSTF starts its hierarchical search from the
+     * lowres (or HME) vectors the lookahead found for the same pair and skips
+     * the coarse layers. The analysis motion search is unaffected. Output is
+     * not bit-exact with the default. Requires mcstf. Default 0 */
+    int     bShareMotionFields;
+
+    /* Adapt the lookahead to the throughput of the encoder. While the encoder
+     * runs slower than lookaheadTargetFps the lookahead window (down to
+     * lookaheadMinDepth), the b-adapt 2 trellis depth (down to 1) and, when
+     * the frame encoders are not waiting on the lookahead, the cooperative
+     * lookahead slices are lowered; they are raised back towards rc-lookahead,
+     * bframes and lookahead-slices once there is headroom. The setting each
+     * frame was decided with is reported in x265_frame_stats. Output depends
+     * on timing. Default 0 */
+    int     bAdaptiveLookahead;
+
+    /* Wall-clock frame rate held by the adaptive lookahead. 0 uses the input
+     * frame rate. Default 0 */
+    double  lookaheadTargetFps;
+
+    /* Smallest lookahead window the adaptive lookahead may use. 0 selects
+     * bframes + 2. Default 0 */
+    int     lookaheadMinDepth;
+
+    /* Write the slice types, cuTree offsets, lowres intra costs and VBV
+     * plan of every picture to this lookahead analysis file, in the format of
+     * x265_lookahead_file_header. Default disabled */
+    char    lookaheadSave[X265_MAX_STRING_SIZE];
+
+    /* Take the slice types, cuTree offsets and VBV plan from a lookahead
+     * analysis file instead of deciding them. The lookahead then only
+     * prepares the lowres pictures and their frame costs. The file must have
+     * been written for the same source and GOP settings. Default disabled */
+    char    lookaheadLoad[X265_MAX_STRING_SIZE];
+
+    /* Run only the lookahead; no picture is encoded and no bitstream is
+     * output. Meant to be used with lookaheadSave, encode calls return one
+     * per picture leaving the lookahead. Default 0 */
+    int     bLookaheadOnly;
+
+    /* Number of cost estimates of one lowres picture evaluated together by a
+     * lookahead batch job, 1 to 8. Larger groups lower the job overhead of
+     * small lowres pictures. 0 selects a grain from the lowres picture size.
+     * Does not change the encode. Default 0 */
+    int     lookaheadBatch;
+
+    /* Predict the split decision of 16x16 to 64x64 CUs with per-size
+     * classifiers trained during the encode on the decisions of earlier
+     * frames of the same slice type, and skip the recursion (or the
+     * unsplit modes) of the CUs they are confident about. Default disabled */
+    int     bSplitPredict;
+
+    /* Probability a split prediction must reach, and the accuracy measured
+     * on the predictions of its side, before a branch of the analysis is
+     * skipped, 0.5 to 1.0. Only read when bSplitPredict is enabled.
+     * Default 0.9 */
+    double  splitPredictThreshold;
 } x265_param;
 
 /* x265_param_alloc:
@@ -2532,6 +2672,27 @@ int x265_encoder_headers(x265_encoder *, x265_nal **pp_nal, uint32_t *pi_nal);
  *      Once flushing has begun, all subsequent calls must pass pic_in as NULL. */
 int x265_encoder_encode(x265_encoder* encoder, x265_nal** pp_nal, uint32_t* pi_nal, x265_picture* pic_in, x265_picture* pic_out);
 
+/* x265_encoder_get_input_buffer:
+ *      returns a picture whose planes point directly into a source frame owned
+ *      by the encoder's frame pool, so the caller can write (or read from file)
+ *      the next input picture in place and avoid the copy normally made by
+ *      x265_encoder_encode. The planes are padded and aligned for the encoder;
+ *      stride is in bytes, bitDepth is the internal bit depth and the samples
+ *      written must already be within that range. Pass the picture (or a copy
+ *      of it with the same plane pointers) to x265_encoder_encode to submit it,
+ *      or to x265_encoder_release_input_buffer to give it back unused.
+ *      Returns NULL if in-place input is not possible for this configuration
+ *      (copy-pic disabled, multi-layer encodes or frame duplication), in which
+ *      case the caller must fall back to its own buffers. May be called from a
+ *      different thread than x265_encoder_encode. */
+x265_picture *x265_encoder_get_input_buffer(x265_encoder *encoder);
+
+/* x265_encoder_release_input_buffer:
+ *      return a picture obtained from x265_encoder_get_input_buffer which will
+ *      not be encoded. Buffers still outstanding are released by
+ *      x265_encoder_close. */
+void x265_encoder_release_input_buffer(x265_encoder *encoder, x265_picture *pic);
+
 /*
 x265_configure_vbv_end:
 * Set the Vbvend flag based on the totalstreamduration.
@@ -2713,6 +2874,8 @@ typedef struct x265_api
     void          (*vmaf_encoder_log)(x265_encoder*, int, char**, x265_param *, x265_vmaf_data *);
 #endif
     int           (*zone_param_parse)(x265_param*, const char*, const char*);
+    x265_picture* (*encoder_get_input_buffer)(x265_encoder*);
+    void          (*encoder_release_input_buffer)(x265_encoder*, x265_picture*);
     /* add new pointers to the end, or increment X265_MAJOR_VERSION */
 } x265_api;
 
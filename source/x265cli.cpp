@@ -27,6 +27,8 @@
 
 #include "x265cli.h"
 #include "svt.h"
+#include "output/asyncoutput.h"
+#include "threadpool.h"
 
 #ifdef ENABLE_LSMASH
 #include <lsmash.h>
@@ -82,6 +84,8 @@ namespace X265_NS {
 #endif
             "\n");
         H0("-D/--output-depth 8|10|12        Output bit depth (also internal bit depth). Default %d\n", param->internalBitDepth);
+        H0("   --output-queue <integer>      Frames queued for the output writer thread, 0 writes synchronously. Default 16\n");
+        H1("   --output-prealloc <integer>   Reserve this many MiB of disk for a raw bitstream output. Default 0\n");
         H0("   --log-level <string>          Logging level: none error warning info debug full. Default %s\n", X265_NS::logLevelNames[param->logLevel + 1]);
         H1("   --log-file <filename>         Save log to file\n" );
         H1("   --log-file-level <string>     Log-file logging level: none error warning info debug full. Default %s\n", X265_NS::logLevelNames[param->logfLevel + 1]);
@@ -116,6 +120,9 @@ namespace X265_NS {
         H1("   --dither                      Enable dither if downscaling to 8 bit pixels. Default disabled\n");
         H0("   --[no-]copy-pic               Copy buffers of input picture in the frame. Default %s\n", OPT(param->bCopyPicToFrame));
         H0("   --reader-options              Pass reader-specific options to input file reader\n");
+        H1("   --vf-threads <integer>        Frames the --vf filter chain processes in parallel, 0 auto, 1 on the reader thread. Default 0\n");
+        H0("   --input-io <string>           How yuv and y4m frames are read: fread, mmap, direct. Default fread\n");
+        H0("   --read-ahead <integer>        Frames the yuv and y4m readers read ahead of the encoder (1..%d). Default %d\n", MAX_READ_AHEAD, DEFAULT_READ_AHEAD);
         H0("\nQuality reporting metrics:\n");
         H0("   --[no-]ssim                   Enable reporting SSIM metric scores. Default %s\n", OPT(param->bEnableSsim));
         H0("   --[no-]psnr                   Enable reporting PSNR metric scores. Default %s\n", OPT(param->bEnablePsnr));
@@ -128,6 +135,7 @@ namespace X265_NS {
         H0("\nThreading, performance:\n");
         H0("   --pools <integer,...>         Comma-separated thread count per thread pool (pool per NUMA node)\n");
         H0("                                 '-' implies no threads on node, '+' implies one thread per core on node\n");
+        H0("   --pool-mode <string>          Thread pool scheduler: bitmap, steal (per-worker work-stealing deques). Default %s\n", x265_pool_mode_names[param->poolMode]);
         H0("-F/--frame-threads <integer>     Number of concurrently encoded frames. 0: auto-determined by core count\n");
         H0("   --[no-]wpp                    Enable Wavefront Parallel Processing. Default %s\n", OPT(param->bEnableWavefront));
         H0("   --[no-]slices <integer>       Enable Multiple Slices feature. Default %d\n", param->maxSlices);
@@ -169,6 +177,8 @@ namespace X265_NS {
            "                                 Default %d\n", param->recursionSkipMode);
         H1("   --rskip-edge-threshold        Threshold in terms of percentage (an integer of range [0,100]) for minimum edge density in CU's used to prune the recursion depth.\n");
         H1("                                 Applicable only to rskip mode 2. Value is preset dependent. Default: %.f\n", param->edgeVarThreshold*100.0f);
+        H1("   --[no-]split-predict          Skip CU recursion branches predicted by online trained split classifiers. Default %s\n", OPT(param->bSplitPredict));
+        H1("   --split-predict-threshold <float> Confidence needed to skip a branch, 0.5 to 1.0. Default %.2f\n", param->splitPredictThreshold);
         H1("   --[no-]tskip-fast             Enable fast intra transform skipping. Default %s\n", OPT(param->bEnableTSkipFast));
         H1("   --[no-]splitrd-skip           Enable skipping split RD analysis when sum of split CU rdCost larger than one split CU rdCost for Intra CU. Default %s\n", OPT(param->bEnableSplitRdSkip));
         H1("   --nr-intra <integer>          An integer value in range of 0 to 2000, which denotes strength of noise reduction in intra CUs. Default 0\n");
@@ -188,7 +198,7 @@ namespace X265_NS {
         H0("   --max-merge <1..5>            Maximum number of merge candidates. Default %d\n", param->maxNumMergeCand);
         H0("   --ref <integer>               max number of L0 references to be allowed (1 .. 16) Default %d\n", param->maxNumReferences);
         H0("   --limit-refs <0|1|2|3>        Limit references per depth (1) or CU (2) or both (3). Default %d\n", param->limitReferences);
-        H0("   --me <string>                 Motion search method dia hex umh star full. Default %d\n", param->searchMethod);
+        H0("   --me <string>                 Motion search method dia hex umh star full epzs. Default %d\n", param->searchMethod);
         H0("-m/--subme <integer>             Amount of subpel refinement to perform (0:least .. 7:most). Default %d \n", param->subpelRefine);
         H0("   --merange <integer>           Motion search range. Default %d\n", param->searchRange);
         H0("   --[no-]rect                   Enable rectangular motion partitions Nx2N and 2NxN. Default %s\n", OPT(param->bEnableRectInter));
@@ -227,6 +237,13 @@ namespace X265_NS {
         H0("   --intra-refresh               Use Periodic Intra Refresh instead of IDR frames\n");
         H0("   --rc-lookahead <integer>      Number of frames for frame-type lookahead (determines encoder latency) Default %d\n", param->lookaheadDepth);
         H1("   --lookahead-slices <0..16>    Number of slices to use per lookahead cost estimate. Default %d\n", param->lookaheadSlices);
+        H1("   --[no-]adaptive-lookahead     Adapt lookahead depth, trellis depth and slices to the encoder throughput. Default %s\n", OPT(param->bAdaptiveLookahead));
+        H1("   --lookahead-target-fps <float> Wall-clock frame rate held by adaptive-lookahead. 0 uses the input frame rate. Default %.1f\n", param->lookaheadTargetFps);
+        H1("   --lookahead-min <integer>     Smallest lookahead window of adaptive-lookahead. 0 selects bframes + 2. Default %d\n", param->lookaheadMinDepth);
+        H1("   --lookahead-save <filename>   Write slice types, cuTree offsets, intra costs and VBV plan to a lookahead analysis file\n");
+        H1("   --lookahead-load <filename>   Take slice types, cuTree offsets and VBV plan from a lookahead analysis file\n");
+        H1("   --[no-]lookahead-only         Run only the lookahead, no bitstream is written. Use with --lookahead-save. Default %s\n", OPT(param->bLookaheadOnly));
+        H1("   --lookahead-batch <0..8>      Cost estimates of one lowres picture per lookahead batch job. 0 auto. Default %d\n", param->lookaheadBatch);
         H0("   --lookahead-threads <integer> Number of threads to be dedicated to perform lookahead only. Default %d\n", param->lookaheadThreads);
         H0("-b/--bframes <0..16>             Maximum number of consecutive b-frames. Default %d\n", param->bframes);
         H1("   --bframe-bias <integer>       Bias towards B frame decisions. Default %d\n", param->bFrameBias);
@@ -317,6 +334,7 @@ namespace X265_NS {
         H1("   --[no-]sbrc                   Enables the segment based rate control. Default %s\n", OPT(param->bEnableSBRC));
         H0("   --qg-size <int>               Specifies the size of the quantization group (64, 32, 16, 8). Default %d\n", param->rc.qgSize);
         H0("   --[no-]cutree                 Enable cutree for Adaptive Quantization. Default %s\n", OPT(param->rc.cuTree));
+        H1("   --[no-]cutree-incremental     Propagate only the changes of the lookahead window in cutree. Default %s\n", OPT(param->bIncrementalCuTree));
         H0("   --[no-]rc-grain               Enable rate-control mode to handle grains specifically. Turned on with tune grain. Default %s\n", OPT(param->rc.bEnableGrain));
         H1("   --ipratio <float>             QP factor between I and P. Default %.2f\n", param->rc.ipFactor);
         H1("   --pbratio <float>             QP factor between P and B. Default %.2f\n", param->rc.pbFactor);
@@ -430,6 +448,7 @@ namespace X265_NS {
         H0("   --[no-]frame-dup              Enable Frame duplication. Default %s\n", OPT(param->bEnableFrameDuplication));
         H0("   --dup-threshold <integer>     PSNR threshold for Frame duplication. Default %d\n", param->dupThreshold);
         H0("   --[no-]mcstf                  Enable GOP-based temporal filter. Default %d\n", param->bEnableTemporalFilter);
+        H1("   --[no-]share-motion-fields    Seed the MCSTF motion search from the lookahead. Default %s\n", OPT(param->bShareMotionFields));
 #if ENABLE_ALPHA
         H0("   --alpha                       Enable alpha channel support. Default %d\n", param->bEnableAlpha);
 #endif
@@ -892,6 +911,38 @@ namespace X265_NS {
                 OPT("output-depth")   /* handled above */;
                 OPT("recon-y4m-exec") reconPlayCmd = optarg;
                 OPT("reader-options") this->readerOpts = optarg;
+                OPT("output-queue")
+                {
+                    this->outputQueue = x265_atoi(optarg, bError);
+                    if (this->outputQueue < 0)
+                    {
+                        x265_log(NULL, X265_LOG_ERROR, "--output-queue must not be negative\n");
+                        return true;
+                    }
+                }
+                OPT("output-prealloc") this->outputPrealloc = x265_atoi(optarg, bError);
+                OPT("input-io")
+                {
+                    int i;
+                    for (i = 0; input_io_names[i]; i++)
+                        if (!strcmp(optarg, input_io_names[i]))
+                            break;
+                    if (!input_io_names[i])
+                    {
+                        x265_log(NULL, X265_LOG_ERROR, "invalid --input-io %s, expected fread, mmap or direct\n", optarg);
+                        return true;
+                    }
+                    this->inputIO = i;
+                }
+                OPT("read-ahead")
+                {
+                    this->readAhead = x265_atoi(optarg, bError);
+                    if (this->readAhead < 1 || this->readAhead > MAX_READ_AHEAD)
+                    {
+                        x265_log(NULL, X265_LOG_ERROR, "--read-ahead must be between 1 and %d\n", MAX_READ_AHEAD);
+                        return true;
+                    }
+                }
                 OPT("svt")    /* handled above */;
                 OPT("qpfile")
                 {
@@ -940,6 +991,7 @@ namespace X265_NS {
                 }
                 OPT("no-zonefile-rc-init") this->param->bNoResetZoneConfig = true;
                 OPT("vf") this->vf = optarg;
+                OPT("vf-threads") this->filterThreads = x265_atoi(optarg, bError);
                 OPT("fullhelp")
                 {
                     param->logLevel = X265_LOG_FULL;
@@ -1041,6 +1093,8 @@ namespace X265_NS {
             info[i].sarHeight = param->vui.sarHeight;
             info[i].skipFrames = seek;
             info[i].encodeToFrame = this->framesToBeEncoded;
+            info[i].ioMode = this->inputIO;
+            info[i].readAhead = this->readAhead;
             info[i].frameCount = 0;
             getParamAspectRatio(param, info[i].sarWidth, info[i].sarHeight);
 
@@ -1060,6 +1114,9 @@ namespace X265_NS {
                 return true;
             }
         }
+        this->inputInfo = info[0];
+        this->inputInfo.filename = NULL;
+        snprintf(this->inputName, sizeof(this->inputName), "%s", inputfn[0]);
 
             //TODO:Validate info params of both the views to equal values
 
@@ -1068,6 +1125,14 @@ namespace X265_NS {
             bool bFail = Filter::parseFilterString(this->vf, &this->filters);
             if (bFail)
                 return true;
+            if (this->filterThreads < 0 || this->filterThreads > FilterPipeline::MAX_THREADS)
+            {
+                x265_log(NULL, X265_LOG_ERROR, "--vf-threads must be between 0 and %d\n", (int)FilterPipeline::MAX_THREADS);
+                return true;
+            }
+            /* auto: leave most cores to the encoder */
+            if (!this->filterThreads)
+                this->filterThreads = X265_MIN(X265_MAX(ThreadPool::getCpuCount() / 4, 1), 4);
         }
 
         /* Unconditionally accept height/width/csp/bitDepth from file info */
@@ -1137,13 +1202,15 @@ namespace X265_NS {
                 general_log(param, input[view]->getName(), X265_LOG_INFO, "%s\n", buf);
         }
 
-        for (int view = 0; view < param->numViews - !!param->format; view++)
-            this->input[view]->startReader();
-
         if (!preset) preset = "medium";
         if (!tune) tune = "none";
         x265_log(param, X265_LOG_INFO, "Using preset %s & tune %s\n", preset, tune);
 
+        if (reconfn[0] && param->bLookaheadOnly)
+        {
+            x265_log(param, X265_LOG_WARNING, "lookahead-only encodes no pictures, recon file is not written\n");
+            reconfn[0] = NULL;
+        }
         if (reconfn[0])
         {
             if (reconFileBitDepth == 0)
@@ -1209,6 +1276,10 @@ namespace X265_NS {
             x265_log_file(param, X265_LOG_ERROR, "failed to open output file <%s> for writing\n", outputfn);
             return true;
         }
+        if (this->outputPrealloc > 0)
+            this->output->preallocate((int64_t)this->outputPrealloc << 20);
+        if (this->outputQueue > 0)
+            this->output = new AsyncOutput(this->output, this->outputQueue);
         general_log_file(param, this->output->getName(), X265_LOG_INFO, "output file: %s\n", outputfn);
 
         for (int view = 0; view < MAX_VIEWS; view++)
@@ -57,6 +57,7 @@ static const struct option long_options[] =
     { "no-asm",               no_argument, NULL, 0 },
     { "pools",          required_argument, NULL, 0 },
     { "numa-pools",     required_argument, NULL, 0 },
+    { "pool-mode",      required_argument, NULL, 0 },
     { "preset",         required_argument, NULL, 'p' },
     { "tune",           required_argument, NULL, 't' },
     { "frame-threads",  required_argument, NULL, 'F' },
@@ -84,11 +85,14 @@ static const struct option long_options[] =
     { "stylish",              no_argument, NULL, 0 },
     { "output",         required_argument, NULL, 'o' },
     { "output-depth",   required_argument, NULL, 'D' },
+    { "output-queue",   required_argument, NULL, 0 },
+    { "output-prealloc", required_argument, NULL, 0 },
     { "input",          required_argument, NULL, 0 },
     { "input-depth",    required_argument, NULL, 0 },
     { "input-res",      required_argument, NULL, 0 },
     { "input-csp",      required_argument, NULL, 0 },
     { "vf",             required_argument, NULL, 0 },
+    { "vf-threads",     required_argument, NULL, 0 },
     { "interlace",      required_argument, NULL, 0 },
     { "no-interlace",         no_argument, NULL, 0 },
     { "field",                no_argument, NULL, 0 },
@@ -98,6 +102,8 @@ static const struct option long_options[] =
     { "frame-skip",     required_argument, NULL, 0 },
     { "frames",         required_argument, NULL, 'f' },
     { "reader-options", required_argument, NULL, 0 },
+    { "input-io",       required_argument, NULL, 0 },
+    { "read-ahead",     required_argument, NULL, 0 },
     { "recon",          required_argument, NULL, 'r' },
     { "recon-depth",    required_argument, NULL, 0 },
     { "no-wpp",               no_argument, NULL, 0 },
@@ -126,6 +132,9 @@ static const struct option long_options[] =
     { "early-skip",           no_argument, NULL, 0 },
     { "rskip",                required_argument, NULL, 0 },
     { "rskip-edge-threshold", required_argument, NULL, 0 },
+    { "split-predict",        no_argument, NULL, 0 },
+    { "no-split-predict",     no_argument, NULL, 0 },
+    { "split-predict-threshold", required_argument, NULL, 0 },
     { "no-fast-cbf",          no_argument, NULL, 0 },
     { "fast-cbf",             no_argument, NULL, 0 },
     { "no-tskip",             no_argument, NULL, 0 },
@@ -160,6 +169,15 @@ static const struct option long_options[] =
     { "intra-refresh",        no_argument, NULL, 0 },
     { "rc-lookahead",   required_argument, NULL, 0 },
     { "lookahead-slices", required_argument, NULL, 0 },
+    { "adaptive-lookahead", no_argument, NULL, 0 },
+    { "no-adaptive-lookahead", no_argument, NULL, 0 },
+    { "lookahead-target-fps", required_argument, NULL, 0 },
+    { "lookahead-min",  required_argument, NULL, 0 },
+    { "lookahead-save", required_argument, NULL, 0 },
+    { "lookahead-load", required_argument, NULL, 0 },
+    { "lookahead-only",       no_argument, NULL, 0 },
+    { "no-lookahead-only",    no_argument, NULL, 0 },
+    { "lookahead-batch",  required_argument, NULL, 0 },
     { "lookahead-threads", required_argument, NULL, 0 },
     { "bframes",        required_argument, NULL, 'b' },
     { "bframe-bias",    required_argument, NULL, 0 },
@@ -240,6 +258,8 @@ static const struct option long_options[] =
     { "strong-intra-smoothing",    no_argument, NULL, 0 },
     { "no-cutree",                 no_argument, NULL, 0 },
     { "cutree",                    no_argument, NULL, 0 },
+    { "no-cutree-incremental",     no_argument, NULL, 0 },
+    { "cutree-incremental",        no_argument, NULL, 0 },
     { "no-hrd",               no_argument, NULL, 0 },
     { "hrd",                  no_argument, NULL, 0 },
     { "sar",            required_argument, NULL, 0 },
@@ -367,6 +387,8 @@ static const struct option long_options[] =
     { "dup-threshold", required_argument, NULL, 0 },
     { "mcstf",                 no_argument, NULL, 0 },
     { "no-mcstf",              no_argument, NULL, 0 },
+    { "share-motion-fields",   no_argument, NULL, 0 },
+    { "no-share-motion-fields", no_argument, NULL, 0 },
 #if ENABLE_ALPHA
     { "alpha",                 no_argument, NULL, 0 },
 #endif
@@ -441,7 +463,15 @@ static const struct option long_options[] =
         int64_t prevUpdateTimeFile;
         char* vf;
         vector<Filter*> filters;
+        int filterThreads;          // frames filtered in parallel by --vf, 1 filters on the reader thread
         const char* readerOpts;
+        int inputIO;                // InputIOMode of the yuv and y4m readers
+        int readAhead;              // frames read ahead of the encoder
+        InputFileInfo inputInfo;    // view 0 as opened, ABR rungs with equal inputs share source frames
+        char inputName[1024];       // inputInfo.filename, which does not outlive parse()
+        int outputQueue;            // frames queued for the output writer thread, 0 writes synchronously
+        int outputPrealloc;         // MiB of disk to reserve for the output file
+        int64_t outputBlockedTime;  // microseconds the encode loop spent waiting on output
 
         int argCnt;
         char** orgArgv;
@@ -489,6 +519,7 @@ static const struct option long_options[] =
             prevUpdateTimeFile = 0;
             bDither = false;
             vf = NULL;
+            filterThreads = 0;
             isAbrLadderConfig = false;
             enableScaler = false;
             encName[0] = 0;
@@ -503,6 +534,13 @@ static const struct option long_options[] =
             argString = NULL;
             stringPool = NULL;
             readerOpts = NULL;
+            inputIO = INPUT_IO_FREAD;
+            readAhead = DEFAULT_READ_AHEAD;
+            memset(&inputInfo, 0, sizeof(inputInfo));
+            inputName[0] = 0;
+            outputQueue = 16;
+            outputPrealloc = 0;
+            outputBlockedTime = 0;
         }
 
         void destroy();